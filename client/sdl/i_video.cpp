@@ -491,7 +491,8 @@ static IVideoMode I_ValidateVideoMode(const IVideoMode& mode)
 
 	// If the user requested a windowed mode, we don't have to worry about
 	// the requested dimensions aligning to an actual video resolution.
-	if (mode.window_mode != WINDOW_Fullscreen || !vid_autoadjust)
+	// Neither does a headless client, which only draws into memory.
+	if (mode.window_mode != WINDOW_Fullscreen || !vid_autoadjust || I_IsHeadless())
 		return desired_mode;
 
 	// Ensure the display type is adhered to
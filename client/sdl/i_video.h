@@ -553,6 +553,9 @@ public:
 // denis - here is a blank implementation of IWindow that allows the client
 // to run without actual video output (e.g. script-controlled demo testing)
 //
+// The primary surface only lives in memory, so any requested size and bit
+// depth can be used.  -benchmark relies on this to render demos headless.
+//
 // ============================================================================
 
 class IDummyWindow : public IWindow
@@ -577,10 +580,14 @@ public:
 
 	virtual bool setMode(const IVideoMode& video_mode)
 	{
-		if (mPrimarySurface == NULL)
+		if (mPrimarySurface == NULL || video_mode != mVideoMode)
 		{
-			// ignore the requested mode and setup the hardcoded mode
-			mPrimarySurface = I_AllocateSurface(mVideoMode.width, mVideoMode.height, mVideoMode.bpp);
+			// allocate before freeing, I_AllocateSurface may look at the old one
+			IWindowSurface* surface = I_AllocateSurface(video_mode.width, video_mode.height, video_mode.bpp);
+			delete mPrimarySurface;
+			mPrimarySurface = surface;
+			mVideoMode = video_mode;
+			mPixelFormat = *mPrimarySurface->getPixelFormat();
 		}
 		return mPrimarySurface != NULL;
 	}
@@ -1240,6 +1240,18 @@ void C_FlushDisplay()
 		NotifyStrings[i].timeout = 0;
 }
 
+//
+// C_FlushLog
+//
+// The client writes to the log file as it prints, so there is never
+// anything waiting.
+//
+void C_FlushLog()
+{
+	if (LOG.is_open())
+		LOG.flush();
+}
+
 void C_Ticker()
 {
 	int surface_height = I_GetSurfaceHeight();
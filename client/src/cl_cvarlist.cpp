@@ -675,6 +675,9 @@ CVAR_FUNC_DECL(	vid_filter, "", "Set render scale quality setting for SDL 2.0, o
 CVAR_FUNC_DECL(	r_optimize, "detect", "Rendering optimizations",
 				CVARTYPE_STRING, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE)
 
+CVAR_RANGE_FUNC_DECL(r_drawthreads, "0", "Number of extra threads used to draw the view",
+				CVARTYPE_INT, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 32.0f)
+
 CVAR_RANGE_FUNC_DECL(screenblocks, "10", "Selects the size of the visible window",
 				CVARTYPE_BYTE, CVAR_CLIENTARCHIVE | CVAR_NOENABLEDISABLE, 3.0f, 12.0f)
 
@@ -35,6 +35,7 @@
 #include "gi.h"
 #include "i_net.h"
 #include "i_system.h"
+#include "stats.h"
 #include "c_dispatch.h"
 #include "st_stuff.h"
 #include "m_argv.h"
@@ -679,6 +680,7 @@ void CL_StepTics(unsigned int count)
 			netdemo.ticker();
 	}
 
+	DThinker::ReclaimLingering ();
 	DObject::EndFrame ();
 }
 
@@ -695,6 +697,8 @@ void CL_DisplayTics()
 //
 void CL_RunTics()
 {
+	PROFILE_ZONE("CL_RunTics");
+
 	std::string cmd = I_ConsoleInput();
 	if (cmd.length())
 		AddCommandString(cmd);
@@ -107,7 +107,7 @@ static void NetGraphDrawBar(int startx, int starty, int width, int height, int c
 	dspan.x2 = startx + width - 1;
 
 	for (dspan.y = starty; dspan.y < starty + height; dspan.y++)
-		R_FillSpan();
+		R_FillSpan(dspan);
 }
 
 void NetGraph::drawWorldIndexSync(int x, int y)
@@ -82,6 +82,7 @@
 #include "stats.h"
 #include "p_ctf.h"
 #include "cl_main.h"
+#include "r_bench.h"
 
 #include "w_ident.h"
 
@@ -212,10 +213,14 @@ void D_DisplayTicker()
 //
 void D_Display()
 {
-	if (nodrawers || I_IsHeadless())
+	// -benchmark still draws headless, into the dummy window's surface
+	if (nodrawers || (I_IsHeadless() && !benchmarking))
 		return; 				// for comparative timing / profiling
 
-	BEGIN_STAT(D_Display);
+	PROFILE_ZONE("D_Display");
+
+	if (benchmarking)
+		R_BenchmarkStartFrame();
 
 	// video mode must be changed before surfaces are locked in I_BeginUpdate
 	V_AdjustVideoMode();
@@ -255,6 +260,11 @@ void D_Display()
 
 			// Drawn to R_GetRenderingSurface()
 			R_RenderPlayerView(&displayplayer());
+
+			if (drawqueue_checkframes > 0)
+				R_CheckDrawQueue(&displayplayer());
+
+			R_BeginBenchPhase(BENCH_HUD);
 			R_DrawViewBorder();
 			ST_Drawer();
 
@@ -268,6 +278,7 @@ void D_Display()
 			HU_Drawer();
 			C_DrawMid();
 			C_DrawGMid();
+			R_EndBenchPhase();
 			break;
 
 		case GS_INTERMISSION:
@@ -320,9 +331,12 @@ void D_Display()
 
 	C_DrawConsole();	// draw console
 	M_Drawer();			// menu is drawn even on top of everything
-	I_FinishUpdate();	// page flip or blit buffer
 
-	END_STAT(D_Display);
+	// hash the frame before I_FinishUpdate draws the fps counters over it
+	if (benchmarking)
+		R_BenchmarkEndFrame();
+
+	I_FinishUpdate();	// page flip or blit buffer
 }
 
 //
@@ -881,6 +895,11 @@ void D_DoomMain()
 	{
 		singledemo = true;
 		G_TimeDemo(Args.GetArg(p + 1));
+
+		// -benchmark writes the timings and hash of every frame to a file
+		int bench = Args.CheckParm("-benchmark");
+		if (bench && bench < Args.NumArgs() - 1)
+			R_StartBenchmark(Args.GetArg(p + 1), Args.GetArg(bench + 1));
 	}
 
 	// denis - this will run a demo and quit
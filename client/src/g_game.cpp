@@ -52,6 +52,7 @@
 #include "w_wad.h"
 #include "p_local.h"
 #include "s_sound.h"
+#include "stats.h"
 #include "s_sndseq.h"
 #include "gstrings.h"
 #include "r_sky.h"
@@ -62,6 +63,7 @@
 #include "cl_demo.h"
 #include "gi.h"
 #include "hu_mousegraph.h"
+#include "r_bench.h"
 
 #ifdef _XBOX
 #include "i_xbox.h"
@@ -753,6 +755,8 @@ extern int connecttimeout;
 
 void G_Ticker (void)
 {
+	PROFILE_ZONE("G_Ticker");
+
 	int 		buf;
 
 	// Turn off no-z-snapping for all players.
@@ -2184,6 +2188,8 @@ BOOL G_CheckDemoStatus (void)
 				Printf(PRINT_HIGH, "timed %i gametics in %i realtics (%.1f fps)\n",
 						gametic, realtics, fps);
 
+				R_FinishBenchmark(gametic, realtics);
+
 				// exit the application
 				CL_QuitCommand();
 				return false;
@@ -561,15 +561,10 @@ void G_DoLoadLevel (int position)
 		it->points = 0;
 	}
 
-	// initialize the msecnode_t freelist.					phares 3/25/98
-	// any nodes in the freelist are gone by now, cleared
-	// by Z_FreeTags() when the previous level ended or player
-	// died.
+	// the msecnode_t pool is cleared by P_SetupLevel() along with the
+	// rest of the level's memory.
 
 	{
-		extern msecnode_t *headsecnode; // phares 3/25/98
-		headsecnode = NULL;
-
 		// denis - todo - wtf is this crap?
 		// [RH] Need to prevent the AActor destructor from trying to
 		//		free the nodes
@@ -0,0 +1,403 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//
+// Render benchmark for -timedemo
+//
+// With -benchmark <file>, every frame -timedemo draws of the level is timed,
+// split into the phases in benchphase_t, and the finished screen is hashed.
+// The results are written to <file> as JSON when the demo ends so that runs
+// from different builds can be compared.  -timedemo runs one gametic per
+// frame without interpolation, so the same demo gives the same frames and
+// the hashes show whether a change altered the picture.
+//
+// Combine with -novideo to render into memory without opening a window, and
+// -width, -height and -bits to pick the resolution and bit depth.
+//
+// The checkdrawqueue command checks that the draw queue draws the same
+// picture as drawing without it, using the same hashes.
+//
+//-----------------------------------------------------------------------------
+
+#include <assert.h>
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "json/json.h"
+
+#include "doomtype.h"
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "cmdlib.h"
+#include "i_system.h"
+#include "i_video.h"
+#include "md5.h"
+#include "r_main.h"
+#include "r_draw.h"
+#include "r_bench.h"
+
+EXTERN_CVAR(r_optimize)
+EXTERN_CVAR(r_drawthreads)
+
+bool benchmarking = false;
+
+static const char* phase_names[NUMBENCHPHASES] =
+{
+	"bsp", "segs", "planes", "masked", "drawqueue", "hud"
+};
+
+OProfileZone bench_zones[NUMBENCHPHASES] =
+{
+	{ "R_RenderBSPNode" }, { "R_StoreWallRange" }, { "R_DrawPlanes" },
+	{ "R_DrawMasked" }, { "R_EndDrawQueue" }, { "HUD" }
+};
+
+struct benchframe_t
+{
+	int			gametic;
+	dtime_t		frametime;
+	dtime_t		phasetime[NUMBENCHPHASES];
+	std::string	hash;
+};
+
+static std::string bench_demoname;
+static std::string bench_filename;
+static std::vector<benchframe_t> bench_frames;
+
+static benchframe_t bench_frame;
+static dtime_t bench_framestart;
+
+// Phases currently being timed, innermost last
+static const int MAXPHASEDEPTH = 8;
+static benchphase_t phase_stack[MAXPHASEDEPTH];
+static int phase_depth;
+static dtime_t phase_start;
+
+
+//
+// R_StartBenchmark
+//
+void R_StartBenchmark(const char* demoname, const char* filename)
+{
+	bench_demoname = demoname;
+	bench_filename = filename;
+	bench_frames.clear();
+	phase_depth = 0;
+	benchmarking = true;
+
+	Printf(PRINT_HIGH, "Benchmarking %s, results will be written to %s\n", demoname, filename);
+}
+
+
+//
+// R_BenchmarkPushPhase
+//
+void R_BenchmarkPushPhase(benchphase_t phase)
+{
+	dtime_t now = I_GetTime();
+
+	if (phase_depth > 0)
+		bench_frame.phasetime[phase_stack[phase_depth - 1]] += now - phase_start;
+
+	assert(phase_depth < MAXPHASEDEPTH);
+	phase_stack[phase_depth++] = phase;
+	phase_start = now;
+}
+
+
+//
+// R_BenchmarkPopPhase
+//
+void R_BenchmarkPopPhase()
+{
+	dtime_t now = I_GetTime();
+
+	assert(phase_depth > 0);
+	bench_frame.phasetime[phase_stack[--phase_depth]] += now - phase_start;
+	phase_start = now;
+}
+
+
+//
+// R_BenchmarkStartFrame
+//
+void R_BenchmarkStartFrame()
+{
+	bench_frame.gametic = gametic;
+	for (int i = 0; i < NUMBENCHPHASES; i++)
+		bench_frame.phasetime[i] = 0;
+	phase_depth = 0;
+
+	bench_framestart = I_GetTime();
+}
+
+
+//
+// R_HashSurface
+//
+// Returns the MD5 hash of the visible pixels of a surface.
+//
+static std::string R_HashSurface(const IWindowSurface* surface)
+{
+	md5_state_t state;
+	md5_byte_t digest[16];
+
+	md5_init(&state);
+
+	const int rowsize = surface->getWidth() * surface->getBytesPerPixel();
+	for (int y = 0; y < surface->getHeight(); y++)
+		md5_append(&state, surface->getBuffer(0, y), rowsize);
+
+	md5_finish(&state, digest);
+
+	std::string hash;
+	for (int i = 0; i < 16; i++)
+	{
+		char hex[3];
+		sprintf(hex, "%02x", digest[i]);
+		hash += hex;
+	}
+	return hash;
+}
+
+
+//
+// R_BenchmarkEndFrame
+//
+// Records the frame that was just drawn.  Only frames showing the level are
+// kept, the rest do not exercise the renderer.
+//
+void R_BenchmarkEndFrame()
+{
+	bench_frame.frametime = I_GetTime() - bench_framestart;
+
+	if (gamestate != GS_LEVEL || gametic == 0)
+		return;
+
+	bench_frame.hash = R_HashSurface(I_GetPrimarySurface());
+	bench_frames.push_back(bench_frame);
+}
+
+
+//
+// R_BenchmarkSummary
+//
+// Returns the total, mean, median, 99th percentile and maximum of a list of
+// times, in milliseconds.
+//
+static Json::Value R_BenchmarkSummary(std::vector<dtime_t>& times)
+{
+	Json::Value summary(Json::objectValue);
+	if (times.empty())
+		return summary;
+
+	std::sort(times.begin(), times.end());
+
+	dtime_t total = 0;
+	for (size_t i = 0; i < times.size(); i++)
+		total += times[i];
+
+	summary["total_ms"] = total / 1e6;
+	summary["mean_ms"] = total / 1e6 / times.size();
+	summary["p50_ms"] = times[times.size() / 2] / 1e6;
+	summary["p99_ms"] = times[std::min(times.size() - 1, times.size() * 99 / 100)] / 1e6;
+	summary["max_ms"] = times.back() / 1e6;
+	return summary;
+}
+
+
+//
+// R_FinishBenchmark
+//
+// Writes the results of the benchmark to the file given to -benchmark.
+//
+void R_FinishBenchmark(int gametics, int realtics)
+{
+	if (!benchmarking)
+		return;
+	benchmarking = false;
+
+	const IWindowSurface* surface = I_GetPrimarySurface();
+
+	Json::Value root(Json::objectValue);
+	root["demo"] = bench_demoname;
+	root["width"] = surface->getWidth();
+	root["height"] = surface->getHeight();
+	root["bpp"] = surface->getBitsPerPixel();
+	root["video_driver"] = I_GetVideoDriverName();
+	root["r_optimize"] = r_optimize.cstring();
+	root["r_drawthreads"] = r_drawthreads.asInt();
+	root["gametics"] = gametics;
+	root["realtics"] = realtics;
+
+	std::vector<dtime_t> times(bench_frames.size());
+
+	Json::Value& summary = root["summary"];
+	for (size_t i = 0; i < bench_frames.size(); i++)
+		times[i] = bench_frames[i].frametime;
+	summary["frame"] = R_BenchmarkSummary(times);
+
+	for (int phase = 0; phase < NUMBENCHPHASES; phase++)
+	{
+		for (size_t i = 0; i < bench_frames.size(); i++)
+			times[i] = bench_frames[i].phasetime[phase];
+		summary[phase_names[phase]] = R_BenchmarkSummary(times);
+	}
+
+	Json::Value& frames = root["frames"];
+	frames = Json::Value(Json::arrayValue);
+	for (size_t i = 0; i < bench_frames.size(); i++)
+	{
+		const benchframe_t& frame = bench_frames[i];
+
+		Json::Value entry(Json::objectValue);
+		entry["gametic"] = frame.gametic;
+		entry["frame_ms"] = frame.frametime / 1e6;
+		for (int phase = 0; phase < NUMBENCHPHASES; phase++)
+			entry[std::string(phase_names[phase]) + "_ms"] = frame.phasetime[phase] / 1e6;
+		entry["hash"] = frame.hash;
+
+		frames.append(entry);
+	}
+
+	std::ofstream out(bench_filename.c_str());
+	Json::StyledStreamWriter writer;
+	writer.write(out, root);
+	out.close();
+
+	if (out.fail())
+		Printf(PRINT_HIGH, "Could not write benchmark results to %s\n", bench_filename.c_str());
+	else
+		Printf(PRINT_HIGH, "Benchmark of %u frames written to %s\n",
+				(unsigned int)bench_frames.size(), bench_filename.c_str());
+
+	bench_frames.clear();
+}
+
+
+// ============================================================================
+//
+// Draw queue check
+//
+// Each frame checked is drawn again from scratch, twice without the draw
+// queue and then once through it for every number of draw threads up to the
+// one asked for.  The hashes of the pictures drawn through the queue have to
+// match the one drawn without it.  A frame that does not come out the same
+// when drawn twice without the queue cannot be compared and is skipped.
+//
+// ============================================================================
+
+int drawqueue_checkframes = 0;
+
+static size_t drawqueue_checkthreads;
+static int drawqueue_checked, drawqueue_skipped, drawqueue_differed;
+
+
+//
+// R_HashView
+//
+// Draws the view with a number of draw threads and returns the hash of the
+// surface it was drawn to.
+//
+static std::string R_HashView(player_t* player, size_t threads)
+{
+	IWindowSurface* surface = R_GetRenderingSurface();
+
+	// clear the view so that pixels the view does not draw, like HOM,
+	// do not keep what the last draw left there
+	surface->getDefaultCanvas()->Clear(viewwindowx, viewwindowy,
+			viewwindowx + viewwidth - 1, viewwindowy + viewheight - 1, argb_t(0, 0, 0));
+
+	R_SetDrawThreads(threads);
+	R_ResetFuzzTable();
+	R_RenderPlayerView(player);
+
+	return R_HashSurface(surface);
+}
+
+
+//
+// R_CheckDrawQueue
+//
+// Called by D_Display after the view has been drawn while checkdrawqueue
+// has frames left to check.
+//
+void R_CheckDrawQueue(player_t* player)
+{
+	if (drawqueue_checkframes <= 0)
+		return;
+
+	const std::string serial = R_HashView(player, 0);
+
+	if (R_HashView(player, 0) != serial)
+	{
+		Printf(PRINT_HIGH, "Frame at gametic %d is not drawn the same twice, skipping it\n",
+				gametic);
+		drawqueue_skipped++;
+	}
+	else
+	{
+		for (size_t threads = 1; threads <= drawqueue_checkthreads; threads++)
+		{
+			const std::string hash = R_HashView(player, threads);
+			if (hash != serial)
+			{
+				Printf(PRINT_HIGH, "Frame at gametic %d differs with %u draw threads: %s, not %s\n",
+						gametic, (unsigned int)threads, hash.c_str(), serial.c_str());
+				drawqueue_differed++;
+			}
+		}
+
+		drawqueue_checked++;
+	}
+
+	R_SetDrawThreads(r_drawthreads.asInt());
+
+	if (--drawqueue_checkframes == 0)
+		Printf(PRINT_HIGH, "Checked %d frames with 1 to %u draw threads, %d differed and %d were skipped\n",
+				drawqueue_checked, (unsigned int)drawqueue_checkthreads,
+				drawqueue_differed, drawqueue_skipped);
+}
+
+
+//
+// checkdrawqueue
+//
+// Checks the next frames of the level, one by default, as described above.
+// Run it while a demo plays back to check many different views.
+//
+BEGIN_COMMAND (checkdrawqueue)
+{
+	if (argc < 2)
+	{
+		Printf(PRINT_HIGH, "checkdrawqueue <threads> [frames]\n");
+		return;
+	}
+
+	drawqueue_checkthreads = clamp(atoi(argv[1]), 1, 32);
+	drawqueue_checkframes = argc > 2 ? MAX(atoi(argv[2]), 1) : 1;
+	drawqueue_checked = drawqueue_skipped = drawqueue_differed = 0;
+}
+END_COMMAND (checkdrawqueue)
+
+
+VERSION_CONTROL (r_bench_cpp, "$Id$")
@@ -0,0 +1,86 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//
+// Render benchmark for -timedemo
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __R_BENCH_H__
+#define __R_BENCH_H__
+
+#include "stats.h"
+
+class player_s;
+typedef player_s player_t;
+
+enum benchphase_t
+{
+	BENCH_BSP,
+	BENCH_SEGS,
+	BENCH_PLANES,
+	BENCH_MASKED,
+	BENCH_DRAWQUEUE,
+	BENCH_HUD,
+	NUMBENCHPHASES
+};
+
+extern bool benchmarking;
+
+// The profiler zone for each phase
+extern OProfileZone bench_zones[NUMBENCHPHASES];
+
+void R_StartBenchmark(const char* demoname, const char* filename);
+void R_FinishBenchmark(int gametics, int realtics);
+
+void R_BenchmarkStartFrame();
+void R_BenchmarkEndFrame();
+
+void R_BenchmarkPushPhase(benchphase_t phase);
+void R_BenchmarkPopPhase();
+
+// The number of frames checkdrawqueue still has to check
+extern int drawqueue_checkframes;
+
+void R_CheckDrawQueue(player_t* player);
+
+//
+// R_BeginBenchPhase / R_EndBenchPhase
+//
+// Time spent between these is added to the given phase.  Phases can nest,
+// in which case the time of the inner phase is not counted in the outer.
+// The phase is also timed as a zone when the profiler is on.
+//
+inline void R_BeginBenchPhase(benchphase_t phase)
+{
+	if (benchmarking)
+		R_BenchmarkPushPhase(phase);
+	if (profiling)
+		Stat_EnterZone(bench_zones[phase]);
+}
+
+inline void R_EndBenchPhase()
+{
+	if (profiling)
+		Stat_LeaveZone();
+	if (benchmarking)
+		R_BenchmarkPopPhase();
+}
+
+#endif // __R_BENCH_H__
@@ -26,6 +26,7 @@
 #include <stddef.h>
 #include <assert.h>
 #include <algorithm>
+#include <vector>
 
 #include "i_sdl.h"
 #include "r_intrin.h"
@@ -37,6 +38,9 @@
 #include "i_video.h"
 #include "v_video.h"
 #include "doomstat.h"
+#include "i_thread.h"
+#include "i_system.h"
+#include "c_dispatch.h"
 
 #include "gi.h"
 #include "v_text.h"
@@ -76,19 +80,21 @@ int 			viewwindowy;
 // [RH] Pointers to the different column drawers.
 //		These get changed depending on the current
 //		screen depth.
-void (*R_DrawColumn)(void);
-void (*R_DrawFuzzColumn)(void);
-void (*R_DrawTranslucentColumn)(void);
-void (*R_DrawTranslatedColumn)(void);
-void (*R_DrawSpan)(void);
-void (*R_DrawSlopeSpan)(void);
-void (*R_FillColumn)(void);
-void (*R_FillSpan)(void);
-void (*R_FillTranslucentSpan)(void);
+void (*R_DrawColumn)(drawcolumn_t&);
+void (*R_DrawFuzzColumn)(drawcolumn_t&);
+void (*R_DrawTranslucentColumn)(drawcolumn_t&);
+void (*R_DrawTranslatedColumn)(drawcolumn_t&);
+void (*R_DrawSpan)(drawspan_t&);
+void (*R_DrawSlopeSpan)(drawspan_t&);
+void (*R_FillColumn)(drawcolumn_t&);
+void (*R_FillSpan)(drawspan_t&);
+void (*R_FillTranslucentSpan)(drawspan_t&);
 
 // Possibly vectorized functions:
-void (*R_DrawSpanD)(void);
-void (*R_DrawSlopeSpanD)(void);
+void (*R_DrawTranslucentColumnD)(drawcolumn_t&);
+void (*R_DrawTranslatedColumnD)(drawcolumn_t&);
+void (*R_DrawSpanD)(drawspan_t&);
+void (*R_DrawSlopeSpanD)(drawspan_t&);
 void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
 // ============================================================================
@@ -107,6 +113,11 @@ class FuzzTable
 public:
 	FuzzTable() : pos(0) { }
 
+	forceinline void reset()
+	{
+		pos = 0;
+	}
+
 	forceinline void incrementRow()
 	{
 		pos = (pos + 1) % FuzzTable::size;
@@ -144,6 +155,17 @@ const int FuzzTable::table[FuzzTable::size] = {
 
 static FuzzTable fuzztable;
 
+//
+// R_ResetFuzzTable
+//
+// Starts the fuzz effect from the beginning of the table, so that drawing
+// the same view twice draws the same fuzz.
+//
+void R_ResetFuzzTable()
+{
+	fuzztable.reset();
+}
+
 
 // ============================================================================
 //
@@ -429,7 +451,7 @@ void R_BuildPlayerTranslation(int player, argb_t dest_color)
 // [SL] - Does nothing (obviously). Used when a column drawing function
 // pointer should not draw anything.
 //
-void R_BlankColumn()
+void R_BlankColumn(drawcolumn_t& drawcolumn)
 {
 }
 
@@ -439,7 +461,7 @@ void R_BlankColumn()
 // [SL] - Does nothing (obviously). Used when a span drawing function
 // pointer should not draw anything.
 //
-void R_BlankSpan()
+void R_BlankSpan(drawspan_t& drawspan)
 {
 }
 
@@ -934,7 +956,8 @@ private:
 //
 // ----------------------------------------------------------------------------
 
-#define FB_COLDEST_P ((palindex_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+#define FB_COLDEST_P(drawcolumn) \
+	((palindex_t*)(drawcolumn).destination + (drawcolumn).yl * (drawcolumn).pitch_in_pixels + (drawcolumn).x)
 
 //
 // R_FillColumnP
@@ -942,9 +965,9 @@ private:
 // Fills a column in the 8bpp palettized screen buffer with a solid color,
 // determined by dcol.color. Performs no shading.
 //
-void R_FillColumnP()
+void R_FillColumnP(drawcolumn_t& drawcolumn)
 {
-	R_FillColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, dcol);
+	R_FillColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 }
 
 //
@@ -953,9 +976,9 @@ void R_FillColumnP()
 // Renders a column to the 8bpp palettized screen buffer from the source buffer
 // dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
 //
-void R_DrawColumnP()
+void R_DrawColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 }
 
 //
@@ -964,9 +987,9 @@ void R_DrawColumnP()
 // Renders a column to the 8bpp palettized screen buffer from the source buffer
 // dcol.source and scaled by dcol.iscale. Performs no shading.
 //
-void R_StretchColumnP()
+void R_StretchColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 }
 
 //
@@ -976,15 +999,15 @@ void R_StretchColumnP()
 // invisibility effect, which shades the column and rearranges the ordering
 // the pixels to create distortion. Shading is performed using colormap 6.
 //
-void R_DrawFuzzColumnP()
+void R_DrawFuzzColumnP(drawcolumn_t& drawcolumn)
 {
 	// adjust the borders (prevent buffer over/under-reads)
-	if (dcol.yl <= 0)
-		dcol.yl = 1;
-	if (dcol.yh >= viewheight - 1)
-		dcol.yh = viewheight - 2;
+	if (drawcolumn.yl <= 0)
+		drawcolumn.yl = 1;
+	if (drawcolumn.yh >= viewheight - 1)
+		drawcolumn.yh = viewheight - 2;
 
-	R_FillColumnGeneric<palindex_t, PaletteFuzzyFunc>(FB_COLDEST_P, dcol);
+	R_FillColumnGeneric<palindex_t, PaletteFuzzyFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 	fuzztable.incrementColumn();
 }
 
@@ -996,9 +1019,9 @@ void R_DrawFuzzColumnP()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
-void R_DrawTranslucentColumnP()
+void R_DrawTranslucentColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 }
 
 //
@@ -1008,9 +1031,9 @@ void R_DrawTranslucentColumnP()
 // from the source buffer dcol.source and scaled by dcol.iscale. The translation
 // table is supplied by dcol.translation. Shading is performed using dcol.colormap.
 //
-void R_DrawTranslatedColumnP()
+void R_DrawTranslatedColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslatedColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteTranslatedColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 }
 
 //
@@ -1022,9 +1045,9 @@ void R_DrawTranslatedColumnP()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
-void R_DrawTlatedLucentColumnP()
+void R_DrawTlatedLucentColumnP(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(FB_COLDEST_P, dcol);
+	R_DrawColumnGeneric<palindex_t, PaletteTranslatedTranslucentColormapFunc>(FB_COLDEST_P(drawcolumn), drawcolumn);
 }
 
 
@@ -1034,7 +1057,8 @@ void R_DrawTlatedLucentColumnP()
 //
 // ----------------------------------------------------------------------------
 
-#define FB_SPANDEST_P ((palindex_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1)
+#define FB_SPANDEST_P(drawspan) \
+	((palindex_t*)(drawspan).destination + (drawspan).y * (drawspan).pitch_in_pixels + (drawspan).x1)
 
 //
 // R_FillSpanP
@@ -1042,9 +1066,9 @@ void R_DrawTlatedLucentColumnP()
 // Fills a span in the 8bpp palettized screen buffer with a solid color,
 // determined by dspan.color. Performs no shading.
 //
-void R_FillSpanP()
+void R_FillSpanP(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<palindex_t, PaletteFunc>(FB_SPANDEST_P, dspan);
+	R_FillSpanGeneric<palindex_t, PaletteFunc>(FB_SPANDEST_P(drawspan), drawspan);
 }
 
 //
@@ -1054,9 +1078,9 @@ void R_FillSpanP()
 // determined by dspan.color using translucency. Shading is performed 
 // using dspan.colormap.
 //
-void R_FillTranslucentSpanP()
+void R_FillTranslucentSpanP(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_SPANDEST_P, dspan);
+	R_FillSpanGeneric<palindex_t, PaletteTranslucentColormapFunc>(FB_SPANDEST_P(drawspan), drawspan);
 }
 
 //
@@ -1065,9 +1089,9 @@ void R_FillTranslucentSpanP()
 // Renders a span for a level plane to the 8bpp palettized screen buffer from
 // the source buffer dspan.source. Shading is performed using dspan.colormap.
 //
-void R_DrawSpanP()
+void R_DrawSpanP(drawspan_t& drawspan)
 {
-	R_DrawLevelSpanGeneric<palindex_t, PaletteColormapFunc>(FB_SPANDEST_P, dspan);
+	R_DrawLevelSpanGeneric<palindex_t, PaletteColormapFunc>(FB_SPANDEST_P(drawspan), drawspan);
 }
 
 //
@@ -1076,9 +1100,9 @@ void R_DrawSpanP()
 // Renders a span for a sloped plane to the 8bpp palettized screen buffer from
 // the source buffer dspan.source. Shading is performed using dspan.colormap.
 //
-void R_DrawSlopeSpanP()
+void R_DrawSlopeSpanP(drawspan_t& drawspan)
 {
-	R_DrawSlopedSpanGeneric<palindex_t, PaletteSlopeColormapFunc>(FB_SPANDEST_P, dspan);
+	R_DrawSlopedSpanGeneric<palindex_t, PaletteSlopeColormapFunc>(FB_SPANDEST_P(drawspan), drawspan);
 }
 
 
@@ -1232,7 +1256,8 @@ private:
 //
 // ----------------------------------------------------------------------------
 
-#define FB_COLDEST_D ((argb_t*)dcol.destination + dcol.yl * dcol.pitch_in_pixels + dcol.x)
+#define FB_COLDEST_D(drawcolumn) \
+	((argb_t*)(drawcolumn).destination + (drawcolumn).yl * (drawcolumn).pitch_in_pixels + (drawcolumn).x)
 
 //
 // R_FillColumnD
@@ -1240,9 +1265,9 @@ private:
 // Fills a column in the 32bpp ARGB8888 screen buffer with a solid color,
 // determined by dcol.color. Performs no shading.
 //
-void R_FillColumnD()
+void R_FillColumnD(drawcolumn_t& drawcolumn)
 {
-	R_FillColumnGeneric<argb_t, DirectFunc>(FB_COLDEST_D, dcol);
+	R_FillColumnGeneric<argb_t, DirectFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
 }
 
 //
@@ -1251,9 +1276,9 @@ void R_FillColumnD()
 // Renders a column to the 32bpp ARGB8888 screen buffer from the source buffer
 // dcol.source and scaled by dcol.iscale. Shading is performed using dcol.colormap.
 //
-void R_DrawColumnD()
+void R_DrawColumnD(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
 }
 
 //
@@ -1263,41 +1288,41 @@ void R_DrawColumnD()
 // invisibility effect, which shades the column and rearranges the ordering
 // the pixels to create distortion. Shading is performed using colormap 6.
 //
-void R_DrawFuzzColumnD()
+void R_DrawFuzzColumnD(drawcolumn_t& drawcolumn)
 {
 	// adjust the borders (prevent buffer over/under-reads)
-	if (dcol.yl <= 0)
-		dcol.yl = 1;
-	if (dcol.yh >= viewheight - 1)
-		dcol.yh = viewheight - 2;
+	if (drawcolumn.yl <= 0)
+		drawcolumn.yl = 1;
+	if (drawcolumn.yh >= viewheight - 1)
+		drawcolumn.yh = viewheight - 2;
 
-	R_FillColumnGeneric<argb_t, DirectFuzzyFunc>(FB_COLDEST_D, dcol);
+	R_FillColumnGeneric<argb_t, DirectFuzzyFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
 	fuzztable.incrementColumn();
 }
 
 //
-// R_DrawTranslucentColumnD
+// R_DrawTranslucentColumnD_c
 //
 // Renders a translucent column to the 32bpp ARGB8888 screen buffer from the
 // source buffer dcol.source and scaled by dcol.iscale. The amount of
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
-void R_DrawTranslucentColumnD()
+void R_DrawTranslucentColumnD_c(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectTranslucentColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
 }
 
 //
-// R_DrawTranslatedColumnD
+// R_DrawTranslatedColumnD_c
 //
 // Renders a column to the 32bpp ARGB8888 screen buffer with color-remapping
 // from the source buffer dcol.source and scaled by dcol.iscale. The translation
 // table is supplied by dcol.translation. Shading is performed using dcol.colormap.
 //
-void R_DrawTranslatedColumnD()
+void R_DrawTranslatedColumnD_c(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectTranslatedColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
 }
 
 //
@@ -1309,9 +1334,9 @@ void R_DrawTranslatedColumnD()
 // translucency is controlled by dcol.translevel. Shading is performed using
 // dcol.colormap.
 //
-void R_DrawTlatedLucentColumnD()
+void R_DrawTlatedLucentColumnD(drawcolumn_t& drawcolumn)
 {
-	R_DrawColumnGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(FB_COLDEST_D, dcol);
+	R_DrawColumnGeneric<argb_t, DirectTranslatedTranslucentColormapFunc>(FB_COLDEST_D(drawcolumn), drawcolumn);
 }
 
 
@@ -1321,7 +1346,8 @@ void R_DrawTlatedLucentColumnD()
 //
 // ----------------------------------------------------------------------------
 
-#define FB_SPANDEST_D ((argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1)
+#define FB_SPANDEST_D(drawspan) \
+	((argb_t*)(drawspan).destination + (drawspan).y * (drawspan).pitch_in_pixels + (drawspan).x1)
 
 //
 // R_FillSpanD
@@ -1329,9 +1355,9 @@ void R_DrawTlatedLucentColumnD()
 // Fills a span in the 32bpp ARGB8888 screen buffer with a solid color,
 // determined by dspan.color. Performs no shading.
 //
-void R_FillSpanD()
+void R_FillSpanD(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<argb_t, DirectFunc>(FB_SPANDEST_D, dspan);
+	R_FillSpanGeneric<argb_t, DirectFunc>(FB_SPANDEST_D(drawspan), drawspan);
 }
 
 //
@@ -1341,9 +1367,9 @@ void R_FillSpanD()
 // determined by dspan.color using translucency. Shading is performed 
 // using dspan.colormap.
 //
-void R_FillTranslucentSpanD()
+void R_FillTranslucentSpanD(drawspan_t& drawspan)
 {
-	R_FillSpanGeneric<argb_t, DirectTranslucentColormapFunc>(FB_SPANDEST_D, dspan);
+	R_FillSpanGeneric<argb_t, DirectTranslucentColormapFunc>(FB_SPANDEST_D(drawspan), drawspan);
 }
 
 //
@@ -1352,9 +1378,9 @@ void R_FillTranslucentSpanD()
 // Renders a span for a level plane to the 32bpp ARGB8888 screen buffer from
 // the source buffer dspan.source. Shading is performed using dspan.colormap.
 //
-void R_DrawSpanD_c()
+void R_DrawSpanD_c(drawspan_t& drawspan)
 {
-	R_DrawLevelSpanGeneric<argb_t, DirectColormapFunc>(FB_SPANDEST_D, dspan);
+	R_DrawLevelSpanGeneric<argb_t, DirectColormapFunc>(FB_SPANDEST_D(drawspan), drawspan);
 }
 
 //
@@ -1363,9 +1389,316 @@ void R_DrawSpanD_c()
 // Renders a span for a sloped plane to the 32bpp ARGB8888 screen buffer from
 // the source buffer dspan.source. Shading is performed using dspan.colormap.
 //
-void R_DrawSlopeSpanD_c()
+void R_DrawSlopeSpanD_c(drawspan_t& drawspan)
+{
+	R_DrawSlopedSpanGeneric<argb_t, DirectSlopeColormapFunc>(FB_SPANDEST_D(drawspan), drawspan);
+}
+
+
+// ============================================================================
+//
+// Draw Queue
+//
+// With r_drawthreads set, the drawers are not called while the view is being
+// drawn.  Each column and span is recorded instead, and R_FlushDrawQueue
+// splits the view into vertical slices that are drawn at the same time by
+// the draw threads.  A slice replays the draws that touch it in the order
+// they were recorded, so every pixel is written in the same order as when
+// drawing without threads and the picture comes out the same.  Fuzz columns
+// read pixels from neighbouring columns, so the queue is flushed and they are
+// drawn straight away.
+//
+// Walking the BSP, clipping and building the visplanes and sprites is still
+// done by the calling thread as before; only the pixel pushing is split up.
+//
+// ============================================================================
+
+// the narrowest slice worth handing to a thread
+static const int DRAWQUEUE_MINSLICEWIDTH = 32;
+
+// slices per thread, so that a thread that finishes early can help out
+static const int DRAWQUEUE_SLICESPERTHREAD = 4;
+
+struct queuedcolumn_t
+{
+	void				(*drawfunc)(drawcolumn_t&);
+	drawcolumn_t		drawcolumn;
+};
+
+struct queuedspan_t
+{
+	void				(*drawfunc)(drawspan_t&);
+	drawspan_t			drawspan;
+
+	// sloped spans are drawn when they are queued and only copied to
+	// the screen later, starting from this offset in queued_pixels
+	size_t				pixels;
+	bool				sloped;
+};
+
+struct slicedraw_t
+{
+	size_t				index;
+	bool				span;
+};
+
+static OWorkerPool draw_pool;
+static bool drawqueue_active = false;
+
+static int slicewidth;
+static int bytesperpixel;
+static std::vector< std::vector<slicedraw_t> > slicedraws;
+
+static std::vector<queuedcolumn_t> queued_columns;
+static std::vector<queuedspan_t> queued_spans;
+static std::vector<byte> queued_pixels;
+
+//
+// R_SetDrawThreads
+//
+// Sets the number of extra threads used to draw the view.
+//
+void R_SetDrawThreads(size_t count)
+{
+	R_EndDrawQueue();
+	draw_pool.resize(count);
+}
+
+//
+// R_BeginDrawQueue
+//
+// Starts recording the draws for the view if there are any draw threads.
+//
+void R_BeginDrawQueue()
+{
+	if (drawqueue_active || draw_pool.size() == 0 || viewwidth <= 0)
+		return;
+
+	int numslices = (int)(draw_pool.size() + 1) * DRAWQUEUE_SLICESPERTHREAD;
+	numslices = clamp(numslices, 1, MAX(viewwidth / DRAWQUEUE_MINSLICEWIDTH, 1));
+
+	slicewidth = (viewwidth + numslices - 1) / numslices;
+	numslices = (viewwidth + slicewidth - 1) / slicewidth;
+	slicedraws.resize(numslices);
+
+	bytesperpixel = R_GetRenderingSurface()->getBytesPerPixel();
+
+	// the cached graphics the queued draws point to must not be purged
+	// before they are drawn
+	Z_SetPurgeCallback(R_FlushDrawQueue);
+
+	drawqueue_active = true;
+}
+
+//
+// R_DrawSliceJob
+//
+// Replays the queued draws that touch one slice, clipped to the slice.
+//
+static void R_DrawSliceJob(size_t index, size_t worker, void* data)
+{
+	const std::vector<slicedraw_t>& draws = slicedraws[index];
+
+	const int sx1 = index * slicewidth;
+	const int sx2 = MIN(sx1 + slicewidth, viewwidth) - 1;
+
+	for (size_t i = 0; i < draws.size(); i++)
+	{
+		if (!draws[i].span)
+		{
+			queuedcolumn_t& queued = queued_columns[draws[i].index];
+			drawcolumn_t drawcolumn = queued.drawcolumn;
+			queued.drawfunc(drawcolumn);
+			continue;
+		}
+
+		const queuedspan_t& queued = queued_spans[draws[i].index];
+		const drawspan_t& span = queued.drawspan;
+		const int x1 = MAX(span.x1, sx1);
+		const int x2 = MIN(span.x2, sx2);
+
+		if (queued.sloped)
+		{
+			byte* dest = span.destination +
+					(span.y * span.pitch_in_pixels + x1) * bytesperpixel;
+			const byte* source = &queued_pixels[queued.pixels] +
+					(x1 - span.x1) * bytesperpixel;
+			memcpy(dest, source, (x2 - x1 + 1) * bytesperpixel);
+		}
+		else
+		{
+			// level spans step through the texture by a fixed amount per
+			// pixel, so starting part way along gives the same pixels
+			drawspan_t drawspan = span;
+			drawspan.xfrac += (x1 - span.x1) * span.xstep;
+			drawspan.yfrac += (x1 - span.x1) * span.ystep;
+			drawspan.x1 = x1;
+			drawspan.x2 = x2;
+			queued.drawfunc(drawspan);
+		}
+	}
+}
+
+//
+// R_FlushDrawQueue
+//
+// Draws everything queued so far.
+//
+void R_FlushDrawQueue()
+{
+	if (!drawqueue_active || (queued_columns.empty() && queued_spans.empty()))
+		return;
+
+	draw_pool.run(slicedraws.size(), &R_DrawSliceJob, NULL);
+
+	for (size_t i = 0; i < slicedraws.size(); i++)
+		slicedraws[i].clear();
+
+	queued_columns.clear();
+	queued_spans.clear();
+	queued_pixels.clear();
+}
+
+//
+// R_EndDrawQueue
+//
+// Draws everything queued so far and goes back to drawing straight away.
+//
+void R_EndDrawQueue()
+{
+	if (!drawqueue_active)
+		return;
+
+	R_FlushDrawQueue();
+
+	Z_SetPurgeCallback(NULL);
+	drawqueue_active = false;
+}
+
+//
+// R_QueueSpan
+//
+// Adds dspan to every slice it crosses.
+//
+static void R_QueueSpan(void (*drawfunc)(drawspan_t&), bool sloped, size_t pixels)
+{
+	queuedspan_t queued;
+	queued.drawfunc = drawfunc;
+	queued.drawspan = dspan;
+	queued.pixels = pixels;
+	queued.sloped = sloped;
+	queued_spans.push_back(queued);
+
+	slicedraw_t draw;
+	draw.index = queued_spans.size() - 1;
+	draw.span = true;
+
+	const int first = dspan.x1 / slicewidth;
+	const int last = MIN(dspan.x2 / slicewidth, (int)slicedraws.size() - 1);
+	for (int i = first; i <= last; i++)
+		slicedraws[i].push_back(draw);
+}
+
+//
+// R_DrawQueuedColumn
+//
+// Draws dcol using drawfunc, or queues it to be drawn later.
+//
+void R_DrawQueuedColumn(void (*drawfunc)(drawcolumn_t&))
+{
+	if (!drawqueue_active)
+	{
+		drawfunc(dcol);
+		return;
+	}
+
+	if (drawfunc == R_BlankColumn)
+		return;
+
+	if (drawfunc == R_DrawFuzzColumn)
+	{
+		// the fuzz effect reads pixels from the columns either side, which
+		// may be in another slice, and steps through the fuzz table as it
+		// goes, so it has to be drawn in order
+		R_FlushDrawQueue();
+		drawfunc(dcol);
+		return;
+	}
+
+	if (dcol.x < 0 || dcol.x >= viewwidth)
+		return;
+
+	queuedcolumn_t queued;
+	queued.drawfunc = drawfunc;
+	queued.drawcolumn = dcol;
+	queued_columns.push_back(queued);
+
+	slicedraw_t draw;
+	draw.index = queued_columns.size() - 1;
+	draw.span = false;
+	slicedraws[dcol.x / slicewidth].push_back(draw);
+}
+
+//
+// R_DrawQueuedSpan
+//
+// Draws dspan using drawfunc, or queues it to be drawn later.
+//
+void R_DrawQueuedSpan(void (*drawfunc)(drawspan_t&))
 {
-	R_DrawSlopedSpanGeneric<argb_t, DirectSlopeColormapFunc>(FB_SPANDEST_D, dspan);
+	if (!drawqueue_active)
+	{
+		drawfunc(dspan);
+		return;
+	}
+
+	if (drawfunc == R_BlankSpan)
+		return;
+
+	if (dspan.x1 < 0 || dspan.x2 >= viewwidth || dspan.x2 < dspan.x1)
+		return;
+
+	R_QueueSpan(drawfunc, false, 0);
+}
+
+//
+// R_DrawQueuedSlopeSpan
+//
+// Draws the sloped span dspan using drawfunc, or queues it to be drawn
+// later.  A sloped span can't be split up exactly, so it is drawn right
+// away into a spare row and only copying it to the screen is queued.
+//
+void R_DrawQueuedSlopeSpan(void (*drawfunc)(drawspan_t&))
+{
+	if (!drawqueue_active)
+	{
+		drawfunc(dspan);
+		return;
+	}
+
+	if (drawfunc == R_BlankSpan)
+		return;
+
+	if (dspan.x1 < 0 || dspan.x2 >= viewwidth || dspan.x2 < dspan.x1)
+		return;
+
+	// keep the same alignment as the screen row since the vectorized
+	// drawers work differently on the unaligned pixels at either end
+	static byte scratch[MAXWIDTH * sizeof(argb_t) + 16];
+	const byte* row = dspan.destination + dspan.y * dspan.pitch_in_pixels * bytesperpixel;
+
+	drawspan_t drawspan = dspan;
+	drawspan.destination = scratch + (((size_t)row - (size_t)scratch) & 15);
+	drawspan.y = 0;
+	drawspan.pitch_in_pixels = 0;
+	drawfunc(drawspan);
+
+	const byte* pixels = drawspan.destination + dspan.x1 * bytesperpixel;
+	const size_t offset = queued_pixels.size();
+	queued_pixels.insert(queued_pixels.end(), pixels,
+			pixels + (dspan.x2 - dspan.x1 + 1) * bytesperpixel);
+
+	R_QueueSpan(drawfunc, true, offset);
 }
 
 
@@ -1450,7 +1783,8 @@ enum r_optimize_kind {
 	OPTIMIZE_NONE,
 	OPTIMIZE_SSE2,
 	OPTIMIZE_MMX,
-	OPTIMIZE_ALTIVEC
+	OPTIMIZE_ALTIVEC,
+	OPTIMIZE_AVX2
 };
 
 static r_optimize_kind optimize_kind = OPTIMIZE_NONE;
@@ -1463,6 +1797,7 @@ static const char *get_optimization_name(r_optimize_kind kind)
 		case OPTIMIZE_SSE2:    return "sse2";
 		case OPTIMIZE_MMX:     return "mmx";
 		case OPTIMIZE_ALTIVEC: return "altivec";
+		case OPTIMIZE_AVX2:    return "avx2";
 		case OPTIMIZE_NONE:
 		default:
 			return "none";
@@ -1513,6 +1848,10 @@ static bool detect_optimizations()
 	if (SDL_HasAltiVec())
 		optimizations_available.push_back(OPTIMIZE_ALTIVEC);
 	#endif
+	#if defined(__AVX2_DRAWERS__) && SDL_VERSION_ATLEAST(2, 0, 4)
+	if (SDL_HasAVX2())
+		optimizations_available.push_back(OPTIMIZE_AVX2);
+	#endif
 
 	return true;
 }
@@ -1547,6 +1886,8 @@ CVAR_FUNC_IMPL(r_optimize)
 		optimize_kind = OPTIMIZE_MMX;
 	else if (stricmp(val, "altivec") == 0 && R_IsOptimizationAvailable(OPTIMIZE_ALTIVEC))
 		optimize_kind = OPTIMIZE_ALTIVEC;
+	else if (stricmp(val, "avx2") == 0 && R_IsOptimizationAvailable(OPTIMIZE_AVX2))
+		optimize_kind = OPTIMIZE_AVX2;
 	else if (stricmp(val, "detect") == 0)
 		// Default to the most preferred:
 		optimize_kind = optimizations_available.back();
@@ -1576,6 +1917,11 @@ CVAR_FUNC_IMPL(r_optimize)
 	}
 }
 
+CVAR_FUNC_IMPL(r_drawthreads)
+{
+	R_SetDrawThreads(var.asInt());
+}
+
 
 //
 // R_InitVectorizedDrawers
@@ -1584,6 +1930,10 @@ CVAR_FUNC_IMPL(r_optimize)
 //
 void R_InitVectorizedDrawers()
 {
+	// Only the AVX2 drawers have vectorized columns so far:
+	R_DrawTranslucentColumnD	= R_DrawTranslucentColumnD_c;
+	R_DrawTranslatedColumnD		= R_DrawTranslatedColumnD_c;
+
 	if (optimize_kind == OPTIMIZE_NONE)
 	{
 		// [SL] set defaults to non-vectorized drawers
@@ -1615,8 +1965,27 @@ void R_InitVectorizedDrawers()
 		r_dimpatchD             = r_dimpatchD_ALTIVEC;
 	}
 	#endif
+	#ifdef __AVX2_DRAWERS__
+	else if (optimize_kind == OPTIMIZE_AVX2)
+	{
+		// Any CPU with AVX2 also has SSE2
+		#ifdef __SSE2__
+		R_DrawSpanD				= R_DrawSpanD_SSE2;
+		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_SSE2;
+		r_dimpatchD             = r_dimpatchD_SSE2;
+		#else
+		R_DrawSpanD				= R_DrawSpanD_c;
+		R_DrawSlopeSpanD		= R_DrawSlopeSpanD_c;
+		r_dimpatchD             = r_dimpatchD_c;
+		#endif
+		R_DrawTranslucentColumnD	= R_DrawTranslucentColumnD_AVX2;
+		R_DrawTranslatedColumnD		= R_DrawTranslatedColumnD_AVX2;
+	}
+	#endif
 
 	// Check that all pointers are definitely assigned!
+	assert(R_DrawTranslucentColumnD != NULL);
+	assert(R_DrawTranslatedColumnD != NULL);
 	assert(R_DrawSpanD != NULL);
 	assert(R_DrawSlopeSpanD != NULL);
 	assert(r_dimpatchD != NULL);
@@ -1655,5 +2024,167 @@ void R_InitColumnDrawers ()
 	}
 }
 
+// ============================================================================
+//
+// Column drawer benchmark
+//
+// ============================================================================
+
+static const int BENCH_WIDTH = 320;
+static const int BENCH_HEIGHT = 240;
+
+//
+// R_MakeBenchColumns
+//
+// Makes up a screen's worth of columns with random lengths, scales and
+// texture offsets, the same every time.  Every other column is from a
+// texture whose height is not a power of two.
+//
+static std::vector<drawcolumn_t> R_MakeBenchColumns(palindex_t* source, argb_t* dest,
+		const shaderef_t& colormap, const translationref_t& translation)
+{
+	std::vector<drawcolumn_t> columns(BENCH_WIDTH);
+	unsigned int seed = 1;
+
+	for (int x = 0; x < BENCH_WIDTH; x++)
+	{
+		drawcolumn_t& column = columns[x];
+
+		seed = seed * 1103515245 + 12345;
+		int top = (seed >> 16) % (BENCH_HEIGHT / 4);
+		seed = seed * 1103515245 + 12345;
+		int length = BENCH_HEIGHT / 2 + (seed >> 16) % (BENCH_HEIGHT / 2 - top);
+
+		seed = seed * 1103515245 + 12345;
+		fixed_t iscale = FRACUNIT / 4 + (seed >> 8) % (2 * FRACUNIT);
+		seed = seed * 1103515245 + 12345;
+		fixed_t texturefrac = (fixed_t)(seed >> 8) - (1 << 23);
+
+		column.source = source;
+		column.destination = (byte*)dest;
+		column.pitch_in_pixels = BENCH_WIDTH;
+		column.post = NULL;
+		column.colormap = colormap;
+		column.translation = translation;
+		column.x = x;
+		column.yl = top;
+		column.yh = top + length - 1;
+		column.iscale = iscale;
+		column.texturemid = 0;
+		column.texturefrac = texturefrac;
+		column.textureheight = (x & 1 ? 72 : 128) << FRACBITS;
+		column.translevel = FRACUNIT * 2 / 3;
+		column.color = 0;
+	}
+
+	return columns;
+}
+
+//
+// R_BenchColumnDrawer
+//
+// Draws the columns with a drawer until the time runs out and returns the
+// rate in millions of pixels per second.
+//
+static double R_BenchColumnDrawer(void (*drawfunc)(drawcolumn_t&),
+		std::vector<drawcolumn_t>& columns, dtime_t duration)
+{
+	QWORD pixels = 0;
+	dtime_t start = I_GetTime(), elapsed = 0;
+
+	while (elapsed < duration)
+	{
+		for (size_t i = 0; i < columns.size(); i++)
+		{
+			drawfunc(columns[i]);
+			pixels += columns[i].yh - columns[i].yl + 1;
+		}
+
+		elapsed = I_GetTime() - start;
+	}
+
+	return (double)pixels / ((double)elapsed / 1000.0);
+}
+
+//
+// benchdrawers
+//
+// Times the scalar column drawers against their vectorized counterparts
+// and checks that both draw the same pixels.
+//
+BEGIN_COMMAND (benchdrawers)
+{
+	int ms = argc > 1 ? atoi(argv[1]) : 1000;
+	if (ms <= 0)
+		ms = 1000;
+
+	std::vector<palindex_t> source(128);
+	for (size_t i = 0; i < source.size(); i++)
+		source[i] = (palindex_t)(i * 37 + 11);
+
+	const shaderef_t colormap(&realcolormaps, 8);
+	const translationref_t translation(translationtables + 256);
+
+	struct drawerpair_t
+	{
+		const char*		name;
+		void			(*scalar)(drawcolumn_t&);
+		void			(*vector)(drawcolumn_t&);
+	};
+
+	drawerpair_t drawers[] = {
+		{ "translucent", R_DrawTranslucentColumnD_c, NULL },
+		{ "translated", R_DrawTranslatedColumnD_c, NULL }
+	};
+
+	#ifdef __AVX2_DRAWERS__
+	if (R_IsOptimizationAvailable(OPTIMIZE_AVX2))
+	{
+		drawers[0].vector = R_DrawTranslucentColumnD_AVX2;
+		drawers[1].vector = R_DrawTranslatedColumnD_AVX2;
+	}
+	#endif
+
+	if (!drawers[0].vector)
+		Printf(PRINT_HIGH, "AVX2 drawers are not available, timing the scalar drawers only\n");
+
+	Printf(PRINT_HIGH, "%-12s %14s %14s %10s\n", "drawer", "scalar Mpx/s", "avx2 Mpx/s", "output");
+
+	for (size_t i = 0; i < ARRAY_LENGTH(drawers); i++)
+	{
+		std::vector<argb_t> scalar_dest(BENCH_WIDTH * BENCH_HEIGHT, argb_t(255, 40, 80, 120));
+		std::vector<argb_t> vector_dest(scalar_dest);
+
+		std::vector<drawcolumn_t> scalar_columns =
+			R_MakeBenchColumns(&source[0], &scalar_dest[0], colormap, translation);
+		std::vector<drawcolumn_t> vector_columns =
+			R_MakeBenchColumns(&source[0], &vector_dest[0], colormap, translation);
+
+		// draw each column once into a fresh buffer to compare the output
+		const char* output = "-";
+		if (drawers[i].vector)
+		{
+			for (size_t x = 0; x < scalar_columns.size(); x++)
+			{
+				drawers[i].scalar(scalar_columns[x]);
+				drawers[i].vector(vector_columns[x]);
+			}
+
+			output = scalar_dest == vector_dest ? "identical" : "DIFFERENT";
+		}
+
+		double scalar_rate = R_BenchColumnDrawer(drawers[i].scalar, scalar_columns,
+				I_ConvertTimeFromMs(ms));
+		double vector_rate = 0.0;
+		if (drawers[i].vector)
+			vector_rate = R_BenchColumnDrawer(drawers[i].vector, vector_columns,
+					I_ConvertTimeFromMs(ms));
+
+		Printf(PRINT_HIGH, "%-12s %14.1f %14.1f %10s\n",
+				drawers[i].name, scalar_rate, vector_rate, output);
+	}
+}
+END_COMMAND (benchdrawers)
+
 VERSION_CONTROL (r_draw_cpp, "$Id$")
 
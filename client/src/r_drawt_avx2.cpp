@@ -0,0 +1,272 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	AVX2 column drawers for the 32bpp renderer.
+//
+//	Each column is drawn eight rows at a time.  The texture coordinates,
+//	the shademap lookups and the translucency blend are done for all eight
+//	pixels at once and the results are written out row by row.  The output
+//	is identical to the R_Draw*ColumnD_c drawers.
+//
+//	Plain opaque columns are left to R_DrawColumnD: it is only a load and a
+//	store per pixel, which the gathers here cannot beat.
+//
+//-----------------------------------------------------------------------------
+
+#include "i_sdl.h"
+#include "r_intrin.h"
+
+#ifdef __AVX2_DRAWERS__
+
+#include <immintrin.h>
+
+#include "doomtype.h"
+#include "doomdef.h"
+#include "r_defs.h"
+#include "r_draw.h"
+#include "r_main.h"
+#include "v_video.h"
+
+// Direct rendering (32-bit) functions for AVX2 optimization:
+
+//
+// R_GetColumnTexels
+//
+// Reads the next eight texels of a column into the lanes of a vector and
+// advances frac past them.  Textures whose height is not a power of two
+// wrap the same way as in R_DrawColumnGeneric.
+//
+template<bool TRANSLATED>
+static forceinline AVX2_TARGET __m256i R_GetColumnTexels(const palindex_t* source,
+		fixed_t& frac, fixed_t fracstep, int texheight, const palindex_t* translation)
+{
+	int texels[8];
+
+	if (texheight & (texheight - 1))
+	{
+		for (int i = 0; i < 8; i++)
+		{
+			texels[i] = source[frac >> FRACBITS];
+			if ((frac += fracstep) >= texheight)
+				frac -= texheight;
+		}
+	}
+	else
+	{
+		const __m256i mfrac = _mm256_add_epi32(_mm256_set1_epi32(frac),
+				_mm256_mullo_epi32(_mm256_set1_epi32(fracstep), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+		const __m256i mask = _mm256_set1_epi32((texheight >> FRACBITS) - 1);
+		_mm256_storeu_si256((__m256i*)texels, _mm256_and_si256(_mm256_srai_epi32(mfrac, FRACBITS), mask));
+
+		for (int i = 0; i < 8; i++)
+			texels[i] = source[texels[i]];
+		frac += fracstep * 8;
+	}
+
+	if (TRANSLATED)
+	{
+		for (int i = 0; i < 8; i++)
+			texels[i] = translation[texels[i]];
+	}
+
+	return _mm256_loadu_si256((const __m256i*)texels);
+}
+
+//
+// R_StoreColumnPixels
+//
+// Writes the eight pixels in a vector down a column.
+//
+static forceinline AVX2_TARGET void R_StoreColumnPixels(argb_t* dest, int pitch, __m256i pixels)
+{
+	uint32_t values[8];
+	_mm256_storeu_si256((__m256i*)values, pixels);
+
+	for (int i = 0; i < 8; i++)
+		dest[i * pitch] = values[i];
+}
+
+
+// ----------------------------------------------------------------------------
+//
+// AVX2 color remapping functors
+//
+// These mirror the Direct*Func functors in r_draw.cpp but shade eight
+// texels at once.  The scalar operator() is used for the rows left over
+// at the end of a column.
+//
+// ----------------------------------------------------------------------------
+
+class AVX2ColormapFunc
+{
+public:
+	AVX2ColormapFunc(const drawcolumn_t& drawcolumn) :
+			colormap(drawcolumn.colormap) { }
+
+	forceinline AVX2_TARGET void operator()(byte c, argb_t* dest) const
+	{
+		*dest = colormap.shade(c);
+	}
+
+	forceinline AVX2_TARGET void operator()(__m256i texels, argb_t* dest, int pitch) const
+	{
+		const __m256i pixels = _mm256_i32gather_epi32((const int*)colormap.m_shademap, texels, 4);
+		R_StoreColumnPixels(dest, pitch, pixels);
+	}
+
+private:
+	const shaderef_t& colormap;
+};
+
+class AVX2TranslucentColormapFunc
+{
+public:
+	AVX2TranslucentColormapFunc(const drawcolumn_t& drawcolumn) :
+			colormap(drawcolumn.colormap)
+	{
+		fga = (drawcolumn.translevel & ~0x03FF) >> 8;
+		fga = fga > 255 ? 255 : fga;
+		bga = 255 - fga;
+	}
+
+	forceinline AVX2_TARGET void operator()(byte c, argb_t* dest) const
+	{
+		argb_t fg = colormap.shade(c);
+		argb_t bg = *dest;
+		*dest = alphablend2a(bg, bga, fg, fga);
+	}
+
+	forceinline AVX2_TARGET void operator()(__m256i texels, argb_t* dest, int pitch) const
+	{
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i fgalpha = _mm256_set1_epi16(fga);
+		const __m256i bgalpha = _mm256_set1_epi16(bga);
+
+		const __m256i fg = _mm256_i32gather_epi32((const int*)colormap.m_shademap, texels, 4);
+		const __m256i bg = _mm256_setr_epi32(dest[0], dest[pitch], dest[pitch * 2], dest[pitch * 3],
+				dest[pitch * 4], dest[pitch * 5], dest[pitch * 6], dest[pitch * 7]);
+
+		// (bg * bga + fg * fga) >> 8 for each color channel, using 16-bit
+		// channels so the products do not overflow
+		__m256i lo = _mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(bg, zero), bgalpha),
+				_mm256_mullo_epi16(_mm256_unpacklo_epi8(fg, zero), fgalpha));
+		__m256i hi = _mm256_add_epi16(
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(bg, zero), bgalpha),
+				_mm256_mullo_epi16(_mm256_unpackhi_epi8(fg, zero), fgalpha));
+		lo = _mm256_srli_epi16(lo, 8);
+		hi = _mm256_srli_epi16(hi, 8);
+
+		// alphablend2a always returns an opaque color
+		const __m256i alpha = _mm256_set1_epi32(argb_t(255, 0, 0, 0));
+		R_StoreColumnPixels(dest, pitch, _mm256_or_si256(_mm256_packus_epi16(lo, hi), alpha));
+	}
+
+private:
+	const shaderef_t& colormap;
+	int fga, bga;
+};
+
+
+//
+// R_DrawColumnGeneric_AVX2
+//
+// Counterpart of R_DrawColumnGeneric that hands the colorfunc eight rows
+// of the column at a time.
+//
+template<typename COLORFUNC, bool TRANSLATED>
+static forceinline AVX2_TARGET void R_DrawColumnGeneric_AVX2(argb_t* dest, const drawcolumn_t& drawcolumn)
+{
+	const palindex_t* source = drawcolumn.source;
+	const int pitch = drawcolumn.pitch_in_pixels;
+	int count = drawcolumn.yh - drawcolumn.yl + 1;
+	if (count <= 0)
+		return;
+
+	const fixed_t fracstep = drawcolumn.iscale;
+	fixed_t frac = drawcolumn.texturefrac;
+
+	const int texheight = drawcolumn.textureheight;
+	const int mask = (texheight >> FRACBITS) - 1;
+	const bool pow2 = (texheight & (texheight - 1)) == 0;
+
+	const palindex_t* translation = TRANSLATED ? drawcolumn.translation.getTable() : NULL;
+
+	COLORFUNC colorfunc(drawcolumn);
+
+	if (!pow2)
+	{
+		if (frac < 0)
+			while ((frac += texheight) < 0);
+		else
+			while (frac >= texheight)
+				frac -= texheight;
+	}
+
+	while (count >= 8)
+	{
+		colorfunc(R_GetColumnTexels<TRANSLATED>(source, frac, fracstep, texheight, translation), dest, pitch);
+		dest += pitch * 8;
+		count -= 8;
+	}
+
+	while (count--)
+	{
+		palindex_t c;
+		if (pow2)
+		{
+			c = source[(frac >> FRACBITS) & mask];
+			frac += fracstep;
+		}
+		else
+		{
+			c = source[frac >> FRACBITS];
+			if ((frac += fracstep) >= texheight)
+				frac -= texheight;
+		}
+
+		colorfunc(TRANSLATED ? translation[c] : c, dest);
+		dest += pitch;
+	}
+}
+
+#define FB_COLDEST_D(drawcolumn) \
+	((argb_t*)(drawcolumn).destination + (drawcolumn).yl * (drawcolumn).pitch_in_pixels + (drawcolumn).x)
+
+AVX2_TARGET void R_DrawTranslucentColumnD_AVX2(drawcolumn_t& drawcolumn)
+{
+	R_DrawColumnGeneric_AVX2<AVX2TranslucentColormapFunc, false>(FB_COLDEST_D(drawcolumn), drawcolumn);
+}
+
+AVX2_TARGET void R_DrawTranslatedColumnD_AVX2(drawcolumn_t& drawcolumn)
+{
+	// Player color ranges are shaded with the player's RGB color instead of
+	// going through the shademap.  Leave those to the scalar drawer.
+	if (drawcolumn.translation.getPlayerID() != -1 && drawcolumn.colormap.mapnum() < NUMCOLORMAPS)
+	{
+		R_DrawTranslatedColumnD_c(drawcolumn);
+		return;
+	}
+
+	R_DrawColumnGeneric_AVX2<AVX2ColormapFunc, true>(FB_COLDEST_D(drawcolumn), drawcolumn);
+}
+
+
+VERSION_CONTROL (r_drawt_avx2_cpp, "$Id$")
+
+#endif
@@ -55,29 +55,29 @@ static inline uintptr_t R_GetBytesUntilAligned(void* data, uintptr_t alignment)
 }
 
 
-void R_DrawSpanD_SSE2 (void)
+void R_DrawSpanD_SSE2 (drawspan_t& drawspan)
 {
 #ifdef RANGECHECK
-	if (dspan.x2 < dspan.x1 || dspan.x1 < 0 || dspan.x2 >= viewwidth ||
-		dspan.y >= viewheight || dspan.y < 0)
+	if (drawspan.x2 < drawspan.x1 || drawspan.x1 < 0 || drawspan.x2 >= viewwidth ||
+		drawspan.y >= viewheight || drawspan.y < 0)
 	{
-		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", dspan.x1, dspan.x2, dspan.y);
+		Printf(PRINT_HIGH, "R_DrawLevelSpan: %i to %i at %i", drawspan.x1, drawspan.x2, drawspan.y);
 		return;
 	}
 #endif
 
-	const int width = dspan.x2 - dspan.x1 + 1;
+	const int width = drawspan.x2 - drawspan.x1 + 1;
 
 	// TODO: store flats in column-major format and swap u and v
-	dsfixed_t ufrac = dspan.yfrac;
-	dsfixed_t vfrac = dspan.xfrac;
-	dsfixed_t ustep = dspan.ystep;
-	dsfixed_t vstep = dspan.xstep;
+	dsfixed_t ufrac = drawspan.yfrac;
+	dsfixed_t vfrac = drawspan.xfrac;
+	dsfixed_t ustep = drawspan.ystep;
+	dsfixed_t vstep = drawspan.xstep;
 
-	const byte* source = dspan.source;
-	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+	const byte* source = drawspan.source;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
 
-	shaderef_t colormap = dspan.colormap;
+	shaderef_t colormap = drawspan.colormap;
 	
 	const int texture_width_bits = 6, texture_height_bits = 6;
 
@@ -175,32 +175,32 @@ void R_DrawSpanD_SSE2 (void)
 	}
 }
 
-void R_DrawSlopeSpanD_SSE2 (void)
+void R_DrawSlopeSpanD_SSE2 (drawspan_t& drawspan)
 {
-	int count = dspan.x2 - dspan.x1 + 1;
+	int count = drawspan.x2 - drawspan.x1 + 1;
 	if (count <= 0)
 		return;
 
 #ifdef RANGECHECK 
-	if (dspan.x2 < dspan.x1
-		|| dspan.x1 < 0
-		|| dspan.x2 >= I_GetSurfaceWidth()
-		|| dspan.y >= I_GetSurfaceHeight())
+	if (drawspan.x2 < drawspan.x1
+		|| drawspan.x1 < 0
+		|| drawspan.x2 >= I_GetSurfaceWidth()
+		|| drawspan.y >= I_GetSurfaceHeight())
 	{
 		I_Error ("R_DrawSlopeSpan: %i to %i at %i",
-				 dspan.x1, dspan.x2, dspan.y);
+				 drawspan.x1, drawspan.x2, drawspan.y);
 	}
 #endif
 
-	float iu = dspan.iu, iv = dspan.iv;
-	float ius = dspan.iustep, ivs = dspan.ivstep;
-	float id = dspan.id, ids = dspan.idstep;
+	float iu = drawspan.iu, iv = drawspan.iv;
+	float ius = drawspan.iustep, ivs = drawspan.ivstep;
+	float id = drawspan.id, ids = drawspan.idstep;
 	
 	// framebuffer	
-	argb_t* dest = (argb_t*)dspan.destination + dspan.y * dspan.pitch_in_pixels + dspan.x1;
+	argb_t* dest = (argb_t*)drawspan.destination + drawspan.y * drawspan.pitch_in_pixels + drawspan.x1;
 	
 	// texture data
-	byte *src = (byte *)dspan.source;
+	byte *src = (byte *)drawspan.source;
 
 	int ltindex = 0;		// index into the lighting table
 
@@ -231,7 +231,7 @@ void R_DrawSlopeSpanD_SSE2 (void)
 		// Blit up to the first 16-byte aligned position:
 		while ((((size_t)dest) & 15) && (incount > 0))
 		{
-			const shaderef_t &colormap = dspan.slopelighting[ltindex++];
+			const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
 			*dest = colormap.shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
 			dest++;
 			ufrac += ustep;
@@ -252,10 +252,10 @@ void R_DrawSlopeSpanD_SSE2 (void)
 					const int spot3 = (((vfrac+vstep*3) >> 10) & 0xFC0) | (((ufrac+ustep*3) >> 16) & 63);
 
 					const __m128i finalColors = _mm_setr_epi32(
-						dspan.slopelighting[ltindex+0].shade(src[spot0]),
-						dspan.slopelighting[ltindex+1].shade(src[spot1]),
-						dspan.slopelighting[ltindex+2].shade(src[spot2]),
-						dspan.slopelighting[ltindex+3].shade(src[spot3])
+						drawspan.slopelighting[ltindex+0].shade(src[spot0]),
+						drawspan.slopelighting[ltindex+1].shade(src[spot1]),
+						drawspan.slopelighting[ltindex+2].shade(src[spot2]),
+						drawspan.slopelighting[ltindex+3].shade(src[spot3])
 					);
 					_mm_store_si128((__m128i *)dest, finalColors);
 
@@ -272,7 +272,7 @@ void R_DrawSlopeSpanD_SSE2 (void)
 		{
 			while(incount--)
 			{
-				const shaderef_t &colormap = dspan.slopelighting[ltindex++];
+				const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
 				const int spot = ((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63);
 				*dest = colormap.shade(src[spot]);
 				dest++;
@@ -311,7 +311,7 @@ void R_DrawSlopeSpanD_SSE2 (void)
 		int incount = count;
 		while (incount--)
 		{
-			const shaderef_t &colormap = dspan.slopelighting[ltindex++];
+			const shaderef_t &colormap = drawspan.slopelighting[ltindex++];
 			*dest = colormap.shade(src[((vfrac >> 10) & 0xFC0) | ((ufrac >> 16) & 63)]);
 			dest++;
 			ufrac += ustep;
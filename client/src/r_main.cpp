@@ -38,6 +38,7 @@
 #include "i_video.h"
 #include "m_vectors.h"
 #include "am_map.h"
+#include "r_bench.h"
 
 void R_BeginInterpolation(fixed_t amount);
 void R_EndInterpolation();
@@ -132,9 +133,9 @@ static argb_t sector_blend_color(0, 255, 255, 255);
 // [SL] Current color blending values (including palette effects)
 fargb_t blend_color(0.0f, 255.0f, 255.0f, 255.0f);
 
-void (*colfunc) (void);
-void (*spanfunc) (void);
-void (*spanslopefunc) (void);
+void (*colfunc) (drawcolumn_t&);
+void (*spanfunc) (drawspan_t&);
+void (*spanslopefunc) (drawspan_t&);
 
 // [AM] Number of fineangles in a default 90 degree FOV at a 4:3 resolution.
 int FieldOfView = 2048;
@@ -1024,11 +1025,19 @@ void R_RenderPlayerView(player_t* player)
 		surface->getDefaultCanvas()->Clear(x1, y1, x2, y2, color);
 	}
 
+	// Hand the drawing to the draw threads.  The flat color drawers use
+	// the current sector's colormap when they are called, so r_drawflat
+	// is always drawn in order.
+	if (!nodrawers && !r_drawflat)
+		R_BeginDrawQueue();
+
 	R_BeginInterpolation(render_lerp_amount);
 
 	// [RH] Setup particles for this frame
 	R_FindParticleSubsectors();
 
+	R_BeginBenchPhase(BENCH_BSP);
+
     // [Russell] - From zdoom 1.22 source, added camera pointer check
 	// Never draw the player unless in chasecam mode
 	if (camera && camera->player && !(player->cheats & CF_CHASECAM))
@@ -1041,9 +1050,19 @@ void R_RenderPlayerView(player_t* player)
 	else
 		R_RenderBSPNode(numnodes - 1);	// The head node is the last node output.
 
+	R_EndBenchPhase();
+
+	R_BeginBenchPhase(BENCH_PLANES);
 	R_DrawPlanes();
+	R_EndBenchPhase();
 
+	R_BeginBenchPhase(BENCH_MASKED);
 	R_DrawMasked();
+	R_EndBenchPhase();
+
+	R_BeginBenchPhase(BENCH_DRAWQUEUE);
+	R_EndDrawQueue();
+	R_EndBenchPhase();
 
 	// NOTE(jsd): Full-screen status color blending:
 	int blend_alpha = int(blend_color.geta() * 255.0f);
@@ -109,6 +109,8 @@ static fixed_t			pl_xstepscale, pl_ystepscale;
 v3float_t				a, b, c;
 float					ixscale, iyscale;
 
+static shaderef_t		slopelighting[MAXWIDTH];
+
 //
 // R_InitPlanes
 // Only at game startup.
@@ -155,12 +157,12 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 	if (fixedlightlev)
 	{
 		for (int i = 0; i < len; i++)
-			dspan.slopelighting[i] = basecolormap.with(fixedlightlev);
+			slopelighting[i] = basecolormap.with(fixedlightlev);
 	}
 	else if (fixedcolormap.isValid())
 	{
 		for (int i = 0; i < len; i++)
-			dspan.slopelighting[i] = fixedcolormap;
+			slopelighting[i] = fixedcolormap;
 	}
 	else
 	{
@@ -177,11 +179,11 @@ void R_MapSlopedPlane(int y, int x1, int x2)
 			index -= (foggy ? 0 : extralight << 2);
 			
 			if (index < 0)
-				dspan.slopelighting[i] = basecolormap;
+				slopelighting[i] = basecolormap;
 			else if (index >= NUMCOLORMAPS)
-				dspan.slopelighting[i] = basecolormap.with((NUMCOLORMAPS - 1));
+				slopelighting[i] = basecolormap.with((NUMCOLORMAPS - 1));
 			else
-				dspan.slopelighting[i] = basecolormap.with(index);
+				slopelighting[i] = basecolormap.with(index);
 			
 			map += step;
 		}
@@ -190,8 +192,9 @@ void R_MapSlopedPlane(int y, int x1, int x2)
    	dspan.y = y;
 	dspan.x1 = x1;
 	dspan.x2 = x2;
+	dspan.slopelighting = slopelighting;
 
-	spanslopefunc();
+	R_DrawQueuedSlopeSpan(spanslopefunc);
 }
 
 
@@ -245,7 +248,7 @@ void R_MapLevelPlane(int y, int x1, int x2)
 	dspan.x1 = x1;
 	dspan.x2 = x2;
 
-	spanfunc();
+	R_DrawQueuedSpan(spanfunc);
 }
 
 //
@@ -39,6 +39,7 @@
 #include "m_vectors.h"
 
 #include "p_lnspec.h"
+#include "r_bench.h"
 
 // a pool of bytes allocated for sprite clipping arrays
 Pool<tallpost_t*> masked_midposts_pool(4096);
@@ -182,7 +183,7 @@ static void R_FillWallHeightArray(
 //
 // R_BlastMaskedSegColumn
 //
-static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
+static inline void R_BlastMaskedSegColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	tallpost_t* post = dcol.post;
 
@@ -224,7 +225,7 @@ static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
 			dcol.source = post->data();
 
 			if (dcol.yl >= 0 && dcol.yh < viewheight && dcol.yl <= dcol.yh)
-				drawfunc();
+				R_DrawQueuedColumn(drawfunc);
 			
 			post = post->next();
 		}
@@ -238,7 +239,7 @@ static inline void R_BlastMaskedSegColumn(void (*drawfunc)())
 //
 // R_BlastSolidSegColumn
 //
-static inline void R_BlastSolidSegColumn(void (*drawfunc)())
+static inline void R_BlastSolidSegColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	if (wallscalex[dcol.x] <= 0)
 		return;
@@ -249,7 +250,7 @@ static inline void R_BlastSolidSegColumn(void (*drawfunc)())
 	dcol.texturefrac = dcol.texturemid + FixedMul((dcol.yl - centery + 1) << FRACBITS, dcol.iscale);
 
 	if (dcol.yl <= dcol.yh)
-		drawfunc();
+		R_DrawQueuedColumn(drawfunc);
 }
 
 inline void SolidColumnBlaster()
@@ -794,6 +795,8 @@ void R_StoreWallRange(int start, int stop)
 	if (count <= 0)
 		return;
 
+	R_BeginBenchPhase(BENCH_SEGS);
+
 	R_ReallocDrawSegs();	// don't overflow and crash
 
 	sidedef = curline->sidedef;
@@ -1079,6 +1082,8 @@ void R_StoreWallRange(int start, int stop)
 	}
 
 	ds_p++;
+
+	R_EndBenchPhase();
 }
 
 
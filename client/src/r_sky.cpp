@@ -183,13 +183,13 @@ void R_InitSkyMap()
 //
 // R_BlastSkyColumn
 //
-static inline void R_BlastSkyColumn(void (*drawfunc)(void))
+static inline void R_BlastSkyColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	if (dcol.yl <= dcol.yh)
 	{
 		dcol.source = dcol.post->data();
 		dcol.texturefrac = dcol.texturemid + (dcol.yl - centery + 1) * dcol.iscale;
-		drawfunc();
+		R_DrawQueuedColumn(drawfunc);
 	}
 }
 
@@ -343,7 +343,7 @@ int*			mceilingclip;
 fixed_t 		spryscale;
 fixed_t 		sprtopscreen;
 
-void R_BlastSpriteColumn(void (*drawfunc)())
+void R_BlastSpriteColumn(void (*drawfunc)(drawcolumn_t&))
 {
 	tallpost_t* post = dcol.post;
 
@@ -380,7 +380,7 @@ void R_BlastSpriteColumn(void (*drawfunc)())
 		dcol.source = post->data();
 
 		if (dcol.yl >= 0 && dcol.yh < viewheight && dcol.yl <= dcol.yh)
-			drawfunc();
+			R_DrawQueuedColumn(drawfunc);
 
 		post = post->next();
 	}
@@ -1353,7 +1353,7 @@ void R_DrawParticle(vissprite_t* vis)
 	dspan.color = vis->startfrac;
 
 	for (dspan.y = y1; dspan.y <= y2; dspan.y++)
-		R_FillTranslucentSpan();
+		R_DrawQueuedSpan(R_FillTranslucentSpan);
 }
 
 VERSION_CONTROL (r_things_cpp, "$Id$")
@@ -26,6 +26,8 @@
 #include <math.h>
 #include <cstddef>
 #include <cassert>
+#include <algorithm>
+#include <vector>
 
 #include "doomstat.h"
 #include "i_system.h"
@@ -38,6 +40,7 @@
 #include "c_dispatch.h"
 #include "cmdlib.h"
 #include "g_level.h"
+#include "hashtable.h"
 
 #include "v_palette.h"
 
@@ -408,6 +411,167 @@ void V_RestoreScreenPalette()
 }
 
 
+// ----------------------------------------------------------------------------
+//
+// Palette quantization index
+//
+// V_BestColor is called for every entry of every colormap, so colored
+// sector lighting can ask for millions of colors while a level loads.  For
+// the default palette, the RGB cube is divided into cells and each cell
+// keeps the few palette entries that can be the closest match for some
+// color inside it.  A lookup then only has to measure those entries instead
+// of all 256.
+//
+// An entry is kept if its nearest distance to the cell is no more than the
+// farthest distance to the cell of any entry: an entry farther away
+// than that can never win.  The candidates are kept in palette order so
+// ties go to the lowest index, and the results are the same as searching
+// the whole palette.
+//
+// ----------------------------------------------------------------------------
+
+static const int BESTCOLOR_BITS = 5;
+static const int BESTCOLOR_SIZE = 1 << BESTCOLOR_BITS;
+static const int BESTCOLOR_CELLWIDTH = 256 / BESTCOLOR_SIZE;
+
+// The fine cells are filled from the candidates of these larger cells
+static const int BESTCOLOR_COARSE_BITS = 3;
+static const int BESTCOLOR_COARSE_SIZE = 1 << BESTCOLOR_COARSE_BITS;
+static const int BESTCOLOR_COARSE_CELLWIDTH = 256 / BESTCOLOR_COARSE_SIZE;
+
+static const argb_t* bestcolor_palette = NULL;
+static unsigned int bestcolor_cells[BESTCOLOR_SIZE * BESTCOLOR_SIZE * BESTCOLOR_SIZE + 1];
+static std::vector<palindex_t> bestcolor_candidates;
+
+
+//
+// V_CellDistance
+//
+// Returns the squared distance along one channel from a color to the
+// nearest edge of a cell, or zero if the color is inside the cell, and sets
+// farthest to the squared distance to the far edge.
+//
+static inline int V_CellDistance(int color, int low, int high, int& farthest)
+{
+	const int tolow = color - low, tohigh = high - color;
+	const int outer = std::max(tolow, tohigh);
+	const int inner = std::max(0, std::max(-tolow, -tohigh));
+
+	farthest = outer * outer;
+	return inner * inner;
+}
+
+
+//
+// V_FindCellCandidates
+//
+// Picks the palette entries out of pool that can be the closest match for a
+// color in the cell of the given width with its lowest corner at r, g, b.
+// Returns the number of entries written to candidates.
+//
+static int V_FindCellCandidates(const argb_t* palette_colors, const palindex_t* pool, int poolsize,
+								int r, int g, int b, int width, palindex_t* candidates)
+{
+	int nearest[256];
+	int bound = MAXINT;
+
+	for (int i = 0; i < poolsize; i++)
+	{
+		const argb_t color(palette_colors[pool[i]]);
+		int fr, fg, fb;
+
+		nearest[i] = V_CellDistance(color.getr(), r, r + width - 1, fr) +
+					V_CellDistance(color.getg(), g, g + width - 1, fg) +
+					V_CellDistance(color.getb(), b, b + width - 1, fb);
+
+		if (fr + fg + fb < bound)
+			bound = fr + fg + fb;
+	}
+
+	int count = 0;
+	for (int i = 0; i < poolsize; i++)
+		if (nearest[i] <= bound)
+			candidates[count++] = pool[i];
+
+	return count;
+}
+
+
+//
+// V_BuildBestColorIndex
+//
+// Builds the quantization index used by V_BestColor for the given palette.
+// The palette must not change while the index is in use.
+//
+static void V_BuildBestColorIndex(const argb_t* palette_colors)
+{
+	// An entry that repeats an earlier color can never be returned
+	palindex_t unique[256];
+	int numunique = 0;
+
+	for (int i = 0; i < 256; i++)
+	{
+		const argb_t color(palette_colors[i]);
+
+		int j = 0;
+		while (j < i && (palette_colors[j].getr() != color.getr() ||
+						palette_colors[j].getg() != color.getg() ||
+						palette_colors[j].getb() != color.getb()))
+			j++;
+
+		if (j == i)
+			unique[numunique++] = i;
+	}
+
+	// Search the whole palette once per coarse cell.  The closest match for
+	// a color in a fine cell is among the candidates of the coarse cell that
+	// contains it, so the fine cells only need to search those.
+	static const int NUMCOARSECELLS = BESTCOLOR_COARSE_SIZE * BESTCOLOR_COARSE_SIZE * BESTCOLOR_COARSE_SIZE;
+	std::vector<palindex_t> coarse_candidates;
+	unsigned int coarse_cells[NUMCOARSECELLS + 1];
+	palindex_t candidates[256];
+
+	for (int cell = 0; cell < NUMCOARSECELLS; cell++)
+	{
+		const int r = (cell >> (2 * BESTCOLOR_COARSE_BITS)) * BESTCOLOR_COARSE_CELLWIDTH;
+		const int g = ((cell >> BESTCOLOR_COARSE_BITS) & (BESTCOLOR_COARSE_SIZE - 1)) * BESTCOLOR_COARSE_CELLWIDTH;
+		const int b = (cell & (BESTCOLOR_COARSE_SIZE - 1)) * BESTCOLOR_COARSE_CELLWIDTH;
+
+		int count = V_FindCellCandidates(palette_colors, unique, numunique,
+										r, g, b, BESTCOLOR_COARSE_CELLWIDTH, candidates);
+
+		coarse_cells[cell] = coarse_candidates.size();
+		coarse_candidates.insert(coarse_candidates.end(), candidates, candidates + count);
+	}
+	coarse_cells[NUMCOARSECELLS] = coarse_candidates.size();
+
+	static const int NUMCELLS = BESTCOLOR_SIZE * BESTCOLOR_SIZE * BESTCOLOR_SIZE;
+	static const int COARSE_SHIFT = BESTCOLOR_BITS - BESTCOLOR_COARSE_BITS;
+	bestcolor_candidates.clear();
+
+	for (int cell = 0; cell < NUMCELLS; cell++)
+	{
+		const int r = cell >> (2 * BESTCOLOR_BITS);
+		const int g = (cell >> BESTCOLOR_BITS) & (BESTCOLOR_SIZE - 1);
+		const int b = cell & (BESTCOLOR_SIZE - 1);
+
+		const int coarse = ((r >> COARSE_SHIFT) << (2 * BESTCOLOR_COARSE_BITS)) |
+						((g >> COARSE_SHIFT) << BESTCOLOR_COARSE_BITS) | (b >> COARSE_SHIFT);
+
+		int count = V_FindCellCandidates(palette_colors,
+				&coarse_candidates[coarse_cells[coarse]], coarse_cells[coarse + 1] - coarse_cells[coarse],
+				r * BESTCOLOR_CELLWIDTH, g * BESTCOLOR_CELLWIDTH, b * BESTCOLOR_CELLWIDTH,
+				BESTCOLOR_CELLWIDTH, candidates);
+
+		bestcolor_cells[cell] = bestcolor_candidates.size();
+		bestcolor_candidates.insert(bestcolor_candidates.end(), candidates, candidates + count);
+	}
+	bestcolor_cells[NUMCELLS] = bestcolor_candidates.size();
+
+	bestcolor_palette = palette_colors;
+}
+
+
 //
 // V_BestColor
 //
@@ -419,6 +583,32 @@ palindex_t V_BestColor(const argb_t* palette_colors, int r, int g, int b)
 	int bestdistortion = MAXINT;
 	int bestcolor = 0;		/// let any color go to 0 as a last resort
 
+	if (palette_colors == bestcolor_palette && (unsigned int)(r | g | b) < 256)
+	{
+		const int shift = 8 - BESTCOLOR_BITS;
+		const int cell = ((r >> shift) << (2 * BESTCOLOR_BITS)) | ((g >> shift) << BESTCOLOR_BITS) | (b >> shift);
+
+		const palindex_t* candidate = &bestcolor_candidates[bestcolor_cells[cell]];
+		const palindex_t* end = candidate + (bestcolor_cells[cell + 1] - bestcolor_cells[cell]);
+
+		for (; candidate != end; candidate++)
+		{
+			argb_t color(palette_colors[*candidate]);
+
+			int dr = r - color.getr();
+			int dg = g - color.getg();
+			int db = b - color.getb();
+			int distortion = dr*dr + dg*dg + db*db;
+			if (distortion < bestdistortion)
+			{
+				bestdistortion = distortion;
+				bestcolor = *candidate;
+			}
+		}
+
+		return bestcolor;
+	}
+
 	for (int i = 0; i < 256; i++)
 	{
 		argb_t color(palette_colors[i]);
@@ -629,6 +819,8 @@ void V_InitPalette(const char* lumpname)
 	for (int i = 0; i < 256; i++, data += 3)
 		default_palette.basecolors[i] = argb_t(255, data[0], data[1], data[2]);
 
+	V_BuildBestColorIndex(default_palette.basecolors);
+
 	V_GammaAdjustPalette(&default_palette);
 
 	V_ForceBlend(argb_t(0, 255, 255, 255));
@@ -1036,25 +1228,39 @@ void BuildColoredLights(shademap_t* maps, int lr, int lg, int lb, int r, int g,
 	}
 }
 
+// The colormaps in the NormalLight list, found by color and fade
+typedef OHashTable<uint64_t, dyncolormap_t*> DynColormapTable;
+static DynColormapTable dyncolormap_table;
+
+static uint64_t SpecialLightsKey(const argb_t color, const argb_t fade)
+{
+	return ((uint64_t)color.getr() << 40) | ((uint64_t)color.getg() << 32) | ((uint64_t)color.getb() << 24) |
+			((uint64_t)fade.getr() << 16) | ((uint64_t)fade.getg() << 8) | (uint64_t)fade.getb();
+}
+
 dyncolormap_t* GetSpecialLights(int lr, int lg, int lb, int fr, int fg, int fb)
 {
 	argb_t color(255, lr, lg, lb);
 	argb_t fade(255, fr, fg, fb);
 	dyncolormap_t* colormap = &NormalLight;
 
-	// Bah! Simple linear search because I want to get this done.
-	while (colormap)
-	{
-		if (color.getr() == colormap->color.getr() &&
-			color.getg() == colormap->color.getg() &&
-			color.getb() == colormap->color.getb() &&
-			fade.getr() == colormap->fade.getr() &&
-			fade.getg() == colormap->fade.getg() &&
-			fade.getb() == colormap->fade.getb())
-			return colormap;
-		else
-			colormap = colormap->next;
-	}
+	if (color.getr() == colormap->color.getr() &&
+		color.getg() == colormap->color.getg() &&
+		color.getb() == colormap->color.getb() &&
+		fade.getr() == colormap->fade.getr() &&
+		fade.getg() == colormap->fade.getg() &&
+		fade.getb() == colormap->fade.getb())
+		return colormap;
+
+	// The list is emptied by setting NormalLight.next to NULL when the level
+	// memory holding the colormaps is freed.
+	if (NormalLight.next == NULL)
+		dyncolormap_table.clear();
+
+	const uint64_t key = SpecialLightsKey(color, fade);
+	DynColormapTable::iterator it = dyncolormap_table.find(key);
+	if (it != dyncolormap_table.end())
+		return it->second;
 
 	// Not found. Create it.
 	colormap = (dyncolormap_t*)Z_Malloc(sizeof(*colormap), PU_LEVEL, 0);
@@ -1068,6 +1274,7 @@ dyncolormap_t* GetSpecialLights(int lr, int lg, int lb, int fr, int fg, int fb)
 	colormap->fade = fade;
 	colormap->next = NormalLight.next;
 	NormalLight.next = colormap;
+	dyncolormap_table.insert(std::make_pair(key, colormap));
 
 	BuildColoredLights(maps, lr, lg, lb, fr, fg, fb);
 
@@ -339,6 +339,10 @@ public:
 
 	virtual void RunThink ();
 
+	void *operator new (size_t size);
+	void operator delete (void *block, size_t size);
+	static void ClearPool ();
+
     // Info for drawing: position.
     fixed_t		x;
     fixed_t		y;
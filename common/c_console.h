@@ -59,6 +59,10 @@ void C_NewModeAdjust (void);
 void C_Ticker (void);
 
 int PrintString (int printlevel, const char *string);
+
+// Waits until everything printed so far has been written to the log file.
+// Must be called before LOG is opened or closed.
+void C_FlushLog (void);
 int STACK_ARGS Printf_Bold (const char *format, ...);
 
 void C_AddNotifyString (int printlevel, const char *s);
@@ -968,9 +968,11 @@ BEGIN_COMMAND (logfile)
     	time (&rawtime);
     	timeinfo = localtime (&rawtime);
     	Printf (PRINT_HIGH, "Log file %s closed on %s\n", LOG_FILE, asctime (timeinfo));
+		C_FlushLog();
 		LOG.close();
 	}
 
+	C_FlushLog();
 	LOG_FILE = (argc > 1 ? argv[1] : DEFAULT_LOG_FILE);
 	LOG.open (LOG_FILE, std::ios::app);
 
@@ -995,6 +997,7 @@ BEGIN_COMMAND (stoplog)
 		time (&rawtime);
     	timeinfo = localtime (&rawtime);
 		Printf (PRINT_HIGH, "Logging to file %s stopped %s\n", LOG_FILE, asctime (timeinfo));
+		C_FlushLog();
 		LOG.close();
 	}
 }
@@ -55,6 +55,7 @@
 #include "d_main.h"
 #include "d_dehacked.h"
 #include "s_sound.h"
+#include "stats.h"
 #include "gi.h"
 #include "w_ident.h"
 
@@ -1116,6 +1117,8 @@ void D_RunTics(void (*sim_func)(), void(*display_func)())
 
 	display_scheduler->run();
 
+	Stat_EndFrame();
+
 	if (timingdemo)
 		return;
 
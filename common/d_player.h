@@ -300,9 +300,10 @@ public:
 			std::string name;
 			std::string md5;
 			unsigned int next_offset;
+			int tokens;			// bytes that can be sent before waiting
 
-			download_t() : name(""), md5(""), next_offset(0) {}
-			download_t(const download_t& other) : name(other.name), md5(other.md5), next_offset(other.next_offset) {}
+			download_t() : name(""), md5(""), next_offset(0), tokens(0) {}
+			download_t(const download_t& other) : name(other.name), md5(other.md5), next_offset(other.next_offset), tokens(other.tokens) {}
 		} download;
 
 		client_t()
@@ -24,6 +24,7 @@
 
 #include "p_local.h"
 #include "dsectoreffect.h"
+#include "m_mempool.h"
 
 
 
@@ -31,6 +32,53 @@ EXTERN_CVAR(co_boomphys)			// [ML] Roll-up of various compat options
 
 IMPLEMENT_SERIAL (DSectorEffect, DThinker)
 
+// Floors, ceilings, doors, plats and lights are allocated from pools with
+// one cache line size each.  Anything larger goes through the zone.
+static FixedPool sectoreffect_pools[] = {
+	FixedPool(1 * FixedPool::CACHE_LINE, 32),
+	FixedPool(2 * FixedPool::CACHE_LINE, 32),
+	FixedPool(3 * FixedPool::CACHE_LINE, 32),
+	FixedPool(4 * FixedPool::CACHE_LINE, 32)
+};
+
+static const size_t NUM_SECTOREFFECT_POOLS =
+	sizeof(sectoreffect_pools) / sizeof(sectoreffect_pools[0]);
+
+static inline size_t SectorEffectPool (size_t size)
+{
+	return (size + FixedPool::CACHE_LINE - 1) / FixedPool::CACHE_LINE - 1;
+}
+
+void *DSectorEffect::operator new (size_t size)
+{
+	size_t pool = SectorEffectPool(size);
+	if (pool >= NUM_SECTOREFFECT_POOLS)
+		return DThinker::operator new (size);
+
+	return sectoreffect_pools[pool].alloc();
+}
+
+void DSectorEffect::operator delete (void *block, size_t size)
+{
+	size_t pool = SectorEffectPool(size);
+	if (pool >= NUM_SECTOREFFECT_POOLS)
+		DThinker::operator delete (block);
+	else
+		sectoreffect_pools[pool].free(block);
+}
+
+//
+// DSectorEffect::ClearPools
+//
+// Forgets every sector effect in the pools.  Must only be called once all
+// thinkers have been destroyed, when the level's memory is freed.
+//
+void DSectorEffect::ClearPools ()
+{
+	for (size_t i = 0; i < NUM_SECTOREFFECT_POOLS; i++)
+		sectoreffect_pools[i].clear();
+}
+
 DSectorEffect::DSectorEffect ()
 {
 	m_Sector = NULL;
@@ -49,6 +49,10 @@ public:
 	~DSectorEffect ();
 	virtual DSectorEffect* Clone(sector_t *sector) const;
 	virtual void Destroy();
+
+	void *operator new (size_t size);
+	void operator delete (void *block, size_t size);
+	static void ClearPools ();
 protected:
 	DSectorEffect ();
 	sector_t	*m_Sector;
@@ -37,6 +37,10 @@ IMPLEMENT_SERIAL (DThinker, DObject)
 DThinker *DThinker::FirstThinker = NULL;
 DThinker *DThinker::LastThinker = NULL;
 
+unsigned int DThinker::NextSerial = 0;
+FThinkerList DThinker::NewThinkers;
+std::vector<FThinkerList> DThinker::ClassLists;
+
 std::vector<DThinker *> LingerDestroy;
 
 void DThinker::Serialize (FArchive &arc)
@@ -110,6 +114,11 @@ DThinker::DThinker ()
 	LastThinker = this;
 	refCount = 0;
 	destroyed = false;
+
+	m_ClassNext = m_ClassPrev = NULL;
+	m_ClassList = NULL;
+	m_Serial = NextSerial++;
+	LinkToList (&NewThinkers);
 }
 
 DThinker::~DThinker ()
@@ -123,9 +132,103 @@ void DThinker::Orphan()
 {
 	m_Next = NULL;
 	m_Prev = NULL;
+	m_ClassNext = NULL;
+	m_ClassPrev = NULL;
+	m_ClassList = NULL;
 	refCount = 0;
 }
 
+//
+// DThinker::LinkToList
+//
+// Adds the thinker to the end of a class list.
+//
+void DThinker::LinkToList (FThinkerList *list)
+{
+	m_ClassList = list;
+	m_ClassNext = NULL;
+	m_ClassPrev = list->tail;
+	if (list->tail)
+		list->tail->m_ClassNext = this;
+	else
+		list->head = this;
+	list->tail = this;
+}
+
+//
+// DThinker::UnlinkFromList
+//
+// Removes the thinker from its class list.  Its own links are left alone,
+// like m_Next and m_Prev, so that an iterator that is about to visit it can
+// still move past it.
+//
+void DThinker::UnlinkFromList ()
+{
+	FThinkerList *list = m_ClassList;
+	if (!list)
+		return;
+
+	if (list->head == this)
+		list->head = m_ClassNext;
+	if (list->tail == this)
+		list->tail = m_ClassPrev;
+	if (m_ClassNext)
+		m_ClassNext->m_ClassPrev = m_ClassPrev;
+	if (m_ClassPrev)
+		m_ClassPrev->m_ClassNext = m_ClassNext;
+
+	m_ClassList = NULL;
+}
+
+//
+// DThinker::SortNewThinkers
+//
+// Moves thinkers created since the last call into the list for their
+// class.  They are moved in the order they were created, so every class
+// list stays in the same order as the main thinker list.
+//
+void DThinker::SortNewThinkers ()
+{
+	if (ClassLists.size() < TypeInfo::m_NumTypes)
+		ClassLists.resize (TypeInfo::m_NumTypes);
+
+	while (NewThinkers.head)
+	{
+		DThinker *thinker = NewThinkers.head;
+		thinker->UnlinkFromList ();
+		thinker->LinkToList (&ClassLists[RUNTIME_TYPE(thinker)->TypeIndex]);
+	}
+}
+
+//
+// DThinker::MatchingClasses
+//
+// Returns the indices of every class that is type or derived from it.
+//
+const std::vector<unsigned short> *DThinker::MatchingClasses (const TypeInfo *type)
+{
+	static std::vector<std::vector<unsigned short> > matches;
+	static std::vector<bool> known;
+
+	if (known.size() < TypeInfo::m_NumTypes)
+	{
+		matches.resize (TypeInfo::m_NumTypes);
+		known.resize (TypeInfo::m_NumTypes, false);
+	}
+
+	if (!known[type->TypeIndex])
+	{
+		for (unsigned short i = 0; i < TypeInfo::m_NumTypes; i++)
+		{
+			if (type->IsAncestorOf (TypeInfo::m_Types[i]))
+				matches[type->TypeIndex].push_back (i);
+		}
+		known[type->TypeIndex] = true;
+	}
+
+	return &matches[type->TypeIndex];
+}
+
 void DThinker::Destroy ()
 {
 	// denis - allow this function to be safely called multiple times
@@ -140,6 +243,7 @@ void DThinker::Destroy ()
 		m_Next->m_Prev = m_Prev;
 	if (m_Prev)
 		m_Prev->m_Next = m_Next;
+	UnlinkFromList ();
 	
 	destroyed = true;
 		
@@ -149,19 +253,37 @@ void DThinker::Destroy ()
 	}
 	else
 		Super::Destroy ();
+}
 
-	size_t l = LingerDestroy.size();	
-	for(size_t i = 0; i < l; i++)
+//
+// DThinker::ReclaimLingering
+//
+// Deletes destroyed thinkers that were still referenced when they were
+// destroyed but no longer are.  Called once per frame, just before
+// DObject::EndFrame.  Deleting a thinker can release its references to
+// others, so thinkers later in the list may be freed on the same pass and
+// earlier ones on the next.
+//
+void DThinker::ReclaimLingering ()
+{
+	size_t kept = 0;
+
+	// LingerDestroy may grow while objects are being deleted
+	for (size_t i = 0; i < LingerDestroy.size(); i++)
 	{
 		DThinker *obj = LingerDestroy[i];
-		if(!obj->refCount)
+		if (obj->refCount)
+		{
+			LingerDestroy[kept++] = obj;
+		}
+		else
 		{
 			obj->ObjectFlags |= OF_Cleanup;
-			LingerDestroy.erase(LingerDestroy.begin() + i);
-			l--; i--;
 			delete obj;
 		}
 	}
+
+	LingerDestroy.resize(kept);
 }
 
 bool DThinker::WasDestroyed ()
@@ -258,9 +380,10 @@ bool IndependentThinker(DThinker *thinker)
 
 void DThinker::RunThinkers ()
 {
+	PROFILE_ZONE("DThinker::RunThinkers");
+
 	DThinker *currentthinker;
 
-	BEGIN_STAT (ThinkCycles);
 	currentthinker = FirstThinker;
 	while (currentthinker)
 	{
@@ -268,7 +391,101 @@ void DThinker::RunThinkers ()
 			currentthinker->RunThink();
 		currentthinker = currentthinker->m_Next;
 	}
-	END_STAT (ThinkCycles);
+}
+
+FThinkerIterator::FThinkerIterator (TypeInfo *type)
+{
+	m_ParentType = type;
+	m_CurrThinker = DThinker::FirstThinker;
+	m_NumLists = 0;
+
+	// Visiting every thinker is quickest done with the main list
+	if (type == RUNTIME_CLASS(DThinker))
+		return;
+
+	const std::vector<unsigned short> *classes = DThinker::MatchingClasses (type);
+	if (classes->empty() || classes->size() > MAX_LISTS)
+		return;
+
+	DThinker::SortNewThinkers ();
+
+	m_NumLists = classes->size();
+	for (size_t i = 0; i < m_NumLists; i++)
+		m_Lists[i] = &DThinker::ClassLists[(*classes)[i]];
+
+	Reset ();
+}
+
+void FThinkerIterator::Reset ()
+{
+	for (size_t i = 0; i < m_NumLists; i++)
+		m_Cursors[i] = m_Lists[i]->head;
+
+	m_LastSerial = 0;
+	m_Started = false;
+	m_Finished = false;
+}
+
+//
+// FThinkerIterator::NextFromLists
+//
+// Returns the matching thinker that comes next in the main list, by merging
+// the class lists in creation order.  This visits thinkers in exactly the
+// same order as walking the main list would, which demo sync relies on.
+//
+DThinker *FThinkerIterator::NextFromLists ()
+{
+	if (DThinker::NewThinkers.head)
+		DThinker::SortNewThinkers ();
+
+	// The last thinker returned was at the end of the main list, where
+	// walking the main list would have stopped.
+	if (m_Finished)
+	{
+		Reset ();
+		return NULL;
+	}
+
+	DThinker *best = NULL;
+	size_t bestlist = 0;
+
+	for (size_t i = 0; i < m_NumLists; i++)
+	{
+		DThinker *cursor = m_Cursors[i];
+
+		if (!cursor)
+		{
+			// Pick up any thinkers created since this list was used up
+			cursor = m_Lists[i]->tail;
+			if (!cursor || (m_Started && !SerialBefore (m_LastSerial, cursor->m_Serial)))
+				continue;
+
+			while (cursor->m_ClassPrev &&
+				   (!m_Started || SerialBefore (m_LastSerial, cursor->m_ClassPrev->m_Serial)))
+				cursor = cursor->m_ClassPrev;
+
+			m_Cursors[i] = cursor;
+		}
+
+		if (!best || SerialBefore (cursor->m_Serial, best->m_Serial))
+		{
+			best = cursor;
+			bestlist = i;
+		}
+	}
+
+	if (!best)
+	{
+		Reset ();
+		return NULL;
+	}
+
+	m_Cursors[bestlist] = best->m_ClassNext;
+	m_LastSerial = best->m_Serial;
+	m_Started = true;
+	m_Finished = (best->m_Next == NULL);
+
+	return best;
 }
 
 void *DThinker::operator new (size_t size)
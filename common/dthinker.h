@@ -28,6 +28,7 @@
 #define __DTHINKER_H__
 
 #include <stdlib.h>
+#include <vector>
 #include "dobject.h"
 
 class AActor;
@@ -51,6 +52,16 @@ typedef union
 typedef actionf_t  think_t;
 
 class FThinkerIterator;
+class DThinker;
+
+// Head and tail of a list of thinkers linked through m_ClassNext/m_ClassPrev
+struct FThinkerList
+{
+	FThinkerList() : head(NULL), tail(NULL) {}
+
+	DThinker *head;
+	DThinker *tail;
+};
 
 // Doubly linked list of thinkers
 class DThinker : public DObject
@@ -73,6 +84,7 @@ public:
 	static void RunThinkers ();
 	static void DestroyAllThinkers ();
 	static void DestroyMostThinkers ();
+	static void ReclaimLingering ();
 	static void SerializeAll (FArchive &arc, bool keepPlayers, bool noStorePlayers);
 
 	bool WasDestroyed();
@@ -83,23 +95,61 @@ private:
 	DThinker *m_Next, *m_Prev;
 	bool destroyed;
 
+	// Every thinker is also kept in a list with the other thinkers of
+	// exactly the same class, so that FThinkerIterator only has to visit
+	// the thinkers it is looking for.  A thinker's class is not known until
+	// its constructor has finished, so new thinkers wait in NewThinkers
+	// until the next time a list is needed.  m_Serial records the order the
+	// thinkers were created in, which is also their order in the main list.
+	DThinker *m_ClassNext, *m_ClassPrev;
+	FThinkerList *m_ClassList;
+	unsigned int m_Serial;
+
+	static unsigned int NextSerial;
+	static FThinkerList NewThinkers;
+	static std::vector<FThinkerList> ClassLists;
+
+	void LinkToList (FThinkerList *list);
+	void UnlinkFromList ();
+
+	static void SortNewThinkers ();
+	static const std::vector<unsigned short> *MatchingClasses (const TypeInfo *type);
+
 	friend class FThinkerIterator;
 };
 
 class FThinkerIterator
 {
 private:
+	// Types with more matching classes than this walk the main list instead
+	static const size_t MAX_LISTS = 8;
+
 	TypeInfo *m_ParentType;
 	DThinker *m_CurrThinker;
 
-public:
-	FThinkerIterator (TypeInfo *type)
+	size_t m_NumLists;
+	FThinkerList *m_Lists[MAX_LISTS];
+	DThinker *m_Cursors[MAX_LISTS];
+	unsigned int m_LastSerial;
+	bool m_Started;
+	bool m_Finished;
+
+	void Reset ();
+	DThinker *NextFromLists ();
+
+	static bool SerialBefore (unsigned int a, unsigned int b)
 	{
-		m_ParentType = type;
-		m_CurrThinker = DThinker::FirstThinker;
+		return (int)(a - b) < 0;
 	}
+
+public:
+	FThinkerIterator (TypeInfo *type);
+
 	DThinker *Next ()
 	{
+		if (m_NumLists)
+			return NextFromLists ();
+
 		while (m_CurrThinker)
 		{
 			if (m_CurrThinker->IsKindOf (m_ParentType))
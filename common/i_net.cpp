@@ -80,6 +80,7 @@ typedef int SOCKET;
 
 #include "doomstat.h"
 #include "i_net.h"
+#include "i_thread.h"
 
 #ifdef _XBOX
 #include "i_xbox.h"
@@ -109,7 +110,6 @@ extern bool	simulated_connection;
 // can't be static to a function because some
 // of the functions
 buf_t compressed, decompressed;
-lzo_byte wrkmem[LZO1X_1_MEM_COMPRESS];
 
 EXTERN_CVAR(port)
 
@@ -354,8 +354,20 @@ void BindToLocalPort (SOCKET s, u_short wanted)
 }
 
 
+#ifdef __linux__
+static void NET_ClearRing (void);
+#endif
+
+static bool net_thread_running = false;
+static int NET_ThreadGetPacket (void);
+static int NET_ThreadQueuePacket (buf_t &buf, netadr_t &to);
+static void NET_ThreadWake (void);
+static void NET_CloseWake (void);
+
 void CloseNetwork (void)
 {
+	NET_StopThread();
+
 #ifdef ODA_HAVE_MINIUPNP
     upnp_rem_redir (port);
 #endif
@@ -364,6 +376,10 @@ void CloseNetwork (void)
 #ifdef _WIN32
 	WSACleanup ();
 #endif
+
+#ifdef __linux__
+	NET_ClearRing();
+#endif
 }
 
 
@@ -439,12 +455,116 @@ bool NET_CompareAdr (netadr_t a, netadr_t b)
 typedef int socklen_t;
 #endif
 
+#ifdef __linux__
+
+// Datagrams are read from the socket in batches and handed out one at
+// a time by NET_GetPacket, saving a system call for every packet when many
+// arrive at once.
+static const size_t NET_RING_SIZE = 32;
+
+static buf_t		net_ring[NET_RING_SIZE];
+static netadr_t		net_ring_from[NET_RING_SIZE];
+static size_t		net_ring_head = 0;
+static size_t		net_ring_count = 0;
+
+//
+// NET_FillRing
+//
+// Reads as many waiting datagrams as will fit into the receive ring.
+// Returns the number read.
+//
+static size_t NET_FillRing (void)
+{
+	struct sockaddr_in	from[NET_RING_SIZE];
+	struct iovec		iovs[NET_RING_SIZE];
+	struct mmsghdr		msgs[NET_RING_SIZE];
+
+	memset(msgs, 0, sizeof(msgs));
+	for (size_t i = 0; i < NET_RING_SIZE; i++)
+	{
+		if (net_ring[i].maxsize() < net_message.maxsize())
+			net_ring[i].resize(net_message.maxsize());
+
+		net_ring[i].clear();
+		iovs[i].iov_base = net_ring[i].ptr();
+		iovs[i].iov_len = net_ring[i].maxsize();
+		msgs[i].msg_hdr.msg_name = &from[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int ret = recvmmsg(inet_socket, msgs, NET_RING_SIZE, MSG_DONTWAIT, NULL);
+
+	if (ret == -1)
+	{
+		if (errno == EWOULDBLOCK)
+			return 0;
+		if (errno == ECONNREFUSED)
+			return 0;
+
+		Printf (PRINT_HIGH, "NET_GetPacket: %s\n", strerror(errno));
+		return 0;
+	}
+
+	for (int i = 0; i < ret; i++)
+	{
+		net_ring[i].setcursize(msgs[i].msg_len);
+		SockadrToNetadr(&from[i], &net_ring_from[i]);
+	}
+
+	net_ring_head = 0;
+	net_ring_count = ret;
+
+	return ret;
+}
+
+//
+// NET_ClearRing
+//
+// Throws away any datagrams that have been read but not handed out yet.
+//
+static void NET_ClearRing (void)
+{
+	net_ring_head = 0;
+	net_ring_count = 0;
+}
+
+int NET_GetPacket (void)
+{
+	if (net_thread_running)
+		return NET_ThreadGetPacket();
+
+	if (net_ring_count == 0 && NET_FillRing() == 0)
+	{
+		net_message.clear();
+		return 0;
+	}
+
+	// Hand the slot's buffer over to net_message rather than copying it.
+	buf_t &slot = net_ring[net_ring_head];
+	net_message.swap(slot);
+	net_message.readpos = 0;
+	net_message.overflowed = false;
+	net_from = net_ring_from[net_ring_head];
+
+	net_ring_head++;
+	net_ring_count--;
+
+	return net_message.size();
+}
+
+#else
+
 int NET_GetPacket (void)
 {
 	int				  ret;
 	struct sockaddr_in   from;
 	socklen_t			fromlen;
 
+	if (net_thread_running)
+		return NET_ThreadGetPacket();
+
 	fromlen = sizeof(from);
 	net_message.clear();
 	ret = recvfrom (inet_socket, (char *)net_message.ptr(), net_message.maxsize(), 0, (struct sockaddr *)&from, &fromlen);
@@ -485,6 +605,8 @@ int NET_GetPacket (void)
 	return ret;
 }
 
+#endif	// __linux__
+
 int NET_SendPacket (buf_t &buf, netadr_t &to)
 {
 	int				   ret;
@@ -498,6 +620,13 @@ int NET_SendPacket (buf_t &buf, netadr_t &to)
 		return 0;
 	}
 
+	if (net_thread_running)
+	{
+		int queued = NET_ThreadQueuePacket(buf, to);
+		NET_ThreadWake();
+		return queued;
+	}
+
 	NetadrToSockadr (&to, &addr);
 
 	ret = sendto (inet_socket, (const char *)buf.ptr(), buf.size(), 0, (struct sockaddr *)&addr, sizeof(addr));
@@ -524,6 +653,489 @@ int NET_SendPacket (buf_t &buf, netadr_t &to)
 	return ret;
 }
 
+//
+// NET_SendPackets
+//
+// Sends a batch of packets in the given order.  On Linux they are handed to
+// the kernel with as few system calls as possible.
+//
+void NET_SendPackets (buf_t **bufs, netadr_t *to, size_t count)
+{
+	if (net_thread_running && !simulated_connection)
+	{
+		for (size_t i = 0; i < count; i++)
+			NET_ThreadQueuePacket(*bufs[i], to[i]);
+
+		NET_ThreadWake();
+		return;
+	}
+
+#ifdef __linux__
+	if (simulated_connection)
+	{
+		for (size_t i = 0; i < count; i++)
+			bufs[i]->clear();
+		return;
+	}
+
+	static const size_t MAX_BATCH = 64;
+
+	struct sockaddr_in addrs[MAX_BATCH];
+	struct iovec iovs[MAX_BATCH];
+	struct mmsghdr msgs[MAX_BATCH];
+
+	size_t sent = 0;
+	while (sent < count)
+	{
+		size_t batch = count - sent < MAX_BATCH ? count - sent : MAX_BATCH;
+
+		memset(msgs, 0, sizeof(msgs[0]) * batch);
+		for (size_t i = 0; i < batch; i++)
+		{
+			NetadrToSockadr(&to[sent + i], &addrs[i]);
+			iovs[i].iov_base = bufs[sent + i]->ptr();
+			iovs[i].iov_len = bufs[sent + i]->size();
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int ret = sendmmsg(inet_socket, msgs, batch, 0);
+
+		if (ret <= 0)
+		{
+			// Let NET_SendPacket deal with (and report) the error, then
+			// carry on with the rest of the batch.
+			NET_SendPacket(*bufs[sent], to[sent]);
+			ret = 1;
+		}
+
+		for (int i = 0; i < ret; i++)
+			bufs[sent + i]->clear();
+
+		sent += ret;
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+		NET_SendPacket(*bufs[i], to[i]);
+#endif
+}
+
+
+// ============================================================================
+//
+// Network thread
+//
+// When enabled, a separate thread owns all reads from and writes to the
+// socket.  Incoming datagrams are stamped with the time they arrived and
+// passed to the game thread through a lock-free queue, so that ping and
+// unlag calculations are not thrown off by when the game thread next gets
+// around to reading the socket.  Outgoing datagrams are passed the other
+// way.  The game thread still does all of the actual packet processing.
+//
+// ============================================================================
+
+struct net_datagram_t
+{
+	buf_t		buf;
+	netadr_t	addr;
+	dtime_t		time;		// arrival time in milliseconds
+};
+
+static const size_t NET_QUEUE_SIZE = 256;
+
+typedef OSPSCQueue<net_datagram_t, NET_QUEUE_SIZE> NetQueue;
+
+static NetQueue			net_inbound;		// network thread -> game thread
+static NetQueue			net_outbound;		// game thread -> network thread
+static OThread			net_thread;
+static volatile size_t	net_thread_quit = 0;
+static dtime_t			net_packet_time = 0;
+
+// Counted by the network thread, which must not call Printf.
+static volatile size_t	net_thread_dropped = 0;
+static volatile size_t	net_thread_errors = 0;
+
+// Packets the game thread threw away because the outbound queue was full.
+static size_t			net_outbound_dropped = 0;
+
+#ifdef _WIN32
+// Set by the game thread to wake the network thread when there are packets
+// waiting to be sent, and by the socket when a datagram arrives.
+static HANDLE			net_wake_event = NULL;
+static WSAEVENT			net_socket_event = WSA_INVALID_EVENT;
+#else
+// Written to by the game thread to wake the network thread when there are
+// packets waiting to be sent.
+static int				net_wake_pipe[2] = { -1, -1 };
+#endif
+
+#ifdef __linux__
+//
+// NET_RingToThread
+//
+// Moves the datagrams in the receive ring that have not been handed out
+// yet to the inbound queue, so the game thread still gets them in order.
+// Only safe to call while the network thread is not running.
+//
+static void NET_RingToThread (void)
+{
+	while (net_ring_count > 0)
+	{
+		net_datagram_t *dg = net_inbound.back();
+		if (!dg)
+		{
+			net_thread_dropped += net_ring_count;
+			break;
+		}
+
+		dg->buf.swap(net_ring[net_ring_head]);
+		dg->addr = net_ring_from[net_ring_head];
+		dg->time = I_MSTime();
+		net_inbound.push();
+
+		net_ring_head++;
+		net_ring_count--;
+	}
+
+	NET_ClearRing();
+}
+#endif
+
+//
+// NET_ThreadWait
+//
+// Sleeps until a datagram arrives or the game thread queues packets to
+// send or asks the thread to quit.
+//
+static void NET_ThreadWait (void)
+{
+#ifdef _WIN32
+	HANDLE events[2] = { net_socket_event, net_wake_event };
+
+	// The socket event stays set until it is reset, and it is set again by
+	// the next datagram once the socket has been read until it is empty.
+	if (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0)
+		WSAResetEvent(net_socket_event);
+#else
+	fd_set fds;
+
+	FD_ZERO(&fds);
+	FD_SET(inet_socket, &fds);
+	FD_SET(net_wake_pipe[0], &fds);
+
+	int maxfd = inet_socket;
+	if (net_wake_pipe[0] > maxfd)
+		maxfd = net_wake_pipe[0];
+
+	if (select(maxfd + 1, &fds, NULL, NULL, NULL) <= 0)
+		return;
+
+	if (FD_ISSET(net_wake_pipe[0], &fds))
+	{
+		char dummy[64];
+		while (read(net_wake_pipe[0], dummy, sizeof(dummy)) > 0)
+			;
+	}
+#endif
+}
+
+//
+// NET_ThreadMain
+//
+static void NET_ThreadMain (void *data)
+{
+	// Datagrams that arrive while the inbound queue is full are read into
+	// here and thrown away.
+	buf_t overflow(MAX_UDP_PACKET);
+
+	while (!I_AtomicLoad(&net_thread_quit))
+	{
+		NET_ThreadWait();
+
+		// Send everything the game thread has queued
+		while (net_datagram_t *dg = net_outbound.front())
+		{
+			struct sockaddr_in addr;
+			NetadrToSockadr(&dg->addr, &addr);
+
+			if (sendto(inet_socket, (const char *)dg->buf.ptr(), dg->buf.size(), 0,
+					   (struct sockaddr *)&addr, sizeof(addr)) == -1)
+				net_thread_errors++;
+
+			dg->buf.clear();
+			net_outbound.pop();
+		}
+
+		// Read everything waiting on the socket
+		for (;;)
+		{
+			net_datagram_t *dg = net_inbound.back();
+			buf_t &buf = dg ? dg->buf : overflow;
+
+			struct sockaddr_in from;
+			socklen_t fromlen = sizeof(from);
+
+			buf.clear();
+			int ret = recvfrom(inet_socket, (char *)buf.ptr(), buf.maxsize(), 0,
+							   (struct sockaddr *)&from, &fromlen);
+			if (ret == -1)
+				break;
+
+			if (!dg)
+			{
+				net_thread_dropped++;
+				continue;
+			}
+
+			buf.setcursize(ret);
+			SockadrToNetadr(&from, &dg->addr);
+			dg->time = I_MSTime();
+
+			net_inbound.push();
+		}
+	}
+}
+
+//
+// NET_OpenWake
+//
+// Sets up what the network thread sleeps on.
+//
+static bool NET_OpenWake (void)
+{
+#ifdef _WIN32
+	net_wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+	net_socket_event = WSACreateEvent();
+
+	if (net_wake_event == NULL || net_socket_event == WSA_INVALID_EVENT ||
+		WSAEventSelect(inet_socket, net_socket_event, FD_READ) == SOCKET_ERROR)
+	{
+		Printf(PRINT_HIGH, "NET_StartThread: unable to create events\n");
+		NET_CloseWake();
+		return false;
+	}
+#else
+	if (pipe(net_wake_pipe) == -1)
+	{
+		Printf(PRINT_HIGH, "NET_StartThread: %s\n", strerror(errno));
+		return false;
+	}
+
+	unsigned long _true = true;
+	ioctlsocket(net_wake_pipe[0], FIONBIO, &_true);
+	ioctlsocket(net_wake_pipe[1], FIONBIO, &_true);
+#endif
+
+	return true;
+}
+
+//
+// NET_CloseWake
+//
+static void NET_CloseWake (void)
+{
+#ifdef _WIN32
+	// Stop signalling the event.  This leaves the socket non-blocking,
+	// which it already was.
+	WSAEventSelect(inet_socket, NULL, 0);
+
+	if (net_socket_event != WSA_INVALID_EVENT)
+		WSACloseEvent(net_socket_event);
+	if (net_wake_event != NULL)
+		CloseHandle(net_wake_event);
+
+	net_socket_event = WSA_INVALID_EVENT;
+	net_wake_event = NULL;
+#else
+	close(net_wake_pipe[0]);
+	close(net_wake_pipe[1]);
+	net_wake_pipe[0] = net_wake_pipe[1] = -1;
+#endif
+}
+
+//
+// NET_StartThread
+//
+// Hands the socket over to a network thread.  Must be called after
+// InitNetCommon.  Datagrams that have already been read from the socket
+// but not handed out are passed on to the thread first.
+//
+bool NET_StartThread (void)
+{
+	if (net_thread_running)
+		return true;
+
+	for (size_t i = 0; i < NetQueue::capacity(); i++)
+	{
+		if (net_inbound.slot(i).buf.maxsize() < MAX_UDP_PACKET)
+			net_inbound.slot(i).buf.resize(MAX_UDP_PACKET);
+		if (net_outbound.slot(i).buf.maxsize() < MAX_UDP_PACKET)
+			net_outbound.slot(i).buf.resize(MAX_UDP_PACKET);
+	}
+
+	if (!NET_OpenWake())
+		return false;
+
+	net_thread_quit = 0;
+	net_thread_dropped = 0;
+	net_thread_errors = 0;
+	net_outbound_dropped = 0;
+
+#ifdef __linux__
+	// The thread has not started, so this thread can fill the queue.
+	NET_RingToThread();
+#endif
+
+	if (!net_thread.start(&NET_ThreadMain, NULL))
+	{
+		Printf(PRINT_HIGH, "NET_StartThread: unable to create thread\n");
+		NET_CloseWake();
+
+		while (net_inbound.front())
+			net_inbound.pop();
+
+		return false;
+	}
+
+	net_thread_running = true;
+	return true;
+}
+
+//
+// NET_StopThread
+//
+// Stops the network thread and returns the socket to the game thread.
+// Packets still waiting to be sent are flushed and any that have been
+// received but not read are thrown away.
+//
+void NET_StopThread (void)
+{
+	if (!net_thread_running)
+		return;
+
+	I_AtomicStore(&net_thread_quit, 1);
+	NET_ThreadWake();
+	net_thread.join();
+
+	net_thread_running = false;
+
+	NET_CloseWake();
+
+	while (net_datagram_t *dg = net_outbound.front())
+	{
+		NET_SendPacket(dg->buf, dg->addr);
+		net_outbound.pop();
+	}
+
+	while (net_inbound.front())
+		net_inbound.pop();
+
+	if (net_thread_dropped || net_thread_errors || net_outbound_dropped)
+		Printf(PRINT_HIGH, "Network thread dropped %u received and %u outgoing packets, "
+				"%u send errors\n",
+				(unsigned)net_thread_dropped, (unsigned)net_outbound_dropped,
+				(unsigned)net_thread_errors);
+}
+
+//
+// NET_ThreadWake
+//
+static void NET_ThreadWake (void)
+{
+#ifdef _WIN32
+	SetEvent(net_wake_event);
+#else
+	char c = 0;
+	if (write(net_wake_pipe[1], &c, 1) == -1)
+	{
+		// The pipe is already full, so the thread is going to wake anyway.
+	}
+#endif
+}
+
+//
+// NET_ThreadGetPacket
+//
+// Moves the oldest datagram received by the network thread into
+// net_message.
+//
+static int NET_ThreadGetPacket (void)
+{
+	net_datagram_t *dg = net_inbound.front();
+	if (!dg)
+	{
+		net_message.clear();
+		return 0;
+	}
+
+	// Hand the slot's buffer over to net_message rather than copying it.
+	net_message.swap(dg->buf);
+	net_message.readpos = 0;
+	net_message.overflowed = false;
+	net_from = dg->addr;
+	net_packet_time = dg->time;
+
+	// The slot may have been given net_message's old buffer, which the
+	// network thread expects to be big enough for any datagram.
+	if (dg->buf.maxsize() < MAX_UDP_PACKET)
+		dg->buf.resize(MAX_UDP_PACKET);
+
+	net_inbound.pop();
+
+	return net_message.size();
+}
+
+//
+// NET_ThreadQueuePacket
+//
+// Copies a packet to the network thread's outbound queue and clears buf.
+// Returns the number of bytes queued.  If the queue is full, the packet is
+// dropped and counted, as the socket would drop it if its own buffer was
+// full.  Sending it straight away would get it out ahead of the packets
+// already queued.
+//
+static int NET_ThreadQueuePacket (buf_t &buf, netadr_t &to)
+{
+	net_datagram_t *dg = net_outbound.back();
+	if (!dg)
+	{
+		net_outbound_dropped++;
+		buf.clear();
+		return 0;
+	}
+
+	int size = buf.size();
+
+	// a buf_t can only be filled to one byte short of its size
+	if (dg->buf.maxsize() <= buf.size())
+		dg->buf.resize(buf.maxsize());
+
+	dg->buf.clear();
+	dg->buf.WriteChunk((const char *)buf.ptr(), buf.size());
+	dg->addr = to;
+
+	net_outbound.push();
+
+	buf.clear();
+	return size;
+}
+
+//
+// NET_PacketTime
+//
+// Returns the time in milliseconds that the last packet returned by
+// NET_GetPacket arrived.  Without the network thread, that is taken to be
+// the time it was read.
+//
+dtime_t NET_PacketTime (void)
+{
+	if (net_thread_running)
+		return net_packet_time;
+
+	return I_MSTime();
+}
 
 #ifndef HOST_NAME_MAX
 #define HOST_NAME_MAX 256
@@ -779,10 +1391,33 @@ bool MSG_DecompressMinilzo ()
 	return true;
 }
 
+compress_scratch_t::compress_scratch_t() :
+	workmem(new byte[LZO1X_1_MEM_COMPRESS])
+{
+}
+
+compress_scratch_t::~compress_scratch_t()
+{
+	delete[] workmem;
+}
+
 //
 // MSG_CompressMinilzo
 //
 bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
+{
+	static compress_scratch_t scratch;
+
+	return MSG_CompressMinilzo(buf, start_offset, write_gap, scratch);
+}
+
+//
+// MSG_CompressMinilzo
+//
+// Only touches the given scratch memory, so it can be called from more
+// than one thread at once as long as each has its own scratch.
+//
+bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap, compress_scratch_t &scratch)
 {
 	if(buf.size() < MINILZO_COMPRESS_MINPACKETSIZE)
 		return false;
@@ -790,23 +1425,25 @@ bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap)
 	lzo_uint outlen = OUT_LEN(buf.maxsize() - start_offset - write_gap);
 	size_t total_len = outlen + start_offset + write_gap;
 
-	if(compressed.maxsize() < total_len)
-		compressed.resize(total_len);
+	if(scratch.compressed.maxsize() < total_len)
+		scratch.compressed.resize(total_len);
 
 	int r = lzo1x_1_compress (buf.ptr() + start_offset,
 							  buf.size() - start_offset,
-							  compressed.ptr() + start_offset + write_gap,
+							  scratch.compressed.ptr() + start_offset + write_gap,
 							  &outlen,
-							  wrkmem);
+							  scratch.workmem);
 
 	// worth the effort?
 	if(r != LZO_E_OK || outlen >= (buf.size() - start_offset - write_gap))
 		return false;
 
-	memcpy(compressed.ptr(), buf.ptr(), start_offset);
+	memcpy(scratch.compressed.ptr(), buf.ptr(), start_offset);
 
-	SZ_Clear(&buf);
-	MSG_WriteChunk(&buf, compressed.ptr(), outlen + start_offset + write_gap);
+	// the compressed data is always smaller, so this can't overflow
+	buf.clear();
+	memcpy(buf.ptr(), scratch.compressed.ptr(), outlen + start_offset + write_gap);
+	buf.cursize = outlen + start_offset + write_gap;
 
 	return true;
 }
@@ -28,6 +28,7 @@
 #include "doomtype.h"
 #include "huffman.h"
 
+#include <algorithm>
 #include <string>
 
 // Max packet size to send and receive, in bytes
@@ -483,6 +484,16 @@ public:
 		return ret;
 	}
 
+	// Exchanges the contents of two buffers without copying them.
+	void swap(buf_t &other)
+	{
+		std::swap(data, other.data);
+		std::swap(allocsize, other.allocsize);
+		std::swap(cursize, other.cursize);
+		std::swap(readpos, other.readpos);
+		std::swap(overflowed, other.overflowed);
+	}
+
 	buf_t &operator =(const buf_t &other)
 	{
 	    // Avoid self-assignment
@@ -539,6 +550,10 @@ bool NET_StringToAdr (const char *s, netadr_t *a);
 bool NET_CompareAdr (netadr_t a, netadr_t b);
 int  NET_GetPacket (void);
 int NET_SendPacket (buf_t &buf, netadr_t &to);
+void NET_SendPackets (buf_t **bufs, netadr_t *to, size_t count);
+bool NET_StartThread (void);
+void NET_StopThread (void);
+dtime_t NET_PacketTime (void);
 std::string NET_GetLocalAddress (void);
 
 void SZ_Clear (buf_t *buf);
@@ -569,8 +584,25 @@ const char *MSG_ReadString (void);
 
 size_t MSG_SetOffset (const size_t &offset, const buf_t::seek_loc_t &loc);
 
+// Working memory for MSG_CompressMinilzo.  Threads compressing packets at
+// the same time must each use their own.
+class compress_scratch_t
+{
+public:
+	buf_t	compressed;
+	byte	*workmem;
+
+	compress_scratch_t();
+	~compress_scratch_t();
+
+private:
+	compress_scratch_t(const compress_scratch_t &);
+	compress_scratch_t &operator =(const compress_scratch_t &);
+};
+
 bool MSG_DecompressMinilzo ();
 bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap);
+bool MSG_CompressMinilzo (buf_t &buf, size_t start_offset, size_t write_gap, compress_scratch_t &scratch);
 
 bool MSG_DecompressAdaptive (huffman &huff);
 bool MSG_CompressAdaptive (huffman &huff, buf_t &buf, size_t start_offset, size_t write_gap);
@@ -0,0 +1,402 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Minimal threading primitives and a fork/join worker pool.
+//
+//-----------------------------------------------------------------------------
+
+#include "version.h"
+#include "i_thread.h"
+
+#ifndef _WIN32
+	#include <errno.h>
+	#include <sys/time.h>
+	#include <time.h>
+#endif
+
+// ============================================================================
+//
+// OMutex
+//
+// ============================================================================
+
+#ifdef _WIN32
+
+OMutex::OMutex()
+{
+	InitializeCriticalSection(&mMutex);
+}
+
+OMutex::~OMutex()
+{
+	DeleteCriticalSection(&mMutex);
+}
+
+void OMutex::lock()
+{
+	EnterCriticalSection(&mMutex);
+}
+
+void OMutex::unlock()
+{
+	LeaveCriticalSection(&mMutex);
+}
+
+#else
+
+OMutex::OMutex()
+{
+	pthread_mutex_init(&mMutex, NULL);
+}
+
+OMutex::~OMutex()
+{
+	pthread_mutex_destroy(&mMutex);
+}
+
+void OMutex::lock()
+{
+	pthread_mutex_lock(&mMutex);
+}
+
+void OMutex::unlock()
+{
+	pthread_mutex_unlock(&mMutex);
+}
+
+#endif
+
+// ============================================================================
+//
+// OSemaphore
+//
+// POSIX unnamed semaphores are not available everywhere (OSX), so a
+// condition variable and counter are used instead.
+//
+// ============================================================================
+
+#ifdef _WIN32
+
+OSemaphore::OSemaphore(unsigned int count)
+{
+	mSemaphore = CreateSemaphore(NULL, count, 0x7FFFFFFF, NULL);
+}
+
+OSemaphore::~OSemaphore()
+{
+	CloseHandle(mSemaphore);
+}
+
+void OSemaphore::post(unsigned int count)
+{
+	if (count)
+		ReleaseSemaphore(mSemaphore, count, NULL);
+}
+
+void OSemaphore::wait()
+{
+	WaitForSingleObject(mSemaphore, INFINITE);
+}
+
+bool OSemaphore::timedWait(unsigned int timeout_ms)
+{
+	return WaitForSingleObject(mSemaphore, timeout_ms) == WAIT_OBJECT_0;
+}
+
+#else
+
+OSemaphore::OSemaphore(unsigned int count) : mCount(count)
+{
+	pthread_mutex_init(&mMutex, NULL);
+	pthread_cond_init(&mCond, NULL);
+}
+
+OSemaphore::~OSemaphore()
+{
+	pthread_cond_destroy(&mCond);
+	pthread_mutex_destroy(&mMutex);
+}
+
+void OSemaphore::post(unsigned int count)
+{
+	pthread_mutex_lock(&mMutex);
+	mCount += count;
+	if (count == 1)
+		pthread_cond_signal(&mCond);
+	else if (count > 1)
+		pthread_cond_broadcast(&mCond);
+	pthread_mutex_unlock(&mMutex);
+}
+
+void OSemaphore::wait()
+{
+	pthread_mutex_lock(&mMutex);
+	while (mCount == 0)
+		pthread_cond_wait(&mCond, &mMutex);
+	mCount--;
+	pthread_mutex_unlock(&mMutex);
+}
+
+bool OSemaphore::timedWait(unsigned int timeout_ms)
+{
+	struct timeval now;
+	gettimeofday(&now, NULL);
+
+	struct timespec deadline;
+	deadline.tv_sec = now.tv_sec + timeout_ms / 1000;
+	deadline.tv_nsec = now.tv_usec * 1000 + (timeout_ms % 1000) * 1000000;
+	if (deadline.tv_nsec >= 1000000000)
+	{
+		deadline.tv_sec++;
+		deadline.tv_nsec -= 1000000000;
+	}
+
+	pthread_mutex_lock(&mMutex);
+	while (mCount == 0)
+	{
+		if (pthread_cond_timedwait(&mCond, &mMutex, &deadline) == ETIMEDOUT)
+			break;
+	}
+
+	bool acquired = mCount > 0;
+	if (acquired)
+		mCount--;
+	pthread_mutex_unlock(&mMutex);
+
+	return acquired;
+}
+
+#endif
+
+// ============================================================================
+//
+// OThread
+//
+// ============================================================================
+
+OThread::OThread() : mFunc(NULL), mData(NULL), mRunning(false)
+{
+}
+
+OThread::~OThread()
+{
+	join();
+}
+
+#ifdef _WIN32
+
+DWORD WINAPI OThread::entry(LPVOID arg)
+{
+	OThread* thread = static_cast<OThread*>(arg);
+	thread->mFunc(thread->mData);
+	return 0;
+}
+
+bool OThread::start(ThreadFunc func, void* data)
+{
+	if (mRunning)
+		return false;
+
+	mFunc = func;
+	mData = data;
+
+	mThread = CreateThread(NULL, 0, &OThread::entry, this, 0, NULL);
+	mRunning = (mThread != NULL);
+
+	return mRunning;
+}
+
+void OThread::join()
+{
+	if (!mRunning)
+		return;
+
+	WaitForSingleObject(mThread, INFINITE);
+	CloseHandle(mThread);
+	mRunning = false;
+}
+
+#else
+
+void* OThread::entry(void* arg)
+{
+	OThread* thread = static_cast<OThread*>(arg);
+	thread->mFunc(thread->mData);
+	return NULL;
+}
+
+bool OThread::start(ThreadFunc func, void* data)
+{
+	if (mRunning)
+		return false;
+
+	mFunc = func;
+	mData = data;
+
+	mRunning = (pthread_create(&mThread, NULL, &OThread::entry, this) == 0);
+
+	return mRunning;
+}
+
+void OThread::join()
+{
+	if (!mRunning)
+		return;
+
+	pthread_join(mThread, NULL);
+	mRunning = false;
+}
+
+#endif
+
+// ============================================================================
+//
+// OWorkerPool
+//
+// ============================================================================
+
+OWorkerPool::OWorkerPool() :
+	mFunc(NULL), mData(NULL), mCount(0), mNext(0), mQuit(false)
+{
+}
+
+OWorkerPool::~OWorkerPool()
+{
+	resize(0);
+}
+
+//
+// OWorkerPool::resize
+//
+// Sets the number of threads that are started in addition to the calling
+// thread.
+//
+void OWorkerPool::resize(size_t num_threads)
+{
+	if (num_threads == mThreads.size())
+		return;
+
+	// Stop all existing threads.
+	if (!mThreads.empty())
+	{
+		mQuit = true;
+		mStart.post(mThreads.size());
+
+		for (size_t i = 0; i < mThreads.size(); i++)
+		{
+			mThreads[i]->join();
+			delete mThreads[i];
+		}
+
+		mThreads.clear();
+		mQuit = false;
+	}
+
+	// The argument structures must not move once the threads are running.
+	mArgs.resize(num_threads);
+
+	for (size_t i = 0; i < num_threads; i++)
+	{
+		mArgs[i].pool = this;
+		mArgs[i].worker = i + 1;
+
+		OThread* thread = new OThread;
+		if (!thread->start(&OWorkerPool::workerEntry, &mArgs[i]))
+		{
+			delete thread;
+			break;
+		}
+
+		mThreads.push_back(thread);
+	}
+}
+
+//
+// OWorkerPool::run
+//
+// Calls func for every job from 0 to count - 1 and returns once they have
+// all completed.  The order that jobs are started in is not defined.
+//
+void OWorkerPool::run(size_t count, JobFunc func, void* data)
+{
+	if (count == 0)
+		return;
+
+	if (mThreads.empty() || count == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			func(i, 0, data);
+		return;
+	}
+
+	mFunc = func;
+	mData = data;
+	mCount = count;
+	mNext = 0;
+
+	mStart.post(mThreads.size());
+
+	work(0);
+
+	for (size_t i = 0; i < mThreads.size(); i++)
+		mDone.wait();
+
+	mFunc = NULL;
+	mData = NULL;
+}
+
+void OWorkerPool::workerEntry(void* data)
+{
+	WorkerArgs* args = static_cast<WorkerArgs*>(data);
+	OWorkerPool* pool = args->pool;
+
+	for (;;)
+	{
+		pool->mStart.wait();
+
+		if (pool->mQuit)
+			return;
+
+		pool->work(args->worker);
+		pool->mDone.post();
+	}
+}
+
+//
+// OWorkerPool::work
+//
+// Takes jobs from the current batch until there are none left.
+//
+void OWorkerPool::work(size_t worker)
+{
+	for (;;)
+	{
+		size_t index;
+
+		{
+			OMutexLock lock(mMutex);
+			if (mNext >= mCount)
+				return;
+			index = mNext++;
+		}
+
+		mFunc(index, worker, mData);
+	}
+}
+
+VERSION_CONTROL (i_thread_cpp, "$Id$")
@@ -0,0 +1,280 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//   Minimal threading primitives and a fork/join worker pool.
+//
+//   Game logic is single threaded.  These are only meant for handing
+//   self-contained work (compressing packets, writing log files) to other
+//   threads, so they are deliberately kept small.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __I_THREAD_H__
+#define __I_THREAD_H__
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _WIN32
+	#include "win32inc.h"
+#else
+	#include <pthread.h>
+#endif
+
+//
+// I_AtomicLoad / I_AtomicStore
+//
+// Reads and writes an aligned word so that everything written before the
+// store is visible to another thread once it sees the stored value.
+//
+inline size_t I_AtomicLoad(const volatile size_t* ptr)
+{
+	size_t val = *ptr;
+	#ifdef _WIN32
+	MemoryBarrier();
+	#else
+	__sync_synchronize();
+	#endif
+	return val;
+}
+
+inline void I_AtomicStore(volatile size_t* ptr, size_t val)
+{
+	#ifdef _WIN32
+	MemoryBarrier();
+	#else
+	__sync_synchronize();
+	#endif
+	*ptr = val;
+}
+
+//
+// OMutex
+//
+class OMutex
+{
+public:
+	OMutex();
+	~OMutex();
+
+	void lock();
+	void unlock();
+
+private:
+	OMutex(const OMutex&);
+	OMutex& operator=(const OMutex&);
+
+	#ifdef _WIN32
+	CRITICAL_SECTION mMutex;
+	#else
+	pthread_mutex_t mMutex;
+	#endif
+};
+
+//
+// OMutexLock
+//
+// Holds a mutex for the lifetime of the object.
+//
+class OMutexLock
+{
+public:
+	explicit OMutexLock(OMutex& mutex) : mMutex(mutex) { mMutex.lock(); }
+	~OMutexLock() { mMutex.unlock(); }
+
+private:
+	OMutexLock(const OMutexLock&);
+	OMutexLock& operator=(const OMutexLock&);
+
+	OMutex& mMutex;
+};
+
+//
+// OSemaphore
+//
+class OSemaphore
+{
+public:
+	explicit OSemaphore(unsigned int count = 0);
+	~OSemaphore();
+
+	void post(unsigned int count = 1);
+	void wait();
+
+	// Waits for at most timeout_ms milliseconds.  Returns false on timeout.
+	bool timedWait(unsigned int timeout_ms);
+
+private:
+	OSemaphore(const OSemaphore&);
+	OSemaphore& operator=(const OSemaphore&);
+
+	#ifdef _WIN32
+	HANDLE mSemaphore;
+	#else
+	pthread_mutex_t mMutex;
+	pthread_cond_t mCond;
+	unsigned int mCount;
+	#endif
+};
+
+//
+// OThread
+//
+class OThread
+{
+public:
+	typedef void (*ThreadFunc)(void* data);
+
+	OThread();
+	~OThread();
+
+	bool start(ThreadFunc func, void* data);
+	void join();
+	bool isRunning() const { return mRunning; }
+
+private:
+	OThread(const OThread&);
+	OThread& operator=(const OThread&);
+
+	#ifdef _WIN32
+	static DWORD WINAPI entry(LPVOID arg);
+	HANDLE mThread;
+	#else
+	static void* entry(void* arg);
+	pthread_t mThread;
+	#endif
+
+	ThreadFunc mFunc;
+	void* mData;
+	bool mRunning;
+};
+
+//
+// OWorkerPool
+//
+// Runs a batch of independent jobs across a fixed number of threads and
+// waits for all of them to finish.  The calling thread takes part in the
+// work, so a pool with no extra threads simply runs every job in order.
+//
+class OWorkerPool
+{
+public:
+	// index is the job number, worker is the number of the thread that is
+	// running it, from 0 to size() inclusive.  Jobs running on the same
+	// worker never overlap, so worker can be used to pick scratch memory.
+	typedef void (*JobFunc)(size_t index, size_t worker, void* data);
+
+	OWorkerPool();
+	~OWorkerPool();
+
+	void resize(size_t num_threads);
+	size_t size() const { return mThreads.size(); }
+
+	void run(size_t count, JobFunc func, void* data);
+
+private:
+	OWorkerPool(const OWorkerPool&);
+	OWorkerPool& operator=(const OWorkerPool&);
+
+	struct WorkerArgs
+	{
+		OWorkerPool* pool;
+		size_t worker;
+	};
+
+	static void workerEntry(void* data);
+	void work(size_t worker);
+
+	std::vector<OThread*> mThreads;
+	std::vector<WorkerArgs> mArgs;
+
+	OMutex mMutex;
+	OSemaphore mStart;
+	OSemaphore mDone;
+
+	JobFunc mFunc;
+	void* mData;
+	size_t mCount;
+	size_t mNext;
+	bool mQuit;
+};
+
+//
+// OSPSCQueue
+//
+// Fixed-size, lock-free queue for passing items from exactly one producer
+// thread to exactly one consumer thread.  Slots are filled and emptied in
+// place so that items holding buffers can be handed over without copying.
+// N must be a power of two.
+//
+template <typename T, size_t N>
+class OSPSCQueue
+{
+public:
+	OSPSCQueue() : mHead(0), mTail(0) { }
+
+	// Producer: returns the next free slot, or NULL if the queue is full.
+	T* back()
+	{
+		size_t tail = mTail;
+		if (tail - I_AtomicLoad(&mHead) >= N)
+			return NULL;
+		return &mSlots[tail & (N - 1)];
+	}
+
+	// Producer: makes the slot returned by back() available.
+	void push()
+	{
+		I_AtomicStore(&mTail, mTail + 1);
+	}
+
+	// Consumer: returns the oldest filled slot, or NULL if the queue is
+	// empty.
+	T* front()
+	{
+		size_t head = mHead;
+		if (I_AtomicLoad(&mTail) == head)
+			return NULL;
+		return &mSlots[head & (N - 1)];
+	}
+
+	// Consumer: releases the slot returned by front().
+	void pop()
+	{
+		I_AtomicStore(&mHead, mHead + 1);
+	}
+
+	// Either thread: the number of filled slots.  It may already be out of
+	// date by the time it is returned.
+	size_t size() const
+	{
+		return I_AtomicLoad(&mTail) - I_AtomicLoad(&mHead);
+	}
+
+	// Gives direct access to every slot, for setting them up before any
+	// thread starts using the queue.
+	T& slot(size_t index) { return mSlots[index]; }
+	static size_t capacity() { return N; }
+
+private:
+	T mSlots[N];
+	volatile size_t mHead;
+	volatile size_t mTail;
+};
+
+#endif	// __I_THREAD_H__
@@ -22,6 +22,9 @@
 //	the intial memory pool is exhausted, additional pools are allocated. These
 //	are consolodated into one large pool the next time clear() is called.
 //
+//	FixedPool hands out slots of a single size and allows them to be freed
+//	individually.
+//
 //    
 //-----------------------------------------------------------------------------
 
@@ -31,6 +34,7 @@
 
 #include "doomtype.h"
 #include <cstring>
+#include <vector>
 
 template <typename T>
 class Pool
@@ -122,4 +126,103 @@ private:
 	byte*		free_block;
 };
 
+//
+// FixedPool
+//
+// Allocates slots of a fixed size from slabs on the system heap.  Freed slots
+// are kept on a list and reused before any new slot is taken.  Slots are
+// padded to a whole number of cache lines and slabs are aligned to a cache
+// line, so objects never share one and objects allocated one after another
+// sit next to each other in memory.  clear() makes every slot available
+// again but keeps the slabs for reuse.
+//
+class FixedPool
+{
+public:
+	static const size_t CACHE_LINE = 64;
+
+	FixedPool(size_t size, size_t count) :
+		slot_size((size + CACHE_LINE - 1) & ~(CACHE_LINE - 1)),
+		slab_count(count), cur_slab(0), cur_slot(0), free_list(NULL),
+		num_used(0)
+	{
+	}
+
+	~FixedPool()
+	{
+		for (size_t i = 0; i < raw_slabs.size(); i++)
+			delete [] raw_slabs[i];
+	}
+
+	size_t size() const { return slot_size; }
+	size_t used() const { return num_used; }
+	size_t capacity() const { return slabs.size() * slab_count; }
+
+	void* alloc()
+	{
+		num_used++;
+
+		if (free_list != NULL)
+		{
+			FreeSlot* slot = free_list;
+			free_list = slot->next;
+			return slot;
+		}
+
+		if (cur_slot == slab_count)
+		{
+			cur_slab++;
+			cur_slot = 0;
+		}
+
+		if (cur_slab == slabs.size())
+			add_slab();
+
+		return slabs[cur_slab] + slot_size * cur_slot++;
+	}
+
+	void free(void* ptr)
+	{
+		if (ptr == NULL)
+			return;
+
+		FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+		slot->next = free_list;
+		free_list = slot;
+		num_used--;
+	}
+
+	void clear()
+	{
+		cur_slab = 0;
+		cur_slot = 0;
+		free_list = NULL;
+		num_used = 0;
+	}
+
+private:
+	struct FreeSlot
+	{
+		FreeSlot* next;
+	};
+
+	void add_slab()
+	{
+		byte* raw = new byte[slot_size * slab_count + CACHE_LINE - 1];
+		size_t misalign = reinterpret_cast<size_t>(raw) & (CACHE_LINE - 1);
+
+		raw_slabs.push_back(raw);
+		slabs.push_back(misalign ? raw + CACHE_LINE - misalign : raw);
+	}
+
+	size_t				slot_size;
+	size_t				slab_count;
+	std::vector<byte*>	slabs;
+	std::vector<byte*>	raw_slabs;
+	size_t				cur_slab;
+	size_t				cur_slot;
+	FreeSlot*			free_list;
+	size_t				num_used;
+};
+
 #endif // __M_MEMPOOL__
@@ -80,6 +80,7 @@ void WeaponPickupMessage(AActor *toucher, weapontype_t &Weapon);
 
 #ifdef SERVER_APP
 void SV_ShareKeys(card_t card, player_t& player);
+void SV_QryInvalidate();
 #endif
 
 //
@@ -92,6 +93,10 @@ void P_GiveFrags(player_t* player, int num)
 	if (!warmup.checkscorechange())
 		return;
 	player->fragcount += num;
+
+#ifdef SERVER_APP
+	SV_QryInvalidate();
+#endif
 }
 
 // Give coop kills to a player
@@ -100,6 +105,10 @@ void P_GiveKills(player_t* player, int num)
 	if (!warmup.checkscorechange())
 		return;
 	player->killcount += num;
+
+#ifdef SERVER_APP
+	SV_QryInvalidate();
+#endif
 }
 
 // Give coop kills to a player
@@ -108,6 +117,10 @@ void P_GiveDeaths(player_t* player, int num)
 	if (!warmup.checkscorechange())
 		return;
 	player->deathcount += num;
+
+#ifdef SERVER_APP
+	SV_QryInvalidate();
+#endif
 }
 
 // Give a specific number of points to a player's team
@@ -116,6 +129,10 @@ void P_GiveTeamPoints(player_t* player, int num)
 	if (!warmup.checkscorechange())
 		return;
 	TEAMpoints[player->userinfo.team] += num;
+
+#ifdef SERVER_APP
+	SV_QryInvalidate();
+#endif
 }
 
 //
@@ -30,6 +30,7 @@
 #endif
 
 #include <set>
+#include <vector>
 
 #define FLOATSPEED		(FRACUNIT*4)
 
@@ -271,6 +272,54 @@ v3fixed_t P_LinePlaneIntersection(const plane_t *plane, const v3fixed_t &lineorg
 
 
 bool P_CheckSightEdges(const AActor* t1, const AActor* t2, float radius_boost);
+void P_ClearSightCache();
+void P_ClearSightCacheBox(const int bbox[4]);
+
+//
+// P_SIGHT
+//
+
+// State of a vanilla line of sight check.  Every thread that checks sight
+// needs its own context.
+struct sightcontext_t
+{
+	divline_t	strace;			// from t1 to t2
+	fixed_t		t2x;
+	fixed_t		t2y;
+
+	fixed_t		sightzstart;	// eye z of looker
+	fixed_t		topslope;
+	fixed_t		bottomslope;	// slopes to top and bottom of target
+
+	// lines already crossed by the current check
+	int					validcount;
+	std::vector<int>	linevalid;
+
+	int			*counts;		// rejected and checked, as sightcounts
+	int			localcounts[2];
+
+	sightcontext_t() : validcount(0), counts(localcounts)
+	{
+		localcounts[0] = localcounts[1] = 0;
+	}
+
+	explicit sightcontext_t(int *c) : validcount(0), counts(c)
+	{
+		localcounts[0] = localcounts[1] = 0;
+	}
+};
+
+// One query for P_CheckSightEdgesBatch.
+struct sightrequest_t
+{
+	const AActor	*t1;
+	const AActor	*t2;
+	float			radius_boost;
+	bool			visible;		// result
+};
+
+void P_CheckSightEdgesBatch(sightrequest_t *requests, size_t count);
+void P_SetSightThreads(size_t count);
 
 bool	P_ChangeSector (sector_t* sector, bool crunch);
 
@@ -288,6 +337,7 @@ extern	fixed_t CameraX, CameraY, CameraZ;
 void	P_RadiusAttack (AActor *spot, AActor *source, int damage, int distance, bool hurtSelf, int mod);
 
 void	P_DelSeclist(msecnode_t *);							// phares 3/16/98
+void	P_ClearSecnodes();
 void	P_CreateSecNodeList(AActor*,fixed_t,fixed_t);		// phares 3/14/98
 int		P_GetMoveFactor(const AActor *mo, int *frictionp);	// phares  3/6/98
 int		P_GetFriction(const AActor *mo, int *frictionfactor);
@@ -297,7 +347,7 @@ BOOL	Check_Sides(AActor *, int, int);					// phares
 //
 // P_SETUP
 //
-extern byte*			rejectmatrix;	// for fast sight rejection
+extern const byte*		rejectmatrix;	// for fast sight rejection
 extern BOOL				rejectempty;
 extern int*				blockmaplump;	// offsets in blockmap are from here
 extern int*				blockmap;
@@ -42,6 +42,7 @@
 #include "z_zone.h"
 #include "p_unlag.h"
 #include "m_vectors.h"
+#include "m_mempool.h"
 #include <math.h>
 #include <set>
 
@@ -3070,36 +3071,34 @@ bool P_ChangeSector (sector_t *sector, bool crunch)
 
 // phares 3/21/98
 //
-// Maintain a freelist of msecnode_t's to reduce memory allocs and frees.
+// Maintain a pool of msecnode_t's to reduce memory allocs and frees.
 
-msecnode_t *headsecnode = NULL;
+static FixedPool secnode_pool(sizeof(msecnode_t), 256);
 
-// P_GetSecnode() retrieves a node from the freelist. The calling routine
+// P_GetSecnode() retrieves a node from the pool. The calling routine
 // should make sure it sets all fields properly.
 
 msecnode_t *P_GetSecnode()
 {
-	msecnode_t *node;
-
-	if (headsecnode)
-	{
-		node = headsecnode;
-		headsecnode = headsecnode->m_snext;
-	}
-	else
-		node = (msecnode_t *)Z_Malloc (sizeof(*node), PU_LEVEL, NULL);
-	return node;
+	return static_cast<msecnode_t *>(secnode_pool.alloc());
 }
 
-// P_PutSecnode() returns a node to the freelist.
+// P_PutSecnode() returns a node to the pool.
 
 void P_PutSecnode (msecnode_t *node)
 {
-	if (!node)
-		return;
+	secnode_pool.free(node);
+}
 
-	node->m_snext = headsecnode;
-	headsecnode = node;
+//
+// P_ClearSecnodes
+//
+// Forgets every node in the pool, including those still attached to
+// actors.  Called when the level's memory is freed.
+//
+void P_ClearSecnodes ()
+{
+	secnode_pool.clear();
 }
 
 // phares 3/16/98
@@ -3554,6 +3553,9 @@ void P_ChangeCeilingHeight(sector_t *sector, fixed_t amount)
 	plane_t *plane = &sector->ceilingplane;
 	plane->d -= FixedMul(amount, plane->c);
 
+	// cached sight checks may pass through this sector
+	P_ClearSightCacheBox(sector->blockbox);
+
 	// The sector's ceilingheight variable is still used for (among other things)
 	// calculating wall texture offsets
 	sector->ceilingheight += amount;
@@ -3567,6 +3569,9 @@ void P_ChangeFloorHeight(sector_t *sector, fixed_t amount)
 	plane_t *plane = &sector->floorplane;
 	plane->d -= FixedMul(amount, plane->c);
 
+	// cached sight checks may pass through this sector
+	P_ClearSightCacheBox(sector->blockbox);
+
 	// The sector's floorheight variable is still used for (among other things)
 	// calculating wall texture offsets
 	sector->floorheight += amount;
@@ -38,6 +38,7 @@
 #include "p_mobj.h"
 #include "p_ctf.h"
 #include "gi.h"
+#include "m_mempool.h"
 
 #define WATER_SINK_FACTOR		3
 #define WATER_SINK_SMALL_FACTOR	4
@@ -83,6 +84,37 @@ netid_map_t actor_by_netid;
 
 IMPLEMENT_SERIAL(AActor, DThinker)
 
+// Actors are spawned and removed constantly, so they are kept in their own
+// pool instead of going through the zone.
+static FixedPool actor_pool(sizeof(AActor), 64);
+
+void *AActor::operator new (size_t size)
+{
+	if (size != sizeof(AActor))
+		return DThinker::operator new (size);
+
+	return actor_pool.alloc();
+}
+
+void AActor::operator delete (void *block, size_t size)
+{
+	if (size != sizeof(AActor))
+		DThinker::operator delete (block);
+	else
+		actor_pool.free(block);
+}
+
+//
+// AActor::ClearPool
+//
+// Forgets every actor in the pool.  Must only be called once all actors
+// have been destroyed, when the level's memory is freed.
+//
+void AActor::ClearPool ()
+{
+	actor_pool.clear();
+}
+
 AActor::~AActor ()
 {
     // Please avoid calling the destructor directly (or through delete)!
@@ -2680,32 +2712,4 @@ void P_SpawnMapThing (mapthing2_t *mthing, int position)
 		P_DeactivateMobj (mobj);
 }
 
-
-//
-// P_VisibleToPlayers
-//
-// Returns true if mo is currently in any player's field of view
-//
-
-bool P_VisibleToPlayers(AActor *mo)
-{
-	if (!mo)
-		return false;
-
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		// players aren't considered visible to themselves
-		if (mo->player && mo->player->id == it->id)
-			continue;
-
-		if (!(it->mo) || it->spectator)
-			continue;
-
-		if (P_CheckSightEdges(it->mo, mo, 5.0))
-			return true;
-	}
-
-	return false;
-}
-
 VERSION_CONTROL (p_mobj_cpp, "$Id$")
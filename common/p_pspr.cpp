@@ -653,7 +653,7 @@ void A_Punch(AActor* mo)
 
 	// [SL] 2011-07-12 - Move players and sectors back to their positions when
 	// this player hit the fire button clientside.
-	Unlag::getInstance().reconcile(player->id);
+	Unlag::getInstance().reconcile(player->id, MELEERANGE);
 
 	slope = P_AimLineAttack (player->mo, angle, MELEERANGE);
 	P_LineAttack (player->mo, angle, MELEERANGE, slope, damage);
@@ -687,7 +687,7 @@ void A_Saw(AActor* mo)
 
 	// [SL] 2011-07-12 - Move players and sectors back to their positions when
 	// this player hit the fire button clientside.
-	Unlag::getInstance().reconcile(player->id);
+	Unlag::getInstance().reconcile(player->id, MELEERANGE+1);
 
 	// use meleerange + 1 so the puff doesn't skip the flash
 	P_LineAttack (player->mo, angle, MELEERANGE+1,
@@ -806,7 +806,8 @@ void A_FireRailgun(AActor* mo)
 
 	// [SL] 2012-04-18 - Move players and sectors back to their positions when
 	// this player hit the fire button clientside.
-	Unlag::getInstance().reconcile(player->id);
+	Unlag::getInstance().reconcile(player->id,
+								   (8192 + abs(RailOffset)) * FRACUNIT);
 
 	P_RailAttack (player->mo, damage, RailOffset);
 
@@ -908,7 +909,7 @@ void P_FireHitscan (player_t *player, size_t quantity, spreadtype_t spread)
 	// NOTE: Important to reconcile sectors and players BEFORE calculating
 	// bulletslope!
 	if (serverside)
-		Unlag::getInstance().reconcile(player->id);
+		Unlag::getInstance().reconcile(player->id, MISSILERANGE);
 
 	fixed_t bulletslope = P_BulletSlope(player->mo);
 
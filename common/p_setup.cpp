@@ -119,7 +119,7 @@ AActor**		blocklinks;		// for thing chains
 // Without special effect, this could be
 //	used as a PVS lookup as well.
 //
-byte*			rejectmatrix;
+const byte*		rejectmatrix;
 BOOL			rejectempty;
 
 
@@ -146,7 +146,7 @@ mapthing2_t		*redteam_p;
 //
 void P_LoadVertexes (int lump)
 {
-	byte *data;
+	const byte *data;
 	int i;
 
 	// Determine number of vertices:
@@ -157,18 +157,18 @@ void P_LoadVertexes (int lump)
 	vertexes = (vertex_t *)Z_Malloc (numvertexes*sizeof(vertex_t), PU_LEVEL, 0);
 
 	// Load data into cache.
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	// Copy and convert vertex coordinates,
 	// internal representation as fixed.
 	for (i = 0; i < numvertexes; i++)
 	{
-		vertexes[i].x = LESHORT(((mapvertex_t *)data)[i].x)<<FRACBITS;
-		vertexes[i].y = LESHORT(((mapvertex_t *)data)[i].y)<<FRACBITS;
+		vertexes[i].x = LESHORT(((const mapvertex_t *)data)[i].x)<<FRACBITS;
+		vertexes[i].y = LESHORT(((const mapvertex_t *)data)[i].y)<<FRACBITS;
 	}
 
 	// Free buffer memory.
-	Z_Free (data);
+	W_ReleaseLumpNum (lump);
 }
 
 
@@ -181,17 +181,17 @@ void P_LoadVertexes (int lump)
 void P_LoadSegs (int lump)
 {
 	int  i;
-	byte *data;
+	const byte *data;
 
 	numsegs = W_LumpLength (lump) / sizeof(mapseg_t);
 	segs = (seg_t *)Z_Malloc (numsegs*sizeof(seg_t), PU_LEVEL, 0);
 	memset (segs, 0, numsegs*sizeof(seg_t));
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	for (i = 0; i < numsegs; i++)
 	{
 		seg_t *li = segs+i;
-		mapseg_t *ml = (mapseg_t *) data + i;
+		const mapseg_t *ml = (const mapseg_t *) data + i;
 
 		int side, linedef;
 		line_t *ldef;
@@ -253,7 +253,7 @@ void P_LoadSegs (int lump)
 		li->length = FLOAT2FIXED(sqrt(dx * dx + dy* dy));
 	}
 
-	Z_Free (data);
+	W_ReleaseLumpNum (lump);
 }
 
 
@@ -262,22 +262,22 @@ void P_LoadSegs (int lump)
 //
 void P_LoadSubsectors (int lump)
 {
-	byte *data;
+	const byte *data;
 	int i;
 
 	numsubsectors = W_LumpLength (lump) / sizeof(mapsubsector_t);
 	subsectors = (subsector_t *)Z_Malloc (numsubsectors*sizeof(subsector_t),PU_LEVEL,0);
-	data = (byte *)W_CacheLumpNum (lump,PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	memset (subsectors, 0, numsubsectors*sizeof(subsector_t));
 
 	for (i = 0; i < numsubsectors; i++)
 	{
-		subsectors[i].numlines = (unsigned short)LESHORT(((mapsubsector_t *)data)[i].numsegs);
-		subsectors[i].firstline = (unsigned short)LESHORT(((mapsubsector_t *)data)[i].firstseg);
+		subsectors[i].numlines = (unsigned short)LESHORT(((const mapsubsector_t *)data)[i].numsegs);
+		subsectors[i].firstline = (unsigned short)LESHORT(((const mapsubsector_t *)data)[i].firstseg);
 	}
 
-	Z_Free (data);
+	W_ReleaseLumpNum (lump);
 }
 
 
@@ -287,9 +287,9 @@ void P_LoadSubsectors (int lump)
 //
 void P_LoadSectors (int lump)
 {
-	byte*				data;
+	const byte*			data;
 	int 				i;
-	mapsector_t*		ms;
+	const mapsector_t*	ms;
 	sector_t*			ss;
 	int					defSeqType;
 
@@ -302,14 +302,14 @@ void P_LoadSectors (int lump)
 	sectors = new sector_t[numsectors];
 	memset(sectors, 0, sizeof(sector_t)*numsectors);
 
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
 	if (level.flags & LEVEL_SNDSEQTOTALCTRL)
 		defSeqType = 0;
 	else
 		defSeqType = -1;
 
-	ms = (mapsector_t *)data;
+	ms = (const mapsector_t *)data;
 	ss = sectors;
 	for (i = 0; i < numsectors; i++, ss++, ms++)
 	{
@@ -380,7 +380,7 @@ void P_LoadSectors (int lump)
 		ss->movefactor = ORIG_FRICTION_FACTOR;
 	}
 
-	Z_Free (data);
+	W_ReleaseLumpNum (lump);
 }
 
 
@@ -389,18 +389,18 @@ void P_LoadSectors (int lump)
 //
 void P_LoadNodes (int lump)
 {
-	byte*		data;
+	const byte*	data;
 	int 		i;
 	int 		j;
 	int 		k;
-	mapnode_t*	mn;
+	const mapnode_t*	mn;
 	node_t* 	no;
 
 	numnodes = W_LumpLength (lump) / sizeof(mapnode_t);
 	nodes = (node_t *)Z_Malloc (numnodes*sizeof(node_t), PU_LEVEL, 0);
-	data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
+	data = (const byte *)W_MapLumpNum (lump);
 
-	mn = (mapnode_t *)data;
+	mn = (const mapnode_t *)data;
 	no = nodes;
 
 	for (i = 0; i < numnodes; i++, no++, mn++)
@@ -426,7 +426,7 @@ void P_LoadNodes (int lump)
 		}
 	}
 
-	Z_Free (data);
+	W_ReleaseLumpNum (lump);
 }
 
 //
@@ -571,9 +571,9 @@ bool P_LoadXNOD(int lump)
 void P_LoadThings (int lump)
 {
 	mapthing2_t mt2;		// [RH] for translation
-	byte *data = (byte *)W_CacheLumpNum (lump, PU_STATIC);
-	mapthing_t *mt = (mapthing_t *)data;
-	mapthing_t *lastmt = (mapthing_t *)(data + W_LumpLength (lump));
+	const byte *data = (const byte *)W_MapLumpNum (lump);
+	const mapthing_t *mt = (const mapthing_t *)data;
+	const mapthing_t *lastmt = (const mapthing_t *)(data + W_LumpLength (lump));
 
 	playerstarts.clear();
 	voodoostarts.clear();
@@ -609,7 +609,7 @@ void P_LoadThings (int lump)
 		P_SpawnMapThing (&mt2, 0);
 	}
 
-	Z_Free (data);
+	W_ReleaseLumpNum (lump);
 }
 
 // [RH]
@@ -1718,6 +1718,11 @@ void P_SetupLevel (char *lumpname, int position)
 	Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
 	NormalLight.next = NULL;	// [RH] Z_FreeTags frees all the custom colormaps
 
+	// Pooled objects belong to the level just like zone memory does.
+	AActor::ClearPool ();
+	DSectorEffect::ClearPools ();
+	P_ClearSecnodes ();
+
 	// UNUSED W_Profile ();
 
 	// find map num
@@ -1762,7 +1767,11 @@ void P_SetupLevel (char *lumpname, int position)
 		P_LoadSegs (lumpnum+ML_SEGS);
 	}
 
-	rejectmatrix = (byte *)W_CacheLumpNum (lumpnum+ML_REJECT, PU_LEVEL);
+	// The reject table is only ever read, so use it in place if the WAD is
+	// mapped into memory.  Otherwise it is cached for the level's lifetime.
+	rejectmatrix = (const byte *)W_MapLumpNum (lumpnum+ML_REJECT);
+	if (rejectmatrix == lumpcache[lumpnum+ML_REJECT])
+		Z_ChangeTag (lumpcache[lumpnum+ML_REJECT], PU_LEVEL);
 	{
 		// [SL] 2011-07-01 - Check to see if the reject table is of the proper size
 		// If it's too short, the reject table should be ignored when
@@ -1781,6 +1790,9 @@ void P_SetupLevel (char *lumpname, int position)
 
 	P_SetupSlopes();
 
+	// forget sight checks made against the previous level's geometry
+	P_ClearSightCache();
+
     po_NumPolyobjs = 0;
 
 	P_AllocStarts();
@@ -26,8 +26,13 @@
 
 #include "doomdef.h"
 
+#include <algorithm>
+
 #include "i_system.h"
+#include "i_thread.h"
+#include "c_dispatch.h"
 #include "p_local.h"
+#include "m_bbox.h"
 #include "m_random.h"
 #include "m_vectors.h"
 
@@ -41,12 +46,12 @@ fixed_t		sightzstart;		// eye z of looker
 fixed_t		topslope;
 fixed_t		bottomslope;		// slopes to top and bottom of target
 
-divline_t	strace;			// from t1 to t2
-fixed_t		t2x;
-fixed_t		t2y;
-
 int		sightcounts[2];
 int		sightcounts2[3];
+int		sightcachecounts[2];	// hits, misses
+
+// used by the vanilla sight checks made from the main thread
+static sightcontext_t sightmain(sightcounts);
 
 extern bool HasBehavior;
 EXTERN_CVAR (co_zdoomphys)
@@ -520,6 +525,128 @@ bool P_CheckSightEdgesZDoom(const AActor *t1, const AActor *t2, float radius_boo
 		|| P_SightPathTraverse(t1->x, t1->y, t2->x - FLOAT2FIXED(w.x), t2->y - FLOAT2FIXED(w.y));
 }
 
+/////////////////////////////////////////////////////////////////////////////
+//  Sight Cache
+//
+//  Monsters frequently check sight against the same target several times
+//  within a tic.  The result of each check is kept along with everything
+//  that it depends on: the subsectors, positions and sizes of both actors.
+//  The cache is emptied at the start of every tic.  When a floor, ceiling
+//  or polyobject moves, only the checks whose sight lines pass through the
+//  blockmap cells it covers are thrown away, so a cached result is always
+//  the same one that a full check would return.
+/////////////////////////////////////////////////////////////////////////////
+
+enum sightquery_t
+{
+	SIGHT_DOOM,
+	SIGHT_ZDOOM,
+	SIGHT_EDGES_DOOM,
+	SIGHT_EDGES_ZDOOM
+};
+
+struct sightcacheentry_t
+{
+	unsigned int	stamp;
+	int				query;
+	const subsector_t	*ss1, *ss2;
+	fixed_t			x1, y1, z1, h1;
+	fixed_t			x2, y2, z2, h2, r2;
+	float			boost;
+	bool			result;
+	int				bbox[4];	// blockmap cells the sight lines pass through
+};
+
+static const size_t SIGHT_CACHE_SIZE = 1024;	// must be a power of two
+static sightcacheentry_t sightcache[SIGHT_CACHE_SIZE];
+static unsigned int sightcachestamp = 1;
+
+//
+// P_ClearSightCache
+//
+// Invalidates all of the cached sight checks.
+//
+void P_ClearSightCache()
+{
+	if (++sightcachestamp == 0)
+	{
+		// the stamp wrapped around, so old entries could appear valid
+		memset(sightcache, 0, sizeof(sightcache));
+		sightcachestamp = 1;
+	}
+}
+
+//
+// P_ClearSightCacheBox
+//
+// Invalidates the cached sight checks whose sight lines may pass through
+// any of the blockmap cells in bbox, such as those of a sector whose floor
+// or ceiling has moved.  Everything else stays cached.
+//
+void P_ClearSightCacheBox(const int bbox[4])
+{
+	for (size_t i = 0; i < SIGHT_CACHE_SIZE; i++)
+	{
+		sightcacheentry_t &entry = sightcache[i];
+
+		if (entry.stamp != sightcachestamp)
+			continue;
+
+		if (entry.bbox[BOXLEFT] > bbox[BOXRIGHT] || entry.bbox[BOXRIGHT] < bbox[BOXLEFT] ||
+			entry.bbox[BOXBOTTOM] > bbox[BOXTOP] || entry.bbox[BOXTOP] < bbox[BOXBOTTOM])
+			continue;
+
+		entry.stamp = 0;
+	}
+}
+
+static void P_MakeSightKey(sightcacheentry_t &key, sightquery_t query,
+						   const AActor *t1, const AActor *t2, float boost)
+{
+	key.stamp = 0;
+	key.query = query;
+	key.ss1 = t1->subsector;
+	key.ss2 = t2->subsector;
+	key.x1 = t1->x;
+	key.y1 = t1->y;
+	key.z1 = t1->z;
+	key.h1 = t1->height;
+	key.x2 = t2->x;
+	key.y2 = t2->y;
+	key.z2 = t2->z;
+	key.h2 = t2->height;
+	key.r2 = (query >= SIGHT_EDGES_DOOM) ? t2->radius : 0;
+	key.boost = boost;
+	key.result = false;
+
+	// the edge checks aim at points up to r2 + boost away from t2
+	fixed_t reach = key.r2 + FLOAT2FIXED(boost) + 1;
+	key.bbox[BOXLEFT] = (MIN(key.x1, key.x2 - reach) - bmaporgx) >> MAPBLOCKSHIFT;
+	key.bbox[BOXRIGHT] = (MAX(key.x1, key.x2 + reach) - bmaporgx) >> MAPBLOCKSHIFT;
+	key.bbox[BOXBOTTOM] = (MIN(key.y1, key.y2 - reach) - bmaporgy) >> MAPBLOCKSHIFT;
+	key.bbox[BOXTOP] = (MAX(key.y1, key.y2 + reach) - bmaporgy) >> MAPBLOCKSHIFT;
+}
+
+static bool P_SameSightKey(const sightcacheentry_t &a, const sightcacheentry_t &b)
+{
+	return	a.query == b.query && a.ss1 == b.ss1 && a.ss2 == b.ss2 &&
+			a.x1 == b.x1 && a.y1 == b.y1 && a.z1 == b.z1 && a.h1 == b.h1 &&
+			a.x2 == b.x2 && a.y2 == b.y2 && a.z2 == b.z2 && a.h2 == b.h2 &&
+			a.r2 == b.r2 && a.boost == b.boost;
+}
+
+static sightcacheentry_t *P_FindSightCacheEntry(const sightcacheentry_t &key)
+{
+	unsigned int hash = (key.ss1 - subsectors) * 0x9E3779B1u;
+	hash ^= (key.ss2 - subsectors) * 0x85EBCA6Bu;
+	hash ^= (key.x1 ^ key.y2) >> FRACBITS;
+	hash ^= ((key.y1 ^ key.x2) >> FRACBITS) << 7;
+	hash ^= key.query << 13;
+	hash ^= hash >> 16;
+
+	return &sightcache[hash & (SIGHT_CACHE_SIZE - 1)];
+}
+
 /////////////////////////////////////////////////////////////////////////////
 //  Vanilla Sight Checking
 /////////////////////////////////////////////////////////////////////////////
@@ -607,9 +734,9 @@ P_InterceptVector2
 //
 // P_CrossSubsector
 // Returns true
-//  if strace crosses the given subsector successfully.
+//  if the trace in ctx crosses the given subsector successfully.
 //
-bool P_CrossSubsector (int num)
+static bool P_CrossSubsector (sightcontext_t &ctx, int num)
 {
     seg_t*		seg;
     line_t*		line;
@@ -645,15 +772,15 @@ bool P_CrossSubsector (int num)
 		line = seg->linedef;
 		
 		// allready checked other side?
-		if (line->validcount == validcount)
+		if (ctx.linevalid[line - lines] == ctx.validcount)
 			continue;
 		
-		line->validcount = validcount;
+		ctx.linevalid[line - lines] = ctx.validcount;
 		
 		v1 = line->v1;
 		v2 = line->v2;
-		s1 = P_DivlineSide (v1->x,v1->y, &strace);
-		s2 = P_DivlineSide (v2->x, v2->y, &strace);
+		s1 = P_DivlineSide (v1->x,v1->y, &ctx.strace);
+		s2 = P_DivlineSide (v2->x, v2->y, &ctx.strace);
 		
 		// line isn't crossed?
 		if (s1 == s2)
@@ -663,8 +790,8 @@ bool P_CrossSubsector (int num)
 		divl.y = v1->y;
 		divl.dx = v2->x - v1->x;
 		divl.dy = v2->y - v1->y;
-		s1 = P_DivlineSide (strace.x, strace.y, &divl);
-		s2 = P_DivlineSide (t2x, t2y, &divl);
+		s1 = P_DivlineSide (ctx.strace.x, ctx.strace.y, &divl);
+		s2 = P_DivlineSide (ctx.t2x, ctx.t2y, &divl);
 		
 		// line isn't crossed?
 		if (s1 == s2)
@@ -679,7 +806,7 @@ bool P_CrossSubsector (int num)
 		front = seg->frontsector;
 		back = seg->backsector;
 
-		frac = P_InterceptVector2 (&strace, &divl);
+		frac = P_InterceptVector2 (&ctx.strace, &divl);
 		
 		// no wall to block sight with?
 		fixed_t crossx = divl.x + FixedMul(frac, divl.dx);
@@ -712,19 +839,19 @@ bool P_CrossSubsector (int num)
 		
 		if (ff != bf)
 		{
-			slope = FixedDiv (openbottom - sightzstart , frac);
-			if (slope > bottomslope)
-				bottomslope = slope;
+			slope = FixedDiv (openbottom - ctx.sightzstart , frac);
+			if (slope > ctx.bottomslope)
+				ctx.bottomslope = slope;
 		}
 		
 		if (fc != bc)
 		{
-			slope = FixedDiv (opentop - sightzstart , frac);
-			if (slope < topslope)
-				topslope = slope;
+			slope = FixedDiv (opentop - ctx.sightzstart , frac);
+			if (slope < ctx.topslope)
+				ctx.topslope = slope;
 		}
 		
-		if (topslope <= bottomslope)
+		if (ctx.topslope <= ctx.bottomslope)
 			return false;		// stop				
     }
     // passed the subsector ok
@@ -736,9 +863,9 @@ bool P_CrossSubsector (int num)
 //
 // P_CrossBSPNode
 // Returns true
-//  if strace crosses the given node successfully.
+//  if the trace in ctx crosses the given node successfully.
 //
-bool P_CrossBSPNode (int bspnum)
+static bool P_CrossBSPNode (sightcontext_t &ctx, int bspnum)
 {
     node_t*	bsp;
     int		side;
@@ -746,56 +873,80 @@ bool P_CrossBSPNode (int bspnum)
     if (bspnum & NF_SUBSECTOR)
     {
 		if (bspnum == -1)
-			return P_CrossSubsector (0);
+			return P_CrossSubsector (ctx, 0);
 		else
-			return P_CrossSubsector (bspnum&(~NF_SUBSECTOR));
+			return P_CrossSubsector (ctx, bspnum&(~NF_SUBSECTOR));
     }
 	
     bsp = &nodes[bspnum];
     
     // decide which side the start point is on
-    side = P_DivlineSide (strace.x, strace.y, (divline_t *)bsp);
+    side = P_DivlineSide (ctx.strace.x, ctx.strace.y, (divline_t *)bsp);
     if (side == 2)
 		side = 0;	// an "on" should cross both sides
 	
     // cross the starting side
-    if (!P_CrossBSPNode (bsp->children[side]) )
+    if (!P_CrossBSPNode (ctx, bsp->children[side]) )
 		return false;
 	
     // the partition plane is crossed here
-    if (side == P_DivlineSide (t2x, t2y,(divline_t *)bsp))
+    if (side == P_DivlineSide (ctx.t2x, ctx.t2y,(divline_t *)bsp))
     {
 		// the line doesn't touch the other side
 		return true;
     }
     
     // cross the ending side		
-    return P_CrossBSPNode (bsp->children[side^1]);
+    return P_CrossBSPNode (ctx, bsp->children[side^1]);
 }
 
 
 //
-// P_CheckSight
+// P_BeginSightCheck
+//
+// Prepares a context for a new sight check.  Each context keeps its own
+// record of the lines it has checked rather than using line_t::validcount
+// so that several checks can run at the same time.
+//
+static void P_BeginSightCheck(sightcontext_t &ctx)
+{
+	if (ctx.linevalid.size() != (size_t)numlines)
+	{
+		ctx.linevalid.assign(numlines, 0);
+		ctx.validcount = 0;
+	}
+
+	if (++ctx.validcount == 0)
+	{
+		std::fill(ctx.linevalid.begin(), ctx.linevalid.end(), 0);
+		ctx.validcount = 1;
+	}
+}
+
+//
+// P_CheckSightDoom
 // Returns true
-//  if a straight line between t1 and t2 is unobstructed.
+//  if a straight line from the eyes of the looker at x1, y1 in sector s1 to
+//  any part of the target at x2, y2 in sector s2 is unobstructed.
 // Uses REJECT.
 //
-bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
+static bool P_CheckSightDoom
+( sightcontext_t &ctx,
+  const sector_t *sec1, const sector_t *sec2,
+  fixed_t x1, fixed_t y1, fixed_t z1, fixed_t h1,
+  fixed_t x2, fixed_t y2, fixed_t z2, fixed_t h2 )
 {
     int		s1;
     int		s2;
     int		pnum;
     int		bytenum;
     int		bitnum;
-
-	if(!t1 || !t2 || !t1->subsector || !t2->subsector)
-		return false;
     
     // First check for trivial rejection.
 	
     // Determine subsector entries in REJECT table.
-    s1 = (t1->subsector->sector - sectors);
-    s2 = (t2->subsector->sector - sectors);
+    s1 = (sec1 - sectors);
+    s2 = (sec2 - sectors);
     pnum = s1*numsectors + s2;
     bytenum = pnum>>3;
     bitnum = 1 << (pnum&7);
@@ -803,7 +954,7 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
     // Check in REJECT table.
     if (!rejectempty && rejectmatrix[bytenum]&bitnum)
     {
-		sightcounts[0]++;
+		ctx.counts[0]++;
 		
 		// can't possibly be connected
 		return false;	
@@ -811,23 +962,34 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
 	
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
+    ctx.counts[1]++;
 	
-    validcount++;
+    P_BeginSightCheck(ctx);
 	
-    sightzstart = t1->z + t1->height - (t1->height>>2);
-    topslope = (t2->z+t2->height) - sightzstart;
-    bottomslope = (t2->z) - sightzstart;
+    ctx.sightzstart = z1 + h1 - (h1>>2);
+    ctx.topslope = (z2+h2) - ctx.sightzstart;
+    ctx.bottomslope = (z2) - ctx.sightzstart;
 	
-    strace.x = t1->x;
-    strace.y = t1->y;
-    t2x = t2->x;
-    t2y = t2->y;
-    strace.dx = t2->x - t1->x;
-    strace.dy = t2->y - t1->y;
+    ctx.strace.x = x1;
+    ctx.strace.y = y1;
+    ctx.t2x = x2;
+    ctx.t2y = y2;
+    ctx.strace.dx = x2 - x1;
+    ctx.strace.dy = y2 - y1;
 	
     // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+    return P_CrossBSPNode (ctx, numnodes-1);	
+}
+
+static bool P_CheckSightDoom
+( sightcontext_t &ctx,
+  fixed_t x1, fixed_t y1, fixed_t z1, fixed_t h1,
+  fixed_t x2, fixed_t y2, fixed_t z2, fixed_t h2 )
+{
+	return P_CheckSightDoom(ctx,
+							P_PointInSubsector(x1, y1)->sector,
+							P_PointInSubsector(x2, y2)->sector,
+							x1, y1, z1, h1, x2, y2, z2, h2);
 }
 
 //
@@ -836,61 +998,44 @@ bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
 //  if a straight line between t1 and t2 is unobstructed.
 // Uses REJECT.
 //
-static bool P_CheckSightDoom
-( fixed_t x1, fixed_t y1, fixed_t z1, fixed_t h1,
-  fixed_t x2, fixed_t y2, fixed_t z2, fixed_t h2 )
+bool P_CheckSightDoom(const AActor* t1, const AActor* t2)
 {
-    int		s1;
-    int		s2;
-    int		pnum;
-    int		bytenum;
-    int		bitnum;
-    
-    // First check for trivial rejection.
-	
-    // Determine subsector entries in REJECT table.
-    s1 = (P_PointInSubsector(x1, y1)->sector - sectors);
-    s2 = (P_PointInSubsector(x2, y2)->sector - sectors);
-    pnum = s1*numsectors + s2;
-    bytenum = pnum>>3;
-    bitnum = 1 << (pnum&7);
-	
-    // Check in REJECT table.
-    if (!rejectempty && rejectmatrix[bytenum]&bitnum)
-    {
-		sightcounts[0]++;
-		
-		// can't possibly be connected
-		return false;	
-    }
-	
-    // An unobstructed LOS is possible.
-    // Now look from eyes of t1 to any part of t2.
-    sightcounts[1]++;
-	
-    validcount++;
-	
-    sightzstart = z1 + h1 - (h1>>2);
-    topslope = (z2+h2) - sightzstart;
-    bottomslope = (z2) - sightzstart;
-	
-    strace.x = x1;
-    strace.y = y1;
-    t2x = x2;
-    t2y = y2;
-    strace.dx = x2 - x1;
-    strace.dy = y2 - y1;
-	
-    // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);	
+	if(!t1 || !t2 || !t1->subsector || !t2->subsector)
+		return false;
+
+	return P_CheckSightDoom(sightmain,
+							t1->subsector->sector, t2->subsector->sector,
+							t1->x, t1->y, t1->z, t1->height,
+							t2->x, t2->y, t2->z, t2->height);
 }
 
 bool P_CheckSight(const AActor* t1, const AActor* t2)
 {
-	if (co_zdoomphys || HasBehavior)
-		return P_CheckSightZDoom(t1, t2);
+	bool zdoom = co_zdoomphys || HasBehavior;
+
+	if (!t1 || !t2 || !t1->subsector || !t2->subsector)
+		return false;
+
+	sightcacheentry_t key;
+	P_MakeSightKey(key, zdoom ? SIGHT_ZDOOM : SIGHT_DOOM, t1, t2, 0.0f);
+
+	sightcacheentry_t *entry = P_FindSightCacheEntry(key);
+	if (entry->stamp == sightcachestamp && P_SameSightKey(*entry, key))
+	{
+		sightcachecounts[0]++;
+		return entry->result;
+	}
+
+	sightcachecounts[1]++;
+
+	if (zdoom)
+		key.result = P_CheckSightZDoom(t1, t2);
 	else
-		return P_CheckSightDoom(t1, t2);
+		key.result = P_CheckSightDoom(t1, t2);
+
+	*entry = key;
+	entry->stamp = sightcachestamp;
+	return key.result;
 }
 
 //
@@ -899,8 +1044,9 @@ bool P_CheckSight(const AActor* t1, const AActor* t2)
 // any part of t2 is unobstructed.
 // Uses REJECT.
 //
-bool P_CheckSightEdgesDoom
-( const AActor*	t1,
+static bool P_CheckSightEdgesDoom
+( sightcontext_t &ctx,
+  const AActor*	t1,
   const AActor*	t2,
   float radius_boost )
 {
@@ -919,25 +1065,215 @@ bool P_CheckSightEdgesDoom
 
 	bool contact = false;
 
-	contact |= P_CheckSightDoom(t1->x, t1->y, t1->z, t1->height,
+	contact |= P_CheckSightDoom(ctx, t1->x, t1->y, t1->z, t1->height,
 							t2->x, t2->y, t2->z, t2->height);
 
-	contact |= P_CheckSightDoom(t1->x, t1->y, t1->z, t1->height,
+	contact |= P_CheckSightDoom(ctx, t1->x, t1->y, t1->z, t1->height,
 							t2->x - FLOAT2FIXED(w.x), t2->y - FLOAT2FIXED(w.y), t2->z, t2->height);
 
-	contact |= P_CheckSightDoom(t1->x, t1->y, t1->z, t1->height,
+	contact |= P_CheckSightDoom(ctx, t1->x, t1->y, t1->z, t1->height,
 							t2->x + FLOAT2FIXED(w.x), t2->y + FLOAT2FIXED(w.y), t2->z, t2->height);
 
 	return contact;
 }	
 
+bool P_CheckSightEdgesDoom
+( const AActor*	t1,
+  const AActor*	t2,
+  float radius_boost )
+{
+	return P_CheckSightEdgesDoom(sightmain, t1, t2, radius_boost);
+}
+
 bool P_CheckSightEdges(const AActor* t1, const AActor* t2, float radius_boost)
 {
-	if (co_zdoomphys || HasBehavior)
-		return P_CheckSightEdgesZDoom(t1, t2, radius_boost);
+	bool zdoom = co_zdoomphys || HasBehavior;
+
+	if (!t1->subsector || !t2->subsector)
+	{
+		if (zdoom)
+			return P_CheckSightEdgesZDoom(t1, t2, radius_boost);
+		else
+			return P_CheckSightEdgesDoom(t1, t2, radius_boost);
+	}
+
+	sightcacheentry_t key;
+	P_MakeSightKey(key, zdoom ? SIGHT_EDGES_ZDOOM : SIGHT_EDGES_DOOM,
+				   t1, t2, radius_boost);
+
+	sightcacheentry_t *entry = P_FindSightCacheEntry(key);
+	if (entry->stamp == sightcachestamp && P_SameSightKey(*entry, key))
+	{
+		sightcachecounts[0]++;
+		return entry->result;
+	}
+
+	sightcachecounts[1]++;
+
+	if (zdoom)
+		key.result = P_CheckSightEdgesZDoom(t1, t2, radius_boost);
 	else
-		return P_CheckSightEdgesDoom(t1, t2, radius_boost);
+		key.result = P_CheckSightEdgesDoom(t1, t2, radius_boost);
+
+	*entry = key;
+	entry->stamp = sightcachestamp;
+	return key.result;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//  Batched Sight Checking
+/////////////////////////////////////////////////////////////////////////////
+
+static OWorkerPool sight_pool;
+static std::vector<sightcontext_t*> sight_contexts;
+
+struct sightbatch_t
+{
+	sightrequest_t	*requests;
+	const size_t	*pending;		// requests that missed the sight cache
+	size_t			count;
+	size_t			chunk;			// requests handed to a worker at a time
+};
+
+//
+// P_SetSightThreads
+//
+// Sets the number of extra threads used by P_CheckSightEdgesBatch.
+//
+void P_SetSightThreads(size_t count)
+{
+	sight_pool.resize(count);
+}
+
+static bool P_ValidSightRequest(const sightrequest_t &req)
+{
+	return req.t1 && req.t2 && req.t1->subsector && req.t2->subsector;
+}
+
+static void P_SightBatchJob(size_t index, size_t worker, void *data)
+{
+	sightbatch_t *batch = static_cast<sightbatch_t*>(data);
+	sightcontext_t &ctx = (worker == 0) ? sightmain : *sight_contexts[worker - 1];
+
+	size_t first = index * batch->chunk;
+	size_t last = MIN(first + batch->chunk, batch->count);
+
+	for (size_t i = first; i < last; i++)
+	{
+		sightrequest_t &req = batch->requests[batch->pending[i]];
+		req.visible = P_CheckSightEdgesDoom(ctx, req.t1, req.t2, req.radius_boost);
+	}
+}
+
+//
+// P_CheckSightEdgesBatch
+//
+// Runs P_CheckSightEdges for each request and stores the result in its
+// visible field.  Map geometry and the actors must not change until it
+// returns.  The sight cache is checked and filled on the calling thread,
+// and the vanilla sight checks that miss it are spread across the sight
+// threads.  ZDoom sight checks use shared state and are made one at a time.
+//
+void P_CheckSightEdgesBatch(sightrequest_t *requests, size_t count)
+{
+	if (co_zdoomphys || HasBehavior)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			sightrequest_t &req = requests[i];
+
+			if (P_ValidSightRequest(req))
+				req.visible = P_CheckSightEdges(req.t1, req.t2, req.radius_boost);
+			else
+				req.visible = false;
+		}
+		return;
+	}
+
+	static std::vector<size_t> pending;
+	static std::vector<sightcacheentry_t> keys;
+	pending.clear();
+	keys.clear();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		sightrequest_t &req = requests[i];
+		req.visible = false;
+
+		if (!P_ValidSightRequest(req))
+			continue;
+
+		sightcacheentry_t key;
+		P_MakeSightKey(key, SIGHT_EDGES_DOOM, req.t1, req.t2, req.radius_boost);
+
+		const sightcacheentry_t *entry = P_FindSightCacheEntry(key);
+		if (entry->stamp == sightcachestamp && P_SameSightKey(*entry, key))
+		{
+			sightcachecounts[0]++;
+			req.visible = entry->result;
+			continue;
+		}
+
+		sightcachecounts[1]++;
+		pending.push_back(i);
+		keys.push_back(key);
+	}
+
+	if (pending.empty())
+		return;
+
+	while (sight_contexts.size() < sight_pool.size())
+		sight_contexts.push_back(new sightcontext_t);
+
+	// Give every thread a few chunks so that a thread stuck with the long
+	// checks doesn't hold up the rest.
+	const size_t chunks = (sight_pool.size() + 1) * 4;
+
+	sightbatch_t batch;
+	batch.requests = requests;
+	batch.pending = &pending[0];
+	batch.count = pending.size();
+	batch.chunk = (pending.size() + chunks - 1) / chunks;
+
+	size_t jobs = (batch.count + batch.chunk - 1) / batch.chunk;
+	sight_pool.run(jobs, &P_SightBatchJob, &batch);
+
+	for (size_t i = 0; i < pending.size(); i++)
+	{
+		sightcacheentry_t &key = keys[i];
+		key.result = requests[pending[i]].visible;
+
+		sightcacheentry_t *entry = P_FindSightCacheEntry(key);
+		*entry = key;
+		entry->stamp = sightcachestamp;
+	}
+
+	// gather the counts kept by the other threads
+	for (size_t i = 0; i < sight_contexts.size(); i++)
+	{
+		sightcounts[0] += sight_contexts[i]->localcounts[0];
+		sightcounts[1] += sight_contexts[i]->localcounts[1];
+		sight_contexts[i]->localcounts[0] = sight_contexts[i]->localcounts[1] = 0;
+	}
+}
+
+BEGIN_COMMAND (sightstats)
+{
+	Printf(PRINT_HIGH, "reject: %d  checked: %d\n",
+		   sightcounts[0], sightcounts[1]);
+	Printf(PRINT_HIGH, "zdoom reject: %d  early out: %d  traversed: %d\n",
+		   sightcounts2[0], sightcounts2[1], sightcounts2[2]);
+	Printf(PRINT_HIGH, "cache hits: %d  misses: %d\n",
+		   sightcachecounts[0], sightcachecounts[1]);
+
+	if (argc >= 2 && stricmp(argv[1], "reset") == 0)
+	{
+		sightcounts[0] = sightcounts[1] = 0;
+		sightcounts2[0] = sightcounts2[1] = sightcounts2[2] = 0;
+		sightcachecounts[0] = sightcachecounts[1] = 0;
+	}
 }
+END_COMMAND (sightstats)
 
 VERSION_CONTROL (p_sight_cpp, "$Id$")
 
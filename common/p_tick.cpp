@@ -77,6 +77,9 @@ void P_Ticker (void)
 		P_AnimationTick(it->mo);
 	}
 
+	// sight checks are only cached within a single tic
+	P_ClearSightCache ();
+
 	DThinker::RunThinkers ();
 	
 	P_UpdateSpecials ();
@@ -24,9 +24,10 @@
 //  
 //   It maintains a history of the positions of every player and the
 //   floor/ceiling heights of every moving sector.  When a player tries to fire
-//   a hitscan weapon, the system calculates that client's lag X, moves all
-//   other players (excluding the shooter) to their position X tics ago, fires
-//   the weapon, then moves all the players back to their original position.  
+//   a hitscan weapon, the system calculates that client's lag X, moves the
+//   other players (excluding the shooter) within range of the weapon to their
+//   position X tics ago, fires the weapon, then moves those players back to
+//   their original position.  
 //   In the system, this is refered to as 'reconciling' (moving players to a
 //   prior position) and 'restoring' (moving players back to their proper
 //   positions).
@@ -36,6 +37,7 @@
 
 #include "doomdef.h"
 #include "doomstat.h"
+#include "m_bbox.h"
 #include "m_vectors.h"
 #include "p_unlag.h"
 #include "p_local.h"
@@ -48,34 +50,6 @@ void SV_SendDestroyActor(AActor *mo);
 
 EXTERN_CVAR(sv_maxunlagtime)
 
-Unlag::SectorHistoryRecord::SectorHistoryRecord()
-	:	sector(NULL), history_size(0),
-		history_ceilingheight(), history_floorheight(),
-		backup_ceilingheight(0), backup_floorheight(0)
-{
-}
-
-Unlag::SectorHistoryRecord::SectorHistoryRecord(sector_t *sec)
-	: 	sector(sec), history_size(Unlag::MAX_HISTORY_TICS),
-		history_ceilingheight(), history_floorheight(),
-		backup_ceilingheight(0), backup_floorheight(0)
-{
-	if (!sector)
-		return;
-
-	fixed_t ceilingheight = P_CeilingHeight(sector);
-	fixed_t floorheight = P_FloorHeight(sector);
-
-	for (size_t i = 0; i < history_size; i++)
-	{
-		history_ceilingheight[i] = ceilingheight;
-		history_floorheight[i] = floorheight;
-	}
-
-	backup_ceilingheight = ceilingheight;
-	backup_floorheight = floorheight;
-}
-
 //
 // Unlag::getInstance
 //
@@ -89,6 +63,13 @@ Unlag& Unlag::getInstance()
 	return instance;
 }
 
+Unlag::Unlag()
+	:	num_players(0), sector_history_size(Unlag::MAX_HISTORY_TICS),
+		shot_x(0), shot_y(0), shot_reach(0), reconciled(false)
+{
+	memset(player_slot, NO_SLOT, sizeof(player_slot));
+}
+
 Unlag::~Unlag()
 {
 	Unlag::reset();   
@@ -138,122 +119,198 @@ void Unlag::moveSector(sector_t *sector, fixed_t ceilingheight,
 }
 
 
+//
+// Unlag::inShotRange
+//
+// Returns true if a player standing at x, y could be hit by the current
+// shot.
+//
+
+bool Unlag::inShotRange(fixed_t x, fixed_t y) const
+{
+	int64_t dx = (int64_t)x - shot_x;
+	int64_t dy = (int64_t)y - shot_y;
+
+	return	dx >= -shot_reach && dx <= shot_reach &&
+			dy >= -shot_reach && dy <= shot_reach;
+}
+
+
+//
+// Unlag::sectorInShotRange
+//
+// Returns true if any of the lines of a sector could be crossed by the
+// current shot.  The sector's blockbox is used since it covers all of its
+// lines.
+//
+
+bool Unlag::sectorInShotRange(const sector_t *sector) const
+{
+	int64_t left = ((int64_t)shot_x - shot_reach - bmaporgx) >> MAPBLOCKSHIFT;
+	int64_t right = ((int64_t)shot_x + shot_reach - bmaporgx) >> MAPBLOCKSHIFT;
+	int64_t bottom = ((int64_t)shot_y - shot_reach - bmaporgy) >> MAPBLOCKSHIFT;
+	int64_t top = ((int64_t)shot_y + shot_reach - bmaporgy) >> MAPBLOCKSHIFT;
+
+	return	sector->blockbox[BOXRIGHT] >= left &&
+			sector->blockbox[BOXLEFT] <= right &&
+			sector->blockbox[BOXTOP] >= bottom &&
+			sector->blockbox[BOXBOTTOM] <= top;
+}
+
+
 //
 // Unlag::reconcilePlayerPositions
 //
-// Moves all of the players except 'shooter' to the position they were
-// at 'ticsago' tics before.  Players who were not alive at that time
-// have their MF_SHOOTABLE flag removed so they do not take damage.
+// Moves the players other than 'shooter' that are within reach of the
+// shot to the position they were at 'ticsago' tics before.  Players who
+// were not alive at that time have their MF_SHOOTABLE flag removed so they
+// do not take damage.
 //
-// If Unlag::reconcile is true, restore all player positions to their state
-// before reconciliation.  Restore the MF_SHOOTABLE flag if we changed it.
+// A player is moved if either their current or their old position is in
+// range.  Players out of range at both positions can not be hit by the
+// shot and are left alone.
 //
-// NOTE: ticsago should be > 0 if we're reconciling and not restoring
+// NOTE: ticsago should be > 0
 //
 
 void Unlag::reconcilePlayerPositions(byte shooter_id, size_t ticsago)
 {
-	for (size_t i=0; i<player_history.size(); i++)
+	const size_t cur = (gametic - ticsago) % Unlag::MAX_HISTORY_TICS;
+
+	const fixed_t *row_x = history_x[cur];
+	const fixed_t *row_y = history_y[cur];
+	const fixed_t *row_z = history_z[cur];
+
+	for (size_t i = 0; i < num_players; i++)
 	{
-		player_t *player = player_history[i].player;
+		player_t *player = player_ptr[i];
+
+		player_moved[i] = false;
+		offset_x[i] = offset_y[i] = offset_z[i] = 0;
 
 		// skip over the player shooting and any spectators
 		if (player->id == shooter_id || player->spectator || !player->mo)
 			continue;
-	
-		fixed_t dest_x, dest_y, dest_z; // position to move player to
 
-		if (!reconciled)
-		{
-			// record the player's current position, which hasn't yet
-			// been saved to the history arrays
-			player_history[i].backup_x = player->mo->x;
-			player_history[i].backup_y = player->mo->y;
-			player_history[i].backup_z = player->mo->z;
-  
-  			size_t cur = (gametic - ticsago) % Unlag::MAX_HISTORY_TICS;
-
-			dest_x = player_history[i].history_x[cur];
-			dest_y = player_history[i].history_y[cur];
-			dest_z = player_history[i].history_z[cur];
-
-			player_history[i].offset_x = player_history[i].backup_x - dest_x;
-			player_history[i].offset_y = player_history[i].backup_y - dest_y;
-			player_history[i].offset_z = player_history[i].backup_z - dest_z;
-
-			if (player_history[i].history_size < ticsago)
-			{
-				// make the player temporarily unshootable since this player
-				// was not alive when the shot was fired.  Kind of a hack.
-				player_history[i].backup_flags = player->mo->flags;
-				player->mo->flags &= ~(MF_SHOOTABLE | MF_SOLID);
-				player_history[i].changed_flags = true;
-			}
+		if (!inShotRange(player->mo->x, player->mo->y) &&
+			!inShotRange(row_x[i], row_y[i]))
+			continue;
 
-			#ifdef _UNLAG_DEBUG_
-			// spawn a marker sprite at the reconciled position for debugging
-	        AActor *mo = new AActor(dest_x, dest_y, dest_z, MT_KEEN);
-			mo->flags &= ~(MF_SHOOTABLE | MF_SOLID);
-			mo->health = -187;
-			SV_SpawnMobj(mo);
-			#endif // _UNLAG_DEBUG_
+		// record the player's current position, which hasn't yet
+		// been saved to the history arrays
+		backup_x[i] = player->mo->x;
+		backup_y[i] = player->mo->y;
+		backup_z[i] = player->mo->z;
+
+		offset_x[i] = backup_x[i] - row_x[i];
+		offset_y[i] = backup_y[i] - row_y[i];
+		offset_z[i] = backup_z[i] - row_z[i];
+
+		if (history_size[i] < ticsago)
+		{
+			// make the player temporarily unshootable since this player
+			// was not alive when the shot was fired.  Kind of a hack.
+			backup_flags[i] = player->mo->flags;
+			player->mo->flags &= ~(MF_SHOOTABLE | MF_SOLID);
+			changed_flags[i] = true;
 		}
-		else
-		{   // we're moving the player back to proper position
-			dest_x = player_history[i].backup_x;
-			dest_y = player_history[i].backup_y;
-			dest_z = player_history[i].backup_z;
 
-			// restore a player's shootability if we removed it previously
-			if (player_history[i].changed_flags)
-			{
-				player->mo->flags = player_history[i].backup_flags;
-				player_history[i].changed_flags = false;
-			}
-		}   
+		#ifdef _UNLAG_DEBUG_
+		// spawn a marker sprite at the reconciled position for debugging
+		AActor *mo = new AActor(row_x[i], row_y[i], row_z[i], MT_KEEN);
+		mo->flags &= ~(MF_SHOOTABLE | MF_SOLID);
+		mo->health = -187;
+		SV_SpawnMobj(mo);
+		#endif // _UNLAG_DEBUG_
 
-		movePlayer(player, dest_x, dest_y, dest_z); 
+		movePlayer(player, row_x[i], row_y[i], row_z[i]);
+		player_moved[i] = true;
 	}
 }
 
 
+//
+// Unlag::restorePlayerPositions
+//
+// Moves the players that were moved by reconcilePlayerPositions back to
+// their proper positions.  Restore the MF_SHOOTABLE flag if we changed it.
+//
+
+void Unlag::restorePlayerPositions()
+{
+	for (size_t i = 0; i < num_players; i++)
+	{
+		if (!player_moved[i])
+			continue;
+
+		player_moved[i] = false;
+
+		player_t *player = player_ptr[i];
+		if (player->spectator || !player->mo)
+			continue;
+
+		// restore a player's shootability if we removed it previously
+		if (changed_flags[i])
+		{
+			player->mo->flags = backup_flags[i];
+			changed_flags[i] = false;
+		}
+
+		movePlayer(player, backup_x[i], backup_y[i], backup_z[i]);
+	}
+}
+
 
 //
 // Unlag::reconcileSectorPositions
 //
-// Moves the ceiling and floor of any sectors considered moveable
-// to the positions they were 'ticsago' tics before.
-//
-// If 'reconciled' is true, restore the ceiling and floors to where they
-// were prior to reconciliation.
+// Moves the ceiling and floor of any moveable sectors within reach of the
+// shot to the positions they were 'ticsago' tics before.
 //
 
 void Unlag::reconcileSectorPositions(size_t ticsago)
 {
-	for (size_t i=0; i<sector_history.size(); i++)
+	const size_t cur = (sector_history_size - 1 - ticsago) 
+					   % Unlag::MAX_HISTORY_TICS;
+
+	for (size_t i = 0; i < sector_ptr.size(); i++)
 	{
-		sector_t *sector = sector_history[i].sector;
+		sector_t *sector = sector_ptr[i];
 
-		fixed_t dest_ceilingheight, dest_floorheight;
-		if (!reconciled)
-		{
-			// record the player's current position, which hasn't yet
-			// been saved to the history arrays
-			sector_history[i].backup_ceilingheight = P_CeilingHeight(sector);
-			sector_history[i].backup_floorheight = P_FloorHeight(sector);
-
-			size_t cur = (sector_history[i].history_size - 1 - ticsago) 
-						  % Unlag::MAX_HISTORY_TICS;
-			dest_ceilingheight = sector_history[i].history_ceilingheight[cur];
-			dest_floorheight = sector_history[i].history_floorheight[cur];
-		}
-		else	// restore to original positions 
-		{
-			dest_ceilingheight = sector_history[i].backup_ceilingheight;
-			dest_floorheight = sector_history[i].backup_floorheight;
-		}
-		moveSector(sector, dest_ceilingheight, dest_floorheight);
-	}	
+		sector_moved[i] = sectorInShotRange(sector);
+		if (!sector_moved[i])
+			continue;
+
+		// record the sector's current position, which hasn't yet
+		// been saved to the history arrays
+		backup_ceilingheight[i] = P_CeilingHeight(sector);
+		backup_floorheight[i] = P_FloorHeight(sector);
+
+		const size_t index = i * Unlag::MAX_HISTORY_TICS + cur;
+		moveSector(sector, history_ceilingheight[index],
+				   history_floorheight[index]);
+	}
+}
+
+
+//
+// Unlag::restoreSectorPositions
+//
+// Moves the ceilings and floors that were moved by reconcileSectorPositions
+// back to where they were prior to reconciliation.
+//
+
+void Unlag::restoreSectorPositions()
+{
+	for (size_t i = 0; i < sector_ptr.size(); i++)
+	{
+		if (!sector_moved[i])
+			continue;
+
+		sector_moved[i] = false;
+		moveSector(sector_ptr[i], backup_ceilingheight[i],
+				   backup_floorheight[i]);
+	}
 }
 
 
@@ -266,9 +323,16 @@ void Unlag::reconcileSectorPositions(size_t ticsago)
 
 void Unlag::reset()
 {
-	player_history.clear();
-	sector_history.clear();
-	player_id_map.clear();
+	num_players = 0;
+	memset(player_slot, NO_SLOT, sizeof(player_slot));
+
+	sector_ptr.clear();
+	history_ceilingheight.clear();
+	history_floorheight.clear();
+	backup_ceilingheight.clear();
+	backup_floorheight.clear();
+	sector_moved.clear();
+	sector_history_size = Unlag::MAX_HISTORY_TICS;
 }
 
 
@@ -284,19 +348,20 @@ void Unlag::recordPlayerPositions()
 	if (!Unlag::enabled())
 		return;
 
-	for (size_t i=0; i<player_history.size(); i++)
+	const size_t cur = gametic % Unlag::MAX_HISTORY_TICS;
+
+	for (size_t i = 0; i < num_players; i++)
 	{
-		player_t *player = player_history[i].player;
+		player_t *player = player_ptr[i];
 	
 		if (player->playerstate == PST_LIVE && 
 			!player->spectator && player->mo)
 		{
-			player_history[i].history_size++;
+			history_size[i]++;
 			
-			size_t cur = gametic % Unlag::MAX_HISTORY_TICS;
-			player_history[i].history_x[cur] = player->mo->x;
-			player_history[i].history_y[cur] = player->mo->y;
-			player_history[i].history_z[cur] = player->mo->z;
+			history_x[cur][i] = player->mo->x;
+			history_y[cur][i] = player->mo->y;
+			history_z[cur][i] = player->mo->z;
 			
 			#ifdef _UNLAG_DEBUG_
 			DPrintf("Unlag (%03d): recording player %d position (%d, %d)\n",
@@ -308,7 +373,7 @@ void Unlag::recordPlayerPositions()
 		} 
 		else
 		{   // reset history for dead, spectating, etc players
-			player_history[i].history_size = 0;
+			history_size[i] = 0;
 		}
 	}
 }
@@ -325,14 +390,15 @@ void Unlag::recordSectorPositions()
 	if (!Unlag::enabled())
 		return;
 
-	for (size_t i=0; i<sector_history.size(); i++)
+	const size_t cur = sector_history_size++ % Unlag::MAX_HISTORY_TICS;
+
+	for (size_t i = 0; i < sector_ptr.size(); i++)
 	{
-		sector_t *sector = sector_history[i].sector;
+		sector_t *sector = sector_ptr[i];
 
-		size_t cur = sector_history[i].history_size++ 
-					 % Unlag::MAX_HISTORY_TICS;
-		sector_history[i].history_ceilingheight[cur] = P_CeilingHeight(sector);
-		sector_history[i].history_floorheight[cur] = P_FloorHeight(sector);
+		const size_t index = i * Unlag::MAX_HISTORY_TICS + cur;
+		history_ceilingheight[index] = P_CeilingHeight(sector);
+		history_floorheight[index] = P_FloorHeight(sector);
 	}
 }
 
@@ -340,20 +406,21 @@ void Unlag::recordSectorPositions()
 //
 // Unlag::refreshRegisteredPlayers
 //
-// Updates the pointer to player_t in each player history record.
+// Updates the pointer to player_t for each registered player.
 // The address of a player's player_t can change when a player is added to or
-// removed from the global 'players' vector.  Also recreate the player_id_map.
+// removed from the global 'players' vector.  Also recreate the player_slot
+// table.
 // 
 
 void Unlag::refreshRegisteredPlayers()
 {
-	player_id_map.clear();
-	for (size_t i=0; i<player_history.size(); i++)
+	memset(player_slot, NO_SLOT, sizeof(player_slot));
+	for (size_t i = 0; i < num_players; i++)
 	{
-		byte id = player_history[i].player_id;
+		byte id = player_id[i];
 
-		player_history[i].player = &idplayer(id);		
-		player_id_map[id] = i;
+		player_ptr[i] = &idplayer(id);
+		player_slot[id] = i;
 	}
 }
 
@@ -373,20 +440,40 @@ void Unlag::registerPlayer(byte player_id)
 	if (!validplayer(idplayer(player_id)))
 		return;
 
-	player_history.push_back(PlayerHistoryRecord());
-	player_history.back().player_id = player_id;
-	player_history.back().history_size = 0;
-	player_history.back().changed_flags = false;
+	if (num_players >= MAXPLAYERS)
+		return;
+
+	size_t i = num_players++;
+	this->player_id[i] = player_id;
+	history_size[i] = 0;
+	player_moved[i] = false;
+	changed_flags[i] = false;
+	current_lag[i] = 0;
+	offset_x[i] = offset_y[i] = offset_z[i] = 0;
 
 	refreshRegisteredPlayers();
 }
 
 
+//
+// UnlagRemoveSlot
+//
+// Shifts the count entries following slot down by one.
+//
+
+template <typename T>
+static inline void UnlagRemoveSlot(T *arr, size_t slot, size_t count)
+{
+	if (count)
+		memmove(&arr[slot], &arr[slot + 1], count * sizeof(T));
+}
+
 //
 // Unlag::unregisterPlayer
 //
 // Removes a player from the player registry that mainins the history
-// of players' positions.
+// of players' positions.  The slots after the player's are shifted down
+// to keep the remaining players in registration order.
 //
 // NOTE: unregisterPlayer should be called immediately following the call to
 // players.erase() to update the pointers to the player objects.
@@ -397,11 +484,33 @@ void Unlag::unregisterPlayer(byte player_id)
 	if (!Unlag::enabled())
 		return;
 
-	size_t history_index = player_id_map[player_id];
-	if (history_index >= player_history.size())
+	size_t slot = player_slot[player_id];
+	if (slot >= num_players)
 		return;
 
-	player_history.erase(player_history.begin() + history_index);
+	size_t count = num_players - slot - 1;
+
+	UnlagRemoveSlot(this->player_id, slot, count);
+	UnlagRemoveSlot(history_size, slot, count);
+	UnlagRemoveSlot(backup_x, slot, count);
+	UnlagRemoveSlot(backup_y, slot, count);
+	UnlagRemoveSlot(backup_z, slot, count);
+	UnlagRemoveSlot(offset_x, slot, count);
+	UnlagRemoveSlot(offset_y, slot, count);
+	UnlagRemoveSlot(offset_z, slot, count);
+	UnlagRemoveSlot(player_moved, slot, count);
+	UnlagRemoveSlot(changed_flags, slot, count);
+	UnlagRemoveSlot(backup_flags, slot, count);
+	UnlagRemoveSlot(current_lag, slot, count);
+
+	for (size_t n = 0; n < Unlag::MAX_HISTORY_TICS; n++)
+	{
+		UnlagRemoveSlot(history_x[n], slot, count);
+		UnlagRemoveSlot(history_y[n], slot, count);
+		UnlagRemoveSlot(history_z[n], slot, count);
+	}
+
+	num_players--;
 	refreshRegisteredPlayers();
 }
 
@@ -416,18 +525,29 @@ void Unlag::unregisterPlayer(byte player_id)
 
 void Unlag::registerSector(sector_t *sector)
 {
-	if (!Unlag::enabled())
+	if (!Unlag::enabled() || !sector)
 		return;
 
-	// Check if this sector already is in sector_history
-	for (size_t i=0; i<sector_history.size(); i++)
+	// Check if this sector already is in the registry
+	for (size_t i = 0; i < sector_ptr.size(); i++)
 	{
 		// note: comparing the pointers to the sector_t objects
-		if (sector_history[i].sector == sector)
+		if (sector_ptr[i] == sector)
 			return;
 	}
 
-	sector_history.push_back(SectorHistoryRecord(sector));
+	fixed_t ceilingheight = P_CeilingHeight(sector);
+	fixed_t floorheight = P_FloorHeight(sector);
+
+	// the sector has been at its current height for its entire history
+	sector_ptr.push_back(sector);
+	history_ceilingheight.insert(history_ceilingheight.end(),
+								 Unlag::MAX_HISTORY_TICS, ceilingheight);
+	history_floorheight.insert(history_floorheight.end(),
+							   Unlag::MAX_HISTORY_TICS, floorheight);
+	backup_ceilingheight.push_back(ceilingheight);
+	backup_floorheight.push_back(floorheight);
+	sector_moved.push_back(false);
 }
 
 
@@ -443,12 +563,22 @@ void Unlag::unregisterSector(sector_t *sector)
 	if (!Unlag::enabled())
 		return;
 
-	for (size_t i=0; i<sector_history.size(); i++)
+	for (size_t i = 0; i < sector_ptr.size(); i++)
 	{
 		// note: comparing the pointers to the sector_t objects
-		if (sector_history[i].sector == sector)  
+		if (sector_ptr[i] == sector)  
 		{
-			sector_history.erase(sector_history.begin() + i);
+			const size_t first = i * Unlag::MAX_HISTORY_TICS;
+			const size_t last = first + Unlag::MAX_HISTORY_TICS;
+
+			sector_ptr.erase(sector_ptr.begin() + i);
+			history_ceilingheight.erase(history_ceilingheight.begin() + first,
+										history_ceilingheight.begin() + last);
+			history_floorheight.erase(history_floorheight.begin() + first,
+									  history_floorheight.begin() + last);
+			backup_ceilingheight.erase(backup_ceilingheight.begin() + i);
+			backup_floorheight.erase(backup_floorheight.begin() + i);
+			sector_moved.erase(sector_moved.begin() + i);
 			return;
 		}
 	}
@@ -458,20 +588,26 @@ void Unlag::unregisterSector(sector_t *sector)
 //
 // Unlag::reconcile
 //
-// Temporarily moves all sectors and players to the positions they were
+// Temporarily moves sectors and players to the positions they were
 // in when a lagging client (shooter) pressed the fire button on the client's
 // end.  This allows a client to aim directly at opponents with hitscan
 // weapons instead of leading them.
 //
+// Only the players and sectors that a trace of the given range fired from
+// the shooter's position could reach are moved.  Nothing else can affect
+// the outcome of the shot.
+//
 
-void Unlag::reconcile(byte shooter_id)
+void Unlag::reconcile(byte shooter_id, fixed_t range)
 {
 	if (!Unlag::enabled())
 		return;	
 
-	size_t player_index = player_id_map[shooter_id];
+	size_t player_index = player_slot[shooter_id];
+	if (player_index >= num_players)
+		return;
 
-	size_t lag = player_history[player_index].current_lag;
+	size_t lag = current_lag[player_index];
 	
 	#ifdef _UNLAG_DEBUG_
 	DPrintf("Unlag (%03d): moving players to their positions at gametic %d (%d tics ago)\n",
@@ -500,8 +636,18 @@ void Unlag::reconcile(byte shooter_id)
 				gametic & 0xFF, shooter_id, lag);
 	#endif	// _UNLAG_DEBUG_
 
+	AActor *shooter = player_ptr[player_index]->mo;
+	if (!shooter)
+		return;
+
 	if (lag > 0 && lag < Unlag::MAX_HISTORY_TICS) 
 	{
+		// a target is hit if the trace passes within its radius, so allow
+		// for the radius of the target and some rounding on top of the range
+		shot_x = shooter->x;
+		shot_y = shooter->y;
+		shot_reach = (int64_t)range + 2 * MAXRADIUS;
+
 		reconcileSectorPositions(lag);
 		reconcilePlayerPositions(shooter_id, lag);
 		reconciled = true;
@@ -523,8 +669,8 @@ void Unlag::restore(byte shooter_id)
 
 	if (reconciled)
 	{
-		reconcileSectorPositions(0);
-		reconcilePlayerPositions(shooter_id, 0);
+		restoreSectorPositions();
+		restorePlayerPositions();
 		reconciled = false;	 // reset after restoring original positions
 	}
 	
@@ -556,8 +702,11 @@ void Unlag::setRoundtripDelay(byte player_id, byte svgametic)
 
 	size_t delay = ((gametic & 0xFF) + 256 - svgametic) & 0xFF;
 	
-	size_t player_index = player_id_map[player_id];
-	player_history[player_index].current_lag = MIN(delay, maxdelay);
+	size_t player_index = player_slot[player_id];
+	if (player_index >= num_players)
+		return;
+
+	current_lag[player_index] = MIN(delay, maxdelay);
 	
 	#ifdef _UNLAG_DEBUG_
 	DPrintf("Unlag (%03d): received gametic %d from player %d, lag = %d\n",
@@ -580,12 +729,14 @@ void Unlag::getReconciliationOffset(	byte target_id,
 	if (!reconciled)	// reconciled will only be true if sv_unlag is 1
 		return;
 
-	size_t target_index  = player_id_map[target_id];
+	size_t target_index = player_slot[target_id];
+	if (target_index >= num_players)
+		return;
 
 	// calculate how far the target was moved during reconciliation
-	x = player_history[target_index].offset_x;
-	y = player_history[target_index].offset_y;
-	z = player_history[target_index].offset_z;
+	x = offset_x[target_index];
+	y = offset_y[target_index];
+	z = offset_z[target_index];
 }
 
 
@@ -600,17 +751,20 @@ void Unlag::getCurrentPlayerPosition(	byte player_id,
 {
 	x = y = z = 0;
 
-	size_t cur = player_id_map[player_id];
-	player_t* player = player_history[cur].player;
+	size_t cur = player_slot[player_id];
+	if (cur >= num_players)
+		return;
+
+	player_t* player = player_ptr[cur];
 
 	if (!player || !player->mo || player->spectator)
 		return;
 
-	if (Unlag::enabled() && reconciled)
+	if (Unlag::enabled() && reconciled && player_moved[cur])
 	{
-		x = player_history[cur].backup_x;
-		y = player_history[cur].backup_y;
-		z = player_history[cur].backup_z;
+		x = backup_x[cur];
+		y = backup_y[cur];
+		z = backup_z[cur];
 	}
 	else
 	{
@@ -630,20 +784,20 @@ void Unlag::debugReconciliation(byte shooter_id)
 {
 	player_t *shooter = &(idplayer(shooter_id));
 	
-	for (size_t i = 0; i < player_history.size(); i++)
+	for (size_t i = 0; i < num_players; i++)
 	{
-		if (player_history[i].player->id == shooter_id)
+		if (player_ptr[i]->id == shooter_id)
 			continue;	
 	
 		for (size_t n = 0; n < MAX_HISTORY_TICS; n++)
 		{
-			if (n > player_history[i].history_size)
+			if (n > history_size[i])
 				break;
 				
 			size_t cur = (gametic - n) % Unlag::MAX_HISTORY_TICS;
 		
-			fixed_t x = player_history[i].history_x[cur];
-			fixed_t y = player_history[i].history_y[cur];
+			fixed_t x = history_x[cur][i];
+			fixed_t y = history_y[cur][i];
 			
 			angle_t angle = P_PointToAngle(shooter->mo->x,	shooter->mo->y, x, y);
 			angle_t deltaangle = 	angle - shooter->mo->angle < ANG180 ?
@@ -653,7 +807,7 @@ void Unlag::debugReconciliation(byte shooter_id)
 			if (deltaangle < 3 * FRACUNIT)
 			{
 				DPrintf("Unlag (%03d): would have hit player %d at gametic %d (%d tics ago)\n",
-						gametic & 0xFF, player_history[i].player->id, (gametic - n) & 0xFF, n);
+						gametic & 0xFF, player_ptr[i]->id, (gametic - n) & 0xFF, n);
 			}
 		}
 	}
@@ -29,7 +29,6 @@
 #define __PUNLAG_H__
 
 #include <vector>
-#include <map>
 #include "doomtype.h"
 #include "m_fixed.h"
 #include "actor.h"
@@ -42,7 +41,7 @@ public:
 	~Unlag();
 	static Unlag& getInstance();  // returns the instantiated Unlag object
 	void reset();	  // called when starting a level
-	void reconcile(byte player_id);
+	void reconcile(byte player_id, fixed_t range);
 	void restore(byte player_id);
 	void recordPlayerPositions();
 	void recordSectorPositions();
@@ -58,67 +57,74 @@ public:
 	static bool enabled();
 private:
 	static const size_t MAX_HISTORY_TICS = TICRATE;
-		
-	typedef struct {
-		byte		player_id;
-
-		// cached pointer to players[n].  Note: this needs to be updated
-		// EVERYTIME a player connects or disconnects.
-		player_t*	player;
-	
-		fixed_t		history_x[Unlag::MAX_HISTORY_TICS];
-		fixed_t		history_y[Unlag::MAX_HISTORY_TICS];
-		fixed_t		history_z[Unlag::MAX_HISTORY_TICS];
-		size_t		history_size;
-		
-		// current position. restore this position after reconciliation.
-		fixed_t		backup_x;
-		fixed_t		backup_y;
-		fixed_t		backup_z;
-
-		fixed_t		offset_x;
-		fixed_t		offset_y;
-		fixed_t		offset_z;
-		
-		// did we change player's MF_SHOOTABLE flag during reconciliation?
-		bool		changed_flags;
-		int			backup_flags; 
-
-		size_t		current_lag;
-	} PlayerHistoryRecord;
-   
-	class SectorHistoryRecord
-	{
-	public:
-		SectorHistoryRecord();
-		SectorHistoryRecord(sector_t *sec);
-
-		sector_t*	sector;
-		size_t		history_size;
-		fixed_t		history_ceilingheight[Unlag::MAX_HISTORY_TICS];
-		fixed_t		history_floorheight[Unlag::MAX_HISTORY_TICS];
-
-		// current position. restore this position after reconciliation.
-		fixed_t		backup_ceilingheight;
-		fixed_t		backup_floorheight;
-	};
-
-	std::vector<PlayerHistoryRecord> player_history;
-	std::vector<SectorHistoryRecord> sector_history;
-	bool reconciled;	
-    
-    // stores an index into the player_history vector, keyed by player_id
-	std::map<byte, size_t> player_id_map;
-
-	Unlag() : reconciled(false) {}  // private contsructor (part of Singleton)
+	static const byte NO_SLOT = 0xFF;
+
+	// Player history is kept in parallel arrays indexed by a slot number.
+	// Slots are handed out in the order players register.  Positions are
+	// stored in a ring buffer with one row per tic so that the positions
+	// of every player at a given tic are contiguous.
+	size_t		num_players;
+	byte		player_slot[256];		// slot for each player id
+	byte		player_id[MAXPLAYERS];
+
+	// cached pointer to players[n].  Note: this needs to be updated
+	// EVERYTIME a player connects or disconnects.
+	player_t*	player_ptr[MAXPLAYERS];
+
+	fixed_t		history_x[MAX_HISTORY_TICS][MAXPLAYERS];
+	fixed_t		history_y[MAX_HISTORY_TICS][MAXPLAYERS];
+	fixed_t		history_z[MAX_HISTORY_TICS][MAXPLAYERS];
+	size_t		history_size[MAXPLAYERS];
+
+	// current position. restore this position after reconciliation.
+	fixed_t		backup_x[MAXPLAYERS];
+	fixed_t		backup_y[MAXPLAYERS];
+	fixed_t		backup_z[MAXPLAYERS];
+
+	fixed_t		offset_x[MAXPLAYERS];
+	fixed_t		offset_y[MAXPLAYERS];
+	fixed_t		offset_z[MAXPLAYERS];
+
+	// was the player moved during reconciliation?
+	bool		player_moved[MAXPLAYERS];
+
+	// did we change player's MF_SHOOTABLE flag during reconciliation?
+	bool		changed_flags[MAXPLAYERS];
+	int			backup_flags[MAXPLAYERS];
+
+	size_t		current_lag[MAXPLAYERS];
+
+	// Sector history, likewise indexed by slot.  The height history holds
+	// MAX_HISTORY_TICS entries for each sector, one sector after another.
+	// All sectors are recorded together, so a single counter serves as
+	// the write position for all of them.
+	std::vector<sector_t*>	sector_ptr;
+	std::vector<fixed_t>	history_ceilingheight;
+	std::vector<fixed_t>	history_floorheight;
+	std::vector<fixed_t>	backup_ceilingheight;
+	std::vector<fixed_t>	backup_floorheight;
+	std::vector<byte>		sector_moved;
+	size_t					sector_history_size;
+
+	// area that the current shot can reach, centered on the shooter
+	fixed_t		shot_x, shot_y;
+	int64_t		shot_reach;
+
+	bool reconciled;
+
+	Unlag();						// private contsructor (part of Singleton)
 	Unlag(const Unlag &rhs);		// private copy constructor
 	Unlag& operator=(const Unlag &rhs);	//private assignment operator
 
 	void movePlayer(player_t *player, fixed_t x, fixed_t y, fixed_t z);
 	void moveSector(sector_t *sector, 
 					fixed_t ceilingheight, fixed_t floorheight);
+	bool inShotRange(fixed_t x, fixed_t y) const;
+	bool sectorInShotRange(const sector_t *sector) const;
 	void reconcilePlayerPositions(byte shooter_id, size_t ticsago);
 	void reconcileSectorPositions(size_t ticsago);
+	void restorePlayerPositions();
+	void restoreSectorPositions();
 	void refreshRegisteredPlayers();
 
 	void debugReconciliation(byte shooter_id);
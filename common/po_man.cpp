@@ -912,6 +912,9 @@ static void UnLinkPolyobj (polyobj_t *po)
 	int i, j;
 	int index;
 
+	// sight checks it blocked where it was may now be clear
+	P_ClearSightCacheBox(po->bbox);
+
 	// remove the polyobj from each blockmap section
 	for(j = po->bbox[BOXBOTTOM]; j <= po->bbox[BOXTOP]; j++)
 	{
@@ -975,6 +978,10 @@ static void LinkPolyobj (polyobj_t *po)
 	po->bbox[BOXLEFT] = (leftX-bmaporgx)>>MAPBLOCKSHIFT;
 	po->bbox[BOXTOP] = (topY-bmaporgy)>>MAPBLOCKSHIFT;
 	po->bbox[BOXBOTTOM] = (bottomY-bmaporgy)>>MAPBLOCKSHIFT;
+
+	// the polyobj may now block cached sight checks
+	P_ClearSightCacheBox(po->bbox);
+
 	// add the polyobj to each blockmap section
 	for(j = po->bbox[BOXBOTTOM]*bmapwidth; j <= po->bbox[BOXTOP]*bmapwidth;
 		j += bmapwidth)
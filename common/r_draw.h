@@ -28,7 +28,7 @@
 #include "r_intrin.h"
 #include "r_defs.h"
 
-typedef struct 
+typedef struct drawcolumn_s
 {
 	byte*				source;
 	byte*				destination;
@@ -57,7 +57,7 @@ typedef struct
 
 extern "C" drawcolumn_t dcol;
 
-typedef struct
+typedef struct drawspan_s
 {
 	byte*				source;
 	byte*				destination;
@@ -84,7 +84,7 @@ typedef struct
 
 	fixed_t				translevel;
 
-	shaderef_t			slopelighting[MAXWIDTH];
+	const shaderef_t*	slopelighting;		// one per pixel, from x1 to x2
 
 	palindex_t			color;
 } drawspan_t;
@@ -98,62 +98,78 @@ void R_RenderColumnRange(int start, int stop, int* top, int* bottom,
 		tallpost_t** posts, void (*colblast)(), bool calc_light, int columnmethod);
 
 // [RH] Pointers to the different column and span drawers...
+// Each takes the column or span it should draw, which is normally dcol or
+// dspan.  R_DrawQueuedColumn and friends should be used to call them while
+// drawing the view so the drawing can be handed to the draw threads.
 
 // The span blitting interface.
 // Hook in assembler or system specific BLT here.
-extern void (*R_DrawColumn)(void);
+extern void (*R_DrawColumn)(drawcolumn_t&);
 
 // The Spectre/Invisibility effect.
-extern void (*R_DrawFuzzColumn)(void);
+extern void (*R_DrawFuzzColumn)(drawcolumn_t&);
 
 // [RH] Draw translucent column;
-extern void (*R_DrawTranslucentColumn)(void);
+extern void (*R_DrawTranslucentColumn)(drawcolumn_t&);
 
 // Draw with color translation tables,
 //	for player sprite rendering,
 //	Green/Red/Blue/Indigo shirts.
-extern void (*R_DrawTranslatedColumn)(void);
+extern void (*R_DrawTranslatedColumn)(drawcolumn_t&);
 
 // Span blitting for rows, floor/ceiling.
 // No Sepctre effect needed.
-extern void (*R_DrawSpan)(void);
+extern void (*R_DrawSpan)(drawspan_t&);
 
-extern void (*R_DrawSlopeSpan)(void);
+extern void (*R_DrawSlopeSpan)(drawspan_t&);
 
-extern void (*R_FillColumn)(void);
-extern void (*R_FillSpan)(void);
-extern void (*R_FillTranslucentSpan)(void);
+extern void (*R_FillColumn)(drawcolumn_t&);
+extern void (*R_FillSpan)(drawspan_t&);
+extern void (*R_FillTranslucentSpan)(drawspan_t&);
 
 // [RH] Initialize the above function pointers
 void R_InitColumnDrawers ();
 
 void R_InitVectorizedDrawers();
 
-void	R_DrawColumnP (void);
-void	R_DrawFuzzColumnP (void);
-void	R_DrawTranslucentColumnP (void);
-void	R_DrawTranslatedColumnP (void);
-void	R_DrawSpanP (void);
-void	R_DrawSlopeSpanIdealP_C (void);
+// Draw the view through the draw queue, which hands the drawing to the
+// r_drawthreads threads when it is active.
+void R_DrawQueuedColumn(void (*drawfunc)(drawcolumn_t&));
+void R_DrawQueuedSpan(void (*drawfunc)(drawspan_t&));
+void R_DrawQueuedSlopeSpan(void (*drawfunc)(drawspan_t&));
 
-void	R_DrawColumnD (void);
-void	R_DrawFuzzColumnD (void);
-void	R_DrawTranslucentColumnD (void);
-void	R_DrawTranslatedColumnD (void);
+void R_SetDrawThreads(size_t count);
+void R_BeginDrawQueue();
+void R_FlushDrawQueue();
+void R_EndDrawQueue();
 
-void	R_DrawTlatedLucentColumnP (void);
+void R_ResetFuzzTable();
+
+void	R_DrawColumnP (drawcolumn_t&);
+void	R_DrawFuzzColumnP (drawcolumn_t&);
+void	R_DrawTranslucentColumnP (drawcolumn_t&);
+void	R_DrawTranslatedColumnP (drawcolumn_t&);
+void	R_DrawSpanP (drawspan_t&);
+void	R_DrawSlopeSpanIdealP_C (drawspan_t&);
+
+void	R_DrawColumnD (drawcolumn_t&);
+void	R_DrawFuzzColumnD (drawcolumn_t&);
+
+void	R_DrawTlatedLucentColumnP (drawcolumn_t&);
 #define R_DrawTlatedLucentColumn R_DrawTlatedLucentColumnP
-void	R_StretchColumnP (void);
+void	R_StretchColumnP (drawcolumn_t&);
 #define R_StretchColumn R_StretchColumnP
 
-void	R_BlankColumn (void);
-void	R_FillColumnP (void);
-void	R_BlankSpan (void);
-void	R_FillSpanP (void);
-void	R_FillSpanD (void);
+void	R_BlankColumn (drawcolumn_t&);
+void	R_FillColumnP (drawcolumn_t&);
+void	R_BlankSpan (drawspan_t&);
+void	R_FillSpanP (drawspan_t&);
+void	R_FillSpanD (drawspan_t&);
 
-void R_DrawSpanD_c(void);
-void R_DrawSlopeSpanD_c(void);
+void R_DrawTranslucentColumnD_c(drawcolumn_t&);
+void R_DrawTranslatedColumnD_c(drawcolumn_t&);
+void R_DrawSpanD_c(drawspan_t&);
+void R_DrawSlopeSpanD_c(drawspan_t&);
 
 #define SPANJUMP 16
 #define INTERPSTEP (0.0625f)
@@ -163,26 +179,33 @@ class IWindowSurface;
 void r_dimpatchD_c(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
 #ifdef __SSE2__
-void R_DrawSpanD_SSE2(void);
-void R_DrawSlopeSpanD_SSE2(void);
+void R_DrawSpanD_SSE2(drawspan_t&);
+void R_DrawSlopeSpanD_SSE2(drawspan_t&);
 void r_dimpatchD_SSE2(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
+#ifdef __AVX2_DRAWERS__
+void R_DrawTranslucentColumnD_AVX2(drawcolumn_t&);
+void R_DrawTranslatedColumnD_AVX2(drawcolumn_t&);
+#endif
+
 #ifdef __MMX__
-void R_DrawSpanD_MMX(void);
-void R_DrawSlopeSpanD_MMX(void);
+void R_DrawSpanD_MMX(drawspan_t&);
+void R_DrawSlopeSpanD_MMX(drawspan_t&);
 void r_dimpatchD_MMX(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
 #ifdef __ALTIVEC__
-void R_DrawSpanD_ALTIVEC(void);
-void R_DrawSlopeSpanD_ALTIVEC(void);
+void R_DrawSpanD_ALTIVEC(drawspan_t&);
+void R_DrawSlopeSpanD_ALTIVEC(drawspan_t&);
 void r_dimpatchD_ALTIVEC(IWindowSurface*, argb_t color, int alpha, int x1, int y1, int w, int h);
 #endif
 
 // Vectorizable function pointers:
-extern void (*R_DrawSpanD)(void);
-extern void (*R_DrawSlopeSpanD)(void);
+extern void (*R_DrawTranslucentColumnD)(drawcolumn_t&);
+extern void (*R_DrawTranslatedColumnD)(drawcolumn_t&);
+extern void (*R_DrawSpanD)(drawspan_t&);
+extern void (*R_DrawSlopeSpanD)(drawspan_t&);
 extern void (*r_dimpatchD)(IWindowSurface* surface, argb_t color, int alpha, int x1, int y1, int w, int h);
 
 extern byte*			translationtables;
@@ -58,4 +58,18 @@
 	#endif
 #endif
 
+// AVX2 drawers are compiled for AVX2 one function at a time so that the rest
+// of the program still runs on CPUs without it.  r_optimize only selects them
+// once the CPU has been checked.
+#if defined(__AVX2__)
+	#define __AVX2_DRAWERS__
+	#define AVX2_TARGET
+#elif defined(_MSC_VER) && (_MSC_VER >= 1800) && (defined(_M_IX86) || defined(_M_X64))
+	#define __AVX2_DRAWERS__
+	#define AVX2_TARGET
+#elif (defined(__i386__) || defined(__x86_64__)) && (__GNUC__ >= 5 || defined(__clang__))
+	#define __AVX2_DRAWERS__
+	#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+
 #endif
@@ -116,9 +116,12 @@ extern int				lightscaleymul;
 //
 // Function pointers to switch refresh/drawing functions.
 //
-extern void 			(*colfunc) (void);
-extern void 			(*spanfunc) (void);
-extern void				(*spanslopefunc) (void);
+struct drawcolumn_s;
+struct drawspan_s;
+
+extern void 			(*colfunc) (drawcolumn_s&);
+extern void 			(*spanfunc) (drawspan_s&);
+extern void				(*spanslopefunc) (drawspan_s&);
 
 
 //
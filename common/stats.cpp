@@ -1,4 +1,4 @@
-// Emacs style mode select   -*- C++ -*- 
+// Emacs style mode select   -*- C++ -*-
 //-----------------------------------------------------------------------------
 //
 // $Id$
@@ -19,81 +19,406 @@
 // DESCRIPTION:
 //	STATS
 //
+//	Zones are timed with I_GetTime and kept in a tree, so the same zone
+//	reached through different callers is counted separately.  The time and
+//	number of calls of every zone are added up over a frame, which is one
+//	pass through D_RunTics, and at the end of the frame the total goes into
+//	a histogram for the zone.  The histograms give the median, 99th
+//	percentile and maximum time per frame for each zone.
+//
+//	The stat console command turns the profiler on and off, prints the
+//	results and can record a trace of every zone entered over a number of
+//	frames.  Traces are written in the Chrome trace event format and can
+//	be opened with chrome://tracing or https://ui.perfetto.dev.
+//
+//	Turning the profiler on or off, resetting it and starting a trace take
+//	effect at the end of the current frame, when no zones are open.
+//
 //-----------------------------------------------------------------------------
 
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <string>
+#include <vector>
 
 #include "doomtype.h"
-#include "v_video.h"
 #include "c_dispatch.h"
+#include "cmdlib.h"
 #include "stats.h"
 #include "i_system.h"
 
-std::vector<FStat*> FStat::stats;
+bool profiling = false;
+
+struct profilenode_t
+{
+	const OProfileZone*	zone;
+	int					depth;
+	std::vector<int>	children;
+
+	// time and calls in the current frame
+	dtime_t				frametime;
+	unsigned int		framecalls;
 
-FStat::FStat (const char *cname)
-: name(cname)
+	// totals over the frames in which the zone was entered
+	unsigned int		frames;
+	uint64_t			calls;
+	dtime_t				totaltime;
+	dtime_t				maxtime;
+	unsigned int		histogram[NUMHISTOGRAMBUCKETS];
+};
+
+struct openzone_t
 {
-	stats.push_back(this);
+	int					node;
+	dtime_t				start;
+	size_t				event;
+};
+
+struct traceevent_t
+{
+	const char*			name;
+	dtime_t				start;
+	dtime_t				duration;
+};
+
+// nodes[0] is the root of the tree and has no zone
+static std::vector<profilenode_t> nodes;
+static std::vector<openzone_t> open_zones;
+
+static bool profile_enabled = false;
+static bool profile_reset = false;
+
+static const size_t NOEVENT = ~(size_t)0;
+static const size_t MAXTRACEEVENTS = 1 << 20;
+
+static std::vector<traceevent_t> trace_events;
+static std::string trace_filename;
+static int trace_frames;
+static bool trace_pending = false;
+static bool tracing = false;
+static dtime_t trace_start;
+
+
+//
+// Stat_NewNode
+//
+static int Stat_NewNode(const OProfileZone* zone, int depth)
+{
+	nodes.push_back(profilenode_t());
+	profilenode_t& node = nodes.back();
+
+	node.zone = zone;
+	node.depth = depth;
+	node.frametime = 0;
+	node.framecalls = 0;
+	node.frames = 0;
+	node.calls = 0;
+	node.totaltime = 0;
+	node.maxtime = 0;
+	for (int i = 0; i < NUMHISTOGRAMBUCKETS; i++)
+		node.histogram[i] = 0;
+
+	return nodes.size() - 1;
 }
 
-FStat::~FStat ()
+
+//
+// Stat_ResetNodes
+//
+static void Stat_ResetNodes()
 {
-	std::vector<FStat*>::iterator i = std::find(stats.begin(), stats.end(), this);
-	
-	if(i != stats.end())
-		stats.erase(i);
+	nodes.clear();
+	Stat_NewNode(NULL, -1);
 }
 
-void FStat::clock()
+
+//
+// Stat_EnterZone
+//
+// Starts timing the zone as a child of the innermost open zone.
+//
+void Stat_EnterZone(OProfileZone& zone)
 {
-	last_clock = I_MSTime();
+	const int parent = open_zones.empty() ? 0 : open_zones.back().node;
+
+	int node = -1;
+	for (size_t i = 0; i < nodes[parent].children.size(); i++)
+	{
+		if (nodes[nodes[parent].children[i]].zone == &zone)
+		{
+			node = nodes[parent].children[i];
+			break;
+		}
+	}
+
+	if (node == -1)
+	{
+		node = Stat_NewNode(&zone, nodes[parent].depth + 1);
+		nodes[parent].children.push_back(node);
+	}
+
+	openzone_t open;
+	open.node = node;
+	open.event = NOEVENT;
+	open.start = I_GetTime();
+
+	if (tracing && trace_events.size() < MAXTRACEEVENTS)
+	{
+		traceevent_t event;
+		event.name = zone.name;
+		event.start = open.start;
+		event.duration = 0;
+
+		open.event = trace_events.size();
+		trace_events.push_back(event);
+	}
+
+	open_zones.push_back(open);
+}
+
+
+//
+// Stat_LeaveZone
+//
+// Stops timing the innermost open zone.
+//
+void Stat_LeaveZone()
+{
+	const dtime_t now = I_GetTime();
+
+	if (open_zones.empty())
+		return;
+
+	const openzone_t& open = open_zones.back();
+	const dtime_t elapsed = now - open.start;
+
+	nodes[open.node].frametime += elapsed;
+	nodes[open.node].framecalls++;
+
+	if (open.event != NOEVENT)
+		trace_events[open.event].duration = elapsed;
+
+	open_zones.pop_back();
 }
 
-void FStat::unclock()
+
+//
+// Stat_HistogramBucket
+//
+int Stat_HistogramBucket(dtime_t time)
 {
-	last_elapsed = I_MSTime() - last_clock;
+	if (time < HISTOGRAM_SUBBUCKETS)
+		return (int)time;
+
+	int exponent = HISTOGRAM_SUBBITS;
+	while (exponent < 63 && time >> (exponent + 1))
+		exponent++;
+
+	const int shift = exponent - HISTOGRAM_SUBBITS;
+	const int bucket = (shift + 1) * HISTOGRAM_SUBBUCKETS + (int)((time >> shift) & (HISTOGRAM_SUBBUCKETS - 1));
+	return std::min(bucket, NUMHISTOGRAMBUCKETS - 1);
 }
 
-void FStat::reset()
+
+//
+// Stat_HistogramValue
+//
+// Returns the time in the middle of a histogram bucket.
+//
+dtime_t Stat_HistogramValue(int bucket)
 {
-	last_elapsed = last_clock = 0;
+	if (bucket < HISTOGRAM_SUBBUCKETS)
+		return bucket;
+
+	const int shift = bucket / HISTOGRAM_SUBBUCKETS - 1;
+	const dtime_t low = (dtime_t)(HISTOGRAM_SUBBUCKETS + bucket % HISTOGRAM_SUBBUCKETS) << shift;
+	return low + ((dtime_t)1 << shift) / 2;
 }
 
-const char *FStat::getname()
+
+//
+// Stat_Percentile
+//
+// Returns the time per frame that the given fraction of the frames in a
+// histogram did not exceed.  No time above maxtime is returned, and the
+// slowest frame is always maxtime.
+//
+dtime_t Stat_Percentile(const unsigned int* histogram, unsigned int frames,
+						dtime_t maxtime, double fraction)
 {
-	return name.c_str();
+	const unsigned int rank = std::max(1u, (unsigned int)(frames * fraction + 0.5));
+	if (rank >= frames)
+		return maxtime;
+
+	unsigned int count = 0;
+	for (int i = 0; i < NUMHISTOGRAMBUCKETS; i++)
+	{
+		count += histogram[i];
+		if (count >= rank)
+			return std::min(Stat_HistogramValue(i), maxtime);
+	}
+	return maxtime;
 }
 
-void FStat::dumpstat()
+
+//
+// Stat_WriteTrace
+//
+static void Stat_WriteTrace()
 {
-	for(size_t i = 0; i < stats.size(); i++)
-		Printf(PRINT_HIGH, "%s\n", stats[i]->getname());
+	FILE* fp = fopen(trace_filename.c_str(), "w");
+	if (fp == NULL)
+	{
+		Printf(PRINT_HIGH, "Could not write profile trace to %s\n", trace_filename.c_str());
+		return;
+	}
+
+	fprintf(fp, "{\"traceEvents\":[\n");
+	for (size_t i = 0; i < trace_events.size(); i++)
+	{
+		const traceevent_t& event = trace_events[i];
+		fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f}\n",
+				i > 0 ? "," : "", event.name,
+				(event.start - trace_start) / 1e3, event.duration / 1e3);
+	}
+	fprintf(fp, "],\"displayTimeUnit\":\"ns\"}\n");
+	fclose(fp);
+
+	Printf(PRINT_HIGH, "Profile trace of %u zones written to %s%s\n",
+			(unsigned int)trace_events.size(), trace_filename.c_str(),
+			trace_events.size() >= MAXTRACEEVENTS ? " (trace is full)" : "");
 }
 
-void FStat::dumpstat(std::string which)
+
+//
+// Stat_EndFrame
+//
+// Adds the time spent in each zone this frame to its histogram.  Called
+// once per pass through the main loop.
+//
+void Stat_EndFrame()
 {
-	for(size_t i = 0; i < stats.size(); i++)
-		if(which == stats[i]->name)
-			stats[i]->dump();
+	if (profiling)
+	{
+		// a zone can only be left open here if an error skipped the end of
+		// a phase, so start over from the root
+		open_zones.clear();
+
+		for (size_t i = 1; i < nodes.size(); i++)
+		{
+			profilenode_t& node = nodes[i];
+			if (node.framecalls == 0)
+				continue;
+
+			node.frames++;
+			node.calls += node.framecalls;
+			node.totaltime += node.frametime;
+			node.maxtime = std::max(node.maxtime, node.frametime);
+			node.histogram[Stat_HistogramBucket(node.frametime)]++;
+
+			node.frametime = 0;
+			node.framecalls = 0;
+		}
+
+		if (tracing && --trace_frames <= 0)
+		{
+			Stat_WriteTrace();
+			trace_events.clear();
+			tracing = false;
+		}
+	}
+
+	if (profile_reset || nodes.empty())
+	{
+		Stat_ResetNodes();
+		profile_reset = false;
+	}
+
+	if (trace_pending)
+	{
+		trace_events.clear();
+		trace_start = I_GetTime();
+		tracing = true;
+		trace_pending = false;
+	}
+
+	profiling = profile_enabled || tracing;
 }
 
-void FStat::dump()
+
+//
+// Stat_PrintNode
+//
+// Prints a zone and the zones inside it.  If a name is given, only the
+// zones with that name and the zones inside them are printed.
+//
+static void Stat_PrintNode(int n, const char* name, bool print)
 {
-	Printf(PRINT_HIGH, "%s: %dms\n", name.c_str(), last_elapsed);
+	const profilenode_t& node = nodes[n];
+
+	if (node.zone && name && iequals(node.zone->name, name))
+		print = true;
+
+	if (node.zone && print && node.frames > 0)
+	{
+		const std::string label = std::string(node.depth * 2, ' ') + node.zone->name;
+
+		Printf(PRINT_HIGH, "%-32s %7u %7.1f %8.3f %8.3f %8.3f %8.3f\n",
+				label.c_str(), node.frames, (double)node.calls / node.frames,
+				node.totaltime / 1e6 / node.frames,
+				Stat_Percentile(node.histogram, node.frames, node.maxtime, 0.50) / 1e6,
+				Stat_Percentile(node.histogram, node.frames, node.maxtime, 0.99) / 1e6,
+				node.maxtime / 1e6);
+	}
+
+	for (size_t i = 0; i < node.children.size(); i++)
+		Stat_PrintNode(node.children[i], name, print);
 }
 
+
 BEGIN_COMMAND (stat)
 {
-	if (argc != 2)
+	if (argc >= 2 && stricmp(argv[1], "on") == 0)
+	{
+		profile_enabled = true;
+		Printf(PRINT_HIGH, "Profiler on\n");
+	}
+	else if (argc >= 2 && stricmp(argv[1], "off") == 0)
+	{
+		profile_enabled = false;
+		Printf(PRINT_HIGH, "Profiler off\n");
+	}
+	else if (argc >= 2 && stricmp(argv[1], "reset") == 0)
+	{
+		profile_reset = true;
+		Printf(PRINT_HIGH, "Profiler reset\n");
+	}
+	else if (argc >= 3 && stricmp(argv[1], "trace") == 0)
+	{
+		if (tracing || trace_pending)
+		{
+			Printf(PRINT_HIGH, "A profile trace is already being recorded\n");
+			return;
+		}
+
+		trace_filename = argv[2];
+		trace_frames = argc >= 4 ? std::max(1, atoi(argv[3])) : 350;
+		trace_pending = true;
+		Printf(PRINT_HIGH, "Recording a profile trace of %d frames\n", trace_frames);
+	}
+	else if (nodes.size() > 1)
 	{
-		Printf (PRINT_HIGH, "Usage: stat <statistics>\n");
-		FStat::dumpstat ();
+		Printf(PRINT_HIGH, "%-32s %7s %7s %8s %8s %8s %8s\n",
+				"zone", "frames", "calls", "mean ms", "p50 ms", "p99 ms", "max ms");
+		Stat_PrintNode(0, argc >= 2 ? argv[1] : NULL, argc < 2);
 	}
 	else
 	{
-		FStat::dumpstat (argv[1]);
+		Printf(PRINT_HIGH, "Usage: stat on|off|reset\n");
+		Printf(PRINT_HIGH, "       stat [zone]\n");
+		Printf(PRINT_HIGH, "       stat trace <filename> [frames]\n");
 	}
 }
 END_COMMAND (stat)
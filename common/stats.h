@@ -1,4 +1,4 @@
-// Emacs style mode select   -*- C++ -*- 
+// Emacs style mode select   -*- C++ -*-
 //-----------------------------------------------------------------------------
 //
 // $Id$
@@ -19,47 +19,83 @@
 // DESCRIPTION:
 //	STATS
 //
+//	Hierarchical profiler.  Code marked with PROFILE_ZONE is timed while
+//	profiling is turned on with the stat console command.  See stats.cpp.
+//
 //-----------------------------------------------------------------------------
 
 
 #ifndef __STATS_H__
 #define __STATS_H__
 
-#include <vector>
-#include <string>
-#include <algorithm>
+#include "doomtype.h"
 
-class FStat
+//
+// OProfileZone
+//
+// A named section of code that is timed by the profiler.  Zones are
+// statically initialized so that marking code costs nothing until the
+// profiler is turned on.
+//
+struct OProfileZone
 {
-public:
-	FStat (const char *cname);
+	const char*		name;
+};
 
-	virtual ~FStat ();
+extern bool profiling;
 
-	void clock();
-	void unclock();
-	void reset();
+void Stat_EnterZone(OProfileZone& zone);
+void Stat_LeaveZone();
+void Stat_EndFrame();
 
-	const char *getname();
+// Histogram buckets: times below 8ns each get a bucket, above that every
+// power of two is split into 8 buckets.  The last bucket holds everything
+// from about 18 minutes on.
+static const int HISTOGRAM_SUBBITS = 3;
+static const int HISTOGRAM_SUBBUCKETS = 1 << HISTOGRAM_SUBBITS;
+static const int NUMHISTOGRAMBUCKETS = (40 - HISTOGRAM_SUBBITS + 2) * HISTOGRAM_SUBBUCKETS;
 
-	static void dumpstat();
-	static void dumpstat(std::string which);
-	void dump();
+int Stat_HistogramBucket(dtime_t time);
+dtime_t Stat_HistogramValue(int bucket);
+dtime_t Stat_Percentile(const unsigned int* histogram, unsigned int frames,
+						dtime_t maxtime, double fraction);
 
-private:
+//
+// OProfileScope
+//
+// Times the zone for as long as the scope is alive.
+//
+class OProfileScope
+{
+public:
+	OProfileScope(OProfileZone& zone) : mActive(profiling)
+	{
+		if (mActive)
+			Stat_EnterZone(zone);
+	}
+
+	~OProfileScope()
+	{
+		if (mActive)
+			Stat_LeaveZone();
+	}
 
-	QWORD last_clock, last_elapsed;
-	std::string name;
-	static std::vector<FStat*> stats;
+private:
+	bool mActive;
 };
 
-#define BEGIN_STAT(n) \
-	static class Stat_##n : public FStat { \
-		public: \
-			Stat_##n () : FStat (#n) {} \
-} Stat_var_##n; Stat_var_##n.clock();
+#define PROFILE_CONCAT2(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT2(a, b)
 
-#define END_STAT(n) Stat_var_##n.unclock();
+//
+// PROFILE_ZONE
+//
+// Times the rest of the enclosing block as a zone with the given name.
+// Zones only run on the main thread.
+//
+#define PROFILE_ZONE(name) \
+	static OProfileZone PROFILE_CONCAT(profile_zone_, __LINE__) = { name }; \
+	OProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(PROFILE_CONCAT(profile_zone_, __LINE__))
 
 #endif //__STATS_H__
 
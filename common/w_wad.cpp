@@ -36,7 +36,16 @@
 #define strcmpi	strcasecmp
 #endif
 
+#if defined(_WIN32) && !defined(_XBOX)
+#include "win32inc.h"
+#define ODA_MAP_WADS
+#elif defined(UNIX) && !defined(GEKKO)
+#include <sys/mman.h>
+#define ODA_MAP_WADS
+#endif
+
 #include <fcntl.h>
+#include <sys/stat.h>
 
 #include "doomtype.h"
 #include "m_swap.h"
@@ -52,6 +61,7 @@
 #include <sstream>
 #include <algorithm>
 #include <vector>
+#include <map>
 #include <iomanip>
 
 
@@ -67,6 +77,19 @@ void**			lumpcache;
 
 static unsigned	stdisk_lumpnum;
 
+// WAD files are mapped into memory when possible, so that reading a
+// lump is a memory copy instead of a seek and a read, and so that read-only
+// lumps can be used in place through W_MapLumpNum.  The pages are shared
+// with any other process that has the same file open.
+struct wadmapping_t
+{
+	FILE		*handle;
+	byte		*data;
+	size_t		size;
+};
+
+static std::vector<wadmapping_t> wadmappings;
+
 //
 // W_LumpNameHash
 //
@@ -133,7 +156,7 @@ void uppercopy (char *to, const char *from)
 
 
 // denis - Standard MD5SUM
-std::string W_MD5(std::string filename)
+static std::string W_HashFile(const std::string &filename)
 {
 	const int file_chunk_size = 8192;
 	FILE *fp = fopen(filename.c_str(), "rb");
@@ -164,6 +187,227 @@ std::string W_MD5(std::string filename)
 }
 
 
+//
+// MD5 cache
+//
+// Hashing a large WAD takes a noticeable amount of time and the same files
+// are hashed many times over (identifying IWADs, searching directories,
+// loading and downloading), so hashes are remembered by path along with the
+// file's size, modification time and inode.  The cache is kept in memory
+// for the lifetime of the process and in a file in the user's directory
+// across restarts.  A hash is only reused if none of the file's details
+// have changed.
+//
+// Each line of the cache file is "hash size mtime inode path".  New hashes
+// are appended, so later lines replace earlier ones for the same path.
+//
+
+static const char *MD5_CACHE_FILENAME = "wadhashes.txt";
+
+struct md5cache_entry_t
+{
+	QWORD		size;
+	QWORD		mtime;
+	QWORD		inode;
+	std::string	hash;
+
+	bool matches(const md5cache_entry_t &other) const
+	{
+		return size == other.size && mtime == other.mtime && inode == other.inode;
+	}
+};
+
+typedef std::map<std::string, md5cache_entry_t> MD5Cache;
+static MD5Cache md5cache;
+static bool md5cache_loaded = false;
+
+//
+// W_GetFileStamp
+//
+// Fills in everything but the hash.  Returns false if the file does not
+// exist.
+//
+static bool W_GetFileStamp(const std::string &filename, md5cache_entry_t &entry)
+{
+	struct stat info;
+	if (stat(filename.c_str(), &info) == -1)
+		return false;
+
+	entry.size = info.st_size;
+	entry.mtime = info.st_mtime;
+	entry.inode = info.st_ino;		// always 0 on Windows
+
+	return true;
+}
+
+//
+// W_WriteMD5CacheEntry
+//
+static void W_WriteMD5CacheEntry(FILE *fp, const std::string &filename, const md5cache_entry_t &entry)
+{
+	std::stringstream line;
+	line << entry.hash << ' ' << entry.size << ' ' << entry.mtime << ' '
+	     << entry.inode << ' ' << filename << '\n';
+
+	fputs(line.str().c_str(), fp);
+}
+
+//
+// W_LoadMD5Cache
+//
+static void W_LoadMD5Cache()
+{
+	md5cache_loaded = true;
+
+	std::string cachefile = I_GetUserFileName(MD5_CACHE_FILENAME);
+	FILE *fp = fopen(cachefile.c_str(), "r");
+	if (!fp)
+		return;
+
+	size_t lines = 0;
+	char buf[4096];
+
+	while (fgets(buf, sizeof(buf), fp))
+	{
+		std::string filename;
+		md5cache_entry_t entry;
+
+		std::istringstream line(buf);
+		if (!(line >> entry.hash >> entry.size >> entry.mtime >> entry.inode))
+			continue;
+
+		line.get();		// the separating space
+		std::getline(line, filename);
+
+		if (entry.hash.length() != 32 || filename.empty())
+			continue;
+
+		md5cache[filename] = entry;
+		lines++;
+	}
+
+	fclose(fp);
+
+	// Rewrite the file once it is mostly out of date entries
+	if (lines > md5cache.size() * 2 + 16)
+	{
+		fp = fopen(cachefile.c_str(), "w");
+		if (!fp)
+			return;
+
+		for (MD5Cache::const_iterator it = md5cache.begin(); it != md5cache.end(); ++it)
+			W_WriteMD5CacheEntry(fp, it->first, it->second);
+
+		fclose(fp);
+	}
+}
+
+//
+// W_MD5
+//
+// Returns the MD5 hash of a file as an upper-case hex string, or an empty
+// string if the file can not be read.
+//
+std::string W_MD5(std::string filename)
+{
+	md5cache_entry_t entry;
+	if (!W_GetFileStamp(filename, entry))
+		return "";
+
+	if (!md5cache_loaded)
+		W_LoadMD5Cache();
+
+	MD5Cache::const_iterator it = md5cache.find(filename);
+	if (it != md5cache.end() && it->second.matches(entry))
+		return it->second.hash;
+
+	entry.hash = W_HashFile(filename);
+	if (entry.hash.empty())
+		return "";
+
+	md5cache[filename] = entry;
+
+	FILE *fp = fopen(I_GetUserFileName(MD5_CACHE_FILENAME).c_str(), "a");
+	if (fp)
+	{
+		W_WriteMD5CacheEntry(fp, filename, entry);
+		fclose(fp);
+	}
+
+	return entry.hash;
+}
+
+
+//
+// W_MapFile
+//
+// Maps an open file into memory.  Returns NULL if the file can not be
+// mapped, in which case lumps are read from it as normal.
+//
+static const byte* W_MapFile(FILE *handle)
+{
+#ifdef ODA_MAP_WADS
+	if (Args.CheckParm("-nommap"))
+		return NULL;
+
+	long size = M_FileLength(handle);
+	if (size <= 0)
+		return NULL;
+
+	byte *data = NULL;
+
+	#ifdef _WIN32
+	HANDLE file = (HANDLE)_get_osfhandle(_fileno(handle));
+	HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping == NULL)
+		return NULL;
+
+	// the view keeps the mapping object alive
+	data = (byte *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+
+	if (data == NULL)
+		return NULL;
+	#else
+	void *ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fileno(handle), 0);
+	if (ptr == MAP_FAILED)
+		return NULL;
+
+	data = (byte *)ptr;
+	#endif
+
+	wadmapping_t wm;
+	wm.handle = handle;
+	wm.data = data;
+	wm.size = size;
+	wadmappings.push_back(wm);
+
+	return data;
+#else
+	return NULL;
+#endif
+}
+
+//
+// W_UnmapFiles
+//
+static void W_UnmapFiles()
+{
+#ifdef ODA_MAP_WADS
+	for (size_t i = 0; i < wadmappings.size(); i++)
+	{
+		#ifdef _WIN32
+		UnmapViewOfFile(wadmappings[i].data);
+		#else
+		munmap(wadmappings[i].data, wadmappings[i].size);
+		#endif
+	}
+#endif
+
+	wadmappings.clear();
+}
+
+
 //
 // LUMP BASED ROUTINES.
 //
@@ -176,6 +420,9 @@ std::string W_MD5(std::string filename)
 //
 void W_AddLumps(FILE* handle, filelump_t* fileinfo, size_t newlumps, bool clientonly)
 {
+	const byte *mapping = W_MapFile(handle);
+	size_t mapsize = mapping ? wadmappings.back().size : 0;
+
 	lumpinfo = (lumpinfo_t*)Realloc(lumpinfo, (numlumps + newlumps) * sizeof(lumpinfo_t));
 	if (!lumpinfo)
 		I_Error("Couldn't realloc lumpinfo");
@@ -188,6 +435,14 @@ void W_AddLumps(FILE* handle, filelump_t* fileinfo, size_t newlumps, bool client
 		lump->handle = handle;
 		lump->position = info->filepos;
 		lump->size = info->size;
+
+		// lumps that claim to extend past the end of the file are read
+		// the old way, so that W_ReadLump reports the error
+		if (mapping && info->filepos >= 0 && info->size >= 0 &&
+			(size_t)info->filepos + (size_t)info->size <= mapsize)
+			lump->mapping = mapping;
+		else
+			lump->mapping = NULL;
 		strncpy(lump->name, info->name, 8);
 
 		lump++;
@@ -368,6 +623,7 @@ void W_MergeLumps (const char *start, const char *end, int space)
 					newlumps++;
 					strncpy (newlumpinfos[0].name, ustart, 8);
 					newlumpinfos[0].handle = NULL;
+					newlumpinfos[0].mapping = NULL;
 					newlumpinfos[0].position =
 						newlumpinfos[0].size = 0;
 					newlumpinfos[0].namespc = ns_global;
@@ -436,6 +692,7 @@ void W_MergeLumps (const char *start, const char *end, int space)
 
 		strncpy (lumpinfo[numlumps].name, uend, 8);
 		lumpinfo[numlumps].handle = NULL;
+		lumpinfo[numlumps].mapping = NULL;
 		lumpinfo[numlumps].position =
 			lumpinfo[numlumps].size = 0;
 		lumpinfo[numlumps].namespc = ns_global;
@@ -603,40 +860,23 @@ void W_ReadLump(unsigned int lump, void* dest)
 	if (lump != stdisk_lumpnum)
     	I_BeginRead();
 
-	fseek (l->handle, l->position, SEEK_SET);
-	c = fread (dest, l->size, 1, l->handle);
-
-	if (feof(l->handle))
-		I_Error ("W_ReadLump: only read %i of %i on lump %i", c, l->size, lump);
-
-	if (lump != stdisk_lumpnum)
-    	I_EndRead();
-}
-
-//
-// W_ReadChunk
-//
-// denis - for wad downloading
-//
-unsigned W_ReadChunk (const char *file, unsigned offs, unsigned len, void *dest, unsigned &filelen)
-{
-	FILE *fp = fopen(file, "rb");
-	unsigned read = 0;
-
-	if(fp)
+	if (l->mapping)
 	{
-		filelen = M_FileLength(fp);
+		memcpy(dest, l->mapping + l->position, l->size);
+	}
+	else
+	{
+		fseek (l->handle, l->position, SEEK_SET);
+		c = fread (dest, l->size, 1, l->handle);
 
-		fseek(fp, offs, SEEK_SET);
-		read = fread(dest, 1, len, fp);
-		fclose(fp);
+		if (feof(l->handle))
+			I_Error ("W_ReadLump: only read %i of %i on lump %i", c, l->size, lump);
 	}
-	else filelen = 0;
 
-	return read;
+	if (lump != stdisk_lumpnum)
+    	I_EndRead();
 }
 
-
 //
 // W_CheckLumpName
 //
@@ -694,6 +934,49 @@ void* W_CacheLumpNum(unsigned int lump, int tag)
 	return lumpcache[lump];
 }
 
+//
+// W_MapLumpNum
+//
+// Returns a read-only pointer to a lump's data.  If the lump's file is
+// mapped into memory, this points straight into the mapping and nothing is
+// copied.  Otherwise the lump is cached as with W_CacheLumpNum.  Either
+// way, W_ReleaseLumpNum must be called once the data is no longer needed.
+//
+// Unlike W_CacheLumpNum, the data is not followed by a terminating zero.
+//
+const void* W_MapLumpNum(unsigned int lump)
+{
+	if (lump >= numlumps)
+		I_Error ("W_MapLumpNum: %i >= numlumps", lump);
+
+	const lumpinfo_t *l = lumpinfo + lump;
+
+	// Callers expect the lump's structures to be suitably aligned.
+	if (l->mapping && (l->position & 3) == 0)
+		return l->mapping + l->position;
+
+	return W_CacheLumpNum(lump, PU_STATIC);
+}
+
+//
+// W_ReleaseLumpNum
+//
+// Releases a lump returned by W_MapLumpNum.
+//
+void W_ReleaseLumpNum(unsigned int lump)
+{
+	if (lump >= numlumps)
+		return;
+
+	const lumpinfo_t *l = lumpinfo + lump;
+
+	if (l->mapping && (l->position & 3) == 0)
+		return;
+
+	if (lumpcache[lump])
+		Z_ChangeTag(lumpcache[lump], PU_CACHE);
+}
+
 //
 // W_CacheLumpName
 //
@@ -810,6 +1093,8 @@ void W_Close ()
 		}
 		lump_p++;
 	}
+
+	W_UnmapFiles();
 }
 
 VERSION_CONTROL (w_wad_cpp, "$Id$")
@@ -67,6 +67,7 @@ typedef struct lumpinfo_s
 {
 	char		name[8]; // denis - todo - string
 	FILE		*handle;
+	const byte	*mapping;	// start of the mapped file, or NULL
 	int			position;
 	int			size;
 
@@ -97,7 +98,9 @@ int		W_GetNumForName (const char *name, int ns = ns_global);
 
 unsigned	W_LumpLength (unsigned lump);
 void		W_ReadLump (unsigned lump, void *dest);
-unsigned	W_ReadChunk (const char *file, unsigned offs, unsigned len, void *dest, unsigned &filelen);
+
+const void *W_MapLumpNum (unsigned lump);
+void W_ReleaseLumpNum (unsigned lump);
 
 void *W_CacheLumpNum (unsigned lump, int tag);
 void *W_CacheLumpName (const char *name, int tag);
@@ -118,9 +118,20 @@ static FauxZone faux_zone;
 //
 // It is of no value to free a cachable block,
 //  because it will get overwritten automatically if needed.
-// 
+//
+// Small blocks with a level tag are not taken from the block list directly.
+// Instead each of those tags has its own arenas, which are large blocks
+// carved up into size classes with a free list for each class.  This keeps
+// thinkers and other short-lived level data from fragmenting the zone and
+// lets Z_FreeTags release a whole tag an arena at a time.
+//
+// Every block that has to be freed individually by Z_FreeTags is kept on a
+// list for its tag.  Arena blocks are only put on it if they have an owner
+// that needs to be cleared or their tag differs from their arena's.
+//
 
 #define ZONEID	0x1d4a11
+#define ARENAID	0x1d4a12
 
 typedef struct
 {
@@ -134,9 +145,89 @@ typedef struct
 	
 } memzone_t;
 
+typedef struct memarena_s
+{
+	struct memarena_s*	next;
+	struct memarena_s*	prev;
+	int					tag;
+	size_t				size;		// bytes available for blocks
+	size_t				used;		// bytes handed out so far
+	size_t				live;		// blocks currently allocated
+	size_t				livebytes;
+	size_t				pinned;		// live blocks whose tag has changed
+	size_t				pinnedbytes;
+	bool				orphaned;	// its tag has been freed
+} memarena_t;
+
+#define MAXZONETAGS		256
+#define ARENA_SIZE		(64*1024)
+#define ARENA_GRAIN		16
+#define ARENA_MAXBLOCK	1024		// largest request served from an arena
+#define ARENA_CLASSES	(ARENA_MAXBLOCK / ARENA_GRAIN + 1)
+
+typedef struct
+{
+	memblock_t	blocks;						// blocks freed one at a time
+	memarena_t*	arenas;						// the first has room left
+	memblock_t*	freelist[ARENA_CLASSES];
+} zonetag_t;
+
 static memzone_t* mainzone;
 static size_t zonesize;
 
+static zonetag_t zonetags[MAXZONETAGS];
+static memarena_t* orphanarenas;
+static void (*purgecallback)(void) = NULL;
+
+static inline bool Z_UsesArena(int tag)
+{
+	return tag >= PU_LEVEL && tag < PU_PURGELEVEL;
+}
+
+static inline size_t Z_ArenaHeaderSize()
+{
+	return (sizeof(memarena_t) + ARENA_GRAIN - 1) & ~(ARENA_GRAIN - 1);
+}
+
+//
+// Z_LinkTag / Z_UnlinkTag
+//
+// Adds or removes a block from the list of blocks for its tag.
+//
+static void Z_LinkTag(memblock_t* block)
+{
+	memblock_t* head = &zonetags[block->tag].blocks;
+
+	block->tagprev = head;
+	block->tagnext = head->tagnext;
+	head->tagnext->tagprev = block;
+	head->tagnext = block;
+}
+
+static void Z_UnlinkTag(memblock_t* block)
+{
+	if (block->tagnext == NULL)
+		return;
+
+	block->tagprev->tagnext = block->tagnext;
+	block->tagnext->tagprev = block->tagprev;
+	block->tagnext = block->tagprev = NULL;
+}
+
+static inline bool Z_IsForeign(const memblock_t* block)
+{
+	return block->arena->orphaned || block->tag != block->arena->tag;
+}
+
+static void Z_CheckTag(int tag, const char* func, const char* file, int line)
+{
+	if (tag == PU_FREE)
+		I_FatalError("%s: cannot use the tag PU_FREE at %s:%i", func, file, line);
+
+	if (tag < 0 || tag >= MAXZONETAGS)
+		I_FatalError("%s: invalid tag %i at %s:%i", func, tag, file, line);
+}
+
 //
 // Z_Close
 //
@@ -175,37 +266,36 @@ void Z_Init(bool _use_zone)
 	
 	block->tag = PU_FREE;
 	block->user = NULL;
+	block->tagnext = block->tagprev = NULL;
+	block->arena = NULL;
 	
 	block->size = mainzone->size - sizeof(memzone_t);
-}
-
 
-//
-// Z_Free2
-//
-void Z_Free2(void* ptr, const char* file, int line)
-{
-	if (!use_zone)
+	// forget every arena and tag list
+	for (int i = 0; i < MAXZONETAGS; i++)
 	{
-		faux_zone.free(ptr);
-		return;
+		zonetag_t* zt = &zonetags[i];
+		zt->blocks.tagnext = zt->blocks.tagprev = &zt->blocks;
+		zt->arenas = NULL;
+		memset(zt->freelist, 0, sizeof(zt->freelist));
 	}
 
-	if (ptr == NULL)
-		return;
-
-	#ifdef ODAMEX_DEBUG
-	Z_CheckHeap();
-	#endif
-
-	memblock_t* block = (memblock_t*)((byte*)ptr - sizeof(memblock_t));
+	orphanarenas = NULL;
+}
 
-	if (block->id != ZONEID)
-		I_FatalError("Z_Free: freed a pointer without ZONEID at %s:%i", file, line);
 
+//
+// Z_HeapFree
+//
+// Returns a block to the zone's block list.
+//
+static void Z_HeapFree(memblock_t* block)
+{
 	if (block->user != NULL)
 		*block->user = NULL;	// clear the user's mark
 
+	Z_UnlinkTag(block);
+
 	// mark as free
 	block->tag = PU_FREE;
 	block->user = NULL; 
@@ -236,34 +326,137 @@ void Z_Free2(void* ptr, const char* file, int line)
 		if (other == mainzone->rover)
 			mainzone->rover = block;
 	}
+}
 
-	#ifdef ODAMEX_DEBUG
-	Z_CheckHeap();
-	#endif
+
+//
+// Z_ReleaseArena
+//
+// Gives an arena's memory back to the zone.  Any blocks still in it are
+// lost without clearing their owners.
+//
+static void Z_ReleaseArena(memarena_t* arena)
+{
+	if (arena->next)
+		arena->next->prev = arena->prev;
+
+	if (arena->prev)
+		arena->prev->next = arena->next;
+	else if (arena->orphaned)
+		orphanarenas = arena->next;
+	else
+		zonetags[arena->tag].arenas = arena->next;
+
+	Z_HeapFree((memblock_t*)((byte*)arena - sizeof(memblock_t)));
 }
 
 
 //
-// Z_Malloc
-// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+// Z_ArenaFree
 //
-#define MINFRAGMENT	64
-#define ALIGN		8
+// Puts a block back on its arena's free list.
+//
+static void Z_ArenaFree(memblock_t* block)
+{
+	if (block->user != NULL)
+		*block->user = NULL;	// clear the user's mark
 
-void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
+	Z_UnlinkTag(block);
+
+	memarena_t* arena = block->arena;
+	bool foreign = Z_IsForeign(block);
+
+	arena->live--;
+	arena->livebytes -= block->size;
+
+	block->tag = PU_FREE;
+	block->user = NULL;
+	block->id = 0;
+
+	if (foreign)
+	{
+		arena->pinned--;
+		arena->pinnedbytes -= block->size;
+
+		if (arena->orphaned)
+		{
+			if (arena->pinned == 0)
+				Z_ReleaseArena(arena);
+			return;
+		}
+	}
+
+	size_t cls = (block->size - sizeof(memblock_t)) / ARENA_GRAIN;
+	memblock_t** freelist = &zonetags[arena->tag].freelist[cls];
+
+	block->next = *freelist;
+	*freelist = block;
+}
+
+
+//
+// Z_Free2
+//
+void Z_Free2(void* ptr, const char* file, int line)
 {
 	if (!use_zone)
 	{
-		return faux_zone.alloc(size, tag, user);
+		faux_zone.free(ptr);
+		return;
 	}
 
+	if (ptr == NULL)
+		return;
+
 	#ifdef ODAMEX_DEBUG
 	Z_CheckHeap();
 	#endif
 
-	if (tag == PU_FREE)
-		I_FatalError("Z_Malloc: cannot allocate a block with tag PU_FREE at %s:%i", file, line);
+	memblock_t* block = (memblock_t*)((byte*)ptr - sizeof(memblock_t));
+
+	if (block->id != ZONEID)
+		I_FatalError("Z_Free: freed a pointer without ZONEID at %s:%i", file, line);
+
+	if (block->arena)
+		Z_ArenaFree(block);
+	else
+		Z_HeapFree(block);
+
+	#ifdef ODAMEX_DEBUG
+	Z_CheckHeap();
+	#endif
+}
+
+
+//
+// Z_SetPurgeCallback
+//
+// Sets a function to be called before a purgable block is freed to make
+// room for a new one.  Pass NULL to remove it.
+//
+void Z_SetPurgeCallback(void (*func)(void))
+{
+	purgecallback = func;
+}
+
 
+//
+// Z_HeapAlloc
+//
+// Takes a block from the zone's block list, purging cachable blocks as
+// needed.
+//
+#define MINFRAGMENT	64
+#define ALIGN		8
+
+// Block data starts straight after the header, so the header has to keep
+// the alignment that block sizes are rounded to.
+typedef char memblock_align_check[sizeof(memblock_t) % ALIGN == 0 ? 1 : -1];
+typedef char memzone_align_check[sizeof(memzone_t) % ALIGN == 0 ? 1 : -1];
+
+static memblock_t* Z_HeapAlloc(size_t size, int tag, void* user, int id,
+							   const char* file, int line)
+{
 	size = (size + ALIGN - 1) & ~(ALIGN - 1);
 
     // scan through the block list,
@@ -301,11 +494,15 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 			}
 			else
 			{
+				// let anything still using cached data finish with it
+				if (purgecallback)
+					purgecallback();
+
 				// free the rover block (adding the size to base)
 				
 				// the rover can be the base block
 				base = base->prev;
-				Z_Free((byte*)rover+sizeof(memblock_t));
+				Z_HeapFree(rover);
 				base = base->next;
 				rover = base->next;
 			}
@@ -325,6 +522,8 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 		
 		newblock->tag = PU_FREE;
 		newblock->user = NULL;	
+		newblock->tagnext = newblock->tagprev = NULL;
+		newblock->arena = NULL;
 		newblock->prev = base;
 		newblock->next = base->next;
 		newblock->next->prev = newblock;
@@ -335,23 +534,125 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 		
 	base->tag = tag;
 	base->user = (void**)user;
-	base->id = ZONEID;
+	base->id = id;
+	base->arena = NULL;
+	base->tagnext = base->tagprev = NULL;
 
-	if (user)
-		*(void**)user = (void*)((byte*)base + sizeof(memblock_t));
-	else
-		if (tag >= PU_PURGELEVEL)
-			I_FatalError("Z_Malloc: an owner is required for purgable blocks at %s:%i", file, line);
+	// arenas are released by Z_FreeTags on their own
+	if (id == ZONEID)
+		Z_LinkTag(base);
 
 	// next allocation will start looking here
 	mainzone->rover = base->next;
 
+	return base;
+}
+
+
+//
+// Z_ArenaAlloc
+//
+// Takes a block from the free list for its size class, or from the end of
+// the tag's current arena.
+//
+static memblock_t* Z_ArenaAlloc(size_t size, int tag, void* user,
+								const char* file, int line)
+{
+	zonetag_t* zt = &zonetags[tag];
+
+	size_t cls = (size + ARENA_GRAIN - 1) / ARENA_GRAIN;
+	if (cls == 0)
+		cls = 1;
+
+	size_t blocksize = sizeof(memblock_t) + cls * ARENA_GRAIN;
+
+	memblock_t* block = zt->freelist[cls];
+	if (block)
+	{
+		zt->freelist[cls] = block->next;
+	}
+	else
+	{
+		memarena_t* arena = zt->arenas;
+		if (arena == NULL || arena->size - arena->used < blocksize)
+		{
+			memblock_t* base = Z_HeapAlloc(Z_ArenaHeaderSize() + ARENA_SIZE,
+										   tag, NULL, ARENAID, file, line);
+
+			arena = (memarena_t*)((byte*)base + sizeof(memblock_t));
+			arena->tag = tag;
+			arena->size = ARENA_SIZE;
+			arena->used = 0;
+			arena->live = arena->livebytes = 0;
+			arena->pinned = arena->pinnedbytes = 0;
+			arena->orphaned = false;
+
+			arena->prev = NULL;
+			arena->next = zt->arenas;
+			if (arena->next)
+				arena->next->prev = arena;
+			zt->arenas = arena;
+		}
+
+		block = (memblock_t*)((byte*)arena + Z_ArenaHeaderSize() + arena->used);
+		arena->used += blocksize;
+
+		block->size = blocksize;
+		block->arena = arena;
+	}
+
+	block->tag = tag;
+	block->user = (void**)user;
+	block->id = ZONEID;
+	block->next = block->prev = NULL;
+	block->tagnext = block->tagprev = NULL;
+
+	block->arena->live++;
+	block->arena->livebytes += blocksize;
+
+	if (user)
+		Z_LinkTag(block);
+
+	return block;
+}
+
+
+//
+// Z_Malloc
+// You can pass a NULL user if the tag is < PU_PURGELEVEL.
+//
+void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
+{
+	if (!use_zone)
+	{
+		return faux_zone.alloc(size, tag, user);
+	}
 
 	#ifdef ODAMEX_DEBUG
 	Z_CheckHeap();
 	#endif
 
-	return (void*)((byte*)base + sizeof(memblock_t));
+	Z_CheckTag(tag, "Z_Malloc", file, line);
+
+	if (!user && tag >= PU_PURGELEVEL)
+		I_FatalError("Z_Malloc: an owner is required for purgable blocks at %s:%i", file, line);
+
+	memblock_t* block;
+	if (Z_UsesArena(tag) && size <= ARENA_MAXBLOCK)
+		block = Z_ArenaAlloc(size, tag, user, file, line);
+	else
+		block = Z_HeapAlloc(size, tag, user, ZONEID, file, line);
+
+	void* ptr = (void*)((byte*)block + sizeof(memblock_t));
+
+	if (user)
+		*(void**)user = ptr;
+
+	#ifdef ODAMEX_DEBUG
+	Z_CheckHeap();
+	#endif
+
+	return ptr;
 }
 
 
@@ -359,6 +660,10 @@ void* Z_Malloc2(size_t size, int tag, void* user, const char* file, int line)
 //
 // Z_FreeTags
 //
+// Blocks on the tag lists are freed one at a time, while the rest of the
+// blocks in the tags' arenas go with their arenas.  An arena that still
+// holds blocks whose tag was changed is kept until those are freed.
+//
 void Z_FreeTags(int lowtag, int hightag)
 {
 	if (!use_zone)
@@ -368,20 +673,49 @@ void Z_FreeTags(int lowtag, int hightag)
 	Z_CheckHeap();
 	#endif
 
-	memblock_t* block;
-	memblock_t* next;
+	if (lowtag < 0)
+		lowtag = 0;
+	if (hightag >= MAXZONETAGS)
+		hightag = MAXZONETAGS - 1;
 
-	for (block = mainzone->blocklist.next; block != &mainzone->blocklist; block = next)
+	for (int tag = lowtag; tag <= hightag; tag++)
 	{
-		// get link before freeing
-		next = block->next;
+		memblock_t* head = &zonetags[tag].blocks;
 
-		// free block?
-		if (block->tag == PU_FREE)
-			continue;
-	    
-		if (block->tag >= lowtag && block->tag <= hightag)
-			Z_Free((byte*)block+sizeof(memblock_t));
+		while (head->tagnext != head)
+			Z_Free((byte*)head->tagnext + sizeof(memblock_t));
+	}
+
+	for (int tag = lowtag; tag <= hightag; tag++)
+	{
+		zonetag_t* zt = &zonetags[tag];
+
+		while (zt->arenas)
+		{
+			memarena_t* arena = zt->arenas;
+
+			if (arena->pinned == 0)
+			{
+				Z_ReleaseArena(arena);
+				continue;
+			}
+
+			// move the arena to the orphan list
+			zt->arenas = arena->next;
+			if (zt->arenas)
+				zt->arenas->prev = NULL;
+
+			arena->orphaned = true;
+			arena->live = arena->pinned;
+			arena->livebytes = arena->pinnedbytes;
+			arena->prev = NULL;
+			arena->next = orphanarenas;
+			if (orphanarenas)
+				orphanarenas->prev = arena;
+			orphanarenas = arena;
+		}
+
+		memset(zt->freelist, 0, sizeof(zt->freelist));
 	}
 
 	#ifdef ODAMEX_DEBUG
@@ -430,10 +764,45 @@ void Z_ChangeTag2(void* ptr, int tag, const char* file, int line)
 	if (tag == PU_FREE)
 		I_Error("Z_ChangeTag: cannot change a tag to PU_FREE");
 
-    if (tag >= PU_PURGELEVEL && block->user == NULL)
-        I_Error("Z_ChangeTag: an owner is required for purgable blocks");
+	if (tag < 0 || tag >= MAXZONETAGS)
+		I_Error("Z_ChangeTag: invalid tag %i at %s:%i", tag, file, line);
+
+	if (tag >= PU_PURGELEVEL && block->user == NULL)
+		I_Error("Z_ChangeTag: an owner is required for purgable blocks");
+
+	if (tag == block->tag)
+		return;
+
+	Z_UnlinkTag(block);
+
+	if (block->arena)
+	{
+		// The block can't leave its arena, so it pins the arena until it
+		// is freed if it no longer shares the arena's tag.  Purgable
+		// blocks in an arena are only freed with their tag.
+		bool wasforeign = Z_IsForeign(block);
+		block->tag = tag;
+		bool isforeign = Z_IsForeign(block);
+
+		if (isforeign && !wasforeign)
+		{
+			block->arena->pinned++;
+			block->arena->pinnedbytes += block->size;
+		}
+		else if (wasforeign && !isforeign)
+		{
+			block->arena->pinned--;
+			block->arena->pinnedbytes -= block->size;
+		}
 
-    block->tag = tag;
+		if (block->user || isforeign)
+			Z_LinkTag(block);
+	}
+	else
+	{
+		block->tag = tag;
+		Z_LinkTag(block);
+	}
 }
 
 
@@ -456,6 +825,13 @@ void Z_ChangeOwner2(void* ptr, void* user, const char* file, int line)
 
 	if (block->user)
 		*block->user = (void*)((byte*)block + sizeof(memblock_t));
+
+	if (block->arena)
+	{
+		Z_UnlinkTag(block);
+		if (block->user || Z_IsForeign(block))
+			Z_LinkTag(block);
+	}
 }
 
 //
@@ -520,6 +896,48 @@ size_t Z_FreeMemory()
 	return pfree + efree;
 }
 
+//
+// Z_GetStats
+//
+void Z_GetStats(zonestats_t& stats)
+{
+	Z_FreeMemory();
+
+	stats.blocks = numblocks;
+	stats.freeblocks = usedeblocks;
+	stats.freebytes = efree;
+	stats.largestfree = largestefree;
+}
+
+//
+// Z_ArenaStats
+//
+// Totals up a list of arenas.
+//
+struct arenastats_t
+{
+	size_t arenas, blocks, used, capacity;
+	arenastats_t() : arenas(0), blocks(0), used(0), capacity(0) { }
+};
+
+static void Z_ArenaStats(const memarena_t* arena, arenastats_t& stats)
+{
+	for (; arena != NULL; arena = arena->next)
+	{
+		stats.arenas++;
+		stats.blocks += arena->live;
+		stats.used += arena->livebytes;
+		stats.capacity += arena->size;
+	}
+}
+
+static void Z_PrintArenaStats(const char* name, const arenastats_t& stats)
+{
+	Printf(PRINT_HIGH, "%-9s %4" PRIuSIZE " arenas  %6" PRIuSIZE " blocks  %9" PRIuSIZE
+	       " of %9" PRIuSIZE " bytes used\n", name, stats.arenas, stats.blocks,
+	       stats.used, stats.capacity);
+}
+
 //
 // Z_DumpHeap
 // Note: TFileDumpHeap( stdout ) ?
@@ -547,7 +965,9 @@ void Z_DumpHeap(int lowtag, int hightag)
 			sprintf(user, "%p", block->user);
 
 		char tag[30];
-		if (block->tag == PU_FREE)
+		if (block->id == ARENAID)
+			sprintf(tag, "ARENA %i", block->tag);
+		else if (block->tag == PU_FREE)
 			sprintf(tag, "FREE");
 		else if (block->tag == PU_STATIC)
 			sprintf(tag, "STATIC");
@@ -583,6 +1003,27 @@ void Z_DumpHeap(int lowtag, int hightag)
 		if (block->tag == PU_FREE && block->next->tag == PU_FREE)
 			Printf(PRINT_HIGH, "ERROR: two consecutive free blocks\n");
     }
+
+	// blocks carved from arenas are summarized for each tag
+	for (int i = 0; i < MAXZONETAGS; i++)
+	{
+		if (i < lowtag || i > hightag || zonetags[i].arenas == NULL)
+			continue;
+
+		char name[16];
+		sprintf(name, "tag %i:", i);
+
+		arenastats_t stats;
+		Z_ArenaStats(zonetags[i].arenas, stats);
+		Z_PrintArenaStats(name, stats);
+	}
+
+	if (orphanarenas)
+	{
+		arenastats_t stats;
+		Z_ArenaStats(orphanarenas, stats);
+		Z_PrintArenaStats("orphaned:", stats);
+	}
 }
 
 
@@ -617,6 +1058,16 @@ BEGIN_COMMAND (mem)
 	       largestpfree, usedlblocks, lsize, largestlsize, usedeblocks, efree,
 	       largestefree, usedpblocks + usedeblocks, pfree + efree,
 	       largestpfree > largestefree ? largestpfree : largestefree);
+
+	if (!use_zone)
+		return;
+
+	arenastats_t stats;
+	for (int i = 0; i < MAXZONETAGS; i++)
+		Z_ArenaStats(zonetags[i].arenas, stats);
+	Z_ArenaStats(orphanarenas, stats);
+
+	Z_PrintArenaStats("arenas:", stats);
 }
 END_COMMAND (mem)
 
@@ -52,12 +52,28 @@ void	Z_DumpHeap (int lowtag, int hightag);
 void	Z_CheckHeap (void);
 size_t 	Z_FreeMemory (void);
 
+// Block counts and sizes of the zone, as the mem command shows them
+struct zonestats_t
+{
+	size_t	blocks;			// every block, free or not
+	size_t	freeblocks;
+	size_t	freebytes;
+	size_t	largestfree;
+};
+
+void	Z_GetStats (zonestats_t &stats);
+
+// Called before a purgable block is thrown out to make room for another.
+void	Z_SetPurgeCallback (void (*func)(void));
+
 // Don't use these, use the macros instead!
 void*   Z_Malloc2 (size_t size, int tag, void *user, const char *file, int line);
 void    Z_Free2 (void *ptr, const char *file, int line);
 void	Z_ChangeTag2 (void *ptr, int tag, const char* file, int line);
 void	Z_ChangeOwner2 (void *ptr, void* user, const char* file, int line);
 
+struct memarena_s;
+
 typedef struct memblock_s
 {
 	size_t 				size;	// including the header and possibly tiny fragments
@@ -66,6 +82,12 @@ typedef struct memblock_s
 	int 				id; 	// should be ZONEID
 	struct memblock_s*	next;
 	struct memblock_s*	prev;
+	struct memblock_s*	tagnext;	// other blocks with the same tag
+	struct memblock_s*	tagprev;
+	struct memarena_s*	arena;		// NULL unless carved from an arena
+#if !defined(_WIN64) && !defined(__LP64__)
+	int					pad[3];		// keep the header a multiple of 16 bytes
+#endif
 } memblock_t;
 
 inline void Z_ChangeTag2(const void *ptr, int tag, const char* file, int line)
@@ -40,6 +40,10 @@
 #include <sys/time.h>
 #endif
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
 #include "i_net.h"
 
 #ifndef _WIN32
@@ -55,6 +59,9 @@ typedef int socklen_t;
 
 
 int net_socket;
+#ifdef __linux__
+int net_epoll = -1;
+#endif
 int localport;
 netadr_t net_from;   // address of who sent the packet
 
@@ -96,6 +103,11 @@ void BindToLocalPort(SOCKET s, u_short port)
 
 void CloseNetwork(void)
 {
+#ifdef __linux__
+	if (net_epoll != -1)
+		close(net_epoll);
+	net_epoll = -1;
+#endif
 	closesocket(net_socket);
 #ifdef _WIN32
 	WSACleanup();
@@ -263,9 +275,62 @@ void InitNetCommon(void)
    if (ioctlsocket(net_socket, FIONBIO, &_true) == -1)
        printf("UDPsocket: ioctl FIONBIO: %s", strerror(errno));
 
+#ifdef __linux__
+   net_epoll = epoll_create(1);
+   if (net_epoll == -1)
+       printf("InitNetCommon: epoll_create: %s\n", strerror(errno));
+   else
+   {
+       struct epoll_event ev;
+       memset(&ev, 0, sizeof(ev));
+       ev.events = EPOLLIN;
+       ev.data.fd = net_socket;
+
+       if (epoll_ctl(net_epoll, EPOLL_CTL_ADD, net_socket, &ev) == -1)
+       {
+           printf("InitNetCommon: epoll_ctl: %s\n", strerror(errno));
+           close(net_epoll);
+           net_epoll = -1;
+       }
+   }
+#endif
+
    net_message.clear();
 }
 
+//
+// I_WaitForPacket
+//
+// Blocks until a packet can be read or timeout_ms milliseconds have passed.
+// Returns true if there is a packet waiting.  Uses epoll where it is
+// available and select everywhere else.
+//
+bool I_WaitForPacket(int timeout_ms)
+{
+#ifdef __linux__
+	if (net_epoll != -1)
+	{
+		struct epoll_event ev;
+		int ret = epoll_wait(net_epoll, &ev, 1, timeout_ms);
+
+		if (ret == -1 && errno != EINTR)
+			printf("I_WaitForPacket: %s\n", strerror(errno));
+
+		return ret > 0;
+	}
+#endif
+
+	fd_set readfds;
+	FD_ZERO(&readfds);
+	FD_SET(net_socket, &readfds);
+
+	struct timeval tv;
+	tv.tv_sec = timeout_ms / 1000;
+	tv.tv_usec = (timeout_ms % 1000) * 1000;
+
+	return select(net_socket + 1, &readfds, NULL, NULL, &tv) > 0;
+}
+
 
 void I_SetPort(netadr_t &addr, int port)
 {
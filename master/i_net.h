@@ -303,7 +303,7 @@ extern buf_t net_message;
 void CloseNetwork(void);
 void InitNetCommon(void);
 void I_SetPort(netadr_t &addr, int port);
-void I_DoSelect(void);
+bool I_WaitForPacket(int timeout_ms);
 
 char *NET_AdrToString(netadr_t a, bool displayport = true);
 bool NET_StringToAdr(char *s, netadr_t *a);
@@ -31,7 +31,8 @@
 
 #include <string>
 #include <vector>
-#include <list>
+#include <map>
+#include <set>
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -43,12 +44,12 @@
 #include <netinet/in.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <time.h>
 #endif
 
 #ifdef _WIN32
 #include <winsock.h>
 #include <time.h>
-#define usleep(n) Sleep(n/1000)
 #endif
 
 #include "i_net.h"
@@ -57,17 +58,26 @@ using namespace std;
 
 #define MAX_SERVERS					1024
 #define MAX_SERVERS_PER_IP			64
-#define MAX_SERVER_AGE				5000
-#define MAX_UNVERIFIED_SERVER_AGE	1000
+
+// All times are in milliseconds.
+#define MAX_SERVER_AGE				250000
+#define MAX_UNVERIFIED_SERVER_AGE	50000
+#define PING_INTERVAL				60000	// between pings of a verified server
+#define MAX_PINGS_PER_SECOND		50
+#define AGE_INTERVAL				1000	// between checks for timed out servers
+#define DUMP_INTERVAL				5000
 
 #define LOGFILE "master_log.txt"
 
+typedef uint64_t mstime_t;
+
 buf_t message(MAX_UDP_PACKET);
 
 typedef struct server
 {
 	netadr_t addr;
-	int age;
+	mstime_t last_seen;
+	mstime_t next_ping;	// 0 if no ping is scheduled
 
 	// from server itself
 	string hostname;
@@ -83,42 +93,117 @@ typedef struct server
 	unsigned int key_sent;
 	bool pinged, verified;
 
-	server() : age(0), players(0), maxplayers(0), gametype(0), skill(0), teamplay(0), ctfmode(0), key_sent(0), pinged(0), verified(0) { memset(&addr, 0, sizeof(addr)); }
+	server() : last_seen(0), next_ping(0), players(0), maxplayers(0), gametype(0), skill(0), teamplay(0), ctfmode(0), key_sent(0), pinged(0), verified(0) { memset(&addr, 0, sizeof(addr)); }
 
 } SServer;
 
-list<SServer> servers;
-list<SServer>::iterator ping_itr = servers.begin(); // this iterator must be updated when servers is changed
+// Servers are indexed by address and port, and verified servers are counted
+// per IP, so that registrations don't have to scan the whole list.
+typedef map<uint64_t, SServer> ServerMap;
+typedef map<uint32_t, int> IPCountMap;
+typedef set<pair<mstime_t, uint64_t> > PingSchedule;
+
+ServerMap servers;
+IPCountMap verified_per_ip;
+PingSchedule ping_schedule;
+
+// The reply to launchers is only rebuilt when the set of verified servers
+// changes.
+buf_t server_list(MAX_UDP_PACKET);
+bool server_list_dirty = true;
+
+// Pings are sent as they fall due, but no faster than MAX_PINGS_PER_SECOND.
+// ping_credit is in thousandths of a ping.
+mstime_t ping_credit = 1000 * MAX_PINGS_PER_SECOND;
+mstime_t ping_credit_time = 0;
+
+mstime_t msTime(void)
+{
+#ifdef _WIN32
+	static mstime_t base = 0;
+	static DWORD last = 0;
+
+	DWORD now = GetTickCount();
+	if (now < last)
+		base += (mstime_t)1 << 32;
+	last = now;
+
+	return base + now;
+#else
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	return (mstime_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+#endif
+}
+
+uint32_t ipKey(const netadr_t &addr)
+{
+	return ((uint32_t)addr.ip[0] << 24) | ((uint32_t)addr.ip[1] << 16) |
+	       ((uint32_t)addr.ip[2] << 8) | addr.ip[3];
+}
+
+uint64_t addrKey(const netadr_t &addr)
+{
+	return ((uint64_t)ipKey(addr) << 16) | addr.port;
+}
 
 bool ipReachedLimit(netadr_t addr)
 {
-	list<SServer>::iterator itr;
-	int verifiedservers = 0;
+	IPCountMap::const_iterator itr = verified_per_ip.find(ipKey(addr));
+
+	return itr != verified_per_ip.end() && itr->second >= MAX_SERVERS_PER_IP;
+}
+
+void schedulePing(uint64_t key, SServer &s, mstime_t when)
+{
+	if (s.next_ping)
+		ping_schedule.erase(make_pair(s.next_ping, key));
+
+	s.next_ping = when;
+
+	if (s.next_ping)
+		ping_schedule.insert(make_pair(s.next_ping, key));
+}
+
+void setVerified(SServer &s, bool verified)
+{
+	if (s.verified == verified)
+		return;
+
+	s.verified = verified;
+	server_list_dirty = true;
+
+	uint32_t ip = ipKey(s.addr);
 
-	// count verified servers
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
-		if ((*itr).verified && memcmp(&(*itr).addr.ip, &addr.ip, 4) == 0)
-			verifiedservers++;
+	if (verified)
+		verified_per_ip[ip]++;
+	else if (--verified_per_ip[ip] <= 0)
+		verified_per_ip.erase(ip);
+}
 
-	return verifiedservers >= MAX_SERVERS_PER_IP;
+void removeServer(ServerMap::iterator itr)
+{
+	setVerified(itr->second, false);
+	schedulePing(itr->first, itr->second, 0);
+	servers.erase(itr);
 }
 
-void addServer(netadr_t addr)
+void addServer(netadr_t addr, mstime_t now)
 {
-	list<SServer>::iterator itr;
-	SServer temp;
+	uint64_t key = addrKey(addr);
+	ServerMap::iterator itr = servers.find(key);
 
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
+	if (itr != servers.end())
 	{
-		if (memcmp(&(*itr).addr.ip, &addr.ip, 4) == 0)
-		{
-			if ((*itr).addr.port == addr.port)
-			{
-				(*itr).age = 0;
-				(*itr).pinged = false;
-				return;
-			}
-		}
+		SServer &s = itr->second;
+
+		s.last_seen = now;
+		s.pinged = false;
+
+		if (!s.next_ping)
+			schedulePing(key, s, now);
+		return;
 	}
 
 	if (servers.size() < MAX_SERVERS)
@@ -126,16 +211,17 @@ void addServer(netadr_t addr)
 		if(ipReachedLimit(addr))
 			return;
 
-		memcpy(&temp.addr, &addr, sizeof(addr));
-		temp.age = 0;
-		servers.push_back(temp);
+		SServer &s = servers[key];
+		memcpy(&s.addr, &addr, sizeof(addr));
+		s.last_seen = now;
+		schedulePing(key, s, now);
 
-		printf("Added new server: %s, %d total\n", NET_AdrToString(temp.addr), (int)servers.size());
+		printf("Added new server: %s, %d total\n", NET_AdrToString(s.addr), (int)servers.size());
 		FILE *fp = fopen(LOGFILE, "a");
 
 		if(fp)
 		{
-			fprintf(fp, "Server registered: %s, %d total\r\n", NET_AdrToString(temp.addr), (int)servers.size());
+			fprintf(fp, "Server registered: %s, %d total\r\n", NET_AdrToString(s.addr), (int)servers.size());
 			fclose(fp);
 		}
 		else
@@ -146,115 +232,86 @@ void addServer(netadr_t addr)
 	printf("Failed to add server: %s, no slots left\n", NET_AdrToString(addr));
 }
 
-void addServerInfo(netadr_t addr)
+void addServerInfo(netadr_t addr, mstime_t now)
 {
-	list<SServer>::iterator itr;
+	ServerMap::iterator itr = servers.find(addrKey(addr));
 	size_t i;
 
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
-	{
-		if (memcmp(&(*itr).addr.ip, &addr.ip, 4) != 0)
-			continue;
-
-		if ((*itr).addr.port != addr.port)
-			continue;
+	if (itr == servers.end())
+		return;
 
-		SServer &s = *itr;
+	SServer &s = itr->second;
 
-		if(!s.key_sent)
-			continue;
+	if(!s.key_sent)
+		return;
 
-		net_message.ReadLong();
+	net_message.ReadLong();
 
-		// check key against one we issued
-		if((unsigned)net_message.ReadLong() != s.key_sent)
-			continue;
-
-		// do not allow too many servers
-		if(ipReachedLimit((*itr).addr))
-			continue;
+	// check key against one we issued
+	if((unsigned)net_message.ReadLong() != s.key_sent)
+		return;
 
-		printf("Server info, IP = %s\n", NET_AdrToString(addr));
+	// do not allow too many servers
+	if(!s.verified && ipReachedLimit(s.addr))
+		return;
 
-		s.verified = true;
-		s.age = 0;
+	printf("Server info, IP = %s\n", NET_AdrToString(addr));
 
-		s.hostname = net_message.ReadString();
-		s.players = net_message.ReadByte();
-		s.maxplayers = net_message.ReadByte();
-		s.map = net_message.ReadString();
+	setVerified(s, true);
+	s.last_seen = now;
 
-		int pwadcount = net_message.ReadByte();
-		if(pwadcount < 0)
-			pwadcount = 0;
+	s.hostname = net_message.ReadString();
+	s.players = net_message.ReadByte();
+	s.maxplayers = net_message.ReadByte();
+	s.map = net_message.ReadString();
 
-		s.pwads.resize(pwadcount);
+	int pwadcount = net_message.ReadByte();
+	if(pwadcount < 0)
+		pwadcount = 0;
 
-		for(i = 0; i < s.pwads.size(); i++)
-			s.pwads[i] = net_message.ReadString();
+	s.pwads.resize(pwadcount);
 
-		s.gametype = net_message.ReadByte();
-		s.skill = net_message.ReadByte();
-		s.teamplay = net_message.ReadByte();
-		s.ctfmode = net_message.ReadByte();
+	for(i = 0; i < s.pwads.size(); i++)
+		s.pwads[i] = net_message.ReadString();
 
-		byte playercount = net_message.ReadByte();
+	s.gametype = net_message.ReadByte();
+	s.skill = net_message.ReadByte();
+	s.teamplay = net_message.ReadByte();
+	s.ctfmode = net_message.ReadByte();
 
-		s.playernames.resize(playercount);
-		s.playerfrags.resize(playercount);
-		s.playerpings.resize(playercount);
-		s.playerteams.resize(playercount);
+	byte playercount = net_message.ReadByte();
 
-		for(i = 0; i < playercount; i++)
-		{
-			s.playernames[i] = net_message.ReadString();
-			s.playerfrags[i] = net_message.ReadShort();
-			s.playerpings[i] = net_message.ReadLong();
-			s.playerteams[i] = net_message.ReadByte();
-		}
+	s.playernames.resize(playercount);
+	s.playerfrags.resize(playercount);
+	s.playerpings.resize(playercount);
+	s.playerteams.resize(playercount);
 
-		break;
+	for(i = 0; i < playercount; i++)
+	{
+		s.playernames[i] = net_message.ReadString();
+		s.playerfrags[i] = net_message.ReadShort();
+		s.playerpings[i] = net_message.ReadLong();
+		s.playerteams[i] = net_message.ReadByte();
 	}
-
-	return;
 }
 
-void ageServers(void)
+void ageServers(mstime_t now)
 {
-	list<SServer>::iterator itr;
-
-	itr = servers.begin();
+	ServerMap::iterator itr = servers.begin();
 
 	while (itr != servers.end())
 	{
-		(*itr).age++;
+		SServer &s = itr->second;
+		mstime_t max_age = s.verified ? MAX_SERVER_AGE : MAX_UNVERIFIED_SERVER_AGE;
 
-		if((*itr).verified)
+		if (now - s.last_seen > max_age)
 		{
-			if ((*itr).age > MAX_SERVER_AGE)
-			{
-				printf("Remote server timed out: %s, ", NET_AdrToString((*itr).addr));
-				if(ping_itr == itr)
-					++ping_itr;
-				itr = servers.erase(itr);
-				printf("%d total\n", (int)servers.size());
-			}
-			else
-				++itr;
+			printf("Remote server timed out: %s, ", NET_AdrToString(s.addr));
+			removeServer(itr++);
+			printf("%d total\n", (int)servers.size());
 		}
 		else
-		{
-			if ((*itr).age > MAX_UNVERIFIED_SERVER_AGE)
-			{
-				printf("Remote server timed out: %s, ", NET_AdrToString((*itr).addr));
-				if(ping_itr == itr)
-					++ping_itr;
-				itr = servers.erase(itr);
-				printf("%d total\n", (int)servers.size());
-			}
-			else
-				++itr;
-		}
+			++itr;
 	}
 }
 
@@ -273,71 +330,71 @@ void dumpServersToFile(const char *file = "./latest")
 
 	file_error = false;
 
-	list<SServer>::iterator itr;
-
-	itr = servers.begin();
-
 	fprintf(fp, "\"Name\",\"Map\",\"Players/Max\",\"WADs\",\"Gametype\",\"Address:Port\"\n");
 
-	int i = 0;
-
-	while (itr != servers.end())
+	for (ServerMap::iterator itr = servers.begin(); itr != servers.end(); ++itr)
 	{
-		if(!(*itr).verified)
-		{
-			++itr;
+		SServer &s = itr->second;
+
+		if(!s.verified)
 			continue;
-		}
 
-        string detectgametype = "ERROR";
-		if((*itr).gametype == 0)
+		string detectgametype = "ERROR";
+		if(s.gametype == 0)
 			detectgametype = "COOP";
 		else
 			detectgametype = "DM";
-		if((*itr).gametype == 1 && (*itr).teamplay == 1)
+		if(s.gametype == 1 && s.teamplay == 1)
 			detectgametype = "TEAM DM";
-		if((*itr).ctfmode == 1)
+		if(s.ctfmode == 1)
 			detectgametype = "CTF";
 
 		string str_wads;
-		for(size_t j = 0; j < (*itr).pwads.size(); j++)
+		for(size_t j = 0; j < s.pwads.size(); j++)
 		{
-			str_wads += (*itr).pwads[j];
+			str_wads += s.pwads[j];
 			str_wads += " ";
 		}
 		if(!str_wads.length())
 			str_wads = " ";
 
-		fprintf(fp, "\"%s\",\"%s\",\"%d/%d\",\"%s\",\"%s\",\"%s\"\n", (*itr).hostname.c_str(), (*itr).map.c_str(), (*itr).players, (*itr).maxplayers, str_wads.c_str(), detectgametype.c_str(), NET_AdrToString((*itr).addr, true));
-
-		i++;
-		++itr;
+		fprintf(fp, "\"%s\",\"%s\",\"%d/%d\",\"%s\",\"%s\",\"%s\"\n", s.hostname.c_str(), s.map.c_str(), s.players, s.maxplayers, str_wads.c_str(), detectgametype.c_str(), NET_AdrToString(s.addr, true));
 	}
 
-    fclose(fp);
+	fclose(fp);
 }
 
-void writeServerData(void)
+void writeServerData(buf_t &buf)
 {
-	list<SServer>::iterator itr;
 	size_t num_verified = 0;
 
-	// count verified servers
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
-		if((*itr).verified)
-			num_verified++;
+	for (IPCountMap::iterator itr = verified_per_ip.begin(); itr != verified_per_ip.end(); ++itr)
+		num_verified += itr->second;
 
-	message.WriteShort(num_verified);
+	buf.WriteShort(num_verified);
 
-	for (itr = servers.begin(); itr != servers.end(); ++itr)
+	for (ServerMap::iterator itr = servers.begin(); itr != servers.end(); ++itr)
 	{
-		if(!(*itr).verified)
+		if(!itr->second.verified)
 			continue;
 
 		for (int i = 0; i < 4; ++i)
-			message.WriteByte((*itr).addr.ip[i]);
-		message.WriteShort(htons((*itr).addr.port));
+			buf.WriteByte(itr->second.addr.ip[i]);
+		buf.WriteShort(htons(itr->second.addr.port));
+	}
+}
+
+void sendServerList(netadr_t to)
+{
+	if (server_list_dirty)
+	{
+		server_list.clear();
+		server_list.WriteLong(LAUNCHER_CHALLENGE);
+		writeServerData(server_list);
+		server_list_dirty = false;
 	}
+
+	NET_SendPacket(server_list.cursize, server_list.data, to);
 }
 
 void daemon_init(void)
@@ -381,9 +438,88 @@ void pingServer(SServer &s)
 	s.pinged = true;
 }
 
+//
+// pingServers
+//
+// Pings every server that is due, as far as the rate limit allows.  Returns
+// the time until more pings need to be sent.
+//
+mstime_t pingServers(mstime_t now)
+{
+	const mstime_t max_credit = 1000 * MAX_PINGS_PER_SECOND;
+
+	ping_credit += (now - ping_credit_time) * MAX_PINGS_PER_SECOND;
+	if (ping_credit > max_credit)
+		ping_credit = max_credit;
+	ping_credit_time = now;
+
+	while (!ping_schedule.empty())
+	{
+		mstime_t due = ping_schedule.begin()->first;
+
+		if (due > now)
+			return due - now;
+
+		if (ping_credit < 1000)
+			return (1000 - ping_credit + MAX_PINGS_PER_SECOND - 1) / MAX_PINGS_PER_SECOND;
+
+		uint64_t key = ping_schedule.begin()->second;
+		SServer &s = servers[key];
+
+		pingServer(s);
+		ping_credit -= 1000;
+
+		// Verified servers are pinged regularly to keep their details up to
+		// date; others are only pinged again once they get back in touch.
+		schedulePing(key, s, s.verified ? now + PING_INTERVAL : 0);
+	}
+
+	return AGE_INTERVAL;
+}
+
+void handlePacket(mstime_t now)
+{
+	int challenge = net_message.ReadLong();
+
+	switch (challenge)
+	{
+	case 0:
+	case SERVER_CHALLENGE:
+		if(net_message.BytesLeftToRead() > 2)
+		{
+			// full reply with deathmatch, wad, etc
+			addServerInfo(net_from, now);
+		}
+		else
+		{
+			// plain contact
+			if(net_message.BytesLeftToRead() == 2)
+			{
+				unsigned short use_port = net_message.ReadShort();
+				net_from.port = htons(use_port);
+			}
+
+			addServer(net_from, now);
+		}
+		break;
+	case LAUNCHER_CHALLENGE:
+		if(net_message.BytesLeftToRead() > 0)
+		{
+			printf("Master syncing server list (ignored), IP = %s\n", NET_AdrToString(net_from));
+		}
+		else
+		{
+			printf("Client request IP = %s\n", NET_AdrToString(net_from));
+			sendServerList(net_from);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
 int main()
 {
-	int challenge;
 	localport = MASTERPORT;
 	InitNetCommon();
 
@@ -391,70 +527,42 @@ int main()
 
 	printf("Odamex Master Started\n");
 
+	mstime_t now = msTime();
+	mstime_t next_age = now + AGE_INTERVAL;
+	mstime_t next_dump = now;
+
+	ping_credit_time = now;
+
 	while (true)
 	{
-		while (NET_GetPacket())
+		mstime_t wait = pingServers(now);
+
+		if (next_age - now < wait)
+			wait = next_age - now;
+		if (next_dump - now < wait)
+			wait = next_dump - now;
+
+		if (I_WaitForPacket((int)wait))
 		{
-			challenge = net_message.ReadLong();
+			now = msTime();
 
-			switch (challenge)
-			{
-			case 0:
-			case SERVER_CHALLENGE:
-				if(net_message.BytesLeftToRead() > 2)
-				{
-					// full reply with deathmatch, wad, etc
-					addServerInfo(net_from);
-				}
-				else
-				{
-					// plain contact
-					if(net_message.BytesLeftToRead() == 2)
-					{
-						unsigned short use_port = net_message.ReadShort();
-						net_from.port = htons(use_port);
-					}
-
-					addServer(net_from);
-				}
-			    break;
-			case LAUNCHER_CHALLENGE:
-				if(net_message.BytesLeftToRead() > 0)
-				{
-					printf("Master syncing server list (ignored), IP = %s\n", NET_AdrToString(net_from));
-				}
-				else
-				{
-					printf("Client request IP = %s\n", NET_AdrToString(net_from));
-					message.clear();
-					message.WriteLong(LAUNCHER_CHALLENGE);
-					writeServerData();
-					NET_SendPacket(message.cursize, message.data, net_from);
-				}
-			    break;
-			default:
-				break;
-			}
+			while (NET_GetPacket())
+				handlePacket(now);
 		}
 
-		static int counter = 0;
+		now = msTime();
 
-		usleep(50*1000); // every 50ms // denis - fixme - use proper timer, age of servers should increase even during packet sending
-
-		ageServers();
+		if (now >= next_age)
+		{
+			ageServers(now);
+			next_age = now + AGE_INTERVAL;
+		}
 
-		if(!(counter%100))
+		if (now >= next_dump)
 		{
 			dumpServersToFile();
-
-			if (ping_itr == servers.end())
-				ping_itr = servers.begin();
-
-			if(ping_itr != servers.end())
-				pingServer(*(ping_itr++));
+			next_dump = now + DUMP_INTERVAL;
 		}
-
-		counter++;
 	}
 
 	servers.clear();
@@ -33,6 +33,7 @@
 #include "sv_main.h"
 #include "doomstat.h"
 #include "gi.h"
+#include "sv_log.h"
 
 #include <string>
 
@@ -97,8 +98,6 @@ char *TimeStamp()
 /* Provide our own Printf() that is sensitive of the
  * console status (in or out of game)
  */
-extern int PrintString (int printlevel, const char *outline);
-
 extern BOOL gameisdead;
 
 int VPrintf(int printlevel, const char* format, va_list parms)
@@ -118,6 +117,7 @@ int VPrintf(int printlevel, const char* format, va_list parms)
 
 	std::string str(TimeStamp());
 	str.append(" ");
+	size_t msgstart = str.length();
 	str.append(outline);
 
 	if (str[str.length() - 1] != '\n')
@@ -136,12 +136,17 @@ int VPrintf(int printlevel, const char* format, va_list parms)
 		}
 	}
 
-	if (LOG.is_open()) {
-		LOG << str;
-		LOG.flush();
-	}
+	SV_LogPrint(printlevel, str, msgstart);
+
+	return str.length();
+}
 
-	return PrintString(printlevel, str.c_str());
+//
+// C_FlushLog
+//
+void C_FlushLog (void)
+{
+	SV_FlushLog();
 }
 
 FORMAT_PRINTF(2, 3) int STACK_ARGS Printf(int printlevel, const char* format, ...)
@@ -36,6 +36,7 @@
 #include "c_dispatch.h"
 #include "p_local.h"
 #include "s_sound.h"
+#include "stats.h"
 #include "r_data.h"
 #include "g_game.h"
 #include "g_level.h"
@@ -109,6 +110,8 @@ int mapchange;
 
 void G_Ticker (void)
 {
+	PROFILE_ZONE("G_Ticker");
+
 	// do player reborns if needed
 	if (serverside)
 	{
@@ -44,6 +44,7 @@
 #include "r_data.h"
 #include "r_sky.h"
 #include "s_sound.h"
+#include "sv_delta.h"
 #include "sv_main.h"
 #include "sv_maplist.h"
 #include "w_wad.h"
@@ -562,6 +563,7 @@ void G_DoResetLevel(bool full_reset)
 
 	// Clear netids of every non-player actor so we don't spam the
 	// destruction message of actors to clients.
+	SV_DeltaForgetAll();
 	{
 		AActor* mo;
 		TThinkerIterator<AActor> iterator;
@@ -769,21 +771,18 @@ void G_DoLoadLevel (int position)
 			TEAMpoints[i] = 0;
 	}
 
-	// initialize the msecnode_t freelist.					phares 3/25/98
-	// any nodes in the freelist are gone by now, cleared
-	// by Z_FreeTags() when the previous level ended or player
-	// died.
+	// the msecnode_t pool is cleared by P_SetupLevel() along with the
+	// rest of the level's memory.
 
 	{
-		extern msecnode_t *headsecnode; // phares 3/25/98
-		headsecnode = NULL;
-
 		// denis - todo - wtf is this crap?
 		// [RH] Need to prevent the AActor destructor from trying to
 		//		free the nodes
 		AActor *actor;
 		TThinkerIterator<AActor> iterator;
 
+		SV_DeltaForgetAll();
+
 		while ( (actor = iterator.Next ()) )
 		{
 			actor->touching_sectorlist = NULL;
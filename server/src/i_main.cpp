@@ -154,6 +154,8 @@ int __cdecl main(int argc, char *argv[])
     }
     catch (CDoomError &error)
     {
+		C_FlushLog();
+
 		if (LOG.is_open())
         {
             LOG << error.GetMsg() << std::endl;
@@ -280,6 +282,8 @@ int main (int argc, char **argv)
     {
 	fprintf (stderr, "%s\n", error.GetMsg().c_str());
 
+	C_FlushLog();
+
 	if (LOG.is_open())
         {
             LOG << error.GetMsg() << std::endl;
@@ -109,13 +109,13 @@ fixed_t		render_lerp_amount;
 
 unsigned int	R_OldBlend = ~0;
 
-void (*colfunc) (void);
+void (*colfunc) (drawcolumn_s&);
 void (*basecolfunc) (void);
 void (*fuzzcolfunc) (void);
 void (*lucentcolfunc) (void);
 void (*transcolfunc) (void);
 void (*tlatedlucentcolfunc) (void);
-void (*spanfunc) (void);
+void (*spanfunc) (drawspan_s&);
 
 void (*hcolfunc_pre) (void);
 void (*hcolfunc_post1) (int hx, int sx, int yl, int yh);
@@ -21,6 +21,7 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -177,6 +178,122 @@ std::string IPRange::string()
 	return buffer.str();
 }
 
+// Return a bitfield of the masked octets, with octet 0 in bit 0.
+byte IPRange::wildcards() const
+{
+	byte bits = 0;
+
+	for (byte i = 0; i < 4; i++)
+	{
+		if (this->mask[i])
+		{
+			bits |= 1 << i;
+		}
+	}
+
+	return bits;
+}
+
+// Return the range's unmasked octets packed into an integer.
+uint32_t IPRange::key() const
+{
+	uint32_t key = 0;
+
+	for (byte i = 0; i < 4; i++)
+	{
+		key <<= 8;
+		if (!this->mask[i])
+		{
+			key |= this->ip[i];
+		}
+	}
+
+	return key;
+}
+
+// Return the key that a range with the given masked octets would need to
+// have to match the address.
+uint32_t IPRange::key(const netadr_t &address, byte wildcards)
+{
+	uint32_t key = 0;
+
+	for (byte i = 0; i < 4; i++)
+	{
+		key <<= 8;
+		if (!(wildcards & (1 << i)))
+		{
+			key |= address.ip[i];
+		}
+	}
+
+	return key;
+}
+
+//// IPRangeIndex ////
+
+// Add an entry.  Sequence numbers must be inserted in increasing order.
+void IPRangeIndex::insert(const IPRange &range, size_t seq)
+{
+	this->buckets[range.wildcards()][range.key()].push_back(seq);
+}
+
+// Remove an entry, if it is in the index.
+void IPRangeIndex::erase(const IPRange &range, size_t seq)
+{
+	Buckets &bucket = this->buckets[range.wildcards()];
+
+	Buckets::iterator it = bucket.find(range.key());
+	if (it == bucket.end())
+	{
+		return;
+	}
+
+	std::vector<size_t> &seqs = it->second;
+	std::vector<size_t>::iterator sit =
+	    std::lower_bound(seqs.begin(), seqs.end(), seq);
+	if (sit != seqs.end() && *sit == seq)
+	{
+		seqs.erase(sit);
+	}
+
+	if (seqs.empty())
+	{
+		bucket.erase(it);
+	}
+}
+
+void IPRangeIndex::clear()
+{
+	for (size_t i = 0; i < 16; i++)
+	{
+		this->buckets[i].clear();
+	}
+}
+
+// Return the lowest sequence number of the entries that match the address,
+// or NO_ENTRY.
+size_t IPRangeIndex::first(const netadr_t &address) const
+{
+	size_t best = NO_ENTRY;
+
+	for (byte i = 0; i < 16; i++)
+	{
+		if (this->buckets[i].empty())
+		{
+			continue;
+		}
+
+		Buckets::const_iterator it =
+		    this->buckets[i].find(IPRange::key(address, i));
+		if (it != this->buckets[i].end() && it->second.front() < best)
+		{
+			best = it->second.front();
+		}
+	}
+
+	return best;
+}
+
 //// Banlist ////
 
 size_t Banlist::size()
@@ -184,6 +301,50 @@ size_t Banlist::size()
 	return this->banlist.size();
 }
 
+// Append a ban to the banlist and its index.
+void Banlist::push_ban(const Ban &ban)
+{
+	size_t seq = this->nextseq++;
+
+	this->banlist.push_back(ban);
+	this->banseq.push_back(seq);
+	this->banindex.insert(ban.range, seq);
+
+	if (ban.expire != 0)
+	{
+		this->banexpiry.push(expiry_t(ban.expire, seq));
+	}
+}
+
+// Append an exception to the exceptionlist and its index.
+void Banlist::push_exception(const Exception &exception)
+{
+	size_t seq = this->nextseq++;
+
+	this->exceptionlist.push_back(exception);
+	this->exceptionseq.push_back(seq);
+	this->exceptionindex.insert(exception.range, seq);
+}
+
+// Take bans that have expired by now out of the index.
+void Banlist::expire_bans(time_t now)
+{
+	while (!this->banexpiry.empty() && this->banexpiry.top().first <= now)
+	{
+		size_t seq = this->banexpiry.top().second;
+		this->banexpiry.pop();
+
+		// The ban might have been removed already.
+		std::vector<size_t>::iterator it =
+		    std::lower_bound(this->banseq.begin(), this->banseq.end(), seq);
+		if (it != this->banseq.end() && *it == seq)
+		{
+			size_t index = it - this->banseq.begin();
+			this->banindex.erase(this->banlist[index].range, seq);
+		}
+	}
+}
+
 bool Banlist::add(const std::string &address, const time_t expire,
                   const std::string &name, const std::string &reason)
 {
@@ -201,7 +362,7 @@ bool Banlist::add(const std::string &address, const time_t expire,
 	ban.reason = reason;
 
 	// Add the ban to the banlist
-	this->banlist.push_back(ban);
+	this->push_ban(ban);
 
 	return true;
 }
@@ -224,7 +385,7 @@ bool Banlist::add(player_t &player, const time_t expire,
 	ban.reason = reason;
 
 	// Add the ban to the banlist
-	this->banlist.push_back(ban);
+	this->push_ban(ban);
 
 	return true;
 }
@@ -242,7 +403,7 @@ bool Banlist::add_exception(const std::string &address, const std::string &name)
 
 	// Add the exception to the banlist.
 	exception.name = name;
-	this->exceptionlist.push_back(exception);
+	this->push_exception(exception);
 
 	return true;
 }
@@ -262,7 +423,7 @@ bool Banlist::add_exception(player_t &player)
 	exception.range.set(player.client.address);
 
 	// Add the exception to the banlist.
-	this->exceptionlist.push_back(exception);
+	this->push_exception(exception);
 
 	return true;
 }
@@ -273,28 +434,25 @@ bool Banlist::add_exception(player_t &player)
 bool Banlist::check(const netadr_t &address, Ban &baninfo)
 {
 	// Check against exception list.
-	for (std::vector<Exception>::iterator it = this->exceptionlist.begin();
-	        it != this->exceptionlist.end(); ++it)
+	if (this->exceptionindex.first(address) != IPRangeIndex::NO_ENTRY)
 	{
-		if (it->range.check(address))
-		{
-			return false;
-		}
+		return false;
 	}
 
-	// Check against banlist.
-	for (std::vector<Ban>::iterator it = this->banlist.begin();
-	        it != this->banlist.end(); ++it)
+	// Check against banlist.  Expired bans are no longer in the index, and
+	// the earliest ban that matches is the one that is reported.
+	this->expire_bans(time(NULL));
+
+	size_t seq = this->banindex.first(address);
+	if (seq == IPRangeIndex::NO_ENTRY)
 	{
-		if (it->range.check(address) && (it->expire == 0 ||
-		                                 it->expire > time(NULL)))
-		{
-			baninfo = *it;
-			return true;
-		}
+		return false;
 	}
 
-	return false;
+	size_t index = std::lower_bound(this->banseq.begin(), this->banseq.end(),
+	                                seq) - this->banseq.begin();
+	baninfo = this->banlist[index];
+	return true;
 }
 
 // Return a complete list of bans.
@@ -409,7 +567,9 @@ bool Banlist::remove(size_t index)
 		return false;
 	}
 
+	this->banindex.erase(this->banlist[index].range, this->banseq[index]);
 	this->banlist.erase(this->banlist.begin() + index);
+	this->banseq.erase(this->banseq.begin() + index);
 	return true;
 }
 
@@ -428,7 +588,10 @@ bool Banlist::remove_exception(size_t index)
 		return false;
 	}
 
+	this->exceptionindex.erase(this->exceptionlist[index].range,
+	                           this->exceptionseq[index]);
 	this->exceptionlist.erase(this->exceptionlist.begin() + index);
+	this->exceptionseq.erase(this->exceptionseq.begin() + index);
 	return true;
 }
 
@@ -436,12 +599,17 @@ bool Banlist::remove_exception(size_t index)
 void Banlist::clear()
 {
 	this->banlist.clear();
+	this->banseq.clear();
+	this->banindex.clear();
+	this->banexpiry = expiryqueue_t();
 }
 
 // Clear the exceptionlist.
 void Banlist::clear_exceptions()
 {
 	this->exceptionlist.clear();
+	this->exceptionseq.clear();
+	this->exceptionindex.clear();
 }
 
 // Fills a JSON array with bans.
@@ -521,7 +689,7 @@ bool Banlist::json_replace(const Json::Value &json_bans)
 		if (!value.isNull())
 			ban.reason = value.asString();
 
-		this->banlist.push_back(ban);
+		this->push_ban(ban);
 	}
 
 	return true;
@@ -24,6 +24,9 @@
 #ifndef __SV_BANLIST__
 #define __SV_BANLIST__
 
+#include <functional>
+#include <map>
+#include <queue>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -45,6 +48,26 @@ public:
 	void set(const netadr_t &address);
 	bool set(const std::string &input);
 	std::string string(void);
+	byte wildcards(void) const;
+	uint32_t key(void) const;
+	static uint32_t key(const netadr_t &address, byte wildcards);
+};
+
+// Finds the lowest numbered entry whose range matches an address without
+// testing every entry.  Entries are grouped by which octets they mask and
+// then looked up by the octets they don't.
+class IPRangeIndex
+{
+public:
+	static const size_t NO_ENTRY = (size_t)-1;
+
+	void insert(const IPRange &range, size_t seq);
+	void erase(const IPRange &range, size_t seq);
+	void clear();
+	size_t first(const netadr_t &address) const;
+private:
+	typedef std::map<uint32_t, std::vector<size_t> > Buckets;
+	Buckets buckets[16];
 };
 
 struct Ban
@@ -70,6 +93,7 @@ typedef std::vector<exceptionlist_result_t> exceptionlist_results_t;
 class Banlist
 {
 public:
+	Banlist(void) : nextseq(0) { };
 	size_t size();
 	bool add(const std::string &address, const time_t expire = 0,
 	         const std::string &name = std::string(),
@@ -93,8 +117,29 @@ public:
 	bool json_replace(const Json::Value &json_bans);
 	void json_exceptions();
 private:
+	typedef std::pair<time_t, size_t> expiry_t;
+	typedef std::priority_queue<expiry_t, std::vector<expiry_t>,
+	                            std::greater<expiry_t> > expiryqueue_t;
+
+	void push_ban(const Ban &ban);
+	void push_exception(const Exception &exception);
+	void expire_bans(time_t now);
+
 	std::vector<Ban> banlist;
 	std::vector<Exception> exceptionlist;
+
+	// Every entry has a sequence number that is never reused, kept in
+	// parallel with the lists, so that the indexes survive removals.
+	std::vector<size_t> banseq;
+	std::vector<size_t> exceptionseq;
+	size_t nextseq;
+
+	IPRangeIndex banindex;
+	IPRangeIndex exceptionindex;
+
+	// Bans that will expire, soonest first.  Expired bans stay in the list
+	// but are taken out of the index.
+	expiryqueue_t banexpiry;
 };
 
 void SV_InitBanlist();
@@ -36,6 +36,15 @@ CVAR(			log_fulltimestamps, "0", "Extended timestamp info (dd/mm/yyyy hh:mm:ss)"
 CVAR(			log_packetdebug, "0", "Print debugging messages for each packet sent",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
 
+CVAR_FUNC_DECL(	log_thread, "0", "Write console output and log files on a separate thread",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR_RANGE_FUNC_DECL(log_flushinterval, "100", "Milliseconds between flushes of console output and log files when log_thread is enabled, 0 to flush every line",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 10000.0f)
+
+CVAR_FUNC_DECL(	log_jsonfile, "", "File to also write console output to as JSON lines",
+				CVARTYPE_STRING, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE)
+
 // Server administrative settings
 // ------------------------------
 
@@ -114,6 +123,21 @@ CVAR_RANGE(		sv_flooddelay, "1.5", "Chat flood protection time (in seconds)",
 CVAR_RANGE_FUNC_DECL(sv_maxrate, "200", "Forces clients to be on or below this rate",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 7.0f, 100000.0f)
 
+CVAR(			sv_deltaupdates, "0", "Only send monster and missile updates that contain changes the client has not acknowledged",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR_RANGE(		sv_updaterange, "0", "Only send monster and missile updates for actors within this many units of what a client is watching (0 means no limit)",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 65536.0f)
+
+CVAR_FUNC_DECL(	sv_netthread, "0", "Read and write network packets on a separate thread",
+				CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
+
+CVAR_RANGE_FUNC_DECL(sv_sendthreads, "0", "Number of extra threads used to compress outgoing packets",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 32.0f)
+
+CVAR_RANGE_FUNC_DECL(sv_sightthreads, "0", "Number of extra threads used for batches of line of sight checks",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 32.0f)
+
 CVAR_RANGE_FUNC_DECL(sv_waddownloadcap, "200", "Cap wad file downloading to a specific rate",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 7.0f, 100000.0f)
 
@@ -164,6 +188,15 @@ CVAR(			sv_banfile, "banlist.json", "Default file to save and load the banlist."
 CVAR_RANGE(		sv_banfile_reload, "0", "Number of seconds to wait between automatically loading the banlist.",
 				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 86400.0f)
 
+CVAR_RANGE(		sv_floodrate, "5", "Packets per second accepted from each IP that is not connected, 0 for no limit",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 1000.0f)
+
+CVAR_RANGE(		sv_floodburst, "10", "Packets that an IP that is not connected can send at once before sv_floodrate applies",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 1.0f, 1000.0f)
+
+CVAR_RANGE(		sv_floodglobalrate, "500", "Packets per second accepted from all IPs that are not connected, 0 for no limit",
+				CVARTYPE_INT, CVAR_SERVERARCHIVE | CVAR_NOENABLEDISABLE, 0.0f, 100000.0f)
+
 // Vote settings
 // =============
 
@@ -244,9 +277,6 @@ CVAR(			sv_dmfarspawn, "0", "EXPERIMENTAL: When enabled in DM, players will spaw
                 "from each other.",
 				CVARTYPE_BOOL, CVAR_SERVERARCHIVE | CVAR_LATCH | CVAR_SERVERINFO)
 
-CVAR(sv_download_test, "0", "Experimental download optimization testing",
-	CVARTYPE_BOOL, CVAR_SERVERARCHIVE)
-
 // Hacky abominations that should be purged with fire and brimstone
 // =================================================================
 
@@ -0,0 +1,347 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Per-client baselines of actor state that a client has acknowledged.
+//
+//  Every actor update written to a client's unreliable buffer is remembered
+//  along with the sequence number of the packet that carried it.  Once the
+//  client acknowledges that packet, the values become the client's baseline
+//  for that actor and any later update whose fields match the baseline can
+//  be skipped.  Updates in packets that are never acknowledged are simply
+//  forgotten, so a lost packet causes the fields to be sent again.
+//
+//-----------------------------------------------------------------------------
+
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "actor.h"
+#include "d_player.h"
+#include "sv_delta.h"
+
+EXTERN_CVAR(sv_deltaupdates)
+
+// Fields are always resent once the acknowledged position is this old, in
+// case the client has drifted from the server.
+static const int DELTA_KEYFRAME_TICS = TICRATE * 2;
+
+// Maximum number of unacknowledged packets tracked for each client.
+static const size_t DELTA_MAX_PENDING = 64;
+
+struct ActorBaseline
+{
+	int			netid;
+	int			tic;		// gametic the position was written
+	byte		fields;		// which groups of fields are valid
+
+	byte		rndindex;
+	fixed_t		x, y, z;
+	angle_t		angle;
+	fixed_t		momx, momy, momz;
+	byte		movedir;
+	int			movecount;
+	int			target;
+	int			tracer;
+
+	ActorBaseline() : netid(0), tic(0), fields(0) { }
+	ActorBaseline(AActor *mo, byte fields);
+
+	byte matching(const ActorBaseline &other, byte check) const;
+	void merge(const ActorBaseline &other);
+};
+
+struct PendingPacket
+{
+	int							sequence;
+	std::vector<ActorBaseline>	actors;
+};
+
+struct DeltaClient
+{
+	typedef std::map<int, ActorBaseline> Baselines;
+
+	Baselines					acked;		// acknowledged by the client
+	std::vector<ActorBaseline>	unsent;		// in the unreliable buffer
+	std::deque<PendingPacket>	pending;	// sent but not yet acknowledged
+};
+
+typedef std::map<byte, DeltaClient> DeltaClients;
+static DeltaClients delta_clients;
+
+ActorBaseline::ActorBaseline(AActor *mo, byte fields) :
+	netid(mo->netid), tic(gametic), fields(fields),
+	rndindex(mo->rndindex), x(mo->x), y(mo->y), z(mo->z),
+	angle(mo->angle), momx(mo->momx), momy(mo->momy), momz(mo->momz),
+	movedir(mo->movedir), movecount(mo->movecount),
+	target(mo->target ? mo->target->netid : 0),
+	tracer(mo->tracer ? mo->tracer->netid : 0)
+{
+}
+
+//
+// ActorBaseline::matching
+//
+// Returns the groups of fields in check that are valid in both baselines
+// and have identical values.
+//
+byte ActorBaseline::matching(const ActorBaseline &other, byte check) const
+{
+	check &= fields & other.fields;
+
+	byte result = 0;
+
+	if ((check & DELTA_POSITION) && rndindex == other.rndindex &&
+		x == other.x && y == other.y && z == other.z)
+		result |= DELTA_POSITION;
+
+	if ((check & DELTA_MOMENTUM) && angle == other.angle &&
+		momx == other.momx && momy == other.momy && momz == other.momz)
+		result |= DELTA_MOMENTUM;
+
+	if ((check & DELTA_MOVEDIR) && movedir == other.movedir &&
+		movecount == other.movecount)
+		result |= DELTA_MOVEDIR;
+
+	if ((check & DELTA_TARGET) && target == other.target)
+		result |= DELTA_TARGET;
+
+	if ((check & DELTA_TRACER) && tracer == other.tracer)
+		result |= DELTA_TRACER;
+
+	return result;
+}
+
+//
+// ActorBaseline::merge
+//
+// Copies the valid groups of fields from other into this baseline.
+//
+void ActorBaseline::merge(const ActorBaseline &other)
+{
+	netid = other.netid;
+
+	if (other.fields & DELTA_POSITION)
+	{
+		tic = other.tic;
+		rndindex = other.rndindex;
+		x = other.x;
+		y = other.y;
+		z = other.z;
+	}
+
+	if (other.fields & DELTA_MOMENTUM)
+	{
+		angle = other.angle;
+		momx = other.momx;
+		momy = other.momy;
+		momz = other.momz;
+	}
+
+	if (other.fields & DELTA_MOVEDIR)
+	{
+		movedir = other.movedir;
+		movecount = other.movecount;
+	}
+
+	if (other.fields & DELTA_TARGET)
+		target = other.target;
+
+	if (other.fields & DELTA_TRACER)
+		tracer = other.tracer;
+
+	fields |= other.fields;
+}
+
+//
+// SV_DeltaChangedFields
+//
+// Returns the groups of fields in fields that need to be sent to a client
+// because the client has not acknowledged their current values.
+//
+byte SV_DeltaChangedFields(player_t &player, AActor *mo, byte fields)
+{
+	if (!sv_deltaupdates || !mo->netid)
+		return fields;
+
+	DeltaClients::iterator cit = delta_clients.find(player.id);
+	if (cit == delta_clients.end())
+		return fields;
+
+	DeltaClient::Baselines::const_iterator bit = cit->second.acked.find(mo->netid);
+	if (bit == cit->second.acked.end())
+		return fields;
+
+	const ActorBaseline &baseline = bit->second;
+
+	if (gametic - baseline.tic >= DELTA_KEYFRAME_TICS)
+		return fields;
+
+	return fields & ~baseline.matching(ActorBaseline(mo, fields), fields);
+}
+
+//
+// SV_DeltaWrote
+//
+// Remembers that the given groups of fields were written to a client's
+// unreliable buffer.
+//
+void SV_DeltaWrote(player_t &player, AActor *mo, byte fields)
+{
+	if (!sv_deltaupdates || !mo->netid || !fields)
+		return;
+
+	delta_clients[player.id].unsent.push_back(ActorBaseline(mo, fields));
+}
+
+//
+// SV_DeltaPacketSent
+//
+// Associates the updates in a client's unreliable buffer with the sequence
+// number of the packet that was just sent, or discards them if the
+// unreliable buffer did not make it into the packet.
+//
+void SV_DeltaPacketSent(player_t &player, int sequence, bool unreliable)
+{
+	DeltaClients::iterator cit = delta_clients.find(player.id);
+	if (cit == delta_clients.end())
+		return;
+
+	DeltaClient &dc = cit->second;
+
+	if (unreliable && !dc.unsent.empty())
+	{
+		dc.pending.push_back(PendingPacket());
+		dc.pending.back().sequence = sequence;
+		dc.pending.back().actors.swap(dc.unsent);
+
+		while (dc.pending.size() > DELTA_MAX_PENDING)
+			dc.pending.pop_front();
+	}
+
+	dc.unsent.clear();
+}
+
+//
+// SV_DeltaPacketAcked
+//
+// Moves the updates carried by an acknowledged packet into the client's
+// baselines.  Packets sent before it are assumed to be lost.
+//
+void SV_DeltaPacketAcked(player_t &player, int sequence)
+{
+	DeltaClients::iterator cit = delta_clients.find(player.id);
+	if (cit == delta_clients.end())
+		return;
+
+	DeltaClient &dc = cit->second;
+
+	while (!dc.pending.empty() && dc.pending.front().sequence < sequence)
+		dc.pending.pop_front();
+
+	if (dc.pending.empty() || dc.pending.front().sequence != sequence)
+		return;
+
+	const std::vector<ActorBaseline> &actors = dc.pending.front().actors;
+	for (size_t i = 0; i < actors.size(); i++)
+	{
+		if (actors[i].fields)
+			dc.acked[actors[i].netid].merge(actors[i]);
+	}
+
+	dc.pending.pop_front();
+}
+
+//
+// SV_DeltaForget
+//
+// Discards everything a client knows about a netid.
+//
+static void SV_DeltaForget(DeltaClient &dc, int netid)
+{
+	dc.acked.erase(netid);
+
+	for (size_t i = 0; i < dc.unsent.size(); i++)
+		if (dc.unsent[i].netid == netid)
+			dc.unsent[i].fields = 0;
+
+	for (size_t p = 0; p < dc.pending.size(); p++)
+	{
+		std::vector<ActorBaseline> &actors = dc.pending[p].actors;
+		for (size_t i = 0; i < actors.size(); i++)
+			if (actors[i].netid == netid)
+				actors[i].fields = 0;
+	}
+}
+
+//
+// SV_DeltaForgetActor
+//
+// Discards everything known about an actor for a client.  Must be called
+// whenever the client is told to spawn or remove the actor, since netids
+// are reused.
+//
+void SV_DeltaForgetActor(player_t &player, AActor *mo)
+{
+	DeltaClients::iterator cit = delta_clients.find(player.id);
+	if (cit == delta_clients.end())
+		return;
+
+	SV_DeltaForget(cit->second, mo->netid);
+}
+
+//
+// SV_DeltaForgetNetID
+//
+// Discards everything known about a netid for every client.  Must be called
+// before the netid is released, so that a new actor given the same netid
+// doesn't start out with a stale baseline.
+//
+void SV_DeltaForgetNetID(int netid)
+{
+	if (!netid)
+		return;
+
+	for (DeltaClients::iterator cit = delta_clients.begin(); cit != delta_clients.end(); ++cit)
+		SV_DeltaForget(cit->second, netid);
+}
+
+//
+// SV_DeltaForgetAll
+//
+// Discards every client's baselines, for when the netids of most actors are
+// released at once.
+//
+void SV_DeltaForgetAll()
+{
+	delta_clients.clear();
+}
+
+//
+// SV_DeltaResetPlayer
+//
+// Discards all baselines for a client.
+//
+void SV_DeltaResetPlayer(player_t &player)
+{
+	delta_clients.erase(player.id);
+}
+
+VERSION_CONTROL (sv_delta_cpp, "$Id$")
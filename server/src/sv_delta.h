@@ -0,0 +1,55 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Per-client baselines of actor state that a client has acknowledged.
+//  Used to skip unreliable actor updates that would tell a client
+//  something it already knows.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __SV_DELTA_H__
+#define __SV_DELTA_H__
+
+#include "doomtype.h"
+
+class AActor;
+class player_s;
+typedef player_s player_t;
+
+// Groups of fields that are sent together in a single message
+enum deltafield_t
+{
+	DELTA_POSITION	= 0x01,	// svc_movemobj
+	DELTA_MOMENTUM	= 0x02,	// svc_mobjspeedangle
+	DELTA_MOVEDIR	= 0x04,	// svc_actor_movedir
+	DELTA_TARGET	= 0x08,	// svc_actor_target
+	DELTA_TRACER	= 0x10,	// svc_actor_tracer
+
+	DELTA_ALL		= 0xFF
+};
+
+byte SV_DeltaChangedFields(player_t &player, AActor *mo, byte fields);
+void SV_DeltaWrote(player_t &player, AActor *mo, byte fields);
+void SV_DeltaPacketSent(player_t &player, int sequence, bool unreliable);
+void SV_DeltaPacketAcked(player_t &player, int sequence);
+void SV_DeltaForgetActor(player_t &player, AActor *mo);
+void SV_DeltaForgetNetID(int netid);
+void SV_DeltaForgetAll();
+void SV_DeltaResetPlayer(player_t &player);
+
+#endif
@@ -0,0 +1,369 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Serves WAD files to downloading clients.
+//
+//  Each file being downloaded is mapped into memory once and shared by
+//  every client downloading it, so chunks are copied straight from the
+//  mapping into the client's packet buffer.  Clients are paced with a
+//  token bucket that is refilled every tic at the client's download rate.
+//
+//-----------------------------------------------------------------------------
+
+#include <map>
+#include <string>
+
+#ifdef _WIN32
+	#include "win32inc.h"
+#else
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+#endif
+
+#include "doomtype.h"
+#include "doomstat.h"
+#include "d_player.h"
+#include "c_cvars.h"
+#include "i_net.h"
+#include "i_system.h"
+#include "sv_main.h"
+#include "sv_download.h"
+
+EXTERN_CVAR(sv_waddownloadcap)
+
+// Largest chunk of a file sent in one packet.  Together with the packet
+// sequence number and the svc_wadchunk header this stays below the
+// 1472 byte UDP payload of a 1500 byte Ethernet MTU.
+static const unsigned int DOWNLOAD_CHUNK_SIZE = 1400;
+
+// Files that no client has downloaded from for this long are unmapped.
+static const dtime_t DOWNLOAD_CACHE_TIMEOUT = 30 * 1000;
+
+//
+// DownloadFile
+//
+// A read-only view of a whole file.  The file is mapped into memory if
+// possible and read into the heap otherwise.
+//
+class DownloadFile
+{
+public:
+	static DownloadFile* open(const std::string &filename);
+	~DownloadFile();
+
+	const byte* data() const { return mData; }
+	unsigned int size() const { return mSize; }
+
+	dtime_t lastused;
+
+private:
+	DownloadFile() :
+		lastused(0), mData(NULL), mSize(0), mMapped(false)
+		#ifdef _WIN32
+		, mFile(INVALID_HANDLE_VALUE), mMapping(NULL)
+		#endif
+	{ }
+
+	DownloadFile(const DownloadFile&);
+	DownloadFile& operator=(const DownloadFile&);
+
+	bool map(const std::string &filename);
+	bool read(const std::string &filename);
+
+	byte*			mData;
+	unsigned int	mSize;
+	bool			mMapped;
+
+	#ifdef _WIN32
+	HANDLE			mFile;
+	HANDLE			mMapping;
+	#endif
+};
+
+typedef std::map<std::string, DownloadFile*> DownloadCache;
+static DownloadCache download_cache;
+
+//
+// DownloadFile::open
+//
+// Returns NULL if the file can not be read.
+//
+DownloadFile* DownloadFile::open(const std::string &filename)
+{
+	DownloadFile *file = new DownloadFile;
+
+	if (file->map(filename) || file->read(filename))
+		return file;
+
+	delete file;
+	return NULL;
+}
+
+DownloadFile::~DownloadFile()
+{
+	if (!mMapped)
+	{
+		delete[] mData;
+		return;
+	}
+
+	#ifdef _WIN32
+	UnmapViewOfFile(mData);
+	CloseHandle(mMapping);
+	CloseHandle(mFile);
+	#else
+	munmap(mData, mSize);
+	#endif
+}
+
+#ifdef _WIN32
+
+bool DownloadFile::map(const std::string &filename)
+{
+	mFile = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+	                    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (mFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD size = GetFileSize(mFile, NULL);
+	if (size == INVALID_FILE_SIZE || size == 0)
+	{
+		CloseHandle(mFile);
+		return false;
+	}
+
+	mMapping = CreateFileMapping(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mMapping == NULL)
+	{
+		CloseHandle(mFile);
+		return false;
+	}
+
+	mData = (byte*)MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0);
+	if (mData == NULL)
+	{
+		CloseHandle(mMapping);
+		CloseHandle(mFile);
+		return false;
+	}
+
+	mSize = size;
+	mMapped = true;
+	return true;
+}
+
+#else
+
+bool DownloadFile::map(const std::string &filename)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || st.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return false;
+
+	// chunks are read in order, so let the kernel read ahead
+	madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+	mData = (byte*)data;
+	mSize = st.st_size;
+	mMapped = true;
+	return true;
+}
+
+#endif
+
+bool DownloadFile::read(const std::string &filename)
+{
+	FILE *fp = fopen(filename.c_str(), "rb");
+	if (!fp)
+		return false;
+
+	fseek(fp, 0, SEEK_END);
+	long size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	if (size < 0)
+	{
+		fclose(fp);
+		return false;
+	}
+
+	mData = new byte[size > 0 ? size : 1];
+	mSize = fread(mData, 1, size, fp);
+	fclose(fp);
+
+	return true;
+}
+
+//
+// SV_GetDownloadFile
+//
+static DownloadFile* SV_GetDownloadFile(const std::string &filename)
+{
+	DownloadCache::iterator it = download_cache.find(filename);
+	if (it != download_cache.end())
+		return it->second;
+
+	DownloadFile *file = DownloadFile::open(filename);
+	if (file)
+		download_cache[filename] = file;
+
+	return file;
+}
+
+//
+// SV_ExpireDownloadCache
+//
+// Unmaps files that nobody has downloaded from in a while.
+//
+static void SV_ExpireDownloadCache(dtime_t now)
+{
+	DownloadCache::iterator it = download_cache.begin();
+	while (it != download_cache.end())
+	{
+		if (now - it->second->lastused > DOWNLOAD_CACHE_TIMEOUT)
+		{
+			delete it->second;
+			download_cache.erase(it++);
+		}
+		else
+			++it;
+	}
+}
+
+//
+// SV_ClearDownloadCache
+//
+void SV_ClearDownloadCache(void)
+{
+	for (DownloadCache::iterator it = download_cache.begin(); it != download_cache.end(); ++it)
+		delete it->second;
+
+	download_cache.clear();
+}
+
+//
+// SV_StartDownload
+//
+// Called when a client asks for a new file.  The client is allowed to send
+// a single chunk straight away.
+//
+void SV_StartDownload(player_t &player)
+{
+	player.client.download.tokens = DOWNLOAD_CHUNK_SIZE;
+}
+
+//
+// SV_WadDownloads
+//
+// Sends each downloading client as many chunks as its download rate
+// allows.
+//
+void SV_WadDownloads(void)
+{
+	if (players.empty())
+	{
+		if (!download_cache.empty())
+			SV_ClearDownloadCache();
+		return;
+	}
+
+	dtime_t now = I_MSTime();
+
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (it->playerstate != PST_DOWNLOAD)
+			continue;
+
+		client_t *cl = &(it->client);
+
+		if (!cl->download.name.length())
+			continue;
+
+		DownloadFile *file = SV_GetDownloadFile(cl->download.name);
+		if (!file)
+			continue;
+
+		file->lastused = now;
+
+		// maximum rate client can download at (in bytes per second)
+		int download_rate = (sv_waddownloadcap > cl->rate) ? cl->rate * 1000 : sv_waddownloadcap * 1000;
+
+		// Refill the client's bucket with one tic worth of data, allowing
+		// at most one extra chunk to build up while it waits.
+		int refill = download_rate / TICRATE;
+		int capacity = refill + DOWNLOAD_CHUNK_SIZE;
+
+		cl->download.tokens += refill;
+		if (cl->download.tokens > capacity)
+			cl->download.tokens = capacity;
+
+		while (cl->download.next_offset < file->size())
+		{
+			unsigned int len = file->size() - cl->download.next_offset;
+			if (len > DOWNLOAD_CHUNK_SIZE)
+				len = DOWNLOAD_CHUNK_SIZE;
+
+			if (cl->download.tokens < (int)len)
+				break;
+
+			// [SL] 2011-08-09 - Always send the data in netbuf and reliablebuf prior
+			// to writing a wadchunk to netbuf to keep packet sizes below the MTU.
+			// This prevents packets from getting dropped due to size on some networks.
+			if (cl->netbuf.size() + cl->reliablebuf.size())
+				SV_SendPacket(*it);
+
+			if (!cl->download.next_offset)
+			{
+				MSG_WriteMarker(&cl->netbuf, svc_wadinfo);
+				MSG_WriteLong(&cl->netbuf, file->size());
+			}
+
+			MSG_WriteMarker(&cl->netbuf, svc_wadchunk);
+			MSG_WriteLong(&cl->netbuf, cl->download.next_offset);
+			MSG_WriteShort(&cl->netbuf, len);
+			MSG_WriteChunk(&cl->netbuf, file->data() + cl->download.next_offset, len);
+
+			// Make double-sure the wadchunk is sent in its own packet
+			SV_SendPacket(*it);
+
+			cl->download.next_offset += len;
+			cl->download.tokens -= len;
+		}
+	}
+
+	SV_ExpireDownloadCache(now);
+}
+
+VERSION_CONTROL (sv_download_cpp, "$Id$")
@@ -0,0 +1,33 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Serves WAD files to downloading clients.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __SV_DOWNLOAD_H__
+#define __SV_DOWNLOAD_H__
+
+class player_s;
+typedef player_s player_t;
+
+void SV_StartDownload(player_t &player);
+void SV_WadDownloads(void);
+void SV_ClearDownloadCache(void);
+
+#endif
@@ -0,0 +1,203 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Rate limiting of packets from addresses that are not connected.
+//
+//  Every packet from an address that doesn't belong to a player has to
+//  pass a token bucket for its IP, and one shared by every IP, before it
+//  is even parsed.  Buckets live in a fixed-size table indexed by a hash
+//  of the IP, so a flood from spoofed addresses can not use up memory; it
+//  only evicts other entries, which start again with a full bucket.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+#include <vector>
+
+#include "doomtype.h"
+#include "c_cvars.h"
+#include "c_dispatch.h"
+#include "i_system.h"
+#include "sv_flood.h"
+
+EXTERN_CVAR(sv_floodrate)
+EXTERN_CVAR(sv_floodburst)
+EXTERN_CVAR(sv_floodglobalrate)
+
+struct floodentry_t
+{
+	byte		ip[4];
+	bool		used;
+	dtime_t		last;		// when tokens was last topped up, in ms
+	dtime_t		tokens;		// in thousandths of a packet
+	unsigned	counts[NUM_FLOODCOUNTERS];
+};
+
+static const size_t FLOOD_TABLE_SIZE = 4096;
+
+static floodentry_t flood_table[FLOOD_TABLE_SIZE];
+static dtime_t flood_global_last = 0;
+static dtime_t flood_global_tokens = 0;
+static unsigned flood_totals[NUM_FLOODCOUNTERS];
+
+//
+// SV_FloodEntry
+//
+// Returns the table entry for an address, taking it over from whichever IP
+// had it before if necessary.
+//
+static floodentry_t &SV_FloodEntry(const netadr_t &from, dtime_t now)
+{
+	unsigned hash = (from.ip[0] * 16777619u) ^ (from.ip[1] * 2654435761u) ^
+	                (from.ip[2] * 40503u) ^ (from.ip[3] * 2246822519u);
+	floodentry_t &entry = flood_table[(hash ^ (hash >> 12)) & (FLOOD_TABLE_SIZE - 1)];
+
+	if (!entry.used || memcmp(entry.ip, from.ip, sizeof(entry.ip)) != 0)
+	{
+		memcpy(entry.ip, from.ip, sizeof(entry.ip));
+		entry.used = true;
+		entry.last = now;
+		entry.tokens = 1000 * (dtime_t)sv_floodburst.asInt();
+		memset(entry.counts, 0, sizeof(entry.counts));
+	}
+
+	return entry;
+}
+
+//
+// SV_TakeToken
+//
+// Tops up a token bucket for the time that has passed and takes a token
+// from it if there is one.
+//
+static bool SV_TakeToken(dtime_t &tokens, dtime_t &last, dtime_t now,
+                         int rate, int burst)
+{
+	dtime_t max_tokens = 1000 * (dtime_t)burst;
+
+	if (now > last)
+	{
+		tokens += (now - last) * rate;
+		if (tokens > max_tokens)
+			tokens = max_tokens;
+	}
+	last = now;
+
+	if (tokens < 1000)
+		return false;
+
+	tokens -= 1000;
+	return true;
+}
+
+//
+// SV_FloodCheck
+//
+// Returns false if a packet from an address that is not connected should be
+// dropped without looking at it.
+//
+bool SV_FloodCheck(const netadr_t &from)
+{
+	int rate = sv_floodrate.asInt();
+	int globalrate = sv_floodglobalrate.asInt();
+
+	if (rate <= 0 && globalrate <= 0)
+		return true;
+
+	dtime_t now = I_MSTime();
+	floodentry_t &entry = SV_FloodEntry(from, now);
+
+	bool allowed = true;
+
+	if (rate > 0)
+	{
+		int burst = std::max(sv_floodburst.asInt(), 1);
+		allowed = SV_TakeToken(entry.tokens, entry.last, now, rate, burst);
+	}
+
+	// The shared bucket allows a second's worth of packets in a burst.
+	if (allowed && globalrate > 0)
+		allowed = SV_TakeToken(flood_global_tokens, flood_global_last, now,
+		                       globalrate, globalrate);
+
+	if (!allowed)
+	{
+		entry.counts[FLOOD_DROP]++;
+		flood_totals[FLOOD_DROP]++;
+	}
+
+	return allowed;
+}
+
+//
+// SV_FloodCount
+//
+void SV_FloodCount(const netadr_t &from, floodcounter_t counter)
+{
+	SV_FloodEntry(from, I_MSTime()).counts[counter]++;
+	flood_totals[counter]++;
+}
+
+static bool SV_CompareFloodEntries(const floodentry_t *a, const floodentry_t *b)
+{
+	return a->counts[FLOOD_DROP] > b->counts[FLOOD_DROP];
+}
+
+//
+// floodstats
+//
+// Lists the addresses that have sent the most packets that were dropped.
+// "floodstats reset" clears the counters.
+//
+BEGIN_COMMAND(floodstats)
+{
+	if (argc > 1 && stricmp(argv[1], "reset") == 0)
+	{
+		memset(flood_table, 0, sizeof(flood_table));
+		memset(flood_totals, 0, sizeof(flood_totals));
+		Printf(PRINT_HIGH, "floodstats: counters reset.\n");
+		return;
+	}
+
+	Printf(PRINT_HIGH, "%u connects, %u queries, %u dropped\n",
+	       flood_totals[FLOOD_CONNECT], flood_totals[FLOOD_QUERY],
+	       flood_totals[FLOOD_DROP]);
+
+	std::vector<const floodentry_t*> entries;
+	for (size_t i = 0; i < FLOOD_TABLE_SIZE; i++)
+	{
+		const floodentry_t &entry = flood_table[i];
+		if (entry.used && (entry.counts[FLOOD_CONNECT] ||
+		                   entry.counts[FLOOD_QUERY] || entry.counts[FLOOD_DROP]))
+			entries.push_back(&entry);
+	}
+
+	std::sort(entries.begin(), entries.end(), SV_CompareFloodEntries);
+
+	for (size_t i = 0; i < entries.size() && i < 20; i++)
+	{
+		const floodentry_t &entry = *entries[i];
+		Printf(PRINT_HIGH, "%d.%d.%d.%d: %u connects, %u queries, %u dropped\n",
+		       entry.ip[0], entry.ip[1], entry.ip[2], entry.ip[3],
+		       entry.counts[FLOOD_CONNECT], entry.counts[FLOOD_QUERY],
+		       entry.counts[FLOOD_DROP]);
+	}
+}
+END_COMMAND(floodstats)
+
+VERSION_CONTROL (sv_flood_cpp, "$Id$")
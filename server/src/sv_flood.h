@@ -0,0 +1,40 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Rate limiting of packets from addresses that are not connected.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __SV_FLOOD_H__
+#define __SV_FLOOD_H__
+
+#include "i_net.h"
+
+enum floodcounter_t
+{
+	FLOOD_CONNECT,		// connection attempts with a valid token
+	FLOOD_QUERY,		// launcher and SQP queries
+	FLOOD_DROP,			// packets thrown away
+
+	NUM_FLOODCOUNTERS
+};
+
+bool SV_FloodCheck(const netadr_t &from);
+void SV_FloodCount(const netadr_t &from, floodcounter_t counter);
+
+#endif // __SV_FLOOD_H__
@@ -0,0 +1,353 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Writes console output to stdout, the log file and the JSON log.
+//
+//  Normally every line is written and flushed as soon as it is printed.
+//  With log_thread enabled, lines are instead passed through a lock-free
+//  queue to a writer thread, which writes them in batches and flushes at
+//  most every log_flushinterval milliseconds, so that a slow disk or
+//  terminal can not hold up the game.  If the queue fills up, lines are
+//  counted and dropped rather than making the game thread wait.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <time.h>
+#include <fstream>
+#include <string>
+
+#include "doomtype.h"
+#include "cmdlib.h"
+#include "c_cvars.h"
+#include "i_system.h"
+#include "i_thread.h"
+#include "sv_log.h"
+
+struct log_record_t
+{
+	std::string	text;		// as printed, including the timestamp
+	size_t		msgstart;	// where the message starts in text
+	int			printlevel;
+	time_t		time;
+};
+
+static const size_t LOG_QUEUE_SIZE = 1024;
+
+typedef OSPSCQueue<log_record_t, LOG_QUEUE_SIZE> LogQueue;
+
+static LogQueue			log_queue;
+static OThread			log_writer;
+static OSemaphore		log_wake;
+static OSemaphore		log_flushed;
+static volatile size_t	log_thread_quit = 0;
+static volatile size_t	log_flush_request = 0;
+static volatile size_t	log_interval = 100;		// copy of log_flushinterval
+static bool				log_thread_running = false;
+
+// Only touched by the game thread.
+static size_t			log_dropped = 0;
+
+// Written to by whichever thread is writing records.
+static std::ofstream	log_json;
+
+//
+// SV_WriteJSONString
+//
+static void SV_WriteJSONString(std::ofstream &out, const std::string &str)
+{
+	out << '"';
+
+	for (size_t i = 0; i < str.length(); i++)
+	{
+		unsigned char c = str[i];
+
+		if (c == '"' || c == '\\')
+			out << '\\' << c;
+		else if (c == '\n')
+			out << "\\n";
+		else if (c == '\t')
+			out << "\\t";
+		else if (c < 0x20)
+		{
+			char esc[8];
+			sprintf(esc, "\\u%04x", c);
+			out << esc;
+		}
+		else
+			out << c;
+	}
+
+	out << '"';
+}
+
+//
+// SV_WriteRecord
+//
+// Writes a record to every output without flushing them.
+//
+static void SV_WriteRecord(const log_record_t &rec)
+{
+	std::string sanitized(rec.text);
+	StripColorCodes(sanitized);
+
+	fputs(sanitized.c_str(), stdout);
+
+	if (LOG.is_open())
+		LOG << rec.text;
+
+	if (log_json.is_open())
+	{
+		std::string msg(sanitized, rec.msgstart < sanitized.length() ? rec.msgstart : 0);
+		if (!msg.empty() && msg[msg.length() - 1] == '\n')
+			msg.erase(msg.length() - 1);
+
+		log_json << "{\"time\":" << (unsigned long)rec.time
+		         << ",\"level\":" << rec.printlevel << ",\"message\":";
+		SV_WriteJSONString(log_json, msg);
+		log_json << "}\n";
+	}
+}
+
+//
+// SV_FlushOutputs
+//
+static void SV_FlushOutputs()
+{
+	fflush(stdout);
+
+	if (LOG.is_open())
+		LOG.flush();
+
+	if (log_json.is_open())
+		log_json.flush();
+}
+
+//
+// SV_LogThreadMain
+//
+static void SV_LogThreadMain(void *data)
+{
+	for (;;)
+	{
+		size_t interval = I_AtomicLoad(&log_interval);
+		log_wake.timedWait(interval > 0 ? interval : 1000);
+
+		// Read the requests before emptying the queue, so that everything
+		// queued before a request was made is written out before it is
+		// answered.
+		size_t quit = I_AtomicLoad(&log_thread_quit);
+		size_t flush = I_AtomicLoad(&log_flush_request);
+
+		bool wrote = false;
+		while (log_record_t *rec = log_queue.front())
+		{
+			SV_WriteRecord(*rec);
+			log_queue.pop();
+			wrote = true;
+		}
+
+		if (wrote)
+			SV_FlushOutputs();
+
+		if (flush)
+		{
+			I_AtomicStore(&log_flush_request, 0);
+			log_flushed.post();
+		}
+
+		if (quit)
+			return;
+	}
+}
+
+//
+// SV_QueueRecord
+//
+// Returns false if the queue is full.
+//
+static bool SV_QueueRecord(int printlevel, const std::string &str, size_t msgstart)
+{
+	log_record_t *rec = log_queue.back();
+	if (!rec)
+		return false;
+
+	// Assigning to the slot's string reuses its buffer.
+	rec->text = str;
+	rec->msgstart = msgstart;
+	rec->printlevel = printlevel;
+	rec->time = time(NULL);
+	log_queue.push();
+
+	return true;
+}
+
+//
+// SV_LogPrint
+//
+// Writes a line of console output.  str is the line as printed and msgstart
+// is the offset of the message after the timestamp.  Must only be called
+// from the game thread.
+//
+void SV_LogPrint(int printlevel, const std::string &str, size_t msgstart)
+{
+	if (!log_thread_running)
+	{
+		log_record_t rec;
+		rec.text = str;
+		rec.msgstart = msgstart;
+		rec.printlevel = printlevel;
+		rec.time = time(NULL);
+
+		SV_WriteRecord(rec);
+		SV_FlushOutputs();
+		return;
+	}
+
+	if (log_dropped)
+	{
+		char msg[64];
+		sprintf(msg, "%u log messages dropped\n", (unsigned)log_dropped);
+
+		if (!SV_QueueRecord(PRINT_HIGH, msg, 0))
+		{
+			log_dropped++;
+			return;
+		}
+
+		log_dropped = 0;
+	}
+
+	if (!SV_QueueRecord(printlevel, str, msgstart))
+	{
+		log_dropped++;
+		return;
+	}
+
+	// Wake the writer early if lines are to be written straight away or
+	// the queue is filling up faster than the flush interval empties it.
+	if (log_interval == 0 || log_queue.size() >= LOG_QUEUE_SIZE / 2)
+		log_wake.post();
+}
+
+//
+// SV_FlushLog
+//
+// Waits until everything printed so far has been written and flushed.
+// Afterwards the writer thread leaves the outputs alone until something
+// else is printed, so LOG and the JSON log can safely be reopened.
+//
+void SV_FlushLog()
+{
+	if (!log_thread_running)
+	{
+		SV_FlushOutputs();
+		return;
+	}
+
+	I_AtomicStore(&log_flush_request, 1);
+	log_wake.post();
+	log_flushed.wait();
+}
+
+//
+// SV_StartLogThread
+//
+bool SV_StartLogThread()
+{
+	if (log_thread_running)
+		return true;
+
+	static bool registered = false;
+	if (!registered)
+	{
+		atterm(SV_StopLogThread);
+		registered = true;
+	}
+
+	log_thread_quit = 0;
+	log_flush_request = 0;
+
+	if (!log_writer.start(&SV_LogThreadMain, NULL))
+	{
+		Printf(PRINT_HIGH, "SV_StartLogThread: unable to create thread\n");
+		return false;
+	}
+
+	log_thread_running = true;
+	return true;
+}
+
+//
+// SV_StopLogThread
+//
+// Writes out everything still queued and stops the writer thread.
+//
+void STACK_ARGS SV_StopLogThread()
+{
+	if (!log_thread_running)
+		return;
+
+	I_AtomicStore(&log_thread_quit, 1);
+	log_wake.post();
+	log_writer.join();
+
+	log_thread_running = false;
+
+	if (log_dropped)
+	{
+		Printf(PRINT_HIGH, "%u log messages dropped\n", (unsigned)log_dropped);
+		log_dropped = 0;
+	}
+}
+
+//
+// log_jsonfile
+//
+// Also writes every line to this file as a JSON object, one per line.
+//
+CVAR_FUNC_IMPL(log_jsonfile)
+{
+	SV_FlushLog();
+
+	if (log_json.is_open())
+		log_json.close();
+
+	if (!strlen(var.cstring()))
+		return;
+
+	log_json.open(var.cstring(), std::ios::app);
+
+	if (!log_json.is_open())
+		Printf(PRINT_HIGH, "Unable to open JSON log file: %s\n", var.cstring());
+}
+
+CVAR_FUNC_IMPL(log_flushinterval)
+{
+	I_AtomicStore(&log_interval, var.asInt());
+}
+
+CVAR_FUNC_IMPL(log_thread)
+{
+	if (var)
+		SV_StartLogThread();
+	else
+		SV_StopLogThread();
+}
+
+VERSION_CONTROL (sv_log_cpp, "$Id$")
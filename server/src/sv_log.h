@@ -0,0 +1,36 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//  Writes console output to stdout, the log file and the JSON log,
+//  optionally on a separate thread.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __SV_LOG_H__
+#define __SV_LOG_H__
+
+#include <string>
+
+#include "doomtype.h"
+
+void SV_LogPrint(int printlevel, const std::string &str, size_t msgstart);
+void SV_FlushLog();
+bool SV_StartLogThread();
+void STACK_ARGS SV_StopLogThread();
+
+#endif
@@ -65,6 +65,11 @@
 #include "d_main.h"
 #include "m_fileio.h"
 #include "m_wdlstats.h"
+#include "stats.h"
+#include "sv_delta.h"
+#include "sv_download.h"
+#include "sv_flood.h"
+#include "hashtable.h"
 
 #include <algorithm>
 #include <sstream>
@@ -114,7 +119,6 @@ EXTERN_CVAR(sv_sharekeys)
 
 void SexMessage (const char *from, char *to, int gender,
 	const char *victim, const char *killer);
-Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it);
 void P_PlayerLeavesGame(player_s* player);
 
 void SV_UpdateShareKeys(player_t& player);
@@ -231,6 +235,8 @@ CVAR_FUNC_IMPL (join_password)
 		Printf(PRINT_HIGH, "join password set");
 	else
 		Printf(PRINT_HIGH, "join password cleared");
+
+	SV_QryInvalidate();
 }
 
 CVAR_FUNC_IMPL (rcon_password) // Remote console password.
@@ -435,6 +441,27 @@ BEGIN_COMMAND (exit)
 END_COMMAND (exit)
 
 
+//
+// sv_netthread
+//
+// The socket is handed to the network thread once it has been created.
+//
+CVAR_FUNC_IMPL(sv_netthread)
+{
+	if (!network_game)
+		return;
+
+	if (var)
+		NET_StartThread();
+	else
+		NET_StopThread();
+}
+
+CVAR_FUNC_IMPL(sv_sightthreads)
+{
+	P_SetSightThreads(var.asInt());
+}
+
 //
 // SV_InitNetwork
 //
@@ -454,6 +481,11 @@ void SV_InitNetwork (void)
 	// set up a socket and net_message buffer
 	InitNetCommon();
 
+	SV_InitTokenSecret();
+
+	if (sv_netthread)
+		NET_StartThread();
+
 	// determine my name & address
 	// NET_GetLocalAddress ();
 
@@ -493,19 +525,54 @@ Players::iterator SV_GetFreeClient(void)
 
 	// update tracking cvar
 	sv_clientcount.ForceSet(players.size());
+	SV_QryInvalidate();
 
 	// Return iterator pointing to the just-inserted player
 	Players::iterator it = players.end();
 	return --it;
 }
 
+// Connected clients indexed by address, so that finding the sender of
+// an incoming packet doesn't require a look at every player.
+typedef OHashTable<QWORD, player_t*> PlayerAddressTable;
+static PlayerAddressTable players_by_address;
+
+static QWORD SV_AddressKey(const netadr_t &adr)
+{
+	return ((QWORD)adr.ip[0] << 40) | ((QWORD)adr.ip[1] << 32) |
+	       ((QWORD)adr.ip[2] << 24) | ((QWORD)adr.ip[3] << 16) | adr.port;
+}
+
+//
+// SV_IndexPlayerAddress
+//
+// Must be called whenever a player's address is assigned.
+//
+void SV_IndexPlayerAddress(player_t &player)
+{
+	players_by_address[SV_AddressKey(player.client.address)] = &player;
+}
+
+//
+// SV_UnindexPlayerAddress
+//
+// Must be called before a player is removed from the players list.
+//
+static void SV_UnindexPlayerAddress(player_t &player)
+{
+	PlayerAddressTable::iterator it =
+		players_by_address.find(SV_AddressKey(player.client.address));
+
+	if (it != players_by_address.end() && it->second == &player)
+		players_by_address.erase(it);
+}
+
 player_t &SV_FindPlayerByAddr(void)
 {
-	for (Players::iterator it = players.begin();it != players.end();++it)
-	{
-		if (NET_CompareAdr(it->client.address, net_from))
-		   return *it;
-	}
+	PlayerAddressTable::iterator it = players_by_address.find(SV_AddressKey(net_from));
+
+	if (it != players_by_address.end())
+		return *it->second;
 
 	return idplayer(0);
 }
@@ -547,6 +614,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 	while ((mo = iterator.Next()))
 		mo->players_aware.unset(it->id);
 
+	SV_DeltaResetPlayer(*it);
+
 	// remove this player's actor object
 	if (it->mo)
 	{
@@ -564,6 +633,8 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 	}
 
 	// remove this player from the global players vector
+	SV_UnindexPlayerAddress(*it);
+
 	Players::iterator next;
 	next = players.erase(it);
 	free_player_ids.insert(player_id);
@@ -572,6 +643,7 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 
 	// update tracking cvar
 	sv_clientcount.ForceSet(players.size());
+	SV_QryInvalidate();
 
 	return next;
 }
@@ -581,12 +653,17 @@ Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it)
 //
 void SV_GetPackets()
 {
+	PROFILE_ZONE("SV_GetPackets");
+
 	while (NET_GetPacket())
 	{
 		player_t &player = SV_FindPlayerByAddr();
 
 		if (!validplayer(player)) // no client with net_from address
 		{
+			if (!SV_FloodCheck(net_from))
+				continue;
+
 			// apparently, someone is trying to connect
 			if (gamestate == GS_LEVEL || gamestate == GS_INTERMISSION)
 				SV_ConnectClient();
@@ -992,6 +1069,7 @@ bool SV_SetupUserInfo(player_t &player)
 		new_netname.erase(MAXPLAYERNAME);
 
 	player.userinfo.netname = new_netname;
+	SV_QryInvalidate();
 
 	// Compare names and broadcast if different.
 	if (!old_netname.empty() && !iequals(new_netname, old_netname))
@@ -1204,6 +1282,7 @@ bool SV_AwarenessUpdate(player_t &player, AActor *mo)
 	if(!ok && previously_ok)
 	{
 		mo->players_aware.unset(player.id);
+		SV_DeltaForgetActor(player, mo);
 
 		MSG_WriteMarker (&cl->reliablebuf, svc_removemobj);
 		MSG_WriteShort (&cl->reliablebuf, mo->netid);
@@ -1213,6 +1292,7 @@ bool SV_AwarenessUpdate(player_t &player, AActor *mo)
 	else if(!previously_ok && ok)
 	{
 		mo->players_aware.set(player.id);
+		SV_DeltaForgetActor(player, mo);
 
 		if(!mo->player || mo->player->playerstate != PST_LIVE)
 		{
@@ -1692,6 +1772,8 @@ void SV_SendServerSettings (player_t &pl)
 //
 void SV_ServerSettingChange (void)
 {
+	SV_QryInvalidate();
+
 	if (gamestate != GS_LEVEL)
 		return;
 
@@ -1869,19 +1951,25 @@ void SV_ConnectClient()
 
 	// New querying system
 	if (SV_QryParseEnquiry(challenge) == 0)
+	{
+		SV_FloodCount(net_from, FLOOD_QUERY);
 		return;
+	}
 
 	if (challenge == LAUNCHER_CHALLENGE)  // for Launcher
 	{
+		SV_FloodCount(net_from, FLOOD_QUERY);
 		SV_SendServerInfo();
 		return;
 	}
 
-	if (challenge != CHALLENGE)
+	if (challenge != CHALLENGE || !SV_IsValidToken(MSG_ReadLong()))
+	{
+		SV_FloodCount(net_from, FLOOD_DROP);
 		return;
+	}
 
-	if (!SV_IsValidToken(MSG_ReadLong()))
-		return;
+	SV_FloodCount(net_from, FLOOD_CONNECT);
 
 	Printf(PRINT_HIGH, "%s is trying to connect...\n", NET_AdrToString (net_from));
 
@@ -1905,6 +1993,7 @@ void SV_ConnectClient()
 
 	// clear and reinitialize client network info
 	cl->address = net_from;
+	SV_IndexPlayerAddress(*player);
 	cl->last_received = gametic;
 	cl->reliable_bps = 0;
 	cl->unreliable_bps = 0;
@@ -2178,6 +2267,7 @@ void SV_SendDisconnectSignal()
 	}
 
 	players.clear();
+	players_by_address.clear();
 }
 
 //
@@ -2197,6 +2287,7 @@ void SV_SendReconnectSignal()
 	}
 
 	players.clear();
+	players_by_address.clear();
 }
 
 //
@@ -2880,60 +2971,208 @@ bool SV_PrivMsg(player_t &player)
 	return true;
 }
 
+// Actors that are due for a position update this tic, sorted by the
+// blockmap cell they are in.  These are gathered once per tic by
+// SV_ClassifyActorUpdates so that sending updates to each client only has
+// to look at the cells around what that client is watching.
+struct actorupdate_t
+{
+	int		block;
+	AActor	*mo;
+
+	bool operator<(const actorupdate_t &other) const
+	{
+		return block < other.block;
+	}
+};
+
+static std::vector<actorupdate_t> missile_updates;
+static std::vector<actorupdate_t> monster_updates;
+
+// the updates that are relevant to the client being written to
+static std::vector<AActor*> relevant_updates;
+
+EXTERN_CVAR(sv_updaterange)
+
 //
-// SV_UpdateMissiles
-// Updates missiles position sometimes.
+// SV_MissileNeedsUpdate
 //
-void SV_UpdateMissiles(player_t &pl)
+static bool SV_MissileNeedsUpdate(AActor *mo)
 {
-    AActor *mo;
+	if (!(mo->flags & MF_MISSILE || mo->flags & MF_SKULLFLY))
+		return false;
 
-    TThinkerIterator<AActor> iterator;
-    while ( (mo = iterator.Next() ) )
-    {
-        if (!(mo->flags & MF_MISSILE || mo->flags & MF_SKULLFLY))
-			continue;
+	if (mo->type == MT_PLASMA)
+		return false;
 
-		if (mo->type == MT_PLASMA)
-			continue;
+	// update missile position every 30 tics
+	if (((gametic+mo->netid) % 30) && (mo->type != MT_TRACER) && (mo->type != MT_FATSHOT))
+		return false;
+	// Revenant tracers and Mancubus fireballs need to be  updated more often
+	else if (((gametic+mo->netid) % 5) && (mo->type == MT_TRACER || mo->type == MT_FATSHOT))
+		return false;
 
-		// update missile position every 30 tics
-		if (((gametic+mo->netid) % 30) && (mo->type != MT_TRACER) && (mo->type != MT_FATSHOT))
-			continue;
-		// Revenant tracers and Mancubus fireballs need to be  updated more often
-		else if (((gametic+mo->netid) % 5) && (mo->type == MT_TRACER || mo->type == MT_FATSHOT))
+	return true;
+}
+
+//
+// SV_MonsterNeedsUpdate
+//
+static bool SV_MonsterNeedsUpdate(AActor *mo)
+{
+	// Ignore corpses.
+	if (mo->flags & MF_CORPSE)
+		return false;
+
+	// We don't handle updating non-monsters here.
+	if (!(mo->flags & MF_COUNTKILL || mo->type == MT_SKULL))
+		return false;
+
+	// update monster position every 7 tics
+	if ((gametic+mo->netid) % 7)
+		return false;
+
+	return mo->target != NULL;
+}
+
+//
+// SV_ClassifyActorUpdates
+// Sorts the actors that need their position updated this tic into the
+// missile and monster update lists.
+//
+static void SV_ClassifyActorUpdates()
+{
+	missile_updates.clear();
+	monster_updates.clear();
+
+	AActor *mo;
+
+	TThinkerIterator<AActor> iterator;
+	while ( (mo = iterator.Next() ) )
+	{
+		bool missile = SV_MissileNeedsUpdate(mo);
+		bool monster = SV_MonsterNeedsUpdate(mo);
+
+		if (!missile && !monster)
 			continue;
 
+		// actors outside of the blockmap are counted in the nearest cell
+		int bx = clamp((mo->x - bmaporgx) >> MAPBLOCKSHIFT, 0, bmapwidth - 1);
+		int by = clamp((mo->y - bmaporgy) >> MAPBLOCKSHIFT, 0, bmapheight - 1);
+
+		actorupdate_t update;
+		update.block = by * bmapwidth + bx;
+		update.mo = mo;
+
+		if (missile)
+			missile_updates.push_back(update);
+		if (monster)
+			monster_updates.push_back(update);
+	}
+
+	std::sort(missile_updates.begin(), missile_updates.end());
+	std::sort(monster_updates.begin(), monster_updates.end());
+}
+
+//
+// SV_GatherRelevantUpdates
+//
+// Collects the updates for actors within sv_updaterange of what a player
+// is watching, which is their own body or the player they are spying on.
+//
+static void SV_GatherRelevantUpdates(player_t &pl, const std::vector<actorupdate_t> &updates)
+{
+	relevant_updates.clear();
+
+	player_t &target = idplayer(pl.spying);
+	AActor *view = pl.mo;
+	if (validplayer(target) && &target != &pl && P_CanSpy(pl, target) && target.mo)
+		view = target.mo;
+
+	if (sv_updaterange.asInt() == 0 || !view)
+	{
+		for (size_t i = 0; i < updates.size(); i++)
+			relevant_updates.push_back(updates[i].mo);
+		return;
+	}
+
+	fixed_t range = sv_updaterange.asInt() << FRACBITS;
+
+	int xl = clamp((view->x - range - bmaporgx) >> MAPBLOCKSHIFT, 0, bmapwidth - 1);
+	int xh = clamp((view->x + range - bmaporgx) >> MAPBLOCKSHIFT, 0, bmapwidth - 1);
+	int yl = clamp((view->y - range - bmaporgy) >> MAPBLOCKSHIFT, 0, bmapheight - 1);
+	int yh = clamp((view->y + range - bmaporgy) >> MAPBLOCKSHIFT, 0, bmapheight - 1);
+
+	// each row of cells in range is one run of the sorted updates
+	for (int by = yl; by <= yh; by++)
+	{
+		actorupdate_t first;
+		first.block = by * bmapwidth + xl;
+
+		std::vector<actorupdate_t>::const_iterator it =
+			std::lower_bound(updates.begin(), updates.end(), first);
+
+		for (; it != updates.end() && it->block <= by * bmapwidth + xh; ++it)
+			relevant_updates.push_back(it->mo);
+	}
+}
+
+//
+// SV_UpdateMissiles
+// Updates missiles position sometimes.
+//
+void SV_UpdateMissiles(player_t &pl)
+{
+	SV_GatherRelevantUpdates(pl, missile_updates);
+
+	for (size_t i = 0; i < relevant_updates.size(); i++)
+	{
+		AActor *mo = relevant_updates[i];
+
 		if(SV_IsPlayerAllowedToSee(pl, mo))
 		{
 			client_t *cl = &pl.client;
 
-			MSG_WriteMarker (&cl->netbuf, svc_movemobj);
-			MSG_WriteShort (&cl->netbuf, mo->netid);
-			MSG_WriteByte (&cl->netbuf, mo->rndindex);
-			MSG_WriteLong (&cl->netbuf, mo->x);
-			MSG_WriteLong (&cl->netbuf, mo->y);
-			MSG_WriteLong (&cl->netbuf, mo->z);
-
-			MSG_WriteMarker (&cl->netbuf, svc_mobjspeedangle);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteLong (&cl->netbuf, mo->angle);
-			MSG_WriteLong (&cl->netbuf, mo->momx);
-			MSG_WriteLong (&cl->netbuf, mo->momy);
-			MSG_WriteLong (&cl->netbuf, mo->momz);
-
+			byte fields = DELTA_POSITION | DELTA_MOMENTUM;
 			if (mo->tracer)
+				fields |= DELTA_TRACER;
+
+			fields = SV_DeltaChangedFields(pl, mo, fields);
+
+			if (fields & DELTA_POSITION)
+			{
+				MSG_WriteMarker (&cl->netbuf, svc_movemobj);
+				MSG_WriteShort (&cl->netbuf, mo->netid);
+				MSG_WriteByte (&cl->netbuf, mo->rndindex);
+				MSG_WriteLong (&cl->netbuf, mo->x);
+				MSG_WriteLong (&cl->netbuf, mo->y);
+				MSG_WriteLong (&cl->netbuf, mo->z);
+			}
+
+			if (fields & DELTA_MOMENTUM)
+			{
+				MSG_WriteMarker (&cl->netbuf, svc_mobjspeedangle);
+				MSG_WriteShort(&cl->netbuf, mo->netid);
+				MSG_WriteLong (&cl->netbuf, mo->angle);
+				MSG_WriteLong (&cl->netbuf, mo->momx);
+				MSG_WriteLong (&cl->netbuf, mo->momy);
+				MSG_WriteLong (&cl->netbuf, mo->momz);
+			}
+
+			if (fields & DELTA_TRACER)
 			{
 				MSG_WriteMarker (&cl->netbuf, svc_actor_tracer);
 				MSG_WriteShort(&cl->netbuf, mo->netid);
 				MSG_WriteShort (&cl->netbuf, mo->tracer->netid);
 			}
 
+			SV_DeltaWrote(pl, mo, fields);
+
             if (cl->netbuf.cursize >= 1024)
                 if(!SV_SendPacket(pl))
                     return;
 		}
-    }
+	}
 }
 
 // Update the given actors state immediately.
@@ -2959,49 +3198,55 @@ void SV_UpdateMobjState(AActor *mo)
 // Keep tabs on monster positions and angles.
 void SV_UpdateMonsters(player_t &pl)
 {
-	AActor *mo;
+	SV_GatherRelevantUpdates(pl, monster_updates);
 
-	TThinkerIterator<AActor> iterator;
-	while ((mo = iterator.Next()))
+	for (size_t i = 0; i < relevant_updates.size(); i++)
 	{
-		// Ignore corpses.
-		if (mo->flags & MF_CORPSE)
-			continue;
-
-		// We don't handle updating non-monsters here.
-		if (!(mo->flags & MF_COUNTKILL || mo->type == MT_SKULL))
-			continue;
-
-		// update monster position every 7 tics
-		if ((gametic+mo->netid) % 7)
-			continue;
+		AActor *mo = relevant_updates[i];
 
-		if (SV_IsPlayerAllowedToSee(pl, mo) && mo->target)
+		if (SV_IsPlayerAllowedToSee(pl, mo))
 		{
 			client_t *cl = &pl.client;
 
-			MSG_WriteMarker(&cl->netbuf, svc_movemobj);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteByte(&cl->netbuf, mo->rndindex);
-			MSG_WriteLong(&cl->netbuf, mo->x);
-			MSG_WriteLong(&cl->netbuf, mo->y);
-			MSG_WriteLong(&cl->netbuf, mo->z);
-
-			MSG_WriteMarker(&cl->netbuf, svc_mobjspeedangle);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteLong(&cl->netbuf, mo->angle);
-			MSG_WriteLong(&cl->netbuf, mo->momx);
-			MSG_WriteLong(&cl->netbuf, mo->momy);
-			MSG_WriteLong(&cl->netbuf, mo->momz);
-
-			MSG_WriteMarker(&cl->netbuf, svc_actor_movedir);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteByte(&cl->netbuf, mo->movedir);
-			MSG_WriteLong(&cl->netbuf, mo->movecount);
-
-			MSG_WriteMarker(&cl->netbuf, svc_actor_target);
-			MSG_WriteShort(&cl->netbuf, mo->netid);
-			MSG_WriteShort(&cl->netbuf, mo->target->netid);
+			byte fields = SV_DeltaChangedFields(pl, mo,
+				DELTA_POSITION | DELTA_MOMENTUM | DELTA_MOVEDIR | DELTA_TARGET);
+
+			if (fields & DELTA_POSITION)
+			{
+				MSG_WriteMarker(&cl->netbuf, svc_movemobj);
+				MSG_WriteShort(&cl->netbuf, mo->netid);
+				MSG_WriteByte(&cl->netbuf, mo->rndindex);
+				MSG_WriteLong(&cl->netbuf, mo->x);
+				MSG_WriteLong(&cl->netbuf, mo->y);
+				MSG_WriteLong(&cl->netbuf, mo->z);
+			}
+
+			if (fields & DELTA_MOMENTUM)
+			{
+				MSG_WriteMarker(&cl->netbuf, svc_mobjspeedangle);
+				MSG_WriteShort(&cl->netbuf, mo->netid);
+				MSG_WriteLong(&cl->netbuf, mo->angle);
+				MSG_WriteLong(&cl->netbuf, mo->momx);
+				MSG_WriteLong(&cl->netbuf, mo->momy);
+				MSG_WriteLong(&cl->netbuf, mo->momz);
+			}
+
+			if (fields & DELTA_MOVEDIR)
+			{
+				MSG_WriteMarker(&cl->netbuf, svc_actor_movedir);
+				MSG_WriteShort(&cl->netbuf, mo->netid);
+				MSG_WriteByte(&cl->netbuf, mo->movedir);
+				MSG_WriteLong(&cl->netbuf, mo->movecount);
+			}
+
+			if (fields & DELTA_TARGET)
+			{
+				MSG_WriteMarker(&cl->netbuf, svc_actor_target);
+				MSG_WriteShort(&cl->netbuf, mo->netid);
+				MSG_WriteShort(&cl->netbuf, mo->target->netid);
+			}
+
+			SV_DeltaWrote(pl, mo, fields);
 
 			if (cl->netbuf.cursize >= 1024)
 			{
@@ -3106,7 +3351,9 @@ void SV_SendPingRequest(client_t* cl)
 // current gametic
 void SV_CalcPing(player_t &player)
 {
-	unsigned int ping = I_MSTime() - MSG_ReadLong();
+	// Use the time the reply arrived rather than the time it was
+	// processed, which can be up to a tic later.
+	unsigned int ping = NET_PacketTime() - MSG_ReadLong();
 
 	if(ping > 999)
 		ping = 999;
@@ -3187,6 +3434,8 @@ void SV_ClearClientsBPS(void)
 //
 void SV_SendPackets()
 {
+	PROFILE_ZONE("SV_SendPackets");
+
 	if (players.empty())
 		return;
 
@@ -3203,10 +3452,13 @@ void SV_SendPackets()
 		++begin;
 
 	// Loop through all players in a staggered fashion.
+	static std::vector<player_t*> batch;
+	batch.clear();
+
 	Players::iterator it = begin;
 	do
 	{
-		SV_SendPacket(*it);
+		batch.push_back(&*it);
 
 		++it;
 		if (it == players.end())
@@ -3214,6 +3466,8 @@ void SV_SendPackets()
 	}
 	while (it != begin);
 
+	SV_SendPacketBatch(batch);
+
 	// Advance the send index.
 	fair_send++;
 }
@@ -3263,11 +3517,16 @@ void SV_SpyPlayer(player_t &viewer)
 //
 void SV_WriteCommands(void)
 {
+	PROFILE_ZONE("SV_WriteCommands");
+
 	// [SL] 2011-05-11 - Save player positions and moving sector heights so
 	// they can be reconciled later for unlagging
 	Unlag::getInstance().recordPlayerPositions();
 	Unlag::getInstance().recordSectorPositions();
 
+	// Figure out which actors need updating once, rather than per-client.
+	SV_ClassifyActorUpdates();
+
 	for (Players::iterator it = players.begin(); it != players.end(); ++it)
 	{
 		client_t *cl = &(it->client);
@@ -3626,6 +3885,8 @@ void SV_SetPlayerSpec(player_t &player, bool setting, bool silent)
 	if (player.ingame() == false)
 		return;
 
+	SV_QryInvalidate();
+
 	if (!setting && player.spectator)
 	{
 		// We want to unspectate the player.
@@ -4120,7 +4381,10 @@ void SV_WantWad(player_t &player)
 	}
 
 	if (player.playerstate != PST_DOWNLOAD || cl->download.name != wadfiles[i])
+	{
 		Printf(PRINT_HIGH, "> client %d is downloading %s\n", player.id, filename.c_str());
+		SV_StartDownload(player);
+	}
 
 	cl->download.name = wadfiles[i];
 	cl->download.md5 = md5;
@@ -4316,165 +4580,6 @@ void SV_WinCheck (void)
 	}
 }
 
-EXTERN_CVAR (sv_waddownloadcap)
-EXTERN_CVAR (sv_download_test)
-
-void SV_OptimizedDownloadTest()
-{
-	// nobody around?
-	if (players.empty())
-		return;
-
-	FILE* file = NULL;
-	std::string lastDownloadName;
-
-	// wad downloading
-	for (Players::iterator it = players.begin(); it != players.end(); ++it)
-	{
-		if (it->playerstate != PST_DOWNLOAD)
-			continue;
-
-		client_t *cl = &(it->client);
-
-		if (!cl->download.name.length())
-			continue;
-
-		static char buff[1024];
-		// Smaller buffer for slower clients
-		int chunk_size = (sizeof(buff) > (unsigned)cl->rate * 1000 / TICRATE) ? cl->rate * 1000 / TICRATE : sizeof(buff);
-
-		// maximum rate client can download at (in bytes per second)
-		int download_rate = (sv_waddownloadcap > cl->rate) ? cl->rate * 1000 : sv_waddownloadcap * 1000;
-
-		//Try to open/close the download file as little as possible.
-		//Too many fopen/fclose calls is inefficient and can choke out the game loop causing the server to be choppy with multiple clients downloading
-		if (lastDownloadName != cl->download.name)
-		{
-			if (file)
-				fclose(file);
-			file = fopen(cl->download.name.c_str(), "rb");
-			lastDownloadName = cl->download.name;
-		}
-
-		if (!file)
-			return;
-
-		do
-		{
-			// [SL] 2011-08-09 - Always send the data in netbuf and reliablebuf prior
-			// to writing a wadchunk to netbuf to keep packet sizes below the MTU.
-			// This prevents packets from getting dropped due to size on some networks.
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			if (!cl->download.next_offset)
-			{
-				MSG_WriteMarker(&cl->netbuf, svc_wadinfo);
-				MSG_WriteLong(&cl->netbuf, M_FileLength(file));
-			}
-
-			fseek(file, cl->download.next_offset, SEEK_SET);
-			size_t read = fread(buff, 1, chunk_size, file);
-
-			if (!read)
-				break;
-
-			MSG_WriteMarker(&cl->netbuf, svc_wadchunk);
-			MSG_WriteLong(&cl->netbuf, cl->download.next_offset);
-			MSG_WriteShort(&cl->netbuf, read);
-			MSG_WriteChunk(&cl->netbuf, buff, read);
-
-			// Make double-sure the wadchunk is sent in its own packet
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			cl->download.next_offset += read;
-		} while (
-			(double)(cl->reliable_bps + cl->unreliable_bps) * TICRATE
-			/ (double)(gametic % TICRATE)	// bps already used
-			+ (double)chunk_size / TICRATE 	// bps this chunk will use
-			< (double)download_rate);
-	}
-
-	if (file)
-		fclose(file);
-}
-
-void SV_DownloadOriginal()
-{
-	// nobody around?
-	if (players.empty())
-		return;
-
-	// wad downloading
-	for (Players::iterator it = players.begin(); it != players.end(); ++it)
-	{
-		if (it->playerstate != PST_DOWNLOAD)
-			continue;
-
-		client_t *cl = &(it->client);
-
-		if (!cl->download.name.length())
-			continue;
-
-		static char buff[1024];
-		// Smaller buffer for slower clients
-		int chunk_size = (sizeof(buff) > (unsigned)cl->rate * 1000 / TICRATE) ? cl->rate * 1000 / TICRATE : sizeof(buff);
-
-		// maximum rate client can download at (in bytes per second)
-		int download_rate = (sv_waddownloadcap > cl->rate) ? cl->rate * 1000 : sv_waddownloadcap * 1000;
-
-		do
-		{
-			// read next bit of wad
-			unsigned int read;
-			unsigned int filelen = 0;
-			read = W_ReadChunk(cl->download.name.c_str(), cl->download.next_offset, chunk_size, buff, filelen);
-
-			if (!read)
-				break;
-
-			// [SL] 2011-08-09 - Always send the data in netbuf and reliablebuf prior
-			// to writing a wadchunk to netbuf to keep packet sizes below the MTU.
-			// This prevents packets from getting dropped due to size on some networks.
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			if (!cl->download.next_offset)
-			{
-				MSG_WriteMarker(&cl->netbuf, svc_wadinfo);
-				MSG_WriteLong(&cl->netbuf, filelen);
-			}
-
-			MSG_WriteMarker(&cl->netbuf, svc_wadchunk);
-			MSG_WriteLong(&cl->netbuf, cl->download.next_offset);
-			MSG_WriteShort(&cl->netbuf, read);
-			MSG_WriteChunk(&cl->netbuf, buff, read);
-
-			// Make double-sure the wadchunk is sent in its own packet
-			if (cl->netbuf.size() + cl->reliablebuf.size())
-				SV_SendPacket(*it);
-
-			cl->download.next_offset += read;
-		} while (
-			(double)(cl->reliable_bps + cl->unreliable_bps) * TICRATE
-			/ (double)(gametic % TICRATE)	// bps already used
-			+ (double)chunk_size / TICRATE 	// bps this chunk will use
-			< (double)download_rate);
-	}
-}
-
-//
-// SV_WadDownloads
-//
-void SV_WadDownloads (void)
-{
-	if (sv_download_test)
-		SV_OptimizedDownloadTest();
-	else
-		SV_DownloadOriginal();
-}
-
 //
 //	SV_WinningTeam					[Toke - teams]
 //
@@ -4591,6 +4696,8 @@ void SV_IntermissionTimeCheck()
 //
 void SV_GameTics (void)
 {
+	PROFILE_ZONE("SV_GameTics");
+
 	if (sv_gametype == GM_CTF)
 		CTF_RunTics();
 
@@ -4681,6 +4788,7 @@ void SV_StepTics(QWORD count)
 		gametic++;
 	}
 
+	DThinker::ReclaimLingering();
 	DObject::EndFrame();
 }
 
@@ -4700,6 +4808,8 @@ void SV_DisplayTics()
 //
 void SV_RunTics()
 {
+	PROFILE_ZONE("SV_RunTics");
+
 	SV_GetPackets();
 
 	std::string cmd = I_ConsoleInput();
@@ -5265,7 +5375,10 @@ void SV_SendDestroyActor(AActor *mo)
 
 	// AActor no longer active. NetID released.
 	if (mo->netid)
+	{
+		SV_DeltaForgetNetID(mo->netid);
 		ServerNetID.ReleaseNetID( mo->netid );
+	}
 }
 
 // Missile exploded so tell clients about it
@@ -26,6 +26,7 @@
 #define __I_SVMAIN_H__
 
 #include <string>
+#include <vector>
 
 #include "actor.h"
 #include "d_player.h"
@@ -51,6 +52,11 @@ public:
 extern client_c clients;
 
 void SV_InitNetwork (void);
+Players::iterator SV_GetFreeClient(void);
+void SV_IndexPlayerAddress(player_t &player);
+player_t &SV_FindPlayerByAddr(void);
+Players::iterator SV_RemoveDisconnectedPlayer(Players::iterator it);
+void SV_StepTics(QWORD count);
 void SV_SendDisconnectSignal();
 void SV_SendReconnectSignal();
 void SV_ExitLevel();
@@ -66,8 +72,10 @@ void STACK_ARGS SV_PlayerPrintf (int level, int who, const char *fmt, ...);
 void SV_CheckTimeouts (void);
 void SV_ConnectClient(void);
 void SV_WriteCommands(void);
+void SV_SendPackets();
 void SV_ClearClientsBPS(void);
 bool SV_SendPacket(player_t &pl);
+void SV_SendPacketBatch(std::vector<player_t*> &batch);
 void SV_AcknowledgePacket(player_t &player);
 void SV_DisplayTics();
 void SV_RunTics();
@@ -27,6 +27,8 @@
 #include "sv_main.h"
 #include "huffman.h"
 #include "i_net.h"
+#include "sv_delta.h"
+#include "i_thread.h"
 
 #ifdef SIMULATE_LATENCY
 #include <thread>
@@ -36,6 +38,7 @@
 QWORD I_MSTime (void);
 
 EXTERN_CVAR (log_packetdebug)
+EXTERN_CVAR (sv_sendthreads)
 #ifdef SIMULATE_LATENCY
 EXTERN_CVAR (sv_latency)
 #endif
@@ -141,31 +144,40 @@ void SV_SendPacketDelayed(buf_t& packet, player_t& pl)
 #endif
 
 //
-// SV_SendPacket
+// SV_AssemblePacket
 //
-bool SV_SendPacket(player_t &pl)
+// Moves the contents of a client's reliable and unreliable buffers into a
+// single packet, ready to be compressed and sent.  Returns false if the
+// client had to be dropped.  If there is nothing to send, the packet is
+// left empty.
+//
+static bool SV_AssemblePacket(player_t &pl, buf_t &packet)
 {
 	int				bps = 0; // bytes per second, not bits per second
 
 	client_t *cl = &pl.client;
 
+	packet.clear();
+
 	if (cl->reliablebuf.overflowed)
 	{ 
 		SZ_Clear(&cl->netbuf);
 		SZ_Clear(&cl->reliablebuf);
+		SV_DeltaPacketSent(pl, cl->sequence, false);
 	    SV_DropClient(pl);
 		return false;
 	}
 	else
 		if (cl->netbuf.overflowed)
+		{
 			SZ_Clear(&cl->netbuf);
+			SV_DeltaPacketSent(pl, cl->sequence, false);
+		}
 
 	// [SL] 2012-05-04 - Don't send empty packets - they still have overhead
 	if (cl->reliablebuf.cursize + cl->netbuf.cursize == 0)
 		return true;
 
-	sendd.clear();
-
 	// save the reliable message 
 	// it will be retransmited, if it's missed
 
@@ -186,12 +198,12 @@ bool SV_SendPacket(player_t &pl)
 	                 // because sizeof(packetnum) == 1. Don't need
 	                 // to use &0xff. Cool, eh? ;-)
 	// copy sequence
-	MSG_WriteLong(&sendd, cl->sequence++);
+	MSG_WriteLong(&packet, cl->sequence++);
     
 	// copy the reliable message to the packet first
     if (cl->reliablebuf.cursize)
     {
-		SZ_Write (&sendd, cl->reliablebuf.data, cl->reliablebuf.cursize);
+		SZ_Write (&packet, cl->reliablebuf.data, cl->reliablebuf.cursize);
 		cl->reliable_bps += cl->reliablebuf.cursize;
     }
 
@@ -200,26 +212,56 @@ bool SV_SendPacket(player_t &pl)
 	if (gametic % 35)
 	    bps = (int)((double)( (cl->unreliable_bps + cl->reliable_bps) * TICRATE)/(double)(gametic%35));
 
+	bool unreliable = false;
+
     if (bps < cl->rate*1000)
 
-	  if (cl->netbuf.cursize && (sendd.maxsize() - sendd.cursize > cl->netbuf.cursize) )
+	  if (cl->netbuf.cursize && (packet.maxsize() - packet.cursize > cl->netbuf.cursize) )
 	  {
-         SZ_Write (&sendd, cl->netbuf.data, cl->netbuf.cursize);
+         SZ_Write (&packet, cl->netbuf.data, cl->netbuf.cursize);
 	     cl->unreliable_bps += cl->netbuf.cursize;
+	     unreliable = true;
 	  }
+
+	// remember which actor updates made it into this packet
+	SV_DeltaPacketSent(pl, cl->sequence - 1, unreliable);
     
 	SZ_Clear(&cl->netbuf);
 	SZ_Clear(&cl->reliablebuf);
-	
-	// compress the packet, but not the sequence id
-	if (sendd.size() > sizeof(int))
-		SV_CompressPacket(sendd, sizeof(int), cl);
 
+	return true;
+}
+
+//
+// SV_LogPacket
+//
+static void SV_LogPacket(player_t &pl, buf_t &packet)
+{
 	if (log_packetdebug)
 	{
 		Printf(PRINT_HIGH, "ply %03u, pkt %06u, size %04u, tic %07u, time %011u\n",
-			   pl.id, cl->sequence - 1, sendd.cursize, gametic, I_MSTime());
+			   pl.id, pl.client.sequence - 1, packet.cursize, gametic, I_MSTime());
 	}
+}
+
+//
+// SV_SendPacket
+//
+bool SV_SendPacket(player_t &pl)
+{
+	client_t *cl = &pl.client;
+
+	if (!SV_AssemblePacket(pl, sendd))
+		return false;
+
+	if (sendd.size() == 0)
+		return true;
+
+	// compress the packet, but not the sequence id
+	if (sendd.size() > sizeof(int))
+		SV_CompressPacket(sendd, sizeof(int), cl);
+
+	SV_LogPacket(pl, sendd);
 
 #ifdef SIMULATE_LATENCY
 	SV_SendPacketDelayed(sendd, pl);
@@ -230,6 +272,86 @@ bool SV_SendPacket(player_t &pl)
 	return true;
 }
 
+// Per-tic packet sending can spread the work of compressing each
+// client's packet across several threads.
+static OWorkerPool send_pool;
+static std::vector<compress_scratch_t*> send_scratch;
+static std::vector<buf_t*> send_packets;
+static std::vector<netadr_t> send_addresses;
+
+CVAR_FUNC_IMPL(sv_sendthreads)
+{
+	send_pool.resize(var.asInt());
+}
+
+static void SV_CompressPacketJob(size_t index, size_t worker, void *data)
+{
+	buf_t &packet = *send_packets[index];
+
+	if (packet.size() <= sizeof(int))
+		return;
+
+	int need_gap = 2; // for svc_compressed and method, below
+
+	if (MSG_CompressMinilzo(packet, sizeof(int), need_gap, *send_scratch[worker]))
+	{
+		packet.ptr()[sizeof(int)] = svc_compressed;
+		packet.ptr()[sizeof(int) + 1] = minilzo_mask;
+	}
+}
+
+//
+// SV_SendPacketBatch
+//
+// Sends a packet to each of the given players, in order.  The packets are
+// put together one at a time, compressed in parallel and then sent all at
+// once.
+//
+void SV_SendPacketBatch(std::vector<player_t*> &batch)
+{
+	size_t count = batch.size();
+
+	while (send_packets.size() < count)
+		send_packets.push_back(new buf_t(MAX_UDP_PACKET));
+	while (send_scratch.size() < send_pool.size() + 1)
+		send_scratch.push_back(new compress_scratch_t);
+	send_addresses.resize(count);
+
+	// Put the packets together.  This touches client state, so it has to be
+	// done in order on this thread.
+	for (size_t i = 0; i < count; i++)
+	{
+		if (!SV_AssemblePacket(*batch[i], *send_packets[i]))
+			send_packets[i]->clear();
+
+		send_addresses[i] = batch[i]->client.address;
+	}
+
+	send_pool.run(count, &SV_CompressPacketJob, NULL);
+
+	// Drop the players that have nothing to send.
+	size_t num_packets = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (send_packets[i]->size() == 0)
+			continue;
+
+		SV_LogPacket(*batch[i], *send_packets[i]);
+
+		std::swap(send_packets[num_packets], send_packets[i]);
+		send_addresses[num_packets] = send_addresses[i];
+		batch[num_packets] = batch[i];
+		num_packets++;
+	}
+
+#ifdef SIMULATE_LATENCY
+	for (size_t i = 0; i < num_packets; i++)
+		SV_SendPacketDelayed(*send_packets[i], *batch[i]);
+#else
+	NET_SendPackets(&send_packets[0], &send_addresses[0], num_packets);
+#endif
+}
+
 //
 // SV_AcknowledgePacket
 //
@@ -240,6 +362,7 @@ void SV_AcknowledgePacket(player_t &player)
 	int sequence = MSG_ReadLong();
 
 	cl->compressor.packet_acked(sequence);
+	SV_DeltaPacketAcked(player, sequence);
 
 	// packet is missed
 	if (sequence - cl->last_sequence > 1)
@@ -29,6 +29,7 @@
 #include "doomstat.h"
 #include "d_main.h"
 #include "d_player.h"
+#include "i_system.h"
 #include "md5.h"
 #include "p_ctf.h"
 #include "version.h"
@@ -68,18 +69,41 @@ struct CvarField_t
 #define QRYRANGEINFO(INTRODUCED,REMOVED) \
     if (EqProtocolVersion >= INTRODUCED && EqProtocolVersion < REMOVED)
 
+// How long in milliseconds a cached response can be sent for.  Pings and
+// time left change without anything calling SV_QryInvalidate.
+#define QRY_CACHE_MAXAGE 1000
+
+// Everything in the information response after the enquirer's time, as
+// built for one protocol version.
+struct QryCache_t
+{
+	std::vector<byte> Data;
+	DWORD Generation;
+	dtime_t BuildTime;
+	bool Valid;
+};
+
+static QryCache_t QryCache[PROTOCOL_VERSION + 1];
+static DWORD QryGeneration = 0;
+
+//
+// SV_QryInvalidate()
+//
+// Called when anything in the information response changes, so that the
+// next query rebuilds it.
+void SV_QryInvalidate()
+{
+	QryGeneration++;
+}
+
 //
 // IntQryBuildInformation()
 //
 // Protocol building routine, the passed parameter is the enquirer version
-static void IntQryBuildInformation(const DWORD& EqProtocolVersion,
-                                   const DWORD& EqTime)
+static void IntQryBuildInformation(const DWORD& EqProtocolVersion)
 {
 	std::vector<CvarField_t> Cvars;
 
-	// bond - time
-	MSG_WriteLong(&ml_message, EqTime);
-
 	// The servers real protocol version
 	// bond - real protocol
 	MSG_WriteLong(&ml_message, PROTOCOL_VERSION);
@@ -399,7 +423,31 @@ static DWORD IntQrySendResponse(const WORD& TagId,
 	else
 		MSG_WriteLong(&ml_message, EqProtocolVersion);
 
-	IntQryBuildInformation(EqProtocolVersion, EqTime);
+	// bond - time
+	MSG_WriteLong(&ml_message, EqTime);
+
+	// The rest of the response is the same for every enquirer with this
+	// protocol version, so it is only built when something has changed
+	QryCache_t& cache = QryCache[EqProtocolVersion];
+	dtime_t now = I_MSTime();
+
+	if (!cache.Valid || cache.Generation != QryGeneration ||
+	    now - cache.BuildTime >= QRY_CACHE_MAXAGE)
+	{
+		size_t start = ml_message.size();
+
+		IntQryBuildInformation(EqProtocolVersion);
+
+		cache.Data.assign(ml_message.ptr() + start,
+		                  ml_message.ptr() + ml_message.size());
+		cache.Generation = QryGeneration;
+		cache.BuildTime = now;
+		cache.Valid = !ml_message.overflowed;
+	}
+	else if (!cache.Data.empty())
+	{
+		SZ_Write(&ml_message, &cache.Data[0], cache.Data.size());
+	}
 
 	NET_SendPacket(ml_message, net_from);
 
@@ -25,11 +25,17 @@
 #include <string>
 #include <vector>
 
+#if defined(_WIN32) && !defined(_XBOX)
+#include "win32inc.h"
+#include <wincrypt.h>
+#endif
+
 #include "doomtype.h"
 #include "doomstat.h"
 #include "d_main.h"
 #include "d_player.h"
 #include "i_system.h"
+#include "md5.h"
 #include "p_ctf.h"
 
 static buf_t ml_message(MAX_UDP_PACKET);
@@ -74,41 +80,108 @@ EXTERN_CVAR (sv_natport)
 // the server will only allow connections with a valid token
 // in order to protect itself from ip spoofing
 //
-struct token_t
-{
-	DWORD id;
-	QWORD issued;
-	netadr_t from;
-};
+// Tokens are an HMAC of the address they were sent to and the period they
+// were issued in, keyed with a secret chosen at startup, so nothing has to
+// be stored until a client comes back with one.  A token stays valid for
+// between one and two periods.
+//
+#define TOKEN_PERIOD	20000	// 20s should be enough for any client to load its wads
 
-#define MAX_TOKEN_AGE	(20 * TICRATE) // 20s should be enough for any client to load its wads
-static std::vector<token_t> connect_tokens;
+static md5_byte_t token_secret[64];
+static bool token_secret_set = false;
 
 //
-// SV_NewToken
+// SV_ReadSystemRandom
 //
-DWORD SV_NewToken()
+// Fills buf with random bytes from the operating system.  Returns false if
+// no source of random bytes fit for a secret key is available.
+//
+static bool SV_ReadSystemRandom(md5_byte_t *buf, size_t len)
 {
-	QWORD now = I_MSTime() * TICRATE / 1000;
+#if defined(_WIN32) && !defined(_XBOX)
+	HCRYPTPROV provider;
+	if (!CryptAcquireContext(&provider, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT | CRYPT_SILENT))
+		return false;
+
+	bool ok = CryptGenRandom(provider, (DWORD)len, buf) != 0;
+	CryptReleaseContext(provider, 0);
+	return ok;
+#elif defined(UNIX)
+	FILE *fp = fopen("/dev/urandom", "rb");
+	if (!fp)
+		return false;
+
+	size_t got = fread(buf, 1, len, fp);
+	fclose(fp);
+	return got == len;
+#else
+	return false;
+#endif
+}
 
-	token_t token;
-	token.id = rand()*time(0);
-	token.issued = now;
-	token.from = net_from;
-	
-	// find an old token to replace
-	for(size_t i = 0; i < connect_tokens.size(); i++)
+//
+// SV_InitTokenSecret
+//
+// A guessable key would let anyone forge tokens for spoofed addresses, so
+// the server refuses to start without a system source of random bytes.
+//
+void SV_InitTokenSecret()
+{
+	if (token_secret_set)
+		return;
+
+	if (!SV_ReadSystemRandom(token_secret, sizeof(token_secret)))
+		I_FatalError("No system random number source to key connect tokens with");
+
+	token_secret_set = true;
+}
+
+//
+// SV_MakeToken
+//
+// HMAC-MD5 of an address and period, truncated to 32 bits.
+//
+static DWORD SV_MakeToken(const netadr_t &addr, QWORD period)
+{
+	SV_InitTokenSecret();
+
+	md5_byte_t message[16];
+	memcpy(message, addr.ip, 4);
+	message[4] = addr.port & 0xFF;
+	message[5] = addr.port >> 8;
+	for (size_t i = 0; i < 8; i++)
+		message[6 + i] = (md5_byte_t)(period >> (8 * i));
+	message[14] = message[15] = 0;
+
+	md5_byte_t ipad[64], opad[64];
+	for (size_t i = 0; i < 64; i++)
 	{
-		if(now - connect_tokens[i].issued >= MAX_TOKEN_AGE)
-		{
-			connect_tokens[i] = token;
-			return token.id;
-		}
+		ipad[i] = token_secret[i] ^ 0x36;
+		opad[i] = token_secret[i] ^ 0x5C;
 	}
 
-	connect_tokens.push_back(token);
+	md5_state_t state;
+	md5_byte_t inner[16], digest[16];
+
+	md5_init(&state);
+	md5_append(&state, ipad, sizeof(ipad));
+	md5_append(&state, message, sizeof(message));
+	md5_finish(&state, inner);
 
-	return token.id;
+	md5_init(&state);
+	md5_append(&state, opad, sizeof(opad));
+	md5_append(&state, inner, sizeof(inner));
+	md5_finish(&state, digest);
+
+	return digest[0] | (digest[1] << 8) | (digest[2] << 16) | ((DWORD)digest[3] << 24);
+}
+
+//
+// SV_NewToken
+//
+DWORD SV_NewToken()
+{
+	return SV_MakeToken(net_from, I_MSTime() / TOKEN_PERIOD);
 }
 
 //
@@ -116,21 +189,10 @@ DWORD SV_NewToken()
 //
 bool SV_IsValidToken(DWORD token)
 {
-	QWORD now = I_MSTime() * TICRATE / 1000;
+	QWORD period = I_MSTime() / TOKEN_PERIOD;
 
-	for(size_t i = 0; i < connect_tokens.size(); i++)
-	{
-		if(connect_tokens[i].id == token
-		&& NET_CompareAdr(connect_tokens[i].from, net_from)
-		&& now - connect_tokens[i].issued < MAX_TOKEN_AGE)
-		{
-			// extend token life and confirm
-			connect_tokens[i].issued = now;
-			return true;
-		}
-	}
-	
-	return false;
+	return token == SV_MakeToken(net_from, period) ||
+	       token == SV_MakeToken(net_from, period - 1);
 }
 
 //
@@ -27,6 +27,7 @@
 #define __SV_SQPOLD_H__
 
 void SV_SendServerInfo ();
+void SV_InitTokenSecret();
 bool SV_IsValidToken(DWORD token);
 
 #endif // __SV_SQPOLD_H__
@@ -0,0 +1,156 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Ban lookups in a large banlist, by testing every entry and with
+//	IPRangeIndex
+//
+//	odabench banlist [-entries n] [-lookups n]
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "sv_banlist.h"
+#include "harness.h"
+
+static unsigned int seed = 1;
+
+static byte RandomOctet()
+{
+	seed = seed * 1103515245 + 12345;
+	return (byte)(seed >> 16);
+}
+
+//
+// RandomRange
+//
+// Makes up a ban in the form they are usually entered: mostly single
+// addresses, some /24 and a few /16 ranges.
+//
+static std::string RandomRange()
+{
+	char buf[32];
+	int kind = RandomOctet() % 20;
+
+	if (kind == 0)
+		sprintf(buf, "%d.%d.*.*", RandomOctet(), RandomOctet());
+	else if (kind < 4)
+		sprintf(buf, "%d.%d.%d.*", RandomOctet(), RandomOctet(), RandomOctet());
+	else
+		sprintf(buf, "%d.%d.%d.%d", RandomOctet(), RandomOctet(), RandomOctet(), RandomOctet());
+
+	return buf;
+}
+
+//
+// LinearFirst
+//
+// Finds the first entry that matches, the way the banlist was checked
+// before it had an index.
+//
+static size_t LinearFirst(std::vector<IPRange>& ranges, const netadr_t& address)
+{
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (ranges[i].check(address))
+			return i;
+	}
+
+	return IPRangeIndex::NO_ENTRY;
+}
+
+BENCHMARK(banlist, lookup)
+{
+	const int num_entries = Test_Param("-entries", 100000, 1000);
+	const int num_lookups = Test_Param("-lookups", 2000, 200);
+
+	seed = 1;
+
+	std::vector<IPRange> ranges(num_entries);
+	IPRangeIndex index;
+	Banlist bans;
+
+	for (int i = 0; i < num_entries; i++)
+	{
+		std::string range = RandomRange();
+		ranges[i].set(range);
+		index.insert(ranges[i], i);
+		bans.add(range);
+	}
+
+	// Half of the lookups are for banned addresses and half are for
+	// addresses that are most likely not banned, as for players joining.
+	std::vector<netadr_t> addresses(num_lookups);
+	for (int i = 0; i < num_lookups; i++)
+	{
+		netadr_t& address = addresses[i];
+		memset(&address, 0, sizeof(address));
+		for (int octet = 0; octet < 4; octet++)
+			address.ip[octet] = RandomOctet();
+
+		if (i % 2)
+		{
+			seed = seed * 1103515245 + 12345;
+			const IPRange& banned = ranges[(seed >> 8) % num_entries];
+
+			// take the octets the range doesn't mask from the range itself
+			uint32_t key = banned.key();
+			byte wildcards = banned.wildcards();
+			for (int octet = 3; octet >= 0; octet--, key >>= 8)
+			{
+				if (!(wildcards & (1 << octet)))
+					address.ip[octet] = key & 0xFF;
+			}
+		}
+	}
+
+	size_t hits = 0;
+
+	OBenchTimer timer;
+	for (int i = 0; i < num_lookups; i++)
+		hits += LinearFirst(ranges, addresses[i]) != IPRangeIndex::NO_ENTRY;
+	dtime_t linear = timer.elapsed();
+
+	timer.restart();
+	for (int i = 0; i < num_lookups; i++)
+		hits += index.first(addresses[i]) != IPRangeIndex::NO_ENTRY;
+	dtime_t indexed = timer.elapsed();
+
+	timer.restart();
+	for (int i = 0; i < num_lookups; i++)
+	{
+		Ban ban;
+		hits += bans.check(addresses[i], ban);
+	}
+	dtime_t checked = timer.elapsed();
+
+	// all three have to agree for the comparison to mean anything
+	for (int i = 0; i < num_lookups; i++)
+		CHECK_EQUAL(LinearFirst(ranges, addresses[i]), index.first(addresses[i]));
+
+	printf("%10s %10s %14s %14s %14s\n",
+	       "entries", "hits", "linear ns", "index ns", "check ns");
+	printf("%10d %10d %14.1f %14.1f %14.1f\n", num_entries, (int)hits / 3,
+	       (double)linear / num_lookups, (double)indexed / num_lookups,
+	       (double)checked / num_lookups);
+}
+
+VERSION_CONTROL (banlist_bench_cpp, "$Id$")
@@ -0,0 +1,186 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Cost of destroying thinkers that are still referenced, and of freeing
+//	them once they are not, when tens of thousands go at once
+//
+//	odabench linger [-actors n]
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdio.h>
+
+#include "doomstat.h"
+#include "dobject.h"
+#include "dthinker.h"
+#include "p_local.h"
+#include "harness.h"
+#include "testmap.h"
+
+extern std::vector<DThinker*> LingerDestroy;
+
+//
+// ScanLingering
+//
+// What DThinker::Destroy used to do after every thinker it destroyed: look
+// through all of the lingering thinkers and free the ones nothing refers to
+// any more.
+//
+static void ScanLingering()
+{
+	size_t l = LingerDestroy.size();
+	for (size_t i = 0; i < l; i++)
+	{
+		DThinker* obj = LingerDestroy[i];
+		if (!obj->refCount)
+		{
+			obj->ObjectFlags |= OF_Cleanup;
+			LingerDestroy.erase(LingerDestroy.begin() + i);
+			l--; i--;
+			delete obj;
+		}
+	}
+}
+
+//
+// SpawnActor
+//
+// Spawns a monster in one of the open cells of the map.
+//
+static AActor* SpawnActor(int i)
+{
+	const int cells = Test_MapCells();
+
+	int x = i % cells, y = (i / cells) % cells;
+	if (Test_CellIsDoor(x, y))
+		x = (x + 1) % cells;
+
+	return new AActor(Test_CellCenter(x), Test_CellCenter(y), ONFLOORZ, MT_POSSESSED);
+}
+
+//
+// DestroyActor
+//
+// Destroys an actor the way the engine does at the time being measured,
+// which for the old way includes going through the lingering thinkers.
+//
+static void DestroyActor(AActor* mo, bool per_destroy_scan)
+{
+	mo->Destroy();
+	if (per_destroy_scan)
+		ScanLingering();
+}
+
+//
+// EndTic
+//
+static void EndTic(bool per_destroy_scan)
+{
+	if (!per_destroy_scan)
+		DThinker::ReclaimLingering();
+	DObject::EndFrame();
+	DObject::BeginFrame();
+}
+
+//
+// linger.massacre
+//
+// Every monster on the map is killed in the same tic while something still
+// holds a reference to each, as a player's attacker does.  The next tic the
+// references are let go and one more actor is destroyed.  Both tics are
+// timed, with the thinkers freed once a frame as they are now and with the
+// scan DThinker::Destroy used to run after every thinker.
+//
+BENCHMARK(linger, massacre)
+{
+	Test_StartEngine();
+
+	std::vector<int> counts;
+	if (Test_Param("-actors", 0, 0))
+	{
+		counts.push_back(Test_Param("-actors", 0, 0));
+	}
+	else if (Test_Quick())
+	{
+		counts.push_back(1000);
+		counts.push_back(4000);
+	}
+	else
+	{
+		counts.push_back(1000);
+		counts.push_back(10000);
+		counts.push_back(40000);
+	}
+
+	printf("%8s %12s %14s %14s %14s\n",
+	       "actors", "reclaim", "massacre us", "release us", "ns/actor");
+
+	for (size_t c = 0; c < counts.size(); c++)
+	{
+		const int count = counts[c];
+
+		for (int per_destroy_scan = 1; per_destroy_scan >= 0; per_destroy_scan--)
+		{
+			Test_LoadMap("MAP02");
+			DObject::BeginFrame();
+
+			std::vector<AActor*> victims(count);
+			AActor::AActorPtrCounted* holders = new AActor::AActorPtrCounted[count];
+			for (int i = 0; i < count; i++)
+			{
+				victims[i] = SpawnActor(i);
+				holders[i] = victims[i]->ptr();
+			}
+			AActor* straggler = SpawnActor(count);
+
+			EndTic(per_destroy_scan != 0);
+
+			OBenchTimer timer;
+			for (int i = 0; i < count; i++)
+				DestroyActor(victims[i], per_destroy_scan != 0);
+			EndTic(per_destroy_scan != 0);
+			const dtime_t massacre = timer.elapsed();
+
+			CHECK_EQUAL(LingerDestroy.size(), (size_t)count);
+
+			timer.restart();
+			for (int i = 0; i < count; i++)
+				holders[i] = AActor::AActorPtr();
+			DestroyActor(straggler, per_destroy_scan != 0);
+			EndTic(per_destroy_scan != 0);
+			const dtime_t release = timer.elapsed();
+
+			// everything has been freed
+			CHECK(LingerDestroy.empty());
+
+			delete[] holders;
+			DObject::EndFrame();
+
+			printf("%8d %12s %14.1f %14.1f %14.1f\n", count,
+			       per_destroy_scan ? "each destroy" : "each frame",
+			       massacre / 1000.0, release / 1000.0,
+			       (double)(massacre + release) / count);
+		}
+	}
+
+	Test_LoadMap("MAP01");
+}
+
+VERSION_CONTROL (linger_bench_cpp, "$Id$")
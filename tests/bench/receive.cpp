@@ -0,0 +1,278 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Time to read bursts of packets off the server's socket and find the
+//	player each came from, as SV_GetPackets does before parsing them
+//
+//	odabench receive [-rounds n] [-players n] [-strangers percent]
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "win32inc.h"
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <unistd.h>
+	typedef int SOCKET;
+	#define closesocket close
+#endif
+
+#include "c_cvars.h"
+#include "i_net.h"
+#include "sv_main.h"
+#include "harness.h"
+#include "testmap.h"
+
+EXTERN_CVAR(port)
+
+extern unsigned int inet_socket;
+void SockadrToNetadr(struct sockaddr_in* s, netadr_t* a);
+
+//
+// OSender
+//
+// A socket on the loopback interface that sends to the server's socket.
+//
+class OSender
+{
+public:
+	OSender()
+	{
+		mSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(mSocket, (sockaddr*)&addr, sizeof(addr));
+
+		socklen_t len = sizeof(addr);
+		getsockname(mSocket, (sockaddr*)&addr, &len);
+		mPort = ntohs(addr.sin_port);
+
+		memset(&mServer, 0, sizeof(mServer));
+		mServer.sin_family = AF_INET;
+		mServer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		mServer.sin_port = htons(::port.asInt());
+	}
+
+	~OSender()
+	{
+		closesocket(mSocket);
+	}
+
+	int port() const
+	{
+		return mPort;
+	}
+
+	void send(const std::vector<byte>& packet)
+	{
+		sendto(mSocket, (const char*)&packet[0], packet.size(), 0,
+		       (sockaddr*)&mServer, sizeof(mServer));
+	}
+
+private:
+	SOCKET		mSocket;
+	int			mPort;
+	sockaddr_in	mServer;
+};
+
+struct burstpacket_t
+{
+	OSender*			sender;
+	std::vector<byte>	data;
+};
+
+//
+// MakeBurst
+//
+// Makes up a burst of packets, the same every time.  Most come from the
+// connected clients and are the size of a packet of movement commands.
+// The rest come from other addresses and are the size of a launcher query.
+//
+static std::vector<burstpacket_t> MakeBurst(int count, std::vector<OSender*>& clients,
+                                            std::vector<OSender*>& strangers, int stranger_percent)
+{
+	std::vector<burstpacket_t> burst(count);
+	unsigned int seed = 1;
+
+	for (int i = 0; i < count; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		const bool stranger = (int)((seed >> 16) % 100) < stranger_percent;
+
+		seed = seed * 1103515245 + 12345;
+		if (stranger)
+		{
+			burst[i].sender = strangers[(seed >> 16) % strangers.size()];
+			burst[i].data.resize(4);
+		}
+		else
+		{
+			burst[i].sender = clients[(seed >> 16) % clients.size()];
+			burst[i].data.resize(24 + (seed >> 8) % 32);
+		}
+
+		for (size_t b = 0; b < burst[i].data.size(); b++)
+			burst[i].data[b] = (byte)(i + b);
+	}
+
+	return burst;
+}
+
+//
+// RecvfromGetPacket
+//
+// Reads a packet with one recvfrom call, the way NET_GetPacket did before
+// it read packets in batches.
+//
+static int RecvfromGetPacket()
+{
+	sockaddr_in from;
+	socklen_t fromlen = sizeof(from);
+
+	net_message.clear();
+	int ret = recvfrom(inet_socket, (char*)net_message.ptr(), net_message.maxsize(), 0,
+	                   (sockaddr*)&from, &fromlen);
+	if (ret <= 0)
+		return 0;
+
+	SockadrToNetadr(&from, &net_from);
+	net_message.setcursize(ret);
+	return ret;
+}
+
+//
+// ScanForPlayer
+//
+// Finds the player net_from belongs to by comparing it with every player's
+// address, the way SV_FindPlayerByAddr did before players were indexed.
+//
+static player_t& ScanForPlayer()
+{
+	for (Players::iterator it = players.begin(); it != players.end(); ++it)
+	{
+		if (NET_CompareAdr(it->client.address, net_from))
+			return *it;
+	}
+
+	return idplayer(0);
+}
+
+//
+// ReceiveBurst
+//
+// Sends a burst to the server's socket and times reading all of it back,
+// returning the nanoseconds taken.  Counts the packets matched to a player.
+//
+static dtime_t ReceiveBurst(const std::vector<burstpacket_t>& burst, bool batched, int& matched)
+{
+	for (size_t i = 0; i < burst.size(); i++)
+		burst[i].sender->send(burst[i].data);
+
+	OBenchTimer timer;
+
+	size_t received = 0;
+	while (received < burst.size())
+	{
+		if ((batched ? NET_GetPacket() : RecvfromGetPacket()) == 0)
+			break;
+		received++;
+
+		player_t& player = batched ? SV_FindPlayerByAddr() : ScanForPlayer();
+		if (validplayer(player))
+			matched++;
+	}
+
+	dtime_t elapsed = timer.elapsed();
+
+	CHECK_EQUAL(received, burst.size());
+	return elapsed;
+}
+
+BENCHMARK(receive, bursts)
+{
+	Test_StartEngine();
+	Test_LoadMap("MAP01");
+
+	// the largest burst has to fit in the socket's buffer
+	int size = 4 << 20;
+	setsockopt(inet_socket, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+
+	while (NET_GetPacket())
+		;
+
+	const int rounds = Test_Param("-rounds", 200, 20);
+	const int num_players = Test_Param("-players", 32, 32);
+	const int stranger_percent = Test_Param("-strangers", 25, 25);
+
+	std::vector<OSender*> clients, strangers;
+	for (int i = 0; i < num_players; i++)
+	{
+		clients.push_back(new OSender);
+		Test_AddPlayer(clients.back()->port());
+	}
+	for (int i = 0; i < 16; i++)
+		strangers.push_back(new OSender);
+
+	const int burst_sizes[] = { 32, 256, 1024 };
+
+	printf("%8s %8s %10s %16s %16s\n",
+	       "players", "burst", "strangers", "recvfrom+scan", "ring+index");
+
+	for (size_t b = 0; b < ARRAY_LENGTH(burst_sizes); b++)
+	{
+		std::vector<burstpacket_t> burst =
+			MakeBurst(burst_sizes[b], clients, strangers, stranger_percent);
+
+		// alternate the two so that both see the same noise
+		dtime_t elapsed[2] = { 0, 0 };
+		int matched[2] = { 0, 0 };
+		for (int round = 0; round < rounds; round++)
+		{
+			for (int batched = 0; batched < 2; batched++)
+				elapsed[batched] += ReceiveBurst(burst, batched != 0, matched[batched]);
+		}
+
+		CHECK_EQUAL(matched[0], matched[1]);
+
+		const double packets = (double)burst_sizes[b] * rounds;
+		printf("%8d %8d %9d%% %13.1f ns %13.1f ns\n", num_players, burst_sizes[b],
+		       stranger_percent, elapsed[0] / packets, elapsed[1] / packets);
+	}
+
+	Test_RemovePlayers();
+
+	for (size_t i = 0; i < clients.size(); i++)
+		delete clients[i];
+	for (size_t i = 0; i < strangers.size(); i++)
+		delete strangers[i];
+}
+
+VERSION_CONTROL (receive_bench_cpp, "$Id$")
@@ -0,0 +1,523 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Time and bandwidth of the send phase of a tic, by number of players,
+//	number of actors, sv_updaterange, sv_deltaupdates and sv_sendthreads
+//
+//	odabench send [-tics n] [-players n] [-actors n] [-threads n]
+//
+//-----------------------------------------------------------------------------
+
+#include <deque>
+#include <queue>
+
+#include <stdio.h>
+#include <string.h>
+
+#include "win32inc.h"
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	typedef int SOCKET;
+	#define closesocket close
+#endif
+
+#include "doomstat.h"
+#include "c_cvars.h"
+#include "dobject.h"
+#include "g_game.h"
+#include "p_local.h"
+#include "sv_delta.h"
+#include "sv_main.h"
+#include "harness.h"
+#include "testmap.h"
+
+EXTERN_CVAR(sv_updaterange)
+EXTERN_CVAR(sv_deltaupdates)
+EXTERN_CVAR(sv_sendthreads)
+
+//
+// OClientSocket
+//
+// A socket on the loopback interface standing in for a client, so that the
+// packets the server sends can be read back.
+//
+class OClientSocket
+{
+public:
+	OClientSocket()
+	{
+		mSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(mSocket, (sockaddr*)&addr, sizeof(addr));
+
+		int size = 1 << 20;
+		setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+
+#ifdef _WIN32
+		u_long nonblocking = 1;
+		ioctlsocket(mSocket, FIONBIO, &nonblocking);
+#else
+		fcntl(mSocket, F_SETFL, O_NONBLOCK);
+#endif
+
+		socklen_t len = sizeof(addr);
+		getsockname(mSocket, (sockaddr*)&addr, &len);
+		mPort = ntohs(addr.sin_port);
+	}
+
+	~OClientSocket()
+	{
+		closesocket(mSocket);
+	}
+
+	int port() const
+	{
+		return mPort;
+	}
+
+	// Reads the next packet waiting on the socket, if there is one.
+	bool receive(buf_t& packet)
+	{
+		packet.clear();
+
+		int size = recv(mSocket, (char*)packet.ptr(), packet.maxsize(), 0);
+		if (size <= 0)
+			return false;
+
+		packet.setcursize(size);
+		return true;
+	}
+
+private:
+	SOCKET	mSocket;
+	int		mPort;
+};
+
+//
+// SpawnActors
+//
+// Scatters monsters chasing the players and rockets in flight over the
+// open cells of the map, the same way every time.  One actor in ten is a
+// rocket.
+//
+static void SpawnActors(int count, std::vector<player_t*>& players_in_game)
+{
+	unsigned int seed = 1;
+	const int cells = Test_MapCells();
+
+	for (int i = 0; i < count; i++)
+	{
+		int x, y;
+		do
+		{
+			seed = seed * 1103515245 + 12345;
+			x = (seed >> 16) % cells;
+			seed = seed * 1103515245 + 12345;
+			y = (seed >> 16) % cells;
+		} while (Test_CellIsDoor(x, y));
+
+		seed = seed * 1103515245 + 12345;
+		fixed_t offset = (int)((seed >> 16) % 128 - 64) << FRACBITS;
+
+		if (i % 10 == 9)
+		{
+			AActor* mo = new AActor(Test_CellCenter(x) + offset, Test_CellCenter(y) - offset,
+			                        32 * FRACUNIT, MT_ROCKET);
+			mo->momx = 20 * FRACUNIT;
+		}
+		else
+		{
+			AActor* mo = new AActor(Test_CellCenter(x) + offset, Test_CellCenter(y) - offset,
+			                        ONFLOORZ, MT_POSSESSED);
+			mo->target = players_in_game[i % players_in_game.size()]->mo->ptr();
+		}
+	}
+}
+
+//
+// MakeEveryoneAware
+//
+// Tells every player about every actor at once, rather than a few each tic
+// as SV_UpdateHiddenMobj does, so that the timed tics only send updates.
+//
+static void MakeEveryoneAware(std::vector<player_t*>& players_in_game)
+{
+	AActor* mo;
+	TThinkerIterator<AActor> iterator;
+	while ((mo = iterator.Next()))
+	{
+		for (size_t i = 0; i < players_in_game.size(); i++)
+			mo->players_aware.set(players_in_game[i]->id);
+	}
+
+	for (size_t i = 0; i < players_in_game.size(); i++)
+	{
+		std::queue<AActor::AActorPtr> empty;
+		std::swap(players_in_game[i]->to_spawn, empty);
+	}
+}
+
+//
+// StartGame
+//
+// Loads the map and fills it with players, spread out over the map, and
+// actors.  Players are sent their packets at the given loopback ports, in
+// order, or at ports nothing listens on when there are none.
+//
+static std::vector<player_t*> StartGame(int num_players, int num_actors,
+                                        const std::vector<int>& ports = std::vector<int>())
+{
+	Test_LoadMap("MAP02");
+
+	const int cells = Test_MapCells();
+
+	std::vector<player_t*> players_in_game;
+	for (int i = 0; i < num_players; i++)
+	{
+		player_t& player = Test_AddPlayer((size_t)i < ports.size() ? ports[i] : 0);
+		Test_MovePlayer(player, 1 + (i * 5) % (cells - 1), 1 + (i * 3) % (cells - 1));
+		player.cheats |= CF_GODMODE;
+
+		// everything written goes out, so that the byte counts are complete
+		player.client.rate = 1000000;
+		players_in_game.push_back(&player);
+	}
+
+	SpawnActors(num_actors, players_in_game);
+	MakeEveryoneAware(players_in_game);
+
+	return players_in_game;
+}
+
+//
+// RunSendPhase
+//
+// Sends the given number of tics of updates, optionally running the game
+// between them, and prints the time taken to send and the unreliable bytes
+// sent per tic.  Each client acknowledges a packet ack_delay tics after it
+// was sent.
+//
+static void RunSendPhase(std::vector<player_t*>& players_in_game, int tics,
+                         bool play, int ack_delay)
+{
+	// the sequence numbers of the packets sent each tic, first and last + 1
+	typedef std::deque< std::pair<int, int> > SentTics;
+	std::vector<SentTics> unacked(players_in_game.size());
+
+	dtime_t elapsed = 0;
+	QWORD bytes = 0;
+
+	for (int tic = 0; tic < tics; tic++)
+	{
+		DObject::BeginFrame();
+
+		if (play)
+			G_Ticker();
+
+		std::vector<int> first_sequence(players_in_game.size());
+		for (size_t i = 0; i < players_in_game.size(); i++)
+		{
+			bytes -= players_in_game[i]->client.unreliable_bps;
+			first_sequence[i] = players_in_game[i]->client.sequence;
+		}
+
+		OBenchTimer timer;
+		SV_WriteCommands();
+		SV_SendPackets();
+		elapsed += timer.elapsed();
+
+		for (size_t i = 0; i < players_in_game.size(); i++)
+		{
+			player_t& player = *players_in_game[i];
+
+			bytes += player.client.unreliable_bps;
+			player.client.reliable_bps = 0;
+			player.client.unreliable_bps = 0;
+
+			// a busy tic is sent as several packets, and each is acknowledged
+			unacked[i].push_back(std::make_pair(first_sequence[i], player.client.sequence));
+			if (unacked[i].size() > (size_t)ack_delay)
+			{
+				for (int seq = unacked[i].front().first; seq < unacked[i].front().second; seq++)
+					SV_DeltaPacketAcked(player, seq);
+				unacked[i].pop_front();
+			}
+		}
+
+		gametic++;
+
+		DObject::EndFrame();
+	}
+
+	printf("%12.1f %12.0f\n", (double)elapsed / tics / 1000.0, (double)bytes / tics);
+}
+
+BENCHMARK(send, scaling)
+{
+	Test_StartEngine();
+
+	const int tics = Test_Param("-tics", 5 * TICRATE, TICRATE);
+
+	// a single size can be asked for, or else a quick run is one small size
+	std::vector<int> player_counts, actor_counts;
+	if (Test_Param("-players", 0, 4))
+	{
+		player_counts.push_back(Test_Param("-players", 0, 4));
+	}
+	else
+	{
+		player_counts.push_back(1);
+		player_counts.push_back(8);
+		player_counts.push_back(16);
+		player_counts.push_back(32);
+	}
+
+	if (Test_Param("-actors", 0, 200))
+	{
+		actor_counts.push_back(Test_Param("-actors", 0, 200));
+	}
+	else
+	{
+		actor_counts.push_back(500);
+		actor_counts.push_back(2000);
+		actor_counts.push_back(8000);
+	}
+
+	// the map is 8192 units across
+	const int ranges[] = { 0, 2048 };
+
+	printf("%8s %8s %8s %12s %12s\n", "players", "actors", "range", "us/tic", "bytes/tic");
+
+	for (size_t p = 0; p < player_counts.size(); p++)
+	{
+		for (size_t a = 0; a < actor_counts.size(); a++)
+		{
+			for (size_t r = 0; r < ARRAY_LENGTH(ranges); r++)
+			{
+				std::vector<player_t*> players_in_game =
+					StartGame(player_counts[p], actor_counts[a]);
+
+				sv_updaterange.Set(ranges[r]);
+				printf("%8d %8d %8d ", player_counts[p], actor_counts[a], ranges[r]);
+				RunSendPhase(players_in_game, tics, false, 0);
+				sv_updaterange.Set(0.0f);
+
+				Test_RemovePlayers();
+			}
+		}
+	}
+}
+
+//
+// send.delta
+//
+// Compares the bytes sent with and without sv_deltaupdates, both with the
+// monsters standing still and with the game running, where they chase the
+// players.  Clients acknowledge packets three tics after they are sent.
+//
+BENCHMARK(send, delta)
+{
+	Test_StartEngine();
+
+	const int tics = Test_Param("-tics", 10 * TICRATE, TICRATE);
+	const int num_players = Test_Param("-players", 8, 4);
+	const int num_actors = Test_Param("-actors", 2000, 200);
+
+	printf("%8s %8s %8s %8s %12s %12s\n",
+	       "players", "actors", "playing", "delta", "us/tic", "bytes/tic");
+
+	for (int play = 0; play < 2; play++)
+	{
+		for (int delta = 0; delta < 2; delta++)
+		{
+			std::vector<player_t*> players_in_game = StartGame(num_players, num_actors);
+
+			sv_deltaupdates.Set(delta);
+			printf("%8d %8d %8d %8d ", num_players, num_actors, play, delta);
+			RunSendPhase(players_in_game, tics, play != 0, 3);
+			sv_deltaupdates.Set(0.0f);
+
+			Test_RemovePlayers();
+		}
+	}
+}
+
+//
+// SameAsSerial
+//
+// Decompresses a packet as a client would, compresses it again on this
+// thread and checks that the result is the packet that was received.
+//
+static bool SameAsSerial(buf_t& received)
+{
+	// the sequence number is never compressed
+	buf_t plain(MAX_UDP_PACKET);
+	SZ_Write(&plain, received.ptr(), sizeof(int));
+
+	const byte* payload = received.ptr() + sizeof(int);
+	if (received.size() > sizeof(int) + 2 && payload[0] == svc_compressed)
+	{
+		if (payload[1] != minilzo_mask)
+			return false;
+
+		net_message.clear();
+		SZ_Write(&net_message, received.ptr(), received.size());
+		MSG_ReadLong();
+		MSG_ReadByte();
+		MSG_ReadByte();
+
+		if (!MSG_DecompressMinilzo())
+			return false;
+
+		SZ_Write(&plain, net_message.ptr(), net_message.size());
+	}
+	else
+	{
+		SZ_Write(&plain, payload, received.size() - sizeof(int));
+	}
+
+	if (MSG_CompressMinilzo(plain, sizeof(int), 2))
+	{
+		plain.ptr()[sizeof(int)] = svc_compressed;
+		plain.ptr()[sizeof(int) + 1] = minilzo_mask;
+	}
+
+	return plain.size() == received.size() &&
+	       memcmp(plain.ptr(), received.ptr(), plain.size()) == 0;
+}
+
+//
+// send.threads
+//
+// Runs the game with each number of sv_sendthreads, from none up, and
+// compares the time to send a tic.  Every client has a socket of its own,
+// and every packet that arrives on it is checked: sequence numbers have to
+// follow on from each other, and compressing the packet's contents on one
+// thread has to give the bytes that were received.
+//
+BENCHMARK(send, threads)
+{
+	Test_StartEngine();
+
+	const int tics = Test_Param("-tics", 10 * TICRATE, TICRATE);
+	const int num_players = Test_Param("-players", 32, 8);
+	const int num_actors = Test_Param("-actors", 4000, 400);
+	const int max_threads = Test_Param("-threads", 3, 2);
+
+	std::vector<OClientSocket*> sockets;
+	std::vector<int> ports;
+	for (int i = 0; i < num_players; i++)
+	{
+		sockets.push_back(new OClientSocket);
+		ports.push_back(sockets.back()->port());
+	}
+
+	buf_t packet(MAX_UDP_PACKET);
+
+	printf("%8s %8s %8s %12s %10s %10s %10s\n",
+	       "players", "actors", "threads", "us/tic", "packets", "compressed", "mismatched");
+
+	for (int threads = 0; threads <= max_threads; threads++)
+	{
+		std::vector<player_t*> players_in_game = StartGame(num_players, num_actors, ports);
+
+		// Leave nothing from before the timed tics on the sockets.  Filling
+		// the map can already have sent packets to flush the reliable buffers.
+		std::vector<int> next_sequence(num_players);
+		for (int i = 0; i < num_players; i++)
+		{
+			while (sockets[i]->receive(packet))
+				;
+			next_sequence[i] = players_in_game[i]->client.sequence;
+		}
+
+		sv_sendthreads.Set(threads);
+
+		dtime_t elapsed = 0;
+		int packets = 0, compressed = 0, mismatched = 0;
+
+		for (int tic = 0; tic < tics; tic++)
+		{
+			DObject::BeginFrame();
+			G_Ticker();
+
+			OBenchTimer timer;
+			SV_WriteCommands();
+			SV_SendPackets();
+			elapsed += timer.elapsed();
+
+			for (int i = 0; i < num_players; i++)
+			{
+				while (sockets[i]->receive(packet))
+				{
+					CHECK(packet.size() >= sizeof(int));
+					if (packet.size() < sizeof(int))
+						continue;
+
+					int sequence;
+					memcpy(&sequence, packet.ptr(), sizeof(sequence));
+					CHECK_EQUAL(LELONG(sequence), next_sequence[i]);
+					next_sequence[i] = LELONG(sequence) + 1;
+
+					if (packet.size() > sizeof(int) && packet.ptr()[sizeof(int)] == svc_compressed)
+						compressed++;
+					if (!SameAsSerial(packet))
+						mismatched++;
+					packets++;
+				}
+
+				// everything that was sent arrived
+				CHECK_EQUAL(next_sequence[i], players_in_game[i]->client.sequence);
+
+				players_in_game[i]->client.reliable_bps = 0;
+				players_in_game[i]->client.unreliable_bps = 0;
+			}
+
+			gametic++;
+
+			DObject::EndFrame();
+		}
+
+		sv_sendthreads.Set(0.0f);
+
+		printf("%8d %8d %8d %12.1f %10d %10d %10d\n", num_players, num_actors, threads,
+		       (double)elapsed / tics / 1000.0, packets, compressed, mismatched);
+
+		CHECK(compressed > 0);
+		CHECK_EQUAL(mismatched, 0);
+
+		Test_RemovePlayers();
+	}
+
+	for (size_t i = 0; i < sockets.size(); i++)
+		delete sockets[i];
+}
+
+VERSION_CONTROL (send_bench_cpp, "$Id$")
@@ -0,0 +1,205 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Cost of spawning and destroying actors
+//
+//	odabench spawn [-ops n] [-live n] [-actors n] [-players n] [-tics n]
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdio.h>
+
+#include "doomstat.h"
+#include "dobject.h"
+#include "m_mempool.h"
+#include "p_local.h"
+#include "z_zone.h"
+#include "harness.h"
+#include "testmap.h"
+
+//
+// spawn.allocator
+//
+// Frees and allocates actor-sized blocks at random out of a set of live
+// ones, from a FixedPool and from the zone, which is where actors came
+// from before they had a pool.
+//
+BENCHMARK(spawn, allocator)
+{
+	const int ops = Test_Param("-ops", 2000000, 20000);
+	const int live = Test_Param("-live", 2000, 200);
+
+	printf("%10s %10s %10s %10s\n", "allocator", "live", "ops", "ns/op");
+
+	for (int zone = 0; zone < 2; zone++)
+	{
+		FixedPool pool(sizeof(AActor), 64);
+		std::vector<void*> blocks(live);
+		unsigned int seed = 1;
+
+		for (int i = 0; i < live; i++)
+			blocks[i] = zone ? Z_Malloc(sizeof(AActor), PU_LEVSPEC, 0) : pool.alloc();
+
+		OBenchTimer timer;
+
+		for (int i = 0; i < ops; i++)
+		{
+			seed = seed * 1103515245 + 12345;
+			void*& block = blocks[(seed >> 16) % live];
+
+			if (zone)
+			{
+				Z_Free(block);
+				block = Z_Malloc(sizeof(AActor), PU_LEVSPEC, 0);
+			}
+			else
+			{
+				pool.free(block);
+				block = pool.alloc();
+			}
+
+			// the constructor would write to it straight away
+			memset(block, 0, 64);
+		}
+
+		dtime_t elapsed = timer.elapsed();
+
+		for (int i = 0; i < live; i++)
+		{
+			if (zone)
+				Z_Free(blocks[i]);
+			else
+				pool.free(blocks[i]);
+		}
+
+		printf("%10s %10d %10d %10.1f\n", zone ? "zone" : "FixedPool", live, ops,
+		       (double)elapsed / ops);
+	}
+}
+
+//
+// spawn.actors
+//
+// Spawns a batch of rockets and destroys them again, as a tic full of
+// explosions does.
+//
+BENCHMARK(spawn, actors)
+{
+	Test_StartEngine();
+	Test_LoadMap("MAP02");
+
+	const int count = Test_Param("-actors", 5000, 500);
+	const int rounds = Test_Param("-rounds", 200, 10);
+
+	std::vector<AActor*> actors(count);
+	dtime_t spawning = 0, destroying = 0;
+
+	for (int round = 0; round < rounds; round++)
+	{
+		OBenchTimer timer;
+
+		for (int i = 0; i < count; i++)
+		{
+			int cell = 1 + i % (Test_MapCells() - 2);
+			actors[i] = new AActor(Test_CellCenter(cell), Test_CellCenter(1),
+			                       32 * FRACUNIT, MT_ROCKET);
+		}
+
+		spawning += timer.elapsed();
+		timer.restart();
+
+		for (int i = 0; i < count; i++)
+			actors[i]->Destroy();
+
+		DThinker::ReclaimLingering();
+		DObject::EndFrame();
+
+		destroying += timer.elapsed();
+	}
+
+	printf("%10s %10s %12s %12s\n", "actors", "rounds", "spawn ns", "destroy ns");
+	printf("%10d %10d %12.1f %12.1f\n", count, rounds,
+	       (double)spawning / ((double)count * rounds),
+	       (double)destroying / ((double)count * rounds));
+}
+
+//
+// spawn.rockets
+//
+// Every player fires a rocket every tic while turning, so rockets are
+// spawned, fly and explode against the walls all the time.
+//
+BENCHMARK(spawn, rockets)
+{
+	Test_StartEngine();
+	Test_LoadMap("MAP02");
+
+	const int num_players = Test_Param("-players", 16, 4);
+	const int tics = Test_Param("-tics", 20 * TICRATE, TICRATE);
+
+	const int cells = Test_MapCells();
+
+	std::vector<player_t*> players_in_game;
+	for (int i = 0; i < num_players; i++)
+	{
+		player_t& player = Test_AddPlayer();
+		Test_MovePlayer(player, 1 + (i * 5) % (cells - 1), 1 + (i * 3) % (cells - 1));
+		player.cheats |= CF_GODMODE;
+		players_in_game.push_back(&player);
+	}
+
+	dtime_t elapsed = 0, worst = 0;
+	int spawned = 0, most_actors = 0;
+
+	for (int tic = 0; tic < tics; tic++)
+	{
+		for (int i = 0; i < num_players; i++)
+		{
+			AActor* mo = players_in_game[i]->mo;
+			mo->angle = ANG((tic * 7 + i * 40) % 360);
+			P_SpawnPlayerMissile(mo, MT_ROCKET);
+			spawned++;
+		}
+
+		OBenchTimer timer;
+		Test_RunTics(1);
+		dtime_t took = timer.elapsed();
+
+		elapsed += took;
+		if (took > worst)
+			worst = took;
+
+		int actors = 0;
+		AActor* mo;
+		TThinkerIterator<AActor> iterator;
+		while ((mo = iterator.Next()))
+			actors++;
+		if (actors > most_actors)
+			most_actors = actors;
+	}
+
+	printf("%10s %10s %10s %12s %12s\n", "players", "rockets", "most live", "us/tic", "worst us");
+	printf("%10d %10d %10d %12.1f %12.1f\n", num_players, spawned, most_actors,
+	       (double)elapsed / tics / 1000.0, (double)worst / 1000.0);
+
+	Test_RemovePlayers();
+}
+
+VERSION_CONTROL (spawn_bench_cpp, "$Id$")
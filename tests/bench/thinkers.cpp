@@ -0,0 +1,177 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Cost of finding the thinkers of one type with TThinkerIterator, against
+//	walking the whole thinker list and checking each thinker's type
+//
+//	odabench thinkers [-rounds n] [-actors n]
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdio.h>
+
+#include "doomstat.h"
+#include "dthinker.h"
+#include "p_local.h"
+#include "p_spec.h"
+#include "harness.h"
+#include "testmap.h"
+
+//
+// FillMap
+//
+// Makes a slaughtermap of the loaded map: the given number of monsters
+// spread over the open cells, a light effect in every sector and every
+// door opening.
+//
+static void FillMap(int num_actors)
+{
+	unsigned int seed = 1;
+	const int cells = Test_MapCells();
+
+	for (int i = 0; i < num_actors; i++)
+	{
+		int x, y;
+		do
+		{
+			seed = seed * 1103515245 + 12345;
+			x = (seed >> 16) % cells;
+			seed = seed * 1103515245 + 12345;
+			y = (seed >> 16) % cells;
+		} while (Test_CellIsDoor(x, y));
+
+		new AActor(Test_CellCenter(x), Test_CellCenter(y), ONFLOORZ, MT_POSSESSED);
+	}
+
+	for (int y = 0; y < cells; y++)
+	{
+		for (int x = 0; x < cells; x++)
+		{
+			sector_t* sector = Test_CellSector(x, y);
+
+			if (Test_CellIsDoor(x, y))
+				EV_DoDoor(DDoor::doorOpen, NULL, NULL, sector->tag, FRACUNIT / 2, 0, NoKey);
+			else if ((x + y) % 3 == 0)
+				new DFireFlicker(sector);
+			else if ((x + y) % 3 == 1)
+				new DGlow(sector);
+			else
+				new DStrobe(sector, 5, 35, false);
+		}
+	}
+}
+
+//
+// WalkMainList
+//
+// Finds the thinkers of a type the way FThinkerIterator used to, by going
+// through every thinker and checking its type.
+//
+static size_t WalkMainList(TypeInfo* type, std::vector<DThinker*>* found = NULL)
+{
+	size_t count = 0;
+
+	DThinker* thinker;
+	TThinkerIterator<DThinker> iterator;
+	while ((thinker = iterator.Next()))
+	{
+		if (thinker->IsKindOf(type))
+		{
+			if (found)
+				found->push_back(thinker);
+			count++;
+		}
+	}
+
+	return count;
+}
+
+//
+// IterateType
+//
+// Finds the thinkers of a type with FThinkerIterator.
+//
+static size_t IterateType(TypeInfo* type, std::vector<DThinker*>* found = NULL)
+{
+	size_t count = 0;
+
+	DThinker* thinker;
+	FThinkerIterator iterator(type);
+	while ((thinker = iterator.Next()))
+	{
+		if (found)
+			found->push_back(thinker);
+		count++;
+	}
+
+	return count;
+}
+
+BENCHMARK(thinkers, iterate)
+{
+	Test_StartEngine();
+	Test_LoadMap("MAP02");
+
+	const int rounds = Test_Param("-rounds", 200, 20);
+	const int num_actors = Test_Param("-actors", 10000, 1000);
+
+	FillMap(num_actors);
+
+	TypeInfo* types[] = {
+		RUNTIME_CLASS(AActor), RUNTIME_CLASS(DLighting), RUNTIME_CLASS(DDoor)
+	};
+
+	const size_t total = WalkMainList(RUNTIME_CLASS(DThinker));
+
+	printf("%12s %10s %10s %14s %14s\n", "type", "found", "thinkers", "main list us", "iterator us");
+
+	for (size_t t = 0; t < ARRAY_LENGTH(types); t++)
+	{
+		// both have to find the same thinkers in the same order
+		std::vector<DThinker*> walked, iterated;
+		WalkMainList(types[t], &walked);
+		IterateType(types[t], &iterated);
+		CHECK(walked == iterated);
+		CHECK(!walked.empty());
+
+		// alternate the two so that both see the same noise
+		dtime_t elapsed[2] = { 0, 0 };
+		size_t found = 0;
+		for (int round = 0; round < rounds; round++)
+		{
+			OBenchTimer timer;
+			found += WalkMainList(types[t]);
+			elapsed[0] += timer.elapsed();
+
+			timer.restart();
+			found -= IterateType(types[t]);
+			elapsed[1] += timer.elapsed();
+		}
+		CHECK_EQUAL(found, 0);
+
+		printf("%12s %10d %10d %14.1f %14.1f\n", types[t]->Name, (int)walked.size(),
+		       (int)total, (double)elapsed[0] / rounds / 1000.0,
+		       (double)elapsed[1] / rounds / 1000.0);
+	}
+
+	Test_LoadMap("MAP01");
+}
+
+VERSION_CONTROL (thinkers_bench_cpp, "$Id$")
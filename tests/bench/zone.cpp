@@ -0,0 +1,140 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Cost of allocating and freeing thinker sized blocks from the level tag
+//	arenas, against the rover allocator every block used to come from, as
+//	the zone gets more fragmented
+//
+//	odabench zone [-rounds n] [-blocks n]
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdio.h>
+
+#include "doomtype.h"
+#include "z_zone.h"
+#include "harness.h"
+
+// A level tag the engine never uses, so that freeing it leaves the rest of
+// the zone alone.
+static const int BENCH_TAG = PU_LEVACS + 8;
+
+//
+// Fragment
+//
+// Fills the zone with small static blocks and frees every other one,
+// leaving that many holes too small for a thinker in front of the rover.
+// Returns the blocks that are left, for Unfragment.
+//
+static std::vector<void*> Fragment(int holes)
+{
+	std::vector<void*> blocks(holes * 2);
+	for (size_t i = 0; i < blocks.size(); i++)
+		blocks[i] = Z_Malloc(32, PU_STATIC, NULL);
+
+	std::vector<void*> kept;
+	for (size_t i = 0; i < blocks.size(); i++)
+	{
+		if (i % 2)
+			kept.push_back(blocks[i]);
+		else
+			Z_Free(blocks[i]);
+	}
+
+	return kept;
+}
+
+static void Unfragment(std::vector<void*>& kept)
+{
+	for (size_t i = 0; i < kept.size(); i++)
+		Z_Free(kept[i]);
+	kept.clear();
+}
+
+// Sizes around those of the thinkers a level spawns, the same every round.
+static size_t ThinkerSize(size_t i)
+{
+	return 200 + (i * 37) % 200;
+}
+
+BENCHMARK(zone, thinkers)
+{
+	// purgable blocks would be thrown out by the first allocations
+	Z_FreeTags(PU_PURGELEVEL, PU_CACHE);
+
+	zonestats_t before;
+	Z_GetStats(before);
+
+	const int rounds = Test_Param("-rounds", 20, 5);
+	const int count = Test_Param("-blocks", 20000, 5000);
+
+	const int holes[] = { 0, 20000 };
+
+	printf("%8s %8s %10s %14s %14s\n", "holes", "blocks", "allocator", "alloc ns", "free ns");
+
+	for (size_t h = 0; h < ARRAY_LENGTH(holes); h++)
+	{
+		std::vector<void*> kept = Fragment(holes[h]);
+		std::vector<void*> blocks(count);
+
+		// alternate the two so that both see the same noise
+		dtime_t alloc[2] = { 0, 0 }, release[2] = { 0, 0 };
+		for (int round = 0; round < rounds; round++)
+		{
+			// the rover, freeing each block as Z_FreeTags used to
+			OBenchTimer timer;
+			for (int i = 0; i < count; i++)
+				blocks[i] = Z_Malloc(ThinkerSize(i), PU_STATIC, NULL);
+			alloc[0] += timer.elapsed();
+
+			timer.restart();
+			for (int i = 0; i < count; i++)
+				Z_Free(blocks[i]);
+			release[0] += timer.elapsed();
+
+			// the arenas, freed all at once
+			timer.restart();
+			for (int i = 0; i < count; i++)
+				blocks[i] = Z_Malloc(ThinkerSize(i), BENCH_TAG, NULL);
+			alloc[1] += timer.elapsed();
+
+			timer.restart();
+			Z_FreeTags(BENCH_TAG, BENCH_TAG);
+			release[1] += timer.elapsed();
+		}
+
+		Z_CheckHeap();
+		Unfragment(kept);
+
+		const double blocktimes = (double)count * rounds;
+		printf("%8d %8d %10s %14.1f %14.1f\n", holes[h], count, "rover",
+		       alloc[0] / blocktimes, release[0] / blocktimes);
+		printf("%8d %8d %10s %14.1f %14.1f\n", holes[h], count, "arena",
+		       alloc[1] / blocktimes, release[1] / blocktimes);
+	}
+
+	// everything went back and merged with the free space around it
+	zonestats_t after;
+	Z_GetStats(after);
+	CHECK_EQUAL(after.blocks, before.blocks);
+	CHECK_EQUAL(after.largestfree, before.largestfree);
+}
+
+VERSION_CONTROL (zone_bench_cpp, "$Id$")
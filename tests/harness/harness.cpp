@@ -0,0 +1,243 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Test and benchmark harness
+//
+//	Stands in for the server's i_main.cpp: it owns Args and the exit
+//	functions, and runs the registered cases instead of D_DoomMain.
+//
+//-----------------------------------------------------------------------------
+
+#include <stack>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "win32inc.h"
+
+#include "m_argv.h"
+#include "d_main.h"
+#include "i_system.h"
+#include "c_console.h"
+#include "z_zone.h"
+#include "errors.h"
+#include "cmdlib.h"
+#include "dobject.h"
+
+#include "harness.h"
+
+DArgs Args;
+
+// functions to be called at shutdown are stored in this stack
+typedef void (STACK_ARGS *term_func_t)(void);
+static std::stack< std::pair<term_func_t, std::string> > TermFuncs;
+
+void addterm (void (STACK_ARGS *func) (), const char *name)
+{
+	TermFuncs.push(std::pair<term_func_t, std::string>(func, name));
+}
+
+void STACK_ARGS call_terms (void)
+{
+	while (!TermFuncs.empty())
+		TermFuncs.top().first(), TermFuncs.pop();
+}
+
+static bool verbose = false;
+
+int PrintString(int printlevel, char const* str)
+{
+	std::string sanitized_str(str);
+	StripColorCodes(sanitized_str);
+
+	if (verbose)
+	{
+		printf("%s", sanitized_str.c_str());
+		fflush(stdout);
+	}
+
+	return sanitized_str.length();
+}
+
+#ifdef _WIN32
+int ShutdownNow()
+{
+	return 0;
+}
+#else
+void daemon_init()
+{
+}
+#endif
+
+static OTestCase* first_case = NULL;
+static OTestCase* last_case = NULL;
+
+static int failures = 0;
+static bool quick = false;
+
+OTestCase::OTestCase(const char* suite, const char* name, testfunc_t func) :
+	suite(suite), name(name), func(func), next(NULL)
+{
+	if (last_case)
+		last_case->next = this;
+	else
+		first_case = this;
+	last_case = this;
+}
+
+void Test_Fail(const char* file, int line, const std::string& message)
+{
+	printf("%s:%d: check failed: %s\n", file, line, message.c_str());
+	failures++;
+}
+
+std::string Test_Describe(const char* a, double va, const char* b, double vb)
+{
+	char buf[64];
+	sprintf(buf, " (%.17g != %.17g)", va, vb);
+	return std::string(a) + " == " + b + buf;
+}
+
+bool Test_Quick()
+{
+	return quick;
+}
+
+int Test_Param(const char* name, int normal, int quick)
+{
+	const char* value = Args.CheckValue(name);
+	if (value)
+		return atoi(value);
+
+	return Test_Quick() ? quick : normal;
+}
+
+OBenchTimer::OBenchTimer() : mStart(I_GetTime())
+{
+}
+
+void OBenchTimer::restart()
+{
+	mStart = I_GetTime();
+}
+
+dtime_t OBenchTimer::elapsed() const
+{
+	return I_GetTime() - mStart;
+}
+
+//
+// Test_Matches
+//
+// Checks a case against a name given on the command line, which is either
+// a suite or suite.name.
+//
+static bool Test_Matches(const OTestCase* c, const char* pattern)
+{
+	const char* dot = strchr(pattern, '.');
+	if (!dot)
+		return stricmp(c->suite, pattern) == 0;
+
+	return strlen(c->suite) == (size_t)(dot - pattern) &&
+	       strnicmp(c->suite, pattern, dot - pattern) == 0 &&
+	       stricmp(c->name, dot + 1) == 0;
+}
+
+int main(int argc, char** argv)
+{
+	Args.SetArgs(argc, argv);
+
+	verbose = Args.CheckParm("-verbose") != 0;
+	quick = Args.CheckParm("-quick") != 0;
+
+	std::vector<const char*> patterns;
+	for (int i = 1; i < argc; i++)
+	{
+		// every parameter but -verbose and -quick takes a value
+		if (argv[i][0] == '-')
+		{
+			if (stricmp(argv[i], "-verbose") != 0 && stricmp(argv[i], "-quick") != 0)
+				i++;
+			continue;
+		}
+		patterns.push_back(argv[i]);
+	}
+
+	int run = 0;
+
+	try
+	{
+		Z_Init();
+
+		atterm(I_Quit);
+		atterm(DObject::StaticShutdown);
+
+		progdir = I_GetBinaryDir();
+
+		for (OTestCase* c = first_case; c; c = c->next)
+		{
+			bool matched = patterns.empty();
+			for (size_t i = 0; i < patterns.size() && !matched; i++)
+				matched = Test_Matches(c, patterns[i]);
+
+			if (!matched)
+				continue;
+
+			printf("%s.%s\n", c->suite, c->name);
+			fflush(stdout);
+
+			int before = failures;
+
+			try
+			{
+				c->func();
+			}
+			catch (CDoomError& error)
+			{
+				Test_Fail(c->suite, 0, "engine error: " + error.GetMsg());
+			}
+
+			if (failures > before)
+				printf("%s.%s FAILED\n", c->suite, c->name);
+			run++;
+		}
+	}
+	catch (CDoomError& error)
+	{
+		fprintf(stderr, "%s\n", error.GetMsg().c_str());
+		call_terms();
+		return EXIT_FAILURE;
+	}
+
+	call_terms();
+
+	if (run == 0)
+	{
+		printf("Nothing matched what was asked for\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("%d run, %d checks failed\n", run, failures);
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+VERSION_CONTROL (harness_cpp, "$Id$")
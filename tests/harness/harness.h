@@ -0,0 +1,106 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Test and benchmark harness
+//
+//	Tests and benchmarks are linked against the same objects as odasrv.
+//	Each is registered with TEST_CASE or BENCHMARK under a suite, which
+//	is the name of the file it is in, and run by name from the command
+//	line:
+//
+//	odatest [-verbose] [suite[.name] ...]
+//	odabench [-verbose] [-quick] [suite[.name] ...]
+//
+//	With no names, everything is run.  Engine output is only shown with
+//	-verbose.  Benchmarks take their own parameters from Args.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __HARNESS_H__
+#define __HARNESS_H__
+
+#include <string>
+
+#include "doomtype.h"
+
+typedef void (*testfunc_t)();
+
+//
+// OTestCase
+//
+// Adds itself to the list of cases that can be run.  Use TEST_CASE or
+// BENCHMARK to declare one.
+//
+struct OTestCase
+{
+	OTestCase(const char* suite, const char* name, testfunc_t func);
+
+	const char*		suite;
+	const char*		name;
+	testfunc_t		func;
+	OTestCase*		next;
+};
+
+#define TEST_CASE(suite, name) \
+	static void suite##_##name(); \
+	static OTestCase suite##_##name##_case(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define BENCHMARK(suite, name) TEST_CASE(suite, name)
+
+void Test_Fail(const char* file, int line, const std::string& message);
+
+//
+// CHECK
+//
+// Counts a failure and goes on with the test if the condition is false.
+//
+#define CHECK(cond) \
+	do { if (!(cond)) Test_Fail(__FILE__, __LINE__, #cond); } while (0)
+
+#define CHECK_EQUAL(a, b) \
+	do { if (!((a) == (b))) Test_Fail(__FILE__, __LINE__, \
+		Test_Describe(#a, (double)(a), #b, (double)(b))); } while (0)
+
+std::string Test_Describe(const char* a, double va, const char* b, double vb);
+
+// true when odabench was asked for a short run, as done from ctest
+bool Test_Quick();
+
+// Picks a benchmark parameter from the command line, or a smaller one for
+// a quick run.
+int Test_Param(const char* name, int normal, int quick);
+
+//
+// OBenchTimer
+//
+// Measures wall clock time in nanoseconds.
+//
+class OBenchTimer
+{
+public:
+	OBenchTimer();
+
+	void restart();
+	dtime_t elapsed() const;
+
+private:
+	dtime_t mStart;
+};
+
+#endif // __HARNESS_H__
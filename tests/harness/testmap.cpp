@@ -0,0 +1,674 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Generated test maps and a running server to test against
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "doomtype.h"
+#include "doomstat.h"
+#include "d_main.h"
+#include "d_items.h"
+#include "d_player.h"
+#include "c_cvars.h"
+#include "g_game.h"
+#include "g_level.h"
+#include "i_system.h"
+#include "minilzo.h"
+#include "p_local.h"
+#include "p_unlag.h"
+#include "r_state.h"
+#include "sv_main.h"
+#include "version.h"
+#include "w_ident.h"
+
+#include "testmap.h"
+
+EXTERN_CVAR(sv_gametype)
+EXTERN_CVAR(sv_maxclients)
+EXTERN_CVAR(sv_maxplayers)
+EXTERN_CVAR(sv_maxrate)
+EXTERN_CVAR(sv_usemasters)
+EXTERN_CVAR(sv_upnp)
+EXTERN_CVAR(sv_emptyreset)
+
+void G_DeathMatchSpawnPlayer(player_t &player);
+
+//
+// OLumpWriter
+//
+// Builds up the contents of a lump, little-endian.
+//
+class OLumpWriter
+{
+public:
+	void byte8(int value)
+	{
+		data.push_back((byte)value);
+	}
+
+	void short16(int value)
+	{
+		byte8(value);
+		byte8(value >> 8);
+	}
+
+	void long32(int value)
+	{
+		short16(value);
+		short16(value >> 16);
+	}
+
+	void name(const char* str)
+	{
+		char buf[8];
+		strncpy(buf, str, 8);
+		data.insert(data.end(), buf, buf + 8);
+	}
+
+	void fill(int value, size_t count)
+	{
+		data.insert(data.end(), count, (byte)value);
+	}
+
+	std::vector<byte> data;
+};
+
+struct testlump_t
+{
+	std::string			name;
+	std::vector<byte>	data;
+};
+
+static void AddLump(std::vector<testlump_t>& lumps, const char* name,
+                    const OLumpWriter& lump = OLumpWriter())
+{
+	testlump_t l;
+	l.name = name;
+	l.data = lump.data;
+	lumps.push_back(l);
+}
+
+static bool CellIsDoor(int x, int y)
+{
+	return x % 4 == 2 && y % 4 == 2;
+}
+
+//
+// AddTexture
+//
+// A texture made of the one patch there is.
+//
+static void AddTexture(OLumpWriter& lump, const char* name, int width, int height)
+{
+	lump.name(name);
+	lump.short16(0);		// masked
+	lump.byte8(0);			// scalex
+	lump.byte8(0);			// scaley
+	lump.short16(width);
+	lump.short16(height);
+	lump.long32(0);			// columndirectory
+	lump.short16(1);		// patchcount
+	lump.short16(0);		// originx
+	lump.short16(0);		// originy
+	lump.short16(0);		// patch
+	lump.short16(1);		// stepdir
+	lump.short16(0);		// colormap
+}
+
+//
+// AddResources
+//
+// Everything but the maps that the server needs to start.
+//
+static void AddResources(std::vector<testlump_t>& lumps)
+{
+	OLumpWriter playpal;
+	for (int pal = 0; pal < 14; pal++)
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			playpal.byte8((i & 7) * 36);
+			playpal.byte8(((i >> 3) & 7) * 36);
+			playpal.byte8((i >> 6) * 85);
+		}
+	}
+	AddLump(lumps, "PLAYPAL", playpal);
+
+	OLumpWriter colormap;
+	for (int map = 0; map < 34; map++)
+		for (int i = 0; i < 256; i++)
+			colormap.byte8(i);
+	AddLump(lumps, "COLORMAP", colormap);
+
+	OLumpWriter pnames;
+	pnames.long32(1);
+	pnames.name("WALLP");
+	AddLump(lumps, "PNAMES", pnames);
+
+	static const char* const textures[] = { "AASTINKY", "WALL", "SKY1" };
+	const int numtextures = sizeof(textures) / sizeof(textures[0]);
+	const int texturesize = 32;
+
+	OLumpWriter texture1;
+	texture1.long32(numtextures);
+	for (int i = 0; i < numtextures; i++)
+		texture1.long32(4 + numtextures * 4 + i * texturesize);
+	for (int i = 0; i < numtextures; i++)
+		AddTexture(texture1, textures[i], 64, 128);
+	AddLump(lumps, "TEXTURE1", texture1);
+
+	// a 64x128 patch with one post in each column
+	OLumpWriter wallp;
+	wallp.short16(64);
+	wallp.short16(128);
+	wallp.short16(0);
+	wallp.short16(0);
+	for (int x = 0; x < 64; x++)
+		wallp.long32(8 + 64 * 4 + x * (128 + 5));
+	for (int x = 0; x < 64; x++)
+	{
+		wallp.byte8(0);
+		wallp.byte8(128);
+		wallp.byte8(0);
+		wallp.fill(x, 128);
+		wallp.byte8(0);
+		wallp.byte8(0xFF);
+	}
+	AddLump(lumps, "WALLP", wallp);
+	AddLump(lumps, "STDISK", wallp);
+
+	OLumpWriter flat;
+	flat.fill(0x40, 64 * 64);
+
+	AddLump(lumps, "F_START");
+	AddLump(lumps, "FLOOR", flat);
+	AddLump(lumps, "F_SKY1", flat);
+	AddLump(lumps, "F_END");
+
+	AddLump(lumps, "S_START");
+	AddLump(lumps, "S_END");
+}
+
+//
+// AddNode
+//
+// Splits the cells from (x0, y0) up to (x1, y1) in half along a grid line
+// and returns the node, or the subsector if there is only one cell.
+//
+static int AddNode(OLumpWriter& nodes, int& numnodes, int cells,
+                   int x0, int y0, int x1, int y1)
+{
+	if (x1 - x0 == 1 && y1 - y0 == 1)
+		return 0x8000 | (y0 * cells + x0);
+
+	const int cs = TESTMAP_CELLSIZE;
+	int children[2];
+	int bbox[2][4];			// top, bottom, left, right
+	int x, y, dx, dy;
+
+	if (x1 - x0 >= y1 - y0)
+	{
+		// split at a vertical line going north, so east is in front
+		int xm = (x0 + x1) / 2;
+		x = xm * cs; y = y0 * cs; dx = 0; dy = (y1 - y0) * cs;
+
+		children[0] = AddNode(nodes, numnodes, cells, xm, y0, x1, y1);
+		children[1] = AddNode(nodes, numnodes, cells, x0, y0, xm, y1);
+
+		int front[4] = { y1 * cs, y0 * cs, xm * cs, x1 * cs };
+		int back[4] = { y1 * cs, y0 * cs, x0 * cs, xm * cs };
+		memcpy(bbox[0], front, sizeof(front));
+		memcpy(bbox[1], back, sizeof(back));
+	}
+	else
+	{
+		// split at a horizontal line going east, so south is in front
+		int ym = (y0 + y1) / 2;
+		x = x0 * cs; y = ym * cs; dx = (x1 - x0) * cs; dy = 0;
+
+		children[0] = AddNode(nodes, numnodes, cells, x0, y0, x1, ym);
+		children[1] = AddNode(nodes, numnodes, cells, x0, ym, x1, y1);
+
+		int front[4] = { ym * cs, y0 * cs, x0 * cs, x1 * cs };
+		int back[4] = { y1 * cs, ym * cs, x0 * cs, x1 * cs };
+		memcpy(bbox[0], front, sizeof(front));
+		memcpy(bbox[1], back, sizeof(back));
+	}
+
+	nodes.short16(x);
+	nodes.short16(y);
+	nodes.short16(dx);
+	nodes.short16(dy);
+	for (int i = 0; i < 2; i++)
+		for (int j = 0; j < 4; j++)
+			nodes.short16(bbox[i][j]);
+	nodes.short16(children[0]);
+	nodes.short16(children[1]);
+
+	return numnodes++;
+}
+
+struct testline_t
+{
+	int v1, v2;
+	int front, back;		// sectors, -1 for none
+};
+
+static void AddSidedef(OLumpWriter& sidedefs, int sector, bool twosided)
+{
+	sidedefs.short16(0);
+	sidedefs.short16(0);
+	sidedefs.name(twosided ? "WALL" : "-");
+	sidedefs.name(twosided ? "WALL" : "-");
+	sidedefs.name(twosided ? "-" : "WALL");
+	sidedefs.short16(sector);
+}
+
+static void AddSeg(OLumpWriter& segs, int v1, int v2, int angle,
+                   const std::vector<testline_t>& lines, int line)
+{
+	segs.short16(v1);
+	segs.short16(v2);
+	segs.short16(angle);
+	segs.short16(line);
+	segs.short16(lines[line].v1 == v1 ? 0 : 1);
+	segs.short16(0);
+}
+
+static void AddThing(OLumpWriter& things, int x, int y, int type)
+{
+	things.short16(Test_CellCenter(x) >> FRACBITS);
+	things.short16(Test_CellCenter(y) >> FRACBITS);
+	things.short16(0);
+	things.short16(type);
+	things.short16(7);		// all skills
+}
+
+//
+// AddMap
+//
+// A square grid of cells.  Lines between cells go east and north, with the
+// cell to the south or west in front, and lines on the edge of the map
+// have the cell inside in front.
+//
+static void AddMap(std::vector<testlump_t>& lumps, const char* mapname, int cells)
+{
+	const int cs = TESTMAP_CELLSIZE;
+	const int n = cells;
+
+	#define VERTEX(x, y)	((y) * (n + 1) + (x))
+	#define SECTOR(x, y)	((y) * n + (x))
+	#define HLINE(x, y)		((y) * n + (x))
+	#define VLINE(x, y)		(n * (n + 1) + (x) * n + (y))
+
+	OLumpWriter things;
+	for (int i = 0; i < 4; i++)
+		AddThing(things, 1 + (i & 1) * 2, 1 + (i >> 1) * 2, 1 + i);
+	for (int y = 1; y < n; y += 2)
+		for (int x = 1; x < n; x += 2)
+			AddThing(things, x, y, 11);
+
+	OLumpWriter vertexes;
+	for (int y = 0; y <= n; y++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			vertexes.short16(x * cs);
+			vertexes.short16(y * cs);
+		}
+	}
+
+	OLumpWriter sectors;
+	for (int y = 0; y < n; y++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			bool door = CellIsDoor(x, y);
+			sectors.short16(0);
+			sectors.short16(door ? 0 : TESTMAP_HEIGHT);
+			sectors.name("FLOOR");
+			sectors.name("FLOOR");
+			sectors.short16(160);
+			sectors.short16(0);
+			sectors.short16(door ? SECTOR(x, y) + 1 : 0);
+		}
+	}
+
+	std::vector<testline_t> lines(2 * n * (n + 1));
+	for (int y = 0; y <= n; y++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			testline_t& line = lines[HLINE(x, y)];
+			if (y == 0)
+			{
+				line.v1 = VERTEX(x + 1, 0);
+				line.v2 = VERTEX(x, 0);
+				line.front = SECTOR(x, 0);
+				line.back = -1;
+			}
+			else
+			{
+				line.v1 = VERTEX(x, y);
+				line.v2 = VERTEX(x + 1, y);
+				line.front = SECTOR(x, y - 1);
+				line.back = y < n ? SECTOR(x, y) : -1;
+			}
+		}
+	}
+	for (int x = 0; x <= n; x++)
+	{
+		for (int y = 0; y < n; y++)
+		{
+			testline_t& line = lines[VLINE(x, y)];
+			if (x == 0)
+			{
+				line.v1 = VERTEX(0, y);
+				line.v2 = VERTEX(0, y + 1);
+				line.front = SECTOR(0, y);
+				line.back = -1;
+			}
+			else
+			{
+				line.v1 = VERTEX(x, y + 1);
+				line.v2 = VERTEX(x, y);
+				line.front = SECTOR(x - 1, y);
+				line.back = x < n ? SECTOR(x, y) : -1;
+			}
+		}
+	}
+
+	OLumpWriter linedefs, sidedefs;
+	int numsides = 0;
+	for (size_t i = 0; i < lines.size(); i++)
+	{
+		const testline_t& line = lines[i];
+		bool twosided = line.back != -1;
+
+		linedefs.short16(line.v1);
+		linedefs.short16(line.v2);
+		linedefs.short16(twosided ? ML_TWOSIDED : ML_BLOCKING);
+		linedefs.short16(0);
+		linedefs.short16(0);
+		linedefs.short16(numsides++);
+		linedefs.short16(twosided ? numsides++ : -1);
+
+		AddSidedef(sidedefs, line.front, twosided);
+		if (twosided)
+			AddSidedef(sidedefs, line.back, twosided);
+	}
+
+	// each cell is a subsector of four segs, going clockwise
+	OLumpWriter segs, ssectors;
+	for (int y = 0; y < n; y++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			AddSeg(segs, VERTEX(x, y), VERTEX(x, y + 1), 0x4000, lines, VLINE(x, y));
+			AddSeg(segs, VERTEX(x, y + 1), VERTEX(x + 1, y + 1), 0, lines, HLINE(x, y + 1));
+			AddSeg(segs, VERTEX(x + 1, y + 1), VERTEX(x + 1, y), 0xC000, lines, VLINE(x + 1, y));
+			AddSeg(segs, VERTEX(x + 1, y), VERTEX(x, y), 0x8000, lines, HLINE(x, y));
+
+			ssectors.short16(4);
+			ssectors.short16(SECTOR(x, y) * 4);
+		}
+	}
+
+	OLumpWriter nodes;
+	int numnodes = 0;
+	AddNode(nodes, numnodes, n, 0, 0, n, n);
+
+	#undef VERTEX
+	#undef SECTOR
+	#undef HLINE
+	#undef VLINE
+
+	// An empty reject table is ignored, and an empty blockmap is built
+	// when the map is loaded.
+	AddLump(lumps, mapname);
+	AddLump(lumps, "THINGS", things);
+	AddLump(lumps, "LINEDEFS", linedefs);
+	AddLump(lumps, "SIDEDEFS", sidedefs);
+	AddLump(lumps, "VERTEXES", vertexes);
+	AddLump(lumps, "SEGS", segs);
+	AddLump(lumps, "SSECTORS", ssectors);
+	AddLump(lumps, "NODES", nodes);
+	AddLump(lumps, "SECTORS", sectors);
+	AddLump(lumps, "REJECT");
+	AddLump(lumps, "BLOCKMAP");
+}
+
+//
+// Test_WriteWad
+//
+void Test_WriteWad(const std::string& filename)
+{
+	std::vector<testlump_t> lumps;
+	AddResources(lumps);
+	AddMap(lumps, "MAP01", 8);
+	AddMap(lumps, "MAP02", 32);
+
+	FILE* fp = fopen(filename.c_str(), "wb");
+	if (!fp)
+		I_FatalError("Could not write %s", filename.c_str());
+
+	OLumpWriter header;
+	header.name("IWAD");
+	header.data.resize(4);
+
+	size_t offset = 12;
+	for (size_t i = 0; i < lumps.size(); i++)
+		offset += lumps[i].data.size();
+
+	header.long32(lumps.size());
+	header.long32(offset);
+	fwrite(&header.data[0], 1, header.data.size(), fp);
+
+	OLumpWriter directory;
+	offset = 12;
+	for (size_t i = 0; i < lumps.size(); i++)
+	{
+		if (!lumps[i].data.empty())
+			fwrite(&lumps[i].data[0], 1, lumps[i].data.size(), fp);
+
+		directory.long32(offset);
+		directory.long32(lumps[i].data.size());
+		directory.name(lumps[i].name.c_str());
+		offset += lumps[i].data.size();
+	}
+	fwrite(&directory.data[0], 1, directory.data.size(), fp);
+
+	fclose(fp);
+}
+
+//
+// Test_StartEngine
+//
+// Does what D_DoomMain does up to loading the first map, without a config
+// file or log.  Masters aren't contacted.
+//
+void Test_StartEngine()
+{
+	static bool started = false;
+	if (started)
+		return;
+	started = true;
+
+	std::string filename = I_GetBinaryDir() + PATHSEP + "odatest.wad";
+	Test_WriteWad(filename);
+
+	gamestate = GS_STARTUP;
+
+	W_SetupFileIdentifiers();
+	InitItems();
+
+	if (lzo_init() != LZO_E_OK)
+		I_FatalError("Could not initialize LZO routines");
+
+	std::vector<std::string> wadfiles(1, filename), patchfiles;
+	D_LoadResourceFiles(wadfiles, patchfiles);
+
+	I_Init();
+	D_Init();
+	atterm(D_Shutdown);
+
+	sv_usemasters.Set(0.0f);
+	sv_upnp.Set(0.0f);
+	SV_InitNetwork();
+
+	cvar_t::EnableCallbacks();
+
+	// every player is in the game, and nobody is dropped for not sending
+	// anything
+	sv_gametype.Set(GM_DM);
+	sv_maxclients.Set(MAXPLAYERS - 1);
+	sv_maxplayers.Set(MAXPLAYERS - 1);
+	sv_emptyreset.Set(0.0f);
+}
+
+//
+// Test_LoadMap
+//
+void Test_LoadMap(const char* mapname)
+{
+	Test_StartEngine();
+	Test_RemovePlayers();
+
+	G_InitNew(mapname);
+}
+
+int Test_MapCells()
+{
+	int cells = 1;
+	while (cells * cells < numsectors)
+		cells++;
+	return cells;
+}
+
+bool Test_CellIsDoor(int x, int y)
+{
+	return CellIsDoor(x, y);
+}
+
+sector_t* Test_CellSector(int x, int y)
+{
+	return &sectors[y * Test_MapCells() + x];
+}
+
+fixed_t Test_CellCenter(int cell)
+{
+	return (cell * TESTMAP_CELLSIZE + TESTMAP_CELLSIZE / 2) << FRACBITS;
+}
+
+//
+// Test_AddPlayer
+//
+player_t& Test_AddPlayer(int port)
+{
+	Players::iterator it = SV_GetFreeClient();
+	if (it == players.end())
+		I_Error("Test_AddPlayer: the server is full");
+
+	player_t& player = *it;
+	client_t& cl = player.client;
+
+	char address[32];
+	sprintf(address, "127.0.0.1:%d", port ? port : 20000 + player.id);
+	NET_StringToAdr(address, &cl.address);
+	SV_IndexPlayerAddress(player);
+
+	cl.last_received = gametic;
+	cl.reliable_bps = 0;
+	cl.unreliable_bps = 0;
+	cl.lastcmdtic = 0;
+	cl.lastclientcmdtic = 0;
+	cl.allow_rcon = false;
+	cl.displaydisconnect = false;
+	cl.version = VERSION;
+	cl.majorversion = GAMEVER / 256;
+	cl.minorversion = GAMEVER % 256;
+	cl.rate = sv_maxrate.asInt();
+
+	SZ_Clear(&cl.netbuf);
+	SZ_Clear(&cl.reliablebuf);
+	SZ_Clear(&cl.relpackets);
+
+	memset(cl.packetseq, -1, sizeof(cl.packetseq));
+	memset(cl.packetbegin, 0, sizeof(cl.packetbegin));
+	memset(cl.packetsize, 0, sizeof(cl.packetsize));
+
+	cl.sequence = 0;
+	cl.last_sequence = -1;
+	cl.packetnum = 0;
+
+	char name[32];
+	sprintf(name, "Player %d", player.id);
+	player.userinfo.netname = name;
+
+	Unlag::getInstance().registerPlayer(player.id);
+
+	player.spectator = false;
+	player.playerstate = PST_REBORN;
+	G_DoReborn(player);
+	player.playerstate = PST_LIVE;
+
+	return player;
+}
+
+//
+// Test_MovePlayer
+//
+void Test_MovePlayer(player_t& player, int x, int y)
+{
+	AActor* mo = player.mo;
+
+	mo->UnlinkFromWorld();
+	mo->x = Test_CellCenter(x);
+	mo->y = Test_CellCenter(y);
+	mo->LinkToWorld();
+	mo->z = mo->floorz = P_FloorHeight(mo);
+	mo->ceilingz = P_CeilingHeight(mo);
+}
+
+//
+// Test_RemovePlayers
+//
+void Test_RemovePlayers()
+{
+	for (Players::iterator it = players.begin(); it != players.end();)
+	{
+		it->playerstate = PST_DISCONNECT;
+		it = SV_RemoveDisconnectedPlayer(it);
+	}
+}
+
+//
+// Test_RunTics
+//
+void Test_RunTics(int count)
+{
+	SV_StepTics(count);
+}
+
+VERSION_CONTROL (testmap_cpp, "$Id$")
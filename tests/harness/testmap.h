@@ -0,0 +1,77 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Generated test maps and a running server to test against
+//
+//	There are no maps in the source tree, so the harness writes an IWAD
+//	of its own.  Each map in it is a square grid of cells, and each cell
+//	is a sector.  Every fourth cell in both directions is a closed door,
+//	with its ceiling on the floor, which blocks sight and movement.
+//
+//	MAP01	8 x 8 cells
+//	MAP02	32 x 32 cells
+//
+//-----------------------------------------------------------------------------
+
+#ifndef __TESTMAP_H__
+#define __TESTMAP_H__
+
+#include <string>
+
+#include "m_fixed.h"
+#include "d_player.h"
+
+static const int TESTMAP_CELLSIZE = 256;		// map units
+static const int TESTMAP_HEIGHT = 128;			// ceiling height of open cells
+
+void Test_WriteWad(const std::string& filename);
+
+// Starts the server with the generated IWAD the first time it is called.
+void Test_StartEngine();
+
+// Loads a map, removing any players first.
+void Test_LoadMap(const char* mapname);
+
+// The number of cells along each side of the loaded map.
+int Test_MapCells();
+
+bool Test_CellIsDoor(int x, int y);
+sector_t* Test_CellSector(int x, int y);
+
+// The middle of a cell, in map coordinates.
+fixed_t Test_CellCenter(int cell);
+
+//
+// Test_AddPlayer
+//
+// Connects a player as if they had just joined the game, without sending
+// any packets.  The player's address is port on the loopback interface,
+// where nothing is listening unless the caller opens a socket there.
+//
+player_t& Test_AddPlayer(int port = 0);
+
+// Moves a player's body to the middle of a cell.
+void Test_MovePlayer(player_t& player, int x, int y);
+
+void Test_RemovePlayers();
+
+// Runs the server for some tics, as SV_RunTics does but without reading
+// packets.
+void Test_RunTics(int count);
+
+#endif // __TESTMAP_H__
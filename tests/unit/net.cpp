@@ -0,0 +1,233 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Tests for the order packets are sent and received in, with and without
+//	the network thread
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "win32inc.h"
+#ifdef _WIN32
+	#include <winsock2.h>
+	#include <ws2tcpip.h>
+#else
+	#include <sys/types.h>
+	#include <sys/socket.h>
+	#include <netinet/in.h>
+	#include <arpa/inet.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	typedef int SOCKET;
+	#define closesocket close
+#endif
+
+#include "c_cvars.h"
+#include "i_net.h"
+#include "i_system.h"
+#include "harness.h"
+#include "testmap.h"
+
+EXTERN_CVAR(port)
+
+//
+// OPeer
+//
+// A socket on the loopback interface that talks to the server's socket.
+//
+class OPeer
+{
+public:
+	OPeer()
+	{
+		mSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+		sockaddr_in addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(mSocket, (sockaddr*)&addr, sizeof(addr));
+
+		int size = 1 << 20;
+		setsockopt(mSocket, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof(size));
+
+#ifdef _WIN32
+		u_long nonblocking = 1;
+		ioctlsocket(mSocket, FIONBIO, &nonblocking);
+#else
+		fcntl(mSocket, F_SETFL, O_NONBLOCK);
+#endif
+
+		socklen_t len = sizeof(addr);
+		getsockname(mSocket, (sockaddr*)&addr, &len);
+
+		char name[32];
+		sprintf(name, "127.0.0.1:%d", ntohs(addr.sin_port));
+		NET_StringToAdr(name, &mAddress);
+
+		memset(&mServer, 0, sizeof(mServer));
+		mServer.sin_family = AF_INET;
+		mServer.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		mServer.sin_port = htons(port.asInt());
+	}
+
+	~OPeer()
+	{
+		closesocket(mSocket);
+	}
+
+	netadr_t& address()
+	{
+		return mAddress;
+	}
+
+	void send(int sequence)
+	{
+		sendto(mSocket, (const char*)&sequence, sizeof(sequence), 0,
+		       (sockaddr*)&mServer, sizeof(mServer));
+	}
+
+	// Returns the sequence number of the next packet, or -1 if none
+	// arrives within a second.
+	int receive()
+	{
+		for (int waited = 0; waited < 1000; waited++)
+		{
+			int sequence;
+			if (recv(mSocket, (char*)&sequence, sizeof(sequence), 0) == sizeof(sequence))
+				return sequence;
+
+			I_Sleep(I_ConvertTimeFromMs(1));
+		}
+
+		return -1;
+	}
+
+private:
+	SOCKET		mSocket;
+	netadr_t	mAddress;
+	sockaddr_in	mServer;
+};
+
+//
+// ServerReceive
+//
+// Reads the next packet sent to the server, waiting for up to a second
+// for the network thread to pass it on.
+//
+static int ServerReceive()
+{
+	for (int waited = 0; waited < 1000; waited++)
+	{
+		if (NET_GetPacket() == sizeof(int))
+		{
+			int sequence = MSG_ReadLong();
+			return sequence;
+		}
+
+		I_Sleep(I_ConvertTimeFromMs(1));
+	}
+
+	return -1;
+}
+
+// Empties the server's socket of anything a previous case left there.
+static void DrainServer()
+{
+	while (NET_GetPacket())
+		;
+}
+
+TEST_CASE(net, thread_keeps_received_order)
+{
+	Test_StartEngine();
+	DrainServer();
+
+	OPeer peer;
+
+	// More than the receive ring holds, so that starting the thread has
+	// to hand the rest of the ring over and then read the socket.
+	const int count = 100;
+	for (int i = 0; i < count; i++)
+		peer.send(i);
+
+	// the first read takes a batch off the socket into the ring
+	CHECK_EQUAL(ServerReceive(), 0);
+
+	CHECK(NET_StartThread());
+
+	for (int i = 1; i < count; i++)
+		CHECK_EQUAL(ServerReceive(), i);
+
+	NET_StopThread();
+}
+
+TEST_CASE(net, thread_keeps_sent_order)
+{
+	Test_StartEngine();
+
+	OPeer peer;
+
+	CHECK(NET_StartThread());
+
+	// Far more than the outbound queue holds, so that some are dropped,
+	// but none may get out ahead of the ones before them.
+	const int count = 5000;
+	for (int i = 0; i < count; i++)
+	{
+		buf_t buf(16);
+		buf.WriteLong(i);
+		NET_SendPacket(buf, peer.address());
+	}
+
+	NET_StopThread();
+
+	int last = -1, received = 0;
+	for (int sequence = peer.receive(); sequence != -1; sequence = peer.receive())
+	{
+		CHECK(sequence > last && sequence < count);
+		last = sequence;
+		received++;
+	}
+
+	CHECK(received > 0);
+}
+
+TEST_CASE(net, sent_order_without_thread)
+{
+	Test_StartEngine();
+
+	OPeer peer;
+
+	const int count = 200;
+	for (int i = 0; i < count; i++)
+	{
+		buf_t buf(16);
+		buf.WriteLong(i);
+		NET_SendPacket(buf, peer.address());
+	}
+
+	for (int i = 0; i < count; i++)
+		CHECK_EQUAL(peer.receive(), i);
+}
+
+VERSION_CONTROL (net_test_cpp, "$Id$")
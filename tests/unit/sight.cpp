@@ -0,0 +1,77 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Tests for the sight cache
+//
+//-----------------------------------------------------------------------------
+
+#include "doomstat.h"
+#include "p_local.h"
+#include "harness.h"
+#include "testmap.h"
+
+extern int sightcachecounts[2];	// hits, misses
+
+TEST_CASE(sight, door_clears_only_nearby_checks)
+{
+	Test_StartEngine();
+	Test_LoadMap("MAP01");
+
+	// a and b look at each other through the closed door, c and d look
+	// along a row on the other side of the map
+	CHECK(Test_CellIsDoor(2, 2));
+	sector_t* door = Test_CellSector(2, 2);
+
+	player_t& a = Test_AddPlayer();
+	player_t& b = Test_AddPlayer();
+	player_t& c = Test_AddPlayer();
+	player_t& d = Test_AddPlayer();
+	Test_MovePlayer(a, 1, 2);
+	Test_MovePlayer(b, 3, 2);
+	Test_MovePlayer(c, 5, 5);
+	Test_MovePlayer(d, 7, 5);
+
+	P_ClearSightCache();
+
+	CHECK(!P_CheckSight(a.mo, b.mo));
+	CHECK(P_CheckSight(c.mo, d.mo));
+
+	int hits = sightcachecounts[0];
+	CHECK(!P_CheckSight(a.mo, b.mo));
+	CHECK(P_CheckSight(c.mo, d.mo));
+	CHECK_EQUAL(sightcachecounts[0], hits + 2);
+
+	// opening the door only throws away the check that passes through it
+	P_ChangeCeilingHeight(door, TESTMAP_HEIGHT * FRACUNIT);
+
+	hits = sightcachecounts[0];
+	int misses = sightcachecounts[1];
+	CHECK(P_CheckSight(c.mo, d.mo));
+	CHECK(P_CheckSight(a.mo, b.mo));
+	CHECK_EQUAL(sightcachecounts[0], hits + 1);
+	CHECK_EQUAL(sightcachecounts[1], misses + 1);
+
+	// and closing it again sees the door once more
+	P_ChangeCeilingHeight(door, -TESTMAP_HEIGHT * FRACUNIT);
+	CHECK(!P_CheckSight(a.mo, b.mo));
+	CHECK(P_CheckSight(c.mo, d.mo));
+
+	Test_RemovePlayers();
+}
+
+VERSION_CONTROL (sight_test_cpp, "$Id$")
@@ -0,0 +1,139 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Tests for the profiler's histogram buckets and percentiles
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "stats.h"
+#include "harness.h"
+
+static void AddFrames(unsigned int* histogram, unsigned int& frames, dtime_t& maxtime,
+                      dtime_t time, unsigned int count)
+{
+	histogram[Stat_HistogramBucket(time)] += count;
+	frames += count;
+	if (time > maxtime)
+		maxtime = time;
+}
+
+TEST_CASE(stats, small_times_are_exact)
+{
+	for (int i = 0; i < HISTOGRAM_SUBBUCKETS; i++)
+	{
+		CHECK_EQUAL(Stat_HistogramBucket(i), i);
+		CHECK_EQUAL(Stat_HistogramValue(i), (dtime_t)i);
+	}
+}
+
+TEST_CASE(stats, buckets_are_ordered)
+{
+	int last = 0;
+	for (dtime_t time = 0; time < ((dtime_t)1 << 40); time += time / 7 + 1)
+	{
+		int bucket = Stat_HistogramBucket(time);
+		CHECK(bucket >= last);
+		CHECK(bucket < NUMHISTOGRAMBUCKETS);
+		last = bucket;
+	}
+}
+
+TEST_CASE(stats, bucket_edges)
+{
+	// every power of two starts a new group of buckets
+	for (int exponent = HISTOGRAM_SUBBITS; exponent < 36; exponent++)
+	{
+		dtime_t edge = (dtime_t)1 << exponent;
+		CHECK_EQUAL(Stat_HistogramBucket(edge) % HISTOGRAM_SUBBUCKETS, 0);
+		CHECK_EQUAL(Stat_HistogramBucket(edge - 1) + 1, Stat_HistogramBucket(edge));
+	}
+
+	CHECK_EQUAL(Stat_HistogramBucket((dtime_t)1 << 60), NUMHISTOGRAMBUCKETS - 1);
+	CHECK_EQUAL(Stat_HistogramBucket(~(dtime_t)0), NUMHISTOGRAMBUCKETS - 1);
+}
+
+TEST_CASE(stats, values_fall_in_their_bucket)
+{
+	for (int bucket = 0; bucket < NUMHISTOGRAMBUCKETS - 1; bucket++)
+		CHECK_EQUAL(Stat_HistogramBucket(Stat_HistogramValue(bucket)), bucket);
+}
+
+TEST_CASE(stats, relative_error)
+{
+	// a bucket is 1/8 of its power of two wide, so the middle of it is
+	// never more than 1/16 away from a time in it
+	for (dtime_t time = 1; time < ((dtime_t)1 << 36); time += time / 13 + 1)
+	{
+		dtime_t value = Stat_HistogramValue(Stat_HistogramBucket(time));
+		dtime_t error = value > time ? value - time : time - value;
+		CHECK(error * 16 <= time);
+	}
+}
+
+TEST_CASE(stats, percentiles)
+{
+	unsigned int histogram[NUMHISTOGRAMBUCKETS];
+	memset(histogram, 0, sizeof(histogram));
+	unsigned int frames = 0;
+	dtime_t maxtime = 0;
+
+	// 98 frames of 1ms, one of 20ms and one of 50ms
+	AddFrames(histogram, frames, maxtime, 1000000, 98);
+	AddFrames(histogram, frames, maxtime, 20000000, 1);
+	AddFrames(histogram, frames, maxtime, 50000000, 1);
+
+	dtime_t p50 = Stat_Percentile(histogram, frames, maxtime, 0.50);
+	CHECK(p50 >= 1000000 - 1000000 / 16 && p50 <= 1000000 + 1000000 / 16);
+
+	dtime_t p98 = Stat_Percentile(histogram, frames, maxtime, 0.98);
+	CHECK_EQUAL(Stat_HistogramBucket(p98), Stat_HistogramBucket(1000000));
+
+	dtime_t p99 = Stat_Percentile(histogram, frames, maxtime, 0.99);
+	CHECK_EQUAL(Stat_HistogramBucket(p99), Stat_HistogramBucket(20000000));
+
+	// the slowest frame is known exactly
+	CHECK_EQUAL(Stat_Percentile(histogram, frames, maxtime, 1.0), (dtime_t)50000000);
+}
+
+TEST_CASE(stats, percentile_of_one_frame)
+{
+	unsigned int histogram[NUMHISTOGRAMBUCKETS];
+	memset(histogram, 0, sizeof(histogram));
+	unsigned int frames = 0;
+	dtime_t maxtime = 0;
+
+	// the middle of the bucket is above the only time, which is the maximum
+	AddFrames(histogram, frames, maxtime, 1000000, 1);
+	CHECK(Stat_HistogramValue(Stat_HistogramBucket(1000000)) > 1000000);
+
+	CHECK_EQUAL(Stat_Percentile(histogram, frames, maxtime, 0.0), (dtime_t)1000000);
+	CHECK_EQUAL(Stat_Percentile(histogram, frames, maxtime, 0.5), (dtime_t)1000000);
+	CHECK_EQUAL(Stat_Percentile(histogram, frames, maxtime, 0.99), (dtime_t)1000000);
+}
+
+TEST_CASE(stats, percentile_of_no_frames)
+{
+	unsigned int histogram[NUMHISTOGRAMBUCKETS];
+	memset(histogram, 0, sizeof(histogram));
+
+	CHECK_EQUAL(Stat_Percentile(histogram, 0, 0, 0.5), (dtime_t)0);
+}
+
+VERSION_CONTROL (stats_test_cpp, "$Id$")
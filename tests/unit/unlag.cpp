@@ -0,0 +1,258 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Replays a recorded game and checks that reconciliation puts players and
+//	moving sectors back where the server had them
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include "doomstat.h"
+#include "d_netcmd.h"
+#include "p_local.h"
+#include "p_spec.h"
+#include "p_unlag.h"
+#include "harness.h"
+#include "testmap.h"
+
+static const int NUM_PLAYERS = 8;
+static const int NUM_DOORS = 2;
+
+struct RecordedPosition
+{
+	fixed_t x, y, z;
+};
+
+struct RecordedTic
+{
+	RecordedPosition	players[NUM_PLAYERS];
+	fixed_t				ceilings[NUM_DOORS];
+};
+
+//
+// RecordInputs
+//
+// Makes up the ticcmds of a game, the same every time.  Each player runs
+// and strafes in a direction that changes every half second.
+//
+static std::vector<NetCommand> RecordInputs(int tics)
+{
+	std::vector<NetCommand> inputs(tics * NUM_PLAYERS);
+	unsigned int seed = 1;
+
+	for (int tic = 0; tic < tics; tic++)
+	{
+		for (int i = 0; i < NUM_PLAYERS; i++)
+		{
+			NetCommand& cmd = inputs[tic * NUM_PLAYERS + i];
+
+			if (tic % (TICRATE / 2) != 0)
+			{
+				cmd = inputs[(tic - 1) * NUM_PLAYERS + i];
+				continue;
+			}
+
+			seed = seed * 1103515245 + 12345;
+			cmd.setForwardMove((short)((int)(seed >> 16) % 101 - 50) << 8);
+			seed = seed * 1103515245 + 12345;
+			cmd.setSideMove((short)((int)(seed >> 16) % 81 - 40) << 8);
+			seed = seed * 1103515245 + 12345;
+			cmd.setAngle((fixed_t)(seed & 0xFFFF0000));
+		}
+	}
+
+	return inputs;
+}
+
+static RecordedPosition PositionOf(player_t* player)
+{
+	RecordedPosition pos;
+	pos.x = player->mo->x;
+	pos.y = player->mo->y;
+	pos.z = player->mo->z;
+	return pos;
+}
+
+static bool SamePosition(const RecordedPosition& a, const RecordedPosition& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+//
+// InReach
+//
+// True if a player standing at pos could be hit by a shot of the given
+// range fired from the shooter's position.
+//
+static bool InReach(player_t* shooter, const RecordedPosition& pos, fixed_t range)
+{
+	double dx = FIXED2FLOAT(pos.x - shooter->mo->x);
+	double dy = FIXED2FLOAT(pos.y - shooter->mo->y);
+	double reach = FIXED2FLOAT(range + MAXRADIUS);
+
+	return dx * dx + dy * dy <= reach * reach;
+}
+
+TEST_CASE(unlag, replay)
+{
+	Test_StartEngine();
+	Test_LoadMap("MAP02");
+
+	CHECK(Unlag::enabled());
+
+	player_t* players_in_game[NUM_PLAYERS];
+	for (int i = 0; i < NUM_PLAYERS; i++)
+	{
+		players_in_game[i] = &Test_AddPlayer();
+		Test_MovePlayer(*players_in_game[i], 1 + 4 * (i % 4), 1 + 4 * (i / 4));
+	}
+
+	// open two doors slowly so that they move for the whole game
+	sector_t* doors[NUM_DOORS] = { Test_CellSector(2, 2), Test_CellSector(6, 2) };
+	for (int i = 0; i < NUM_DOORS; i++)
+	{
+		CHECK(Test_CellIsDoor(2 + 4 * i, 2));
+		EV_DoDoor(DDoor::doorOpen, NULL, NULL, doors[i]->tag, FRACUNIT / 2, 0, NoKey);
+	}
+
+	const int tics = Test_Param("-tics", 4 * TICRATE, 2 * TICRATE);
+	const std::vector<NetCommand> inputs = RecordInputs(tics);
+
+	const fixed_t ranges[] = { MELEERANGE, 1024 * FRACUNIT, MISSILERANGE };
+	const int first_tic = gametic;
+
+	std::vector<RecordedTic> authoritative;
+	int reconciled = 0, moved = 0, sectors_moved = 0;
+
+	for (int tic = 0; tic < tics; tic++)
+	{
+		for (int i = 0; i < NUM_PLAYERS; i++)
+		{
+			NetCommand cmd = inputs[tic * NUM_PLAYERS + i];
+			cmd.setTic(gametic);
+			cmd.setWorldIndex(gametic);
+			players_in_game[i]->cmdqueue.push(cmd);
+		}
+
+		Test_RunTics(1);
+
+		RecordedTic record;
+		for (int i = 0; i < NUM_PLAYERS; i++)
+			record.players[i] = PositionOf(players_in_game[i]);
+		for (int i = 0; i < NUM_DOORS; i++)
+			record.ceilings[i] = P_CeilingHeight(doors[i]);
+		authoritative.push_back(record);
+
+		// wait for a full history before shooting
+		if (tic < TICRATE)
+			continue;
+
+		// shoot from every player, with every lag that can be unlagged
+		for (int shooter = 0; shooter < NUM_PLAYERS; shooter++)
+		{
+			for (int lag = 1; lag < TICRATE; lag++)
+			{
+				for (size_t r = 0; r < ARRAY_LENGTH(ranges); r++)
+				{
+					player_t* shooter_player = players_in_game[shooter];
+					const byte shooter_id = shooter_player->id;
+
+					// the world index a client returns is the tic of the last
+					// update it saw, so the positions it was aiming at are
+					// the ones recorded at the end of that tic
+					const RecordedTic& then = authoritative[gametic - lag - first_tic];
+
+					Unlag::getInstance().setRoundtripDelay(shooter_id, (gametic - lag) & 0xFF);
+					Unlag::getInstance().reconcile(shooter_id, ranges[r]);
+					reconciled++;
+
+					for (int i = 0; i < NUM_PLAYERS; i++)
+					{
+						RecordedPosition pos = PositionOf(players_in_game[i]);
+						const RecordedPosition& now = record.players[i];
+						const RecordedPosition& old = then.players[i];
+
+						if (i == shooter)
+						{
+							CHECK(SamePosition(pos, now));
+							continue;
+						}
+
+						// anyone the shot could reach is where the shooter saw
+						// them, and anyone else is where they are now
+						if (InReach(shooter_player, old, ranges[r]) ||
+						    InReach(shooter_player, now, ranges[r]))
+							CHECK(SamePosition(pos, old));
+						else
+							CHECK(SamePosition(pos, now) || SamePosition(pos, old));
+
+						if (SamePosition(pos, old) && !SamePosition(old, now))
+						{
+							moved++;
+
+							fixed_t x, y, z;
+							Unlag::getInstance().getReconciliationOffset(
+								players_in_game[i]->id, x, y, z);
+							CHECK_EQUAL(x, now.x - old.x);
+							CHECK_EQUAL(y, now.y - old.y);
+							CHECK_EQUAL(z, now.z - old.z);
+
+							Unlag::getInstance().getCurrentPlayerPosition(
+								players_in_game[i]->id, x, y, z);
+							CHECK_EQUAL(x, now.x);
+							CHECK_EQUAL(y, now.y);
+						}
+					}
+
+					// Sector heights are recorded per tic like players, but
+					// a lag of one puts them back to the record before the
+					// last one.  This is how sectors have always been
+					// reconciled.
+					const RecordedTic& sectors_then =
+						authoritative[gametic - 1 - lag - first_tic];
+					for (int i = 0; i < NUM_DOORS; i++)
+					{
+						fixed_t height = P_CeilingHeight(doors[i]);
+						if (height != record.ceilings[i])
+						{
+							CHECK_EQUAL(height, sectors_then.ceilings[i]);
+							sectors_moved++;
+						}
+					}
+
+					Unlag::getInstance().restore(shooter_id);
+
+					for (int i = 0; i < NUM_PLAYERS; i++)
+						CHECK(SamePosition(PositionOf(players_in_game[i]), record.players[i]));
+					for (int i = 0; i < NUM_DOORS; i++)
+						CHECK_EQUAL(P_CeilingHeight(doors[i]), record.ceilings[i]);
+				}
+			}
+		}
+	}
+
+	// the replay has to have moved players around for this to mean anything
+	CHECK(reconciled > 0);
+	CHECK(moved > 0);
+	CHECK(sectors_moved > 0);
+
+	Test_RemovePlayers();
+}
+
+VERSION_CONTROL (unlag_test_cpp, "$Id$")
@@ -0,0 +1,216 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Tests for the zone's level tag arenas and Z_FreeTags
+//
+//-----------------------------------------------------------------------------
+
+#include <vector>
+
+#include <string.h>
+
+#include "doomtype.h"
+#include "z_zone.h"
+#include "harness.h"
+
+// Level tags the engine never uses, so that freeing them leaves the rest
+// of the zone alone.  Like every level tag, small blocks with these come
+// from arenas.
+static const int FIRST_TAG = PU_LEVACS + 8;
+static const int LAST_TAG = FIRST_TAG + 3;
+
+struct testblock_t
+{
+	byte*	data;
+	size_t	size;
+	int		tag;
+	bool	owned;
+	bool	live;
+};
+
+static unsigned int seed = 1;
+
+static unsigned int Random(unsigned int range)
+{
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) % range;
+}
+
+static byte FillByte(size_t i, int cycle)
+{
+	return (byte)(i * 7 + cycle * 13 + 1);
+}
+
+// Checks that nothing has written over a block since it was filled.
+static bool Intact(const testblock_t& block, byte fill)
+{
+	for (size_t i = 0; i < block.size; i++)
+	{
+		if (block.data[i] != fill)
+			return false;
+	}
+	return true;
+}
+
+//
+// zone.free_tags_cycles
+//
+// Allocates blocks of arena and heap sizes with level tags and PU_STATIC,
+// some with owners, frees some of them and changes the tags of others,
+// then frees the level tags, over and over.  Owners of the blocks that
+// were freed are cleared, blocks moved to PU_STATIC survive untouched, and
+// once everything is freed the zone is back to the blocks it started with.
+//
+TEST_CASE(zone, free_tags_cycles)
+{
+	// purgable blocks could be thrown out along the way and change the
+	// shape of the zone
+	Z_FreeTags(PU_PURGELEVEL, PU_CACHE);
+
+	zonestats_t before;
+	Z_GetStats(before);
+
+	const int cycles = Test_Param("-cycles", 50, 10);
+	const size_t count = 2000;
+
+	std::vector<void*> owners(count);
+	std::vector<testblock_t> blocks(count);
+
+	for (int cycle = 0; cycle < cycles; cycle++)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			testblock_t& block = blocks[i];
+
+			// mostly sizes that come from arenas, the rest from the heap
+			block.size = Random(10) < 7 ? 1 + Random(1024) : 1025 + Random(8000);
+			block.tag = Random(10) == 0 ? PU_STATIC : FIRST_TAG + Random(LAST_TAG - FIRST_TAG + 1);
+			block.owned = Random(2) == 0;
+			block.live = true;
+
+			owners[i] = NULL;
+			block.data = (byte*)Z_Malloc(block.size, block.tag, block.owned ? &owners[i] : NULL);
+			if (block.owned)
+				CHECK(owners[i] == block.data);
+
+			memset(block.data, FillByte(i, cycle), block.size);
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			testblock_t& block = blocks[i];
+
+			unsigned int action = Random(20);
+			if (action < 4)
+			{
+				Z_Free(block.data);
+				block.live = false;
+				if (block.owned)
+					CHECK(owners[i] == NULL);
+			}
+			else if (action < 7)
+			{
+				block.tag = PU_STATIC;
+				Z_ChangeTag(block.data, block.tag);
+			}
+			else if (action < 10)
+			{
+				block.tag = FIRST_TAG + Random(LAST_TAG - FIRST_TAG + 1);
+				Z_ChangeTag(block.data, block.tag);
+			}
+		}
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (blocks[i].live)
+				CHECK(Intact(blocks[i], FillByte(i, cycle)));
+		}
+
+		Z_FreeTags(FIRST_TAG, LAST_TAG);
+		Z_CheckHeap();
+
+		for (size_t i = 0; i < count; i++)
+		{
+			testblock_t& block = blocks[i];
+			if (!block.live)
+				continue;
+
+			if (block.tag == PU_STATIC)
+			{
+				CHECK(Intact(block, FillByte(i, cycle)));
+				if (block.owned)
+					CHECK(owners[i] == block.data);
+
+				Z_Free(block.data);
+			}
+			else if (block.owned)
+			{
+				CHECK(owners[i] == NULL);
+			}
+
+			block.live = false;
+		}
+
+		Z_CheckHeap();
+	}
+
+	zonestats_t after;
+	Z_GetStats(after);
+
+	CHECK_EQUAL(after.blocks, before.blocks);
+	CHECK_EQUAL(after.freeblocks, before.freeblocks);
+	CHECK_EQUAL(after.freebytes, before.freebytes);
+	CHECK_EQUAL(after.largestfree, before.largestfree);
+}
+
+//
+// zone.arenas_recycle_blocks
+//
+// Freeing a small level block and allocating another of the same size
+// class gets the same memory back, and freeing the tag gives the zone
+// back every arena.
+//
+TEST_CASE(zone, arenas_recycle_blocks)
+{
+	Z_FreeTags(PU_PURGELEVEL, PU_CACHE);
+
+	zonestats_t before;
+	Z_GetStats(before);
+
+	void* first = Z_Malloc(100, FIRST_TAG, NULL);
+	void* second = Z_Malloc(100, FIRST_TAG, NULL);
+	CHECK(first != second);
+
+	Z_Free(first);
+	CHECK(Z_Malloc(97, FIRST_TAG, NULL) == first);
+
+	// a lot more than fits in one arena
+	for (int i = 0; i < 10000; i++)
+		Z_Malloc(200, FIRST_TAG, NULL);
+
+	Z_FreeTags(FIRST_TAG, FIRST_TAG);
+	Z_CheckHeap();
+
+	zonestats_t after;
+	Z_GetStats(after);
+
+	CHECK_EQUAL(after.blocks, before.blocks);
+	CHECK_EQUAL(after.largestfree, before.largestfree);
+}
+
+VERSION_CONTROL (zone_test_cpp, "$Id$")
@@ -0,0 +1,546 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Game server packet flood generator
+//
+//	Floods a game server with the packets anyone can send it without
+//	connecting: launcher queries, SQP queries, connect attempts with
+//	made-up tokens and junk.  Each packet comes from one of many source
+//	addresses, as a flood with spoofed sources would.  Reports how much
+//	the server answers, and how quickly it still answers a launcher that
+//	queries it at a normal rate.
+//
+//	Every source gets its own loopback address (127.2.x.y), so the server
+//	has to be run on the same machine.  The server's tic times under the
+//	flood can be read with its stat console command.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "i_net.h"
+#include "version.h"
+
+using namespace std;
+
+#define SERVERPORT			10666
+
+// An SQP query for full server information (see SV_QryParseEnquiry).
+#define SQP_CHALLENGE		0xAD011002
+#define SQP_PROTOCOL		8
+
+// A probe query that gets no reply within this time is counted as lost.
+#define PROBE_TIMEOUT_US	1000000
+
+#define REPORT_INTERVAL_US	1000000
+
+typedef uint64_t ustime_t;
+
+enum floodkind_t
+{
+	FLOOD_LAUNCHER,
+	FLOOD_SQP,
+	FLOOD_CONNECT,
+	FLOOD_JUNK,
+
+	NUM_FLOODKINDS
+};
+
+static const char *kindnames[NUM_FLOODKINDS] =
+{
+	"launcher", "sqp", "connect", "junk"
+};
+
+struct options_t
+{
+	const char *server;
+	int sources;
+	int rate;			// flood packets per second
+	int proberate;		// probe queries per second
+	int duration;		// seconds
+	bool kinds[NUM_FLOODKINDS];
+};
+
+struct stats_t
+{
+	int sent;
+	uint64_t sentbytes;
+	int replies;
+	uint64_t replybytes;
+	int probes;
+	int probereplies;
+	int probelost;
+	vector<ustime_t> latency;
+};
+
+static options_t opts;
+static sockaddr_in server_addr;
+
+static vector<int> sources;
+static int probe_sock;
+static ustime_t probe_sent;		// 0 if no probe is outstanding
+
+static stats_t total, interval;
+
+static buf_t packet(MAX_UDP_PACKET);
+
+ustime_t usTime(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	return (ustime_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+//
+// openSocket
+//
+// Opens a non-blocking UDP socket bound to the given address on any port.
+//
+int openSocket(uint32_t ip)
+{
+	int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == -1)
+		return -1;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(ip);
+	addr.sin_port = 0;
+
+	if (bind(s, (sockaddr *)&addr, sizeof(addr)) == -1 ||
+	    fcntl(s, F_SETFL, O_NONBLOCK) == -1)
+	{
+		close(s);
+		return -1;
+	}
+
+	return s;
+}
+
+bool resolveServer(const char *str, sockaddr_in *addr)
+{
+	string host = str;
+	int port = SERVERPORT;
+
+	size_t colon = host.find(':');
+	if (colon != string::npos)
+	{
+		port = atoi(host.c_str() + colon + 1);
+		host.erase(colon);
+	}
+
+	hostent *h = gethostbyname(host.c_str());
+	if (!h || h->h_addrtype != AF_INET)
+		return false;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_port = htons(port);
+	memcpy(&addr->sin_addr, h->h_addr_list[0], 4);
+
+	return true;
+}
+
+void sendPacket(int sock)
+{
+	sendto(sock, (const char *)packet.data, packet.cursize, 0,
+	       (sockaddr *)&server_addr, sizeof(server_addr));
+}
+
+//
+// readPacket
+//
+// Reads the next packet from the server into packet.  Returns false once
+// the socket has nothing left to read.
+//
+bool readPacket(int sock)
+{
+	sockaddr_in from;
+	socklen_t fromlen = sizeof(from);
+
+	while (true)
+	{
+		packet.clear();
+
+		int ret = recvfrom(sock, (char *)packet.data, packet.maxsize(), 0,
+		                   (sockaddr *)&from, &fromlen);
+		if (ret < 0)
+			return false;
+
+		if (from.sin_addr.s_addr != server_addr.sin_addr.s_addr ||
+		    from.sin_port != server_addr.sin_port)
+			continue;
+
+		packet.setcursize(ret);
+		return true;
+	}
+}
+
+//
+// buildFlood
+//
+// Writes a flood packet of the given kind into packet.
+//
+void buildFlood(floodkind_t kind)
+{
+	packet.clear();
+
+	switch (kind)
+	{
+	case FLOOD_LAUNCHER:
+		packet.WriteLong(LAUNCHER_CHALLENGE);
+		break;
+
+	case FLOOD_SQP:
+		packet.WriteLong(SQP_CHALLENGE);
+		packet.WriteLong(GAMEVER);
+		packet.WriteLong(SQP_PROTOCOL);
+		packet.WriteLong(rand());			// time
+		break;
+
+	case FLOOD_CONNECT:
+		// a token the server never gave out, followed by the start of a
+		// connect request
+		packet.WriteLong(CHALLENGE);
+		packet.WriteLong(rand());
+		packet.WriteShort(GAMEVER);
+		packet.WriteByte(0);
+		break;
+
+	default:
+	{
+		int length = 4 + rand() % 64;
+		for (int i = 0; i < length; i++)
+			packet.WriteByte(rand());
+		break;
+	}
+	}
+}
+
+void sendFlood(size_t source, floodkind_t kind)
+{
+	buildFlood(kind);
+	sendPacket(sources[source]);
+
+	total.sent++;
+	interval.sent++;
+	total.sentbytes += packet.cursize;
+	interval.sentbytes += packet.cursize;
+}
+
+void sendProbe(ustime_t now)
+{
+	if (probe_sent)
+		return;
+
+	packet.clear();
+	packet.WriteLong(LAUNCHER_CHALLENGE);
+	sendPacket(probe_sock);
+	probe_sent = now;
+
+	total.probes++;
+	interval.probes++;
+}
+
+void readProbe(ustime_t now)
+{
+	if (!probe_sent)
+		return;		// a late reply to a probe that was counted as lost
+
+	total.probereplies++;
+	interval.probereplies++;
+	total.latency.push_back(now - probe_sent);
+	interval.latency.push_back(now - probe_sent);
+
+	probe_sent = 0;
+}
+
+void expireProbe(ustime_t now)
+{
+	if (probe_sent && now - probe_sent > PROBE_TIMEOUT_US)
+	{
+		probe_sent = 0;
+
+		total.probelost++;
+		interval.probelost++;
+	}
+}
+
+ustime_t percentile(const vector<ustime_t> &sorted, int pct)
+{
+	if (sorted.empty())
+		return 0;
+
+	return sorted[(sorted.size() - 1) * pct / 100];
+}
+
+void printStats(const char *label, stats_t &s, double seconds)
+{
+	sort(s.latency.begin(), s.latency.end());
+
+	printf("%s: sent %.0f/s (%.0f KB/s), replies %.0f/s (%.0f KB/s), "
+	       "probes %d answered %d lost %d, "
+	       "probe latency p50 %uus p99 %uus max %uus\n",
+	       label,
+	       s.sent / seconds, s.sentbytes / seconds / 1024,
+	       s.replies / seconds, s.replybytes / seconds / 1024,
+	       s.probes, s.probereplies, s.probelost,
+	       (unsigned)percentile(s.latency, 50),
+	       (unsigned)percentile(s.latency, 99),
+	       (unsigned)percentile(s.latency, 100));
+}
+
+void usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+	       "  -server <host[:port]>  server to flood (default 127.0.0.1:%d)\n"
+	       "  -sources <n>           source addresses (default %d)\n"
+	       "  -rate <n>              flood packets per second (default %d)\n"
+	       "  -proberate <n>         launcher queries per second to time (default %d)\n"
+	       "  -kind <kind>           launcher, sqp, connect, junk or all (default all)\n"
+	       "  -duration <s>          seconds to run for (default %d)\n",
+	       name, SERVERPORT, opts.sources, opts.rate, opts.proberate,
+	       opts.duration);
+}
+
+bool parseKind(const char *val)
+{
+	bool all = !strcmp(val, "all");
+	bool found = all;
+
+	for (int i = 0; i < NUM_FLOODKINDS; i++)
+	{
+		opts.kinds[i] = all || !strcmp(val, kindnames[i]);
+		found = found || opts.kinds[i];
+	}
+
+	return found;
+}
+
+bool parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+			return false;
+
+		const char *arg = argv[i];
+		const char *val = argv[++i];
+
+		if (!strcmp(arg, "-server"))
+			opts.server = val;
+		else if (!strcmp(arg, "-sources"))
+			opts.sources = atoi(val);
+		else if (!strcmp(arg, "-rate"))
+			opts.rate = atoi(val);
+		else if (!strcmp(arg, "-proberate"))
+			opts.proberate = atoi(val);
+		else if (!strcmp(arg, "-kind"))
+		{
+			if (!parseKind(val))
+				return false;
+		}
+		else if (!strcmp(arg, "-duration"))
+			opts.duration = atoi(val);
+		else
+			return false;
+	}
+
+	// A source at 127.2.x.0 or .255 would look odd in the server's logs.
+	return opts.sources > 0 && opts.sources <= 254 * 256 &&
+	       opts.rate >= 0 && opts.proberate >= 0 && opts.duration > 0;
+}
+
+//
+// raiseFileLimit
+//
+// Every source address needs a socket of its own.
+//
+bool raiseFileLimit(size_t needed)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+		return false;
+
+	if (rl.rlim_cur >= needed)
+		return true;
+
+	if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < needed)
+		return false;
+
+	rl.rlim_cur = needed;
+	return setrlimit(RLIMIT_NOFILE, &rl) == 0;
+}
+
+int main(int argc, char **argv)
+{
+	opts.server = "127.0.0.1";
+	opts.sources = 1000;
+	opts.rate = 20000;
+	opts.proberate = 10;
+	opts.duration = 30;
+	parseKind("all");
+
+	if (!parseArgs(argc, argv))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!resolveServer(opts.server, &server_addr))
+	{
+		printf("Could not resolve server %s\n", opts.server);
+		return 1;
+	}
+
+	if (!raiseFileLimit(opts.sources + 16))
+	{
+		printf("Not allowed to open %d sockets\n", opts.sources + 1);
+		return 1;
+	}
+
+	sources.resize(opts.sources);
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		uint32_t ip = (127 << 24) | (2 << 16) | ((i / 254) << 8) | (i % 254 + 1);
+
+		sources[i] = openSocket(ip);
+		if (sources[i] == -1)
+		{
+			printf("Could not open a socket for source %d: %s\n", (int)i, strerror(errno));
+			return 1;
+		}
+	}
+
+	probe_sock = openSocket(INADDR_LOOPBACK);
+	if (probe_sock == -1)
+	{
+		printf("Could not open the probe socket: %s\n", strerror(errno));
+		return 1;
+	}
+
+	vector<floodkind_t> kinds;
+	for (int i = 0; i < NUM_FLOODKINDS; i++)
+		if (opts.kinds[i])
+			kinds.push_back((floodkind_t)i);
+
+	// Sources come first in the poll list, then the probe.
+	vector<pollfd> fds(sources.size() + 1);
+	for (size_t i = 0; i < fds.size(); i++)
+	{
+		fds[i].fd = i < sources.size() ? sources[i] : probe_sock;
+		fds[i].events = POLLIN;
+	}
+
+	printf("Flooding server %s:%d from %d sources, %d packets/s, %d probes/s for %ds\n",
+	       inet_ntoa(server_addr.sin_addr), ntohs(server_addr.sin_port),
+	       opts.sources, opts.rate, opts.proberate, opts.duration);
+
+	ustime_t start = usTime();
+	ustime_t end = start + (ustime_t)opts.duration * 1000000;
+	ustime_t next_report = start + REPORT_INTERVAL_US;
+	ustime_t last_report = start;
+
+	// Packets owed since start, sent as their time comes round.
+	uint64_t flood_sent = 0, probes_sent = 0;
+	size_t next_source = 0;
+
+	ustime_t now = start;
+
+	while (now < end)
+	{
+		uint64_t flood_due = (uint64_t)(now - start) * opts.rate / 1000000;
+		for (; flood_sent < flood_due; flood_sent++)
+		{
+			sendFlood(next_source, kinds[flood_sent % kinds.size()]);
+			next_source = (next_source + 1) % sources.size();
+		}
+
+		uint64_t probes_due = (uint64_t)(now - start) * opts.proberate / 1000000;
+		for (; probes_sent < probes_due; probes_sent++)
+			sendProbe(now);
+
+		if (poll(&fds[0], fds.size(), 1) > 0)
+		{
+			now = usTime();
+
+			for (size_t i = 0; i < fds.size(); i++)
+			{
+				if (!(fds[i].revents & POLLIN))
+					continue;
+
+				while (readPacket(fds[i].fd))
+				{
+					if (i < sources.size())
+					{
+						total.replies++;
+						interval.replies++;
+						total.replybytes += packet.cursize;
+						interval.replybytes += packet.cursize;
+					}
+					else
+						readProbe(now);
+				}
+			}
+		}
+
+		now = usTime();
+		expireProbe(now);
+
+		if (now >= next_report)
+		{
+			printStats("last second", interval, (now - last_report) / 1e6);
+			interval = stats_t();
+
+			last_report = now;
+			next_report = now + REPORT_INTERVAL_US;
+		}
+	}
+
+	printStats("total", total, (now - start) / 1e6);
+
+	for (size_t i = 0; i < sources.size(); i++)
+		close(sources[i]);
+	close(probe_sock);
+
+	return 0;
+}
@@ -0,0 +1,567 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id$
+//
+// Copyright (C) 2006-2020 by The Odamex Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//	Master server load generator
+//
+//	Simulates a large number of game servers registering with a master
+//	and answering its pings, while a set of launchers asks for the server
+//	list as fast as requested.  Reports the master's list reply latency
+//	and how many servers it has verified.
+//
+//	Every simulated server gets its own loopback address (127.1.x.y), so
+//	the master's per-IP limit doesn't apply and the master has to be run
+//	on the same machine.
+//
+//-----------------------------------------------------------------------------
+
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <stdint.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "i_net.h"
+
+using namespace std;
+
+// A launcher query that gets no reply within this time is counted as lost.
+#define QUERY_TIMEOUT_US	1000000
+
+#define REPORT_INTERVAL_US	1000000
+
+typedef uint64_t ustime_t;
+
+struct options_t
+{
+	const char *master;
+	int servers;
+	int launchers;
+	int regrate;		// registrations per second
+	int queryrate;		// launcher queries per second
+	int duration;		// seconds
+};
+
+struct simserver_t
+{
+	int sock;
+	int pings;			// pings answered
+};
+
+struct launcher_t
+{
+	int sock;
+	ustime_t sent;		// 0 if no query is outstanding
+};
+
+struct stats_t
+{
+	int registrations;
+	int pings;
+	int queries;
+	int skipped;		// queries not sent because every launcher was waiting
+	int replies;
+	int lost;
+	int malformed;
+	int listed;			// servers in the last list reply
+	vector<ustime_t> latency;
+};
+
+static options_t opts;
+static sockaddr_in master_addr;
+
+static vector<simserver_t> simservers;
+static vector<launcher_t> launchers;
+static deque<size_t> idle_launchers;
+
+static stats_t total, interval;
+
+static buf_t packet(MAX_UDP_PACKET);
+
+ustime_t usTime(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+
+	return (ustime_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+//
+// openSocket
+//
+// Opens a non-blocking UDP socket bound to the given address on any port.
+//
+int openSocket(uint32_t ip)
+{
+	int s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == -1)
+		return -1;
+
+	sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(ip);
+	addr.sin_port = 0;
+
+	if (bind(s, (sockaddr *)&addr, sizeof(addr)) == -1 ||
+	    fcntl(s, F_SETFL, O_NONBLOCK) == -1)
+	{
+		close(s);
+		return -1;
+	}
+
+	return s;
+}
+
+bool resolveMaster(const char *str, sockaddr_in *addr)
+{
+	string host = str;
+	int port = MASTERPORT;
+
+	size_t colon = host.find(':');
+	if (colon != string::npos)
+	{
+		port = atoi(host.c_str() + colon + 1);
+		host.erase(colon);
+	}
+
+	hostent *h = gethostbyname(host.c_str());
+	if (!h || h->h_addrtype != AF_INET)
+		return false;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_port = htons(port);
+	memcpy(&addr->sin_addr, h->h_addr_list[0], 4);
+
+	return true;
+}
+
+void sendPacket(int sock)
+{
+	sendto(sock, (const char *)packet.data, packet.cursize, 0,
+	       (sockaddr *)&master_addr, sizeof(master_addr));
+}
+
+//
+// readPacket
+//
+// Reads the next packet from the master into packet.  Returns false once
+// the socket has nothing left to read.
+//
+bool readPacket(int sock)
+{
+	sockaddr_in from;
+	socklen_t fromlen = sizeof(from);
+
+	while (true)
+	{
+		packet.clear();
+
+		int ret = recvfrom(sock, (char *)packet.data, packet.maxsize(), 0,
+		                   (sockaddr *)&from, &fromlen);
+		if (ret < 0)
+			return false;
+
+		if (from.sin_addr.s_addr != master_addr.sin_addr.s_addr ||
+		    from.sin_port != master_addr.sin_port)
+			continue;
+
+		packet.setcursize(ret);
+		return true;
+	}
+}
+
+void registerServer(simserver_t &s)
+{
+	packet.clear();
+	packet.WriteLong(SERVER_CHALLENGE);
+	sendPacket(s.sock);
+
+	total.registrations++;
+	interval.registrations++;
+}
+
+//
+// answerPing
+//
+// Replies to the master's ping with the same server info a game server
+// sends (see SV_SendServerInfo).
+//
+void answerPing(simserver_t &s, size_t index)
+{
+	if (packet.ReadLong() != LAUNCHER_CHALLENGE)
+		return;
+
+	int key = packet.ReadLong();
+	if (packet.overflowed)
+		return;
+
+	char hostname[64];
+	sprintf(hostname, "masterload server %d", (int)index);
+
+	packet.clear();
+	packet.WriteLong(SERVER_CHALLENGE);
+	packet.WriteLong(0);			// token
+	packet.WriteLong(key);
+	packet.WriteString(hostname);
+	packet.WriteByte(0);			// players
+	packet.WriteByte(8);			// maxplayers
+	packet.WriteString("MAP01");
+	packet.WriteByte(0);			// pwads
+	packet.WriteByte(1);			// gametype
+	packet.WriteByte(4);			// skill
+	packet.WriteByte(0);			// teamplay
+	packet.WriteByte(0);			// ctfmode
+	packet.WriteByte(0);			// players in game
+	sendPacket(s.sock);
+
+	s.pings++;
+	total.pings++;
+	interval.pings++;
+}
+
+void sendQuery(ustime_t now)
+{
+	if (idle_launchers.empty())
+	{
+		total.skipped++;
+		interval.skipped++;
+		return;
+	}
+
+	launcher_t &l = launchers[idle_launchers.front()];
+	idle_launchers.pop_front();
+
+	packet.clear();
+	packet.WriteLong(LAUNCHER_CHALLENGE);
+	sendPacket(l.sock);
+	l.sent = now;
+
+	total.queries++;
+	interval.queries++;
+}
+
+void readServerList(launcher_t &l, size_t index, ustime_t now)
+{
+	if (!l.sent)
+		return;		// a late reply to a query that was counted as lost
+
+	if (packet.ReadLong() != LAUNCHER_CHALLENGE)
+		return;
+
+	int count = packet.ReadShort() & 0xFFFF;
+
+	if (packet.overflowed || packet.BytesLeftToRead() != (size_t)count * 6)
+	{
+		total.malformed++;
+		interval.malformed++;
+	}
+	else
+	{
+		total.listed = interval.listed = count;
+	}
+
+	total.replies++;
+	interval.replies++;
+	total.latency.push_back(now - l.sent);
+	interval.latency.push_back(now - l.sent);
+
+	l.sent = 0;
+	idle_launchers.push_back(index);
+}
+
+void expireQueries(ustime_t now)
+{
+	for (size_t i = 0; i < launchers.size(); i++)
+	{
+		launcher_t &l = launchers[i];
+
+		if (l.sent && now - l.sent > QUERY_TIMEOUT_US)
+		{
+			l.sent = 0;
+			idle_launchers.push_back(i);
+
+			total.lost++;
+			interval.lost++;
+		}
+	}
+}
+
+ustime_t percentile(const vector<ustime_t> &sorted, int pct)
+{
+	if (sorted.empty())
+		return 0;
+
+	return sorted[(sorted.size() - 1) * pct / 100];
+}
+
+void printStats(const char *label, stats_t &s, double seconds)
+{
+	sort(s.latency.begin(), s.latency.end());
+
+	ustime_t sum = 0;
+	for (size_t i = 0; i < s.latency.size(); i++)
+		sum += s.latency[i];
+
+	printf("%s: reg %.0f/s, pings %.0f/s, queries %.0f/s, replies %.0f/s, "
+	       "skipped %d, lost %d, malformed %d, listed %d, "
+	       "latency avg %.0fus p50 %uus p99 %uus max %uus\n",
+	       label,
+	       s.registrations / seconds, s.pings / seconds,
+	       s.queries / seconds, s.replies / seconds,
+	       s.skipped, s.lost, s.malformed, s.listed,
+	       s.latency.empty() ? 0.0 : (double)sum / s.latency.size(),
+	       (unsigned)percentile(s.latency, 50),
+	       (unsigned)percentile(s.latency, 99),
+	       (unsigned)percentile(s.latency, 100));
+}
+
+void resetStats(stats_t &s)
+{
+	int listed = s.listed;
+
+	s = stats_t();
+	s.listed = listed;
+}
+
+void usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+	       "  -master <host[:port]>  master to load (default 127.0.0.1:%d)\n"
+	       "  -servers <n>           simulated servers (default %d)\n"
+	       "  -regrate <n>           registrations per second (default %d)\n"
+	       "  -queryrate <n>         launcher queries per second (default %d)\n"
+	       "  -launchers <n>         launchers, each with one query in flight (default %d)\n"
+	       "  -duration <s>          seconds to run for (default %d)\n",
+	       name, MASTERPORT, opts.servers, opts.regrate, opts.queryrate,
+	       opts.launchers, opts.duration);
+}
+
+bool parseArgs(int argc, char **argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+			return false;
+
+		const char *arg = argv[i];
+		const char *val = argv[++i];
+
+		if (!strcmp(arg, "-master"))
+			opts.master = val;
+		else if (!strcmp(arg, "-servers"))
+			opts.servers = atoi(val);
+		else if (!strcmp(arg, "-regrate"))
+			opts.regrate = atoi(val);
+		else if (!strcmp(arg, "-queryrate"))
+			opts.queryrate = atoi(val);
+		else if (!strcmp(arg, "-launchers"))
+			opts.launchers = atoi(val);
+		else if (!strcmp(arg, "-duration"))
+			opts.duration = atoi(val);
+		else
+			return false;
+	}
+
+	// A server at 127.1.x.0 or .255 would look odd in the master's logs.
+	return opts.servers > 0 && opts.servers <= 254 * 256 &&
+	       opts.launchers > 0 && opts.regrate >= 0 && opts.queryrate >= 0 &&
+	       opts.duration > 0;
+}
+
+//
+// raiseFileLimit
+//
+// Every simulated server needs a socket of its own.
+//
+bool raiseFileLimit(size_t needed)
+{
+	struct rlimit rl;
+
+	if (getrlimit(RLIMIT_NOFILE, &rl) == -1)
+		return false;
+
+	if (rl.rlim_cur >= needed)
+		return true;
+
+	if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < needed)
+		return false;
+
+	rl.rlim_cur = needed;
+	return setrlimit(RLIMIT_NOFILE, &rl) == 0;
+}
+
+int main(int argc, char **argv)
+{
+	opts.master = "127.0.0.1";
+	opts.servers = 200;
+	opts.launchers = 64;
+	opts.regrate = 1000;
+	opts.queryrate = 1000;
+	opts.duration = 30;
+
+	if (!parseArgs(argc, argv))
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!resolveMaster(opts.master, &master_addr))
+	{
+		printf("Could not resolve master %s\n", opts.master);
+		return 1;
+	}
+
+	if (!raiseFileLimit(opts.servers + opts.launchers + 16))
+	{
+		printf("Not allowed to open %d sockets\n", opts.servers + opts.launchers);
+		return 1;
+	}
+
+	simservers.resize(opts.servers);
+	for (size_t i = 0; i < simservers.size(); i++)
+	{
+		uint32_t ip = (127 << 24) | (1 << 16) | ((i / 254) << 8) | (i % 254 + 1);
+
+		simservers[i].sock = openSocket(ip);
+		simservers[i].pings = 0;
+
+		if (simservers[i].sock == -1)
+		{
+			printf("Could not open a socket for server %d: %s\n", (int)i, strerror(errno));
+			return 1;
+		}
+	}
+
+	launchers.resize(opts.launchers);
+	for (size_t i = 0; i < launchers.size(); i++)
+	{
+		launchers[i].sock = openSocket(INADDR_LOOPBACK);
+		launchers[i].sent = 0;
+
+		if (launchers[i].sock == -1)
+		{
+			printf("Could not open a launcher socket: %s\n", strerror(errno));
+			return 1;
+		}
+
+		idle_launchers.push_back(i);
+	}
+
+	// Servers come first in the poll list, then launchers.
+	vector<pollfd> fds(simservers.size() + launchers.size());
+	for (size_t i = 0; i < fds.size(); i++)
+	{
+		fds[i].fd = i < simservers.size() ? simservers[i].sock : launchers[i - simservers.size()].sock;
+		fds[i].events = POLLIN;
+	}
+
+	printf("Loading master %s:%d with %d servers, %d registrations/s, %d queries/s for %ds\n",
+	       inet_ntoa(master_addr.sin_addr), ntohs(master_addr.sin_port),
+	       opts.servers, opts.regrate, opts.queryrate, opts.duration);
+
+	ustime_t start = usTime();
+	ustime_t end = start + (ustime_t)opts.duration * 1000000;
+	ustime_t next_report = start + REPORT_INTERVAL_US;
+	ustime_t last_report = start;
+
+	// Packets owed since start, sent as their time comes round.
+	uint64_t regs_sent = 0, queries_sent = 0;
+	size_t next_server = 0;
+
+	ustime_t now = start;
+
+	while (now < end)
+	{
+		uint64_t regs_due = (uint64_t)(now - start) * opts.regrate / 1000000;
+		for (; regs_sent < regs_due; regs_sent++)
+		{
+			registerServer(simservers[next_server]);
+			next_server = (next_server + 1) % simservers.size();
+		}
+
+		uint64_t queries_due = (uint64_t)(now - start) * opts.queryrate / 1000000;
+		for (; queries_sent < queries_due; queries_sent++)
+			sendQuery(now);
+
+		if (poll(&fds[0], fds.size(), 1) > 0)
+		{
+			now = usTime();
+
+			for (size_t i = 0; i < fds.size(); i++)
+			{
+				if (!(fds[i].revents & POLLIN))
+					continue;
+
+				while (readPacket(fds[i].fd))
+				{
+					if (i < simservers.size())
+						answerPing(simservers[i], i);
+					else
+						readServerList(launchers[i - simservers.size()], i - simservers.size(), now);
+				}
+			}
+		}
+
+		now = usTime();
+		expireQueries(now);
+
+		if (now >= next_report)
+		{
+			printStats("last second", interval, (now - last_report) / 1e6);
+			resetStats(interval);
+
+			last_report = now;
+			next_report = now + REPORT_INTERVAL_US;
+		}
+	}
+
+	printStats("total", total, (now - start) / 1e6);
+
+	int answered = 0;
+	for (size_t i = 0; i < simservers.size(); i++)
+		if (simservers[i].pings)
+			answered++;
+
+	printf("%d of %d servers were pinged by the master\n", answered, (int)simservers.size());
+
+	for (size_t i = 0; i < simservers.size(); i++)
+		close(simservers[i].sock);
+	for (size_t i = 0; i < launchers.size(); i++)
+		close(launchers[i].sock);
+
+	return 0;
+}